@@ -28,6 +28,17 @@ typedef struct
 
 bool arena_init(arena_t *arena);
 void *arena_alloc(arena_t *arena, size_t size);
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align);
+/*
+ * Allocates room for `capacity` elements and copies the first `count` of
+ * `items` into it, for arrays that outgrow their allocation. The old one is
+ * not reclaimed until the arena goes.
+ */
+void *arena_grow(
+    arena_t *arena, const void *items, size_t count, size_t capacity, size_t element_size);
+size_t arena_used(const arena_t *arena);
+/* Frees every allocation at once but keeps the chunks, to be filled again in order. */
+void arena_reset(arena_t *arena);
 void arena_destroy(arena_t *arena);
 
 #endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _ASSEMBLER_H
+#define _ASSEMBLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * In-process x86-64 assembler for the instructions the backend emits. It
+ * takes the same mnemonics and register names as the text the emitter
+ * writes, one instruction at a time, and encodes them into a growable
+ * buffer. Jumps are always near (rel32) so nothing needs relaxing.
+ *
+ * Local labels are a prefix and one or two numbers as in the emitter and
+ * are resolved by assembler_finish. Symbols are left to whoever places the
+ * code: the assembler records where each is defined and every place that
+ * refers to one, either as a rel32 from the end of the instruction or as
+ * an absolute 64-bit word.
+ */
+
+#define ASSEMBLER_NO_REGISTER 0xff
+/* Base of rip-relative memory operands */
+#define ASSEMBLER_RIP 0xfe
+
+typedef enum {
+    ASSEMBLER_NONE,
+    ASSEMBLER_REGISTER,
+    ASSEMBLER_IMMEDIATE,
+    /* [base + index*scale + value], or [rip + target] */
+    ASSEMBLER_MEMORY,
+    /* A label or symbol as the target of a jump or call */
+    ASSEMBLER_TARGET
+} assembler_kind_t;
+
+/* A local label when `symbol` is NULL */
+typedef struct
+{
+    const char *symbol;
+    const char *prefix;
+    uint32_t first;
+    uint32_t second;
+} assembler_target_t;
+
+typedef struct
+{
+    uint8_t kind;
+    /* Bytes, 0 when a memory operand does not say */
+    uint8_t size;
+    /* The register, or the base of a memory operand */
+    uint8_t reg;
+    uint8_t index;
+    uint8_t scale;
+    /* Immediate or displacement */
+    int64_t value;
+    assembler_target_t target;
+} assembler_operand_t;
+
+typedef enum {
+    ASSEMBLER_REL32,
+    ASSEMBLER_ABS64,
+    /* 32-bit distance from `base` to the target, both labels */
+    ASSEMBLER_DIFFERENCE
+} assembler_fixup_kind_t;
+
+typedef struct
+{
+    assembler_target_t target;
+    assembler_target_t base;
+    uint8_t kind;
+    /* Offset of the field */
+    uint32_t at;
+    /* rel32 fields count from the end of their instruction */
+    uint32_t end;
+} assembler_fixup_t;
+
+typedef struct
+{
+    assembler_target_t target;
+    uint32_t offset;
+} assembler_definition_t;
+
+typedef struct
+{
+    uint8_t *code;
+    size_t size;
+    size_t capacity;
+    assembler_definition_t *labels;
+    uint32_t label_count;
+    uint32_t label_capacity;
+    /* Local label references until assembler_finish, then symbol references */
+    assembler_fixup_t *fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+    assembler_definition_t *symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    /* First problem met, sticky like writer errors */
+    const char *error;
+} assembler_t;
+
+void assembler_init(assembler_t *assembler);
+void assembler_destroy(assembler_t *assembler);
+/* Parses a register name such as "rax", "r10d" or "sil". */
+bool assembler_register(const char *name, uint8_t *number, uint8_t *size);
+/* Encodes one instruction; unsupported forms set `error`. */
+void assembler_instr(
+    assembler_t *assembler,
+    const char *mnemonic,
+    const assembler_operand_t *operands,
+    uint32_t count);
+/* Pads with int3 up to a multiple of `alignment`, a power of two. */
+void assembler_align(assembler_t *assembler, uint32_t alignment);
+void assembler_define(assembler_t *assembler, assembler_target_t target);
+void assembler_quad(assembler_t *assembler, assembler_target_t target);
+void assembler_difference(
+    assembler_t *assembler, assembler_target_t target, assembler_target_t base);
+/*
+ * Resolves local labels. Afterwards `fixups` lists only the symbol
+ * references and `symbols` their definitions. Returns false on any error.
+ */
+bool assembler_finish(assembler_t *assembler);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _AST_H
+#define _AST_H
+
+#include <arena.h>
+#include <intern.h>
+#include <lexer.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * The AST is stored as flat arrays inside an arena. Nodes refer to each other
+ * and to tokens by 32-bit indices; variable-length children (statement lists,
+ * parameters, arguments...) live as contiguous ranges of the `extra` array.
+ * Node 0 is always the root, so an index of 0 also means "no node".
+ */
+
+typedef uint32_t ast_index_t;
+
+#define AST_NONE 0
+
+typedef enum {
+    AST_ROOT,          /* lhs..rhs: declarations */
+    AST_FUNCTION,      /* token: name, lhs: extra[params_start, params_end, return], rhs: body */
+    AST_PARAM,         /* token: name, lhs: type */
+    AST_CLASS,         /* token: name, lhs..rhs: fields */
+    AST_FIELD,         /* token: name, lhs: type */
+    AST_INTERFACE,     /* token: name, lhs..rhs: bodiless functions */
+    AST_IMPL,          /* token: class name, lhs: extra[interface, methods_start, methods_end] */
+    AST_ENUM,          /* token: name, lhs..rhs: variants */
+    AST_ENUM_VARIANT,  /* token: name */
+    AST_TYPE_ALIAS,    /* token: name, lhs: type */
+    AST_LET,           /* token: name, lhs: type, rhs: initializer */
+    AST_BLOCK,         /* lhs..rhs: statements */
+    AST_LAZY_BODY,     /* token: '{', lhs: matching '}' token, not parsed yet */
+    AST_RETURN,        /* lhs: value */
+    AST_IF,            /* lhs: condition, rhs: extra[then, else] */
+    AST_FOR,           /* lhs: condition, rhs: body */
+    AST_SWITCH,        /* lhs: value, rhs: extra[cases_start, cases_end] */
+    AST_CASE,          /* lhs: extra[labels_start, labels_end], rhs: body block */
+    AST_BREAK,
+    AST_CONTINUE,
+    AST_FALL,
+    AST_SKIP,
+    AST_EXPR_STMT,     /* lhs: expression */
+    AST_ASSIGN,        /* op: assignment operator, lhs: target, rhs: value */
+    AST_BINARY,        /* op: operator, lhs, rhs: operands */
+    AST_UNARY,         /* op: operator, lhs: operand */
+    AST_CALL,          /* lhs: callee, rhs: extra[args_start, args_end] */
+    AST_MEMBER,        /* token: member name, lhs: object */
+    AST_PATH,          /* token: member name, lhs: namespace */
+    AST_IDENTIFIER,    /* token: name */
+    AST_INTEGER,       /* lhs: low 32 bits, rhs: high 32 bits */
+    AST_BOOL,          /* lhs: value */
+    AST_NULL,
+    AST_TYPE_NAME,     /* token: primitive keyword or identifier */
+    AST_FUNCTION_TYPE  /* lhs: extra[params_start, params_end, return_type] */
+} ast_kind_t;
+
+#define AST_FLAG_DEFAULT (1 << 0) /* AST_CASE: `default` arm */
+
+typedef struct
+{
+    uint8_t kind;
+    uint8_t op;
+    uint16_t flags;
+    uint32_t token;
+    ast_index_t lhs;
+    ast_index_t rhs;
+} ast_node_t;
+
+typedef struct
+{
+    arena_t *arena;
+    intern_t *interner;
+    token_t *tokens;
+    /* Interned name of each identifier token, INTERN_NONE for other tokens */
+    intern_id_t *names;
+    uint32_t token_count;
+    ast_node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+} ast_t;
+
+bool ast_init(ast_t *ast, arena_t *arena, intern_t *interner);
+bool ast_reserve(ast_t *ast, uint32_t nodes, uint32_t extra);
+ast_index_t ast_add_node(
+    ast_t *ast, ast_kind_t kind, uint32_t token, ast_index_t lhs, ast_index_t rhs);
+/* Appends `count` values to the extra array and returns the index of the first one. */
+uint32_t ast_add_extra(ast_t *ast, const uint32_t *values, uint32_t count);
+/*
+ * Appends the trees in `parts` to the freshly initialized `ast` as if their
+ * sources had been concatenated in order: indices are relocated, names are
+ * interned again into `ast->interner` and token lines are shifted by
+ * `line_offsets[i]`. Each part keeps its own TOKEN_EOF. The parts are only
+ * read, so they may live in arenas that are released afterwards.
+ */
+bool ast_merge(ast_t *ast, const ast_t *const *parts, uint32_t count, const size_t *line_offsets);
+/*
+ * Whether every token, node and extra index of `ast` is in bounds, every
+ * node kind is known and no node has two parents. For trees read back from
+ * storage, which may be damaged.
+ */
+bool ast_validate(const ast_t *ast);
+
+const char *ast_kind_name(ast_kind_t kind);
+void ast_dump(const ast_t *ast, ast_index_t node, FILE *out);
+
+#define ast_node(ast, index) (&(ast)->nodes[(index)])
+#define ast_token(ast, index) (&(ast)->tokens[(ast)->nodes[(index)].token])
+#define ast_name(ast, index) ((ast)->names[(ast)->nodes[(index)].token])
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <ast.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * On-disk cache of parsed files. An entry is keyed by a hash of the file's
+ * contents salted with the compiler version and the parser flags, and holds
+ * the tree exactly as it sits in memory: tokens, names, nodes and extra,
+ * followed by the identifiers the names refer to. Loading maps the entry
+ * and points the tree's arrays into the mapping, only the identifiers are
+ * interned again. Entries are written to a temporary file and renamed into
+ * place, so concurrent compiles never see half an entry.
+ */
+
+/* Part of every key, change it whenever the parser's output changes */
+#define CACHE_VERSION "dash-ast-2"
+
+typedef struct
+{
+    const char *directory;
+    uint64_t salt;
+} cache_t;
+
+/* Mapping an entry's tree points into, until cache_release */
+typedef struct
+{
+    void *data;
+    size_t size;
+} cache_entry_t;
+
+/* Fast 64-bit hash of `size` bytes, processed a word at a time */
+uint64_t cache_hash(const void *data, size_t size, uint64_t seed);
+
+/* Creates `directory` if needed, `flags` being the parser's */
+bool cache_init(cache_t *cache, const char *directory, unsigned flags);
+/* Key of the file whose contents hash to `hash` with a seed of 0 */
+uint64_t cache_key(const cache_t *cache, uint64_t hash);
+/*
+ * Fills the freshly initialized `ast` from the entry for `key`, false when
+ * there is none or it does not match. The tree stays read-only.
+ */
+bool cache_load(const cache_t *cache, uint64_t key, ast_t *ast, cache_entry_t *entry);
+bool cache_store(const cache_t *cache, uint64_t key, const ast_t *ast);
+void cache_release(cache_entry_t *entry);
+
+#endif
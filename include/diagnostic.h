@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _DIAGNOSTIC_H
+#define _DIAGNOSTIC_H
+
+#include <arena.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct
+{
+    size_t line;
+    size_t column;
+    const char *message;
+} diagnostic_t;
+
+/* One input of a multi-file compile, its lines follow `first_line` */
+typedef struct
+{
+    const char *path;
+    size_t first_line;
+} diagnostic_source_t;
+
+typedef struct
+{
+    arena_t *arena;
+    diagnostic_t *items;
+    uint32_t count;
+    uint32_t capacity;
+    /* Inputs in line order, when the lines span several files */
+    const diagnostic_source_t *sources;
+    uint32_t source_count;
+} diagnostics_t;
+
+void diagnostics_init(diagnostics_t *diagnostics, arena_t *arena);
+void diagnostics_add(
+    diagnostics_t *diagnostics, size_t line, size_t column, const char *format, ...);
+/*
+ * Line within its own file of a line of the merged input, setting `path` to
+ * that file's, or to NULL when there is a single input.
+ */
+size_t diagnostics_locate(const diagnostics_t *diagnostics, size_t line, const char **path);
+/* `path` names the input unless sources were set */
+void diagnostics_print(const diagnostics_t *diagnostics, FILE *out, const char *path);
+
+#endif
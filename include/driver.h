@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _DRIVER_H
+#define _DRIVER_H
+
+#include <arena.h>
+#include <ast.h>
+#include <cache.h>
+#include <diagnostic.h>
+#include <intern.h>
+#include <pool.h>
+#include <stdio.h>
+
+/*
+ * Front end over many input files. Every file is read, lexed and fully
+ * parsed by its own pool task into its own arena, interner and tree, so the
+ * workers never share an allocator. The trees are then merged in
+ * command-line order into a single ast_t, which makes everything after
+ * parsing, diagnostics included, independent of how the tasks were
+ * scheduled. The merged lines are numbered across the files, one after the
+ * other, and diagnostics map them back through their sources.
+ *
+ * With a cache, a file whose contents were parsed before is not lexed or
+ * parsed again: its tree is mapped from the cache entry instead.
+ *
+ * A driver given its inputs with driver_set_inputs lives across compiles
+ * and keeps every file parsed after the merge. The next compile reuses a
+ * tree as long as the file's inode, size and modification time, or failing
+ * that its contents, are the same, so only edited files are parsed again.
+ */
+
+/* Flags every file is parsed with, part of the cache key */
+#define DRIVER_PARSE_FLAGS 0
+
+/* What a file looked like when it was read */
+typedef struct
+{
+    uint64_t inode;
+    uint64_t size;
+    int64_t seconds;
+    int64_t nanoseconds;
+} driver_stamp_t;
+
+typedef struct
+{
+    const char *path;
+    intern_id_t path_id;
+    driver_stamp_t stamp;
+    /* Of the contents, valid while `ok` */
+    uint64_t hash;
+    arena_t arena;
+    intern_t interner;
+    ast_t ast;
+    diagnostics_t diagnostics;
+    size_t size;
+    /* Where the tree lives when it came from the cache */
+    cache_entry_t entry;
+    bool cached;
+    /* Kept from the previous compile */
+    bool reused;
+    /* Already among the paths driver_set_inputs is going through */
+    bool listed;
+    /* Reason the file has no diagnostics to explain its failure, if any */
+    const char *error;
+    /* Whether the arena is live, the merge releases it unless the driver persists */
+    bool loaded;
+    bool ok;
+} driver_file_t;
+
+typedef struct
+{
+    /* This compile's inputs, in order */
+    driver_file_t **files;
+    uint32_t file_count;
+    /* Optional, set after driver_init */
+    const cache_t *cache;
+    /* Set by driver_set_inputs: files are looked up by path and kept parsed */
+    bool persistent;
+    arena_t arena;
+    intern_t paths;
+    /* Indexed by path id, NULL for paths no longer given */
+    driver_file_t **by_path;
+    uint32_t path_capacity;
+    /* Totals over the files of the last driver_parse, for tracing */
+    size_t bytes;
+    uint32_t tokens;
+    uint32_t cache_hits;
+    uint32_t reused;
+} driver_t;
+
+bool driver_init(driver_t *driver, const char *const *paths, uint32_t count);
+/*
+ * Replaces the inputs of a persistent driver, which must have been zeroed
+ * before the first call. Files given before keep their trees, the ones left
+ * out are released and repeated paths only count once. The paths are
+ * copied.
+ */
+bool driver_set_inputs(driver_t *driver, const char *const *paths, uint32_t count);
+void driver_destroy(driver_t *driver);
+/* Reads and parses every file on `pool`, false when any of them failed. */
+bool driver_parse(driver_t *driver, pool_t *pool);
+/* Prints each file's errors, in the order the files were given. */
+void driver_report(const driver_t *driver, FILE *out);
+/*
+ * Merges the parsed files into the freshly initialized `ast` and points
+ * `diagnostics` at them. The files' arenas are released unless the driver
+ * is persistent.
+ */
+bool driver_merge(driver_t *driver, ast_t *ast, diagnostics_t *diagnostics);
+
+#endif
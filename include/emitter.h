@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _EMITTER_H
+#define _EMITTER_H
+
+#include <assembler.h>
+#include <stdint.h>
+#include <writer.h>
+
+/*
+ * GNU assembler text (Intel syntax) written straight into a writer. A line
+ * is a mnemonic or directive and its operands; the operand calls add the
+ * separators themselves, so
+ *
+ *   emitter_instr(e, "mov");
+ *   emitter_register(e, "rax");
+ *   emitter_memory(e, "qword", "rbp", NULL, 1, -8);
+ *   emitter_end(e);
+ *
+ * writes "\tmov rax, qword ptr [rbp - 8]\n". Operands with other shapes
+ * start with emitter_operand() and are spelled with the fragment calls.
+ * Local labels are a prefix and one or two numbers: ".L3_7" is
+ * emitter_local(e, ".L", 3, 7), ".Lvtable2" is emitter_local(e, ".Lvtable",
+ * 2, EMITTER_NO_NUMBER).
+ *
+ * An emitter made with emitter_init_assembler encodes the same calls into
+ * an assembler instead. Only the structured calls work there: fragments
+ * set the assembler's error, and emitter_line drops the directive, since
+ * sections and symbol types mean nothing to code placed in memory.
+ */
+
+#define EMITTER_NO_NUMBER UINT32_MAX
+
+typedef struct
+{
+    writer_t *writer;
+    assembler_t *assembler;
+    /* Operands on the current line so far */
+    uint32_t operands;
+    /* The instruction being built for the assembler */
+    const char *mnemonic;
+    assembler_operand_t pending[3];
+} emitter_t;
+
+void emitter_init(emitter_t *emitter, writer_t *writer);
+void emitter_init_assembler(emitter_t *emitter, assembler_t *assembler);
+/* Whether the writer or assembler behind `emitter` failed. */
+bool emitter_failed(const emitter_t *emitter);
+
+/* Fragments, written as they are */
+void emitter_text(emitter_t *emitter, const char *text);
+void emitter_unsigned(emitter_t *emitter, uint64_t value);
+void emitter_signed(emitter_t *emitter, int64_t value);
+void emitter_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second);
+
+/* Lines */
+void emitter_instr(emitter_t *emitter, const char *mnemonic);
+void emitter_end(emitter_t *emitter);
+/* A whole line without operands, "\t.text\n" for ".text". */
+void emitter_line(emitter_t *emitter, const char *text);
+/* "<label>:\n" for a local label. */
+void emitter_define_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second);
+/* "<name>:\n" for a symbol. */
+void emitter_define_symbol(emitter_t *emitter, const char *name);
+/* ".p2align <log2>" */
+void emitter_align(emitter_t *emitter, uint32_t log2);
+/* Aligns to 16 bytes and starts function `name`, exported when `global`. */
+void emitter_begin_function(emitter_t *emitter, const char *name, bool global);
+void emitter_end_function(emitter_t *emitter, const char *name);
+/* ".quad <name>" */
+void emitter_quad_symbol(emitter_t *emitter, const char *name);
+/* ".long <label> - <base>" for jump tables. */
+void emitter_long_difference(
+    emitter_t *emitter,
+    const char *prefix,
+    uint32_t first,
+    uint32_t second,
+    const char *base_prefix,
+    uint32_t base_first,
+    uint32_t base_second);
+
+/* Operands */
+void emitter_operand(emitter_t *emitter);
+void emitter_register(emitter_t *emitter, const char *name);
+void emitter_immediate(emitter_t *emitter, int64_t value);
+/*
+ * `size` ptr [base + index*scale + displacement]. `index` may be NULL, and
+ * `size` too for the bare address lea takes.
+ */
+void emitter_memory(
+    emitter_t *emitter,
+    const char *size,
+    const char *base,
+    const char *index,
+    uint32_t scale,
+    int64_t displacement);
+/* A local label as a jump target or data word. */
+void emitter_local_operand(
+    emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second);
+/* A symbol as a jump or call target. */
+void emitter_symbol_operand(emitter_t *emitter, const char *name);
+/* The address of a local label or symbol, "[rip + <label>]". */
+void emitter_rip_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second);
+void emitter_rip_symbol(emitter_t *emitter, const char *name);
+
+#endif
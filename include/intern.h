@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _INTERN_H
+#define _INTERN_H
+
+#include <arena.h>
+#include <stdint.h>
+
+/*
+ * String interner mapping each distinct identifier to a small dense id, so
+ * later passes compare and hash names as integers. Id 0 is never assigned.
+ */
+
+typedef uint32_t intern_id_t;
+
+#define INTERN_NONE 0
+
+typedef struct
+{
+    const char *string;
+    uint32_t hash;
+    uint32_t length;
+} intern_entry_t;
+
+typedef struct
+{
+    arena_t *arena;
+    intern_id_t *slots;
+    uint32_t slot_mask;
+    intern_entry_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+} intern_t;
+
+bool intern_init(intern_t *interner, arena_t *arena);
+intern_id_t intern(intern_t *interner, const char *string, size_t length);
+/* Returns the id of an already interned string, or INTERN_NONE. */
+intern_id_t intern_find(const intern_t *interner, const char *string, size_t length);
+const char *intern_string(const intern_t *interner, intern_id_t id);
+
+#endif
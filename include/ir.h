@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _IR_H
+#define _IR_H
+
+#include <arena.h>
+#include <ast.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * SSA intermediate representation. Like the AST it is made of flat arrays of
+ * small records linked by 32-bit indices: every instruction of a function
+ * lives in `instrs` and is named by its index, which is also the SSA value it
+ * defines. Blocks list their instructions in order, phis first and exactly
+ * one terminator last. Variable-length operand lists (phi inputs, call
+ * arguments) are ranges of `operands`; phi inputs follow the order of the
+ * block's predecessors. Index 0 is never a valid value or instruction.
+ */
+
+typedef uint32_t ir_value_t;
+
+#define IR_NONE 0
+
+typedef enum {
+    IR_VOID,
+    IR_BOOL,
+    IR_I8,
+    IR_I16,
+    IR_I32,
+    IR_I64,
+    IR_U8,
+    IR_U16,
+    IR_U32,
+    IR_U64,
+    /* Object references, function addresses */
+    IR_PTR
+} ir_type_t;
+
+typedef enum {
+    IR_NOP,
+    IR_CONST,         /* a: low 32 bits, b: high 32 bits */
+    IR_PARAM,         /* a: parameter index */
+    IR_PHI,           /* a..a+b: operands, one per predecessor */
+    IR_COPY,          /* a: value */
+    IR_ADD,           /* a, b: operands */
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,           /* signedness follows the type */
+    IR_MOD,
+    IR_NEG,           /* a: operand */
+    IR_NOT,           /* a: boolean operand */
+    IR_EQ,            /* a, b: operands, result is IR_BOOL */
+    IR_NE,
+    IR_LT,            /* signedness follows the operands' type */
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_BIT_TEST,      /* a: bit index below 64, b: mask; (b >> a) & 1 */
+    IR_FUNC_ADDR,     /* a: function index */
+    IR_VTABLE,        /* a: module vtable index */
+    IR_METHOD,        /* a: vtable, b: slot, c: interface declaration; the slot's function */
+    IR_CALL,          /* a: function index, b..b+c: arguments */
+    IR_CALL_INDIRECT, /* a: callee value, b..b+c: arguments */
+    IR_CALL_SECOND,   /* a: preceding call returning a pair; the vtable half */
+    IR_NEW,           /* a: size in bytes, b: class declaration */
+    IR_LOAD,          /* a: object, b: byte offset */
+    IR_STORE,         /* a: object, b: value, c: byte offset */
+    IR_JUMP,          /* a: target block */
+    IR_BRANCH,        /* a: condition, b: then block, c: else block */
+    IR_SWITCH,        /* a: value, b: default block, then c (low, high, block) cases */
+    IR_JUMP_TABLE,    /* a: index below c, b..b+c: target blocks */
+    IR_RETURN,        /* a: value or IR_NONE, b: vtable of a returned pair or IR_NONE */
+    IR_UNREACHABLE
+} ir_op_t;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t block;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} ir_instr_t;
+
+typedef struct
+{
+    ir_value_t *instrs;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *preds;
+    uint32_t pred_count;
+    uint32_t pred_capacity;
+} ir_block_t;
+
+typedef struct
+{
+    const char *name;
+    ast_index_t declaration;
+    ir_type_t result;
+    /* Interface results come back as (object, vtable), see IR_CALL_SECOND */
+    bool returns_pair;
+    uint32_t param_count;
+    uint8_t *param_types;
+    ir_instr_t *instrs;
+    uint32_t instr_count;
+    uint32_t instr_capacity;
+    uint32_t *operands;
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+    /* None when the function was compiled earlier and is only called from here */
+    ir_block_t *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    /* Set when the function could not be lowered */
+    const char *error;
+    ast_index_t error_node;
+} ir_function_t;
+
+/*
+ * Method table of an impl of an interface: the function implementing each
+ * interface method, in the interface's declaration order. Interface values
+ * are fat pointers, an (object, vtable) pair kept in two SSA values, two
+ * parameters or two field slots, so objects carry no header.
+ */
+typedef struct
+{
+    ast_index_t impl;
+    ast_index_t class;
+    ast_index_t interface;
+    uint32_t *methods;
+    uint32_t method_count;
+} ir_vtable_t;
+
+typedef struct
+{
+    arena_t *arena;
+    const ast_t *ast;
+    ir_function_t *functions;
+    uint32_t function_count;
+    /* Sorted by impl node */
+    ir_vtable_t *vtables;
+    uint32_t vtable_count;
+    /* Set when later modules may add impls, so no interface is known to have just one */
+    bool open;
+    /* IR function index of each AST function node, by node index */
+    uint32_t *function_of_node;
+    /* One arena per pool worker for function bodies */
+    arena_t *worker_arenas;
+    uint32_t worker_count;
+} ir_module_t;
+
+bool ir_module_init(ir_module_t *module, arena_t *arena, const ast_t *ast, uint32_t workers);
+void ir_module_destroy(ir_module_t *module);
+/* Index of the vtable built for `impl`, UINT32_MAX if there is none. */
+uint32_t ir_find_vtable(const ir_module_t *module, ast_index_t impl);
+
+/* Builder: all growth happens in `arena`, which may differ between calls. */
+uint32_t ir_add_block(ir_function_t *function, arena_t *arena);
+ir_value_t ir_add_instr(
+    ir_function_t *function,
+    arena_t *arena,
+    ir_op_t op,
+    ir_type_t type,
+    uint32_t a,
+    uint32_t b,
+    uint32_t c);
+/* Creates an instruction and appends it to `block`. */
+ir_value_t ir_append(
+    ir_function_t *function,
+    arena_t *arena,
+    uint32_t block,
+    ir_op_t op,
+    ir_type_t type,
+    uint32_t a,
+    uint32_t b,
+    uint32_t c);
+ir_value_t ir_append_const(
+    ir_function_t *function, arena_t *arena, uint32_t block, ir_type_t type, uint64_t value);
+bool ir_block_push(ir_function_t *function, arena_t *arena, uint32_t block, ir_value_t value);
+bool ir_add_pred(ir_function_t *function, arena_t *arena, uint32_t block, uint32_t pred);
+/* Switch case `index`, see IR_SWITCH. */
+uint64_t ir_switch_value(const ir_function_t *function, const ir_instr_t *instr, uint32_t index);
+uint32_t ir_switch_target(const ir_function_t *function, const ir_instr_t *instr, uint32_t index);
+/* Reserves `count` operands, copied from `values` when not NULL; returns the first index. */
+uint32_t ir_add_operands(
+    ir_function_t *function, arena_t *arena, const uint32_t *values, uint32_t count);
+/* Drops predecessor `index` of `block` together with the matching phi inputs. */
+void ir_remove_pred(ir_function_t *function, uint32_t block, uint32_t index);
+uint32_t ir_pred_index(const ir_function_t *function, uint32_t block, uint32_t pred);
+
+uint64_t ir_const_value(const ir_instr_t *instr);
+void ir_set_const(ir_instr_t *instr, uint64_t value);
+unsigned ir_type_bits(ir_type_t type);
+bool ir_type_signed(ir_type_t type);
+/* Wraps `value` to the width of `type`, sign or zero extending it back to 64 bits. */
+uint64_t ir_wrap(ir_type_t type, uint64_t value);
+bool ir_is_terminator(ir_op_t op);
+/* Whether removing an unused instance could change behaviour. */
+bool ir_has_side_effects(const ir_function_t *function, ir_value_t value);
+const char *ir_op_name(ir_op_t op);
+
+ir_value_t ir_terminator(const ir_function_t *function, uint32_t block);
+uint32_t ir_successor_count(const ir_function_t *function, uint32_t block);
+uint32_t ir_successor(const ir_function_t *function, uint32_t block, uint32_t index);
+/* Calls visit(context, &operand) for every value operand of `value`. */
+void ir_for_each_operand(
+    ir_function_t *function, ir_value_t value, void (*visit)(void *, uint32_t *), void *context);
+/* Calls visit(context, &target) for every successor block named by a terminator. */
+void ir_for_each_target(
+    ir_function_t *function, ir_value_t value, void (*visit)(void *, uint32_t *), void *context);
+/*
+ * Replaces every edge from `old` into `block` by edges from `preds`. Phi
+ * inputs for the new edges take the value that flowed in from `old`.
+ */
+bool ir_replace_pred(
+    ir_function_t *function,
+    arena_t *arena,
+    uint32_t block,
+    uint32_t old,
+    const uint32_t *preds,
+    uint32_t count);
+
+/*
+ * Reverse postorder of the blocks reachable from the entry block. `order`
+ * needs room for block_count entries; returns how many were reached.
+ */
+uint32_t ir_reverse_postorder(const ir_function_t *function, uint32_t *order);
+/* Immediate dominators (Cooper, Harvey & Kennedy), idom[entry] = entry, unreached = -1. */
+void ir_dominators(
+    const ir_function_t *function, const uint32_t *order, uint32_t count, uint32_t *idom);
+
+/* Checks structural invariants, writing the first problem into `error`. */
+bool ir_verify(const ir_function_t *function, char *error, size_t size);
+void ir_dump_function(const ir_module_t *module, const ir_function_t *function, FILE *out);
+void ir_dump(const ir_module_t *module, FILE *out);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _JIT_H
+#define _JIT_H
+
+#include <arena.h>
+#include <intern.h>
+#include <ir.h>
+#include <stdint.h>
+
+/*
+ * Native code compiled in process. The x86 backend emits through the
+ * in-process assembler, and each module's code is copied into a private
+ * mapping and linked against everything placed before it by symbol name,
+ * so later modules call earlier functions directly. Functions and vtables
+ * already placed are skipped when a module defines them again.
+ *
+ * The mapping reserves JIT_CODE_SIZE bytes of address space up front so
+ * every rel32 reaches; pages are written, then made read-only and
+ * executable, never both writable and executable. `__dash_alloc` is a stub
+ * calling back into C for objects, which live in `heap` until jit_destroy.
+ */
+
+#define JIT_CODE_SIZE (256 << 20)
+
+typedef struct
+{
+    uint8_t *code;
+    /* Bytes placed so far, each module starting on a fresh page */
+    size_t size;
+    size_t page_size;
+    arena_t arena;
+    intern_t symbols;
+    /* Address of each symbol by intern id, NULL until placed */
+    uint8_t **addresses;
+    uint32_t address_capacity;
+    arena_t heap;
+    /* Set when compiling or running fails */
+    const char *error;
+} jit_t;
+
+bool jit_init(jit_t *jit);
+void jit_destroy(jit_t *jit);
+/*
+ * Compiles the functions and vtables of `module` that are not placed yet.
+ * Lowers any IR_SWITCH left first. On failure nothing of the module is
+ * kept and `error` says why.
+ */
+bool jit_add_module(jit_t *jit, ir_module_t *module);
+/* Entry of Dash function `name`, NULL if it was never compiled. */
+void *jit_find_function(const jit_t *jit, const char *name);
+/*
+ * Runs function `name`, which takes no parameters. `result` gets the
+ * returned value, or its object half for interface results. Traps (a
+ * division by zero, unreachable code or a crash such as a stack overflow)
+ * are caught and return false with `error` set. Not reentrant.
+ */
+bool jit_call(jit_t *jit, const char *name, uint64_t *result);
+
+#endif
@@ -89,9 +89,12 @@ typedef enum {
     TOKEN_RIGHT_BRACE
 } token_type_t;
 
+/* Room for the digits of any 64-bit literal and one more, to tell it overflows */
+#define LEXER_VALUE_SIZE 24
+
 typedef struct
 {
-    char value[16];
+    char value[LEXER_VALUE_SIZE];
     size_t line;
     size_t column;
     token_type_t type;
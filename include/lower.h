@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _LOWER_H
+#define _LOWER_H
+
+#include <diagnostic.h>
+#include <ir.h>
+#include <pool.h>
+#include <sema.h>
+
+/*
+ * Lowers every checked function and method with a body to SSA form, one IR
+ * function each in declaration order. SSA is built directly while walking
+ * the AST (Braun et al., "Simple and Efficient Construction of Static Single
+ * Assignment Form"), so no dominance frontiers are needed. Bodies are lowered
+ * on `pool` when given, each worker allocating from its own module arena.
+ * Functions of settled declarations (see sema_t) only get their signature.
+ */
+bool lower_module(
+    ir_module_t *module, const sema_t *sema, pool_t *pool, diagnostics_t *diagnostics);
+
+/* Byte offset of `field` in objects of its class, and the size of those objects. */
+uint32_t lower_field_offset(const sema_t *sema, ast_index_t class, ast_index_t field);
+uint32_t lower_class_size(const sema_t *sema, ast_index_t class);
+
+#endif
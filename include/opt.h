@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _OPT_H
+#define _OPT_H
+
+#include <ir.h>
+#include <pool.h>
+
+/*
+ * IR optimization passes. Every pass can be run on its own and records a
+ * trace span under its name, so --time-report shows where the time goes:
+ *
+ *   devirt    turns interface calls into direct calls when the vtable is
+ *             known or the interface has a single impl
+ *   inline    copies small non-recursive callees into their call sites,
+ *             one level per run
+ *   fold      evaluates constant operations and branches, simplifies
+ *             algebraic identities
+ *   copyprop  forwards copies and trivial phis to their uses
+ *   cse       shares pure computations along the dominator tree
+ *   dce       drops unreachable blocks and instructions nobody uses
+ *   switch    lowers IR_SWITCH to jump tables, bit tests and compare trees
+ *
+ * All passes but devirt and inline work on one function at a time and run
+ * on `pool` when given. Functions that failed to lower, or have no body in
+ * this module, are left alone.
+ */
+
+#define OPT_DEFAULT_PASSES \
+    "devirt,inline,fold,copyprop,cse,dce,devirt,switch,fold,copyprop,cse,dce"
+
+/* Callees with at most this many instructions are inlined */
+#define OPT_INLINE_LIMIT 32
+
+/*
+ * devirt treats the module as the whole program unless it is open: an
+ * interface with a single impl dispatches to it unconditionally. Vtables
+ * merged by phis are followed this deep.
+ */
+#define OPT_DEVIRT_PHI_DEPTH 4
+
+/*
+ * Switch lowering: runs of cases within 64 values that reach at most a few
+ * blocks become bit tests, runs filling at least OPT_TABLE_MIN_DENSITY percent
+ * of their range become jump tables, and the remaining clusters are found by
+ * binary search, ending in a short chain of comparisons.
+ */
+#define OPT_BIT_TEST_MAX_TARGETS 3
+#define OPT_BIT_TEST_MIN_CASES 3
+#define OPT_TABLE_MIN_CASES 4
+#define OPT_TABLE_MIN_DENSITY 40
+#define OPT_TABLE_MAX_SIZE 4096
+#define OPT_SWITCH_CHAIN_CLUSTERS 3
+
+bool opt_has_pass(const char *name, size_t length);
+/* Returns false when there is no pass called `name`. */
+bool opt_run_pass(ir_module_t *module, const char *name, pool_t *pool);
+/* Runs a comma separated list of passes in order, stopping at an unknown name. */
+bool opt_run_passes(ir_module_t *module, const char *passes, pool_t *pool);
+
+#endif
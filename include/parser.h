@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _PARSER_H
+#define _PARSER_H
+
+#include <ast.h>
+#include <diagnostic.h>
+#include <lexer.h>
+
+/*
+ * Grammar overview:
+ *
+ *   declaration := function | class | interface | impl | enum | type | let
+ *   function    := 'function' NAME '(' (NAME ':' type),* ')' ('->' type)? block
+ *   class       := 'class' NAME '{' (NAME ':' type ';')* '}'
+ *   interface   := 'interface' NAME '{' (function signature ';')* '}'
+ *   impl        := 'impl' NAME (':' NAME)? '{' function* '}'
+ *   enum        := 'enum' NAME '{' NAME,* '}'
+ *   type        := 'type' NAME '=' type ';'
+ *   let         := 'let' NAME (':' type)? ('=' expression)? ';'
+ *   switch      := 'switch' expression '{' ((expression,+ | 'default') ':' statement*)* '}'
+ */
+
+/*
+ * With PARSER_LAZY_BODIES only function signatures are parsed eagerly; each
+ * body is skipped by brace matching and recorded as an AST_LAZY_BODY token
+ * range, to be parsed by parser_parse_body the first time a pass needs it.
+ */
+#define PARSER_LAZY_BODIES (1 << 0)
+
+/* Lexes the whole input into `ast->tokens`, always ending with TOKEN_EOF. */
+bool parser_tokenize(ast_t *ast, lexer_t *lexer, diagnostics_t *diagnostics);
+/*
+ * Like parser_tokenize, with the `count` tokens of `prefix` first, which
+ * were lexed before and do not end with TOKEN_EOF.
+ */
+bool parser_tokenize_after(
+    ast_t *ast, const token_t *prefix, uint32_t count, lexer_t *lexer, diagnostics_t *diagnostics);
+bool parser_parse(ast_t *ast, diagnostics_t *diagnostics, unsigned flags);
+/* Returns the parsed body block of `function`, parsing it first if it is lazy. */
+ast_index_t parser_parse_body(ast_t *ast, ast_index_t function, diagnostics_t *diagnostics);
+/* Parses every lazy body left in the tree. */
+bool parser_parse_bodies(ast_t *ast, diagnostics_t *diagnostics);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Work-stealing thread pool for data-parallel phases. pool_run() splits the
+ * task indices [0, count) into one contiguous share per worker; a worker
+ * takes tasks from the bottom of its own share and, once it runs dry, steals
+ * from the top of the others', so uneven tasks still balance out. Shares are
+ * lock-free Chase-Lev deques. The calling thread takes part as worker 0.
+ */
+
+#define POOL_CACHE_LINE 64
+
+typedef void (*pool_task_t)(void *context, uint32_t worker, uint32_t task);
+
+typedef struct
+{
+    int64_t top;
+    char top_padding[POOL_CACHE_LINE - sizeof(int64_t)];
+    int64_t bottom;
+    char bottom_padding[POOL_CACHE_LINE - sizeof(int64_t)];
+} pool_deque_t;
+
+typedef struct
+{
+    uint32_t worker_count;
+    pool_deque_t *deques;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    /* Bumped by every pool_run() to release the workers */
+    uint32_t generation;
+    uint32_t busy;
+    bool stopping;
+    const char *name;
+    pool_task_t task;
+    void *context;
+} pool_t;
+
+/* Number of online processors, at least 1. */
+uint32_t pool_cpu_count(void);
+/* Starts `worker_count - 1` threads; 0 means one worker per processor. */
+bool pool_init(pool_t *pool, uint32_t worker_count);
+/* Runs task(context, worker, i) for every i in [0, count) and waits for all of them. */
+void pool_run(pool_t *pool, const char *name, uint32_t count, pool_task_t task, void *context);
+void pool_destroy(pool_t *pool);
+
+#endif
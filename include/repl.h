@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _REPL_H
+#define _REPL_H
+
+#include <jit.h>
+#include <lexer.h>
+#include <stdio.h>
+
+/*
+ * Interactive session on top of the JIT. An entry starting with a
+ * declaration keyword (function, class, interface, impl, enum, type, let)
+ * joins the session's definitions once it checks; anything else is run as
+ * the body of a fresh function and its value printed when it has an
+ * integer or bool type.
+ *
+ * Only the entry is lexed, with reader_from_string, and only its bodies are
+ * parsed, checked and compiled. The definitions so far are kept as tokens
+ * and just bind their signatures again; their functions and vtables stay
+ * placed in the JIT and new code links against them. No assembler or linker
+ * runs.
+ */
+
+typedef struct
+{
+    jit_t jit;
+    /* Tokens of the definitions accepted so far, without a TOKEN_EOF */
+    token_t *tokens;
+    uint32_t token_count;
+    uint32_t token_capacity;
+    size_t line_count;
+    /* Top-level declarations among `tokens` */
+    uint32_t declaration_count;
+    /* Source of the entry being checked */
+    char *text;
+    size_t length;
+    size_t capacity;
+    /* Expression entries run so far, each gets its own function */
+    uint32_t entry_count;
+    const char *passes;
+} repl_t;
+
+bool repl_init(repl_t *repl, const char *passes);
+void repl_destroy(repl_t *repl);
+/*
+ * Checks, compiles and runs one entry. Results go to `out`, diagnostics and
+ * traps to `err`; returns false when the entry failed, which leaves the
+ * session as it was.
+ */
+bool repl_eval(repl_t *repl, const char *entry, FILE *out, FILE *err);
+/*
+ * Reads entries from `in` until its end, one per line unless braces are
+ * left open. Prompts on `out` when `prompt` is set.
+ */
+void repl_run(repl_t *repl, FILE *in, FILE *out, FILE *err, bool prompt);
+
+#endif
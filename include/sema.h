@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _SEMA_H
+#define _SEMA_H
+
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <pool.h>
+#include <pthread.h>
+#include <symbols.h>
+#include <types.h>
+
+#define AST_FLAG_GLOBAL (1 << 1) /* AST_LET: top-level constant */
+
+/* Open-addressing map from a pair of 32-bit keys to a 32-bit value */
+typedef struct
+{
+    uint32_t first;
+    uint32_t second;
+    uint32_t value;
+} sema_entry_t;
+
+typedef struct
+{
+    sema_entry_t *entries;
+    uint32_t mask;
+    uint32_t count;
+} sema_map_t;
+
+/* A top-level declaration or method analysed as one unit of work */
+typedef struct
+{
+    ast_index_t node;
+    /* Impl of a method, AST_NONE otherwise */
+    ast_index_t owner;
+    /* Where the task's diagnostics were recorded */
+    uint32_t worker;
+    uint32_t first_diagnostic;
+    uint32_t diagnostic_count;
+    bool ok;
+    /* Part of one of the first `settled_count` declarations, its body is skipped */
+    bool settled;
+} sema_task_t;
+
+typedef struct
+{
+    arena_t arena;
+    diagnostics_t diagnostics;
+    symbols_t locals;
+} sema_worker_t;
+
+typedef struct
+{
+    ast_t *ast;
+    arena_t *arena;
+    diagnostics_t *diagnostics;
+    symbols_t globals;
+    intern_id_t self_name;
+    types_t types;
+    /* (class, method name) -> method function */
+    sema_map_t methods;
+    /* (class, interface) -> impl */
+    sema_map_t implements;
+    /* Declaration each identifier, type name, member or path resolves to, by node index */
+    ast_index_t *declarations;
+    /* Type of each expression and declaration, by node index */
+    type_id_t *node_types;
+    uint32_t node_capacity;
+    /* Runs resolution and checking of bodies in parallel when set */
+    pool_t *pool;
+    sema_worker_t *workers;
+    uint32_t worker_count;
+    sema_task_t *tasks;
+    uint32_t task_count;
+    /*
+     * Leading top-level declarations whose bodies an earlier run over the
+     * same source already checked. Their signatures are bound again but
+     * their bodies are not resolved, checked or even parsed when lazy.
+     */
+    uint32_t settled_count;
+    /* Serializes interning into `types` while bodies are checked concurrently */
+    pthread_mutex_t types_lock;
+} sema_t;
+
+bool sema_init(sema_t *sema, ast_t *ast, arena_t *arena, diagnostics_t *diagnostics);
+void sema_destroy(sema_t *sema);
+/* Binds every top-level declaration; only needs function signatures. */
+bool sema_declare(sema_t *sema);
+/* Resolves names in signatures and function bodies, parsing lazy bodies as needed. */
+bool sema_resolve(sema_t *sema);
+/* Type checks declarations and then every function body. */
+bool sema_check(sema_t *sema);
+
+/* Evaluates a checked constant expression (literals, enum variants, global lets). */
+bool sema_eval_constant(const sema_t *sema, ast_index_t node, uint64_t *value);
+uint32_t sema_map_find(const sema_map_t *map, uint32_t first, uint32_t second);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <arena.h>
+#include <driver.h>
+#include <intern.h>
+#include <pool.h>
+#include <stdio.h>
+
+/*
+ * Long-running compiler for build systems and editors, which issue many
+ * small compiles and would otherwise pay for starting cold every time. The
+ * worker pool, the interned identifiers and the driver's parsed files live
+ * as long as the server; the arena every compile allocates from is reset,
+ * not freed, between requests. Only files that changed since the previous
+ * request are read and parsed again.
+ *
+ * A request is one line holding the arguments of a `dash` command line,
+ * separated by whitespace. The reply is a line "<status> <out> <err>",
+ * the exit status and the byte counts of the compile's output and errors,
+ * followed by those bytes. A "stop" request is answered with "0 0 0" and
+ * ends the server once the connection closes.
+ */
+
+#define SERVER_STOP "stop"
+
+typedef struct server server_t;
+
+/* Compiles one request's command line, `argv[0]` being "dash" */
+typedef int (*server_compile_t)(server_t *server, int argc, char **argv, FILE *out, FILE *err);
+
+struct server
+{
+    pool_t *pool;
+    /* Reset before every request */
+    arena_t arena;
+    /* Holds the identifiers, kept across requests */
+    arena_t names;
+    intern_t interner;
+    driver_t driver;
+    server_compile_t compile;
+    uint32_t request_count;
+    bool stopping;
+};
+
+bool server_init(server_t *server, pool_t *pool, server_compile_t compile);
+void server_destroy(server_t *server);
+/* Answers the requests read from `in` on `out`, until its end or a stop. */
+void server_serve(server_t *server, FILE *in, FILE *out);
+/*
+ * Serves one connection after the other on the Unix socket at `path`,
+ * replacing a stale socket left there, until a stop. False when the socket
+ * could not be set up.
+ */
+bool server_listen(server_t *server, const char *path);
+
+#endif
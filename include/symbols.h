@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _SYMBOLS_H
+#define _SYMBOLS_H
+
+#include <arena.h>
+#include <ast.h>
+#include <intern.h>
+
+/*
+ * Scoped symbol table. Bindings are pushed on a single shadow stack and an
+ * open-addressing table maps each name to its innermost binding; a binding
+ * remembers the one it shadows, so entering a scope is O(1) and leaving it
+ * only touches the bindings it introduced. Name slots are never removed, a
+ * popped name simply points back at the binding it shadowed (or none).
+ */
+
+typedef enum {
+    SYMBOL_LET,
+    SYMBOL_PARAM,
+    SYMBOL_SELF,
+    SYMBOL_FUNCTION,
+    SYMBOL_CLASS,
+    SYMBOL_INTERFACE,
+    SYMBOL_ENUM,
+    SYMBOL_TYPE_ALIAS
+} symbol_kind_t;
+
+typedef uint32_t symbol_index_t;
+
+#define SYMBOL_NONE 0
+
+typedef struct
+{
+    intern_id_t name;
+    symbol_kind_t kind;
+    ast_index_t declaration;
+    symbol_index_t shadowed;
+    uint32_t depth;
+} symbol_t;
+
+typedef struct
+{
+    intern_id_t name;
+    symbol_index_t binding;
+} symbol_slot_t;
+
+typedef struct symbols symbols_t;
+
+struct symbols
+{
+    arena_t *arena;
+    /* Consulted when a name has no binding here, e.g. globals for locals */
+    const symbols_t *parent;
+    symbol_slot_t *slots;
+    uint32_t slot_mask;
+    uint32_t slot_count;
+    symbol_t *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    uint32_t *scopes;
+    uint32_t depth;
+    uint32_t scope_capacity;
+};
+
+bool symbols_init(symbols_t *symbols, arena_t *arena, const symbols_t *parent);
+bool symbols_push_scope(symbols_t *symbols);
+void symbols_pop_scope(symbols_t *symbols);
+/*
+ * Binds `name` in the innermost scope. Returns SYMBOL_NONE if the name is
+ * already bound in that scope, with `*previous` set to the existing binding.
+ */
+symbol_index_t symbols_declare(
+    symbols_t *symbols,
+    intern_id_t name,
+    symbol_kind_t kind,
+    ast_index_t declaration,
+    symbol_index_t *previous);
+/* Returns the innermost binding of `name`, searching parents, or NULL. */
+const symbol_t *symbols_lookup(const symbols_t *symbols, intern_id_t name);
+const symbol_t *symbols_get(const symbols_t *symbols, symbol_index_t index);
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Lightweight compile-time instrumentation. Spans are measured with a
+ * monotonic clock and recorded only while tracing is enabled; when it is
+ * disabled trace_begin/trace_end reduce to a single branch on a global.
+ */
+
+typedef struct
+{
+    const char *name;
+    uint64_t start;
+} trace_span_t;
+
+extern bool trace_enabled;
+
+void trace_enable(void);
+void trace_disable(void);
+trace_span_t trace_begin(const char *name);
+void trace_end(trace_span_t *span);
+void trace_counter(const char *name, uint64_t value);
+/* Tags the calling thread's events, 0 being the main thread. Recording is thread-safe. */
+void trace_set_thread(uint32_t thread);
+
+/* Writes the recorded events in the Chrome trace event JSON format. */
+bool trace_write_json(const char *path);
+/* Prints the accumulated wall time of each span name. */
+void trace_report(FILE *out);
+void trace_destroy(void);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _TYPES_H
+#define _TYPES_H
+
+#include <arena.h>
+#include <ast.h>
+#include <stdint.h>
+
+/*
+ * Hash-consed type table. Every structurally distinct type is created once
+ * and identified by a 32-bit id, so two types are equal exactly when their
+ * ids are. Primitive types are preallocated with ids equal to their kind.
+ * Classes, interfaces and enums are nominal and keyed by their declaration.
+ */
+
+typedef uint32_t type_id_t;
+
+typedef enum {
+    TYPE_ERROR,
+    TYPE_VOID,
+    TYPE_BOOL,
+    TYPE_I8,
+    TYPE_I16,
+    TYPE_I32,
+    TYPE_I64,
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_F32,
+    TYPE_F64,
+    TYPE_STRING,
+    TYPE_NULL,
+    TYPE_CLASS,
+    TYPE_INTERFACE,
+    TYPE_ENUM,
+    TYPE_FUNCTION
+} type_kind_t;
+
+/* Number of preallocated primitive types, ids [0, TYPE_PRIMITIVE_COUNT) */
+#define TYPE_PRIMITIVE_COUNT TYPE_CLASS
+
+typedef struct
+{
+    type_kind_t kind;
+    /* Nominal types: declaration node. Function types: result type. */
+    uint32_t operand;
+    /* Function types: parameter types are params[first_param, first_param + param_count) */
+    uint32_t first_param;
+    uint32_t param_count;
+    uint32_t hash;
+} type_t;
+
+typedef struct
+{
+    arena_t *arena;
+    type_t *types;
+    uint32_t count;
+    uint32_t capacity;
+    type_id_t *params;
+    uint32_t param_count;
+    uint32_t param_capacity;
+    type_id_t *slots;
+    uint32_t slot_mask;
+} types_t;
+
+bool types_init(types_t *types, arena_t *arena);
+/*
+ * Makes room for `type_count` more types with `param_count` parameters in
+ * all, so that interning them does not move the arrays types_get and
+ * types_params point into.
+ */
+bool types_reserve(types_t *types, uint32_t type_count, uint32_t param_count);
+type_id_t types_nominal(types_t *types, type_kind_t kind, ast_index_t declaration);
+type_id_t types_function(
+    types_t *types, const type_id_t *params, uint32_t param_count, type_id_t result);
+const type_t *types_get(const types_t *types, type_id_t id);
+const type_id_t *types_params(const types_t *types, type_id_t function);
+/* Writes a readable spelling of `id` into `buffer` for diagnostics. */
+void types_format(
+    const types_t *types, const ast_t *ast, type_id_t id, char *buffer, size_t size);
+
+bool type_is_integer(type_id_t id);
+bool type_is_signed(type_id_t id);
+bool type_is_float(type_id_t id);
+/* Width in bits of an integer or float type, 0 for anything else. */
+unsigned type_bits(type_id_t id);
+/* Wraps `value` to the width of integer type `id`, sign or zero extending it back to 64 bits. */
+uint64_t type_wrap(type_id_t id, uint64_t value);
+
+#endif
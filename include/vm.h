@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VM_H
+#define _VM_H
+
+#include <arena.h>
+#include <ir.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Bytecode interpreter. Each IR function becomes a stream of 32-bit words:
+ * an opcode followed by its operands, which are registers of the current
+ * frame, immediates, function indices or word offsets of jump targets.
+ * Every SSA value gets its own 64-bit register, parameters first, kept
+ * wrapped to its type like ir_wrap; phis become moves on the incoming
+ * edges.
+ *
+ * Dispatch is threaded through GCC's labels as values, `goto *label[op]`
+ * at the end of every handler; other compilers, or building with
+ * VM_SWITCH_DISPATCH defined, get a plain switch loop.
+ *
+ * Superinstructions cover the common pairs: a compare feeding the branch
+ * right after it becomes one compare-and-branch, an add or sub of a 32-bit
+ * constant becomes VM_ADDI, and an interface method looked up only to be
+ * called becomes VM_CALLM. Field offsets are static in Dash, so the inline
+ * caches sit on VM_CALLM instead: each call site remembers the last vtable
+ * it saw and the function it dispatched to.
+ *
+ * Objects are allocated from an arena owned by the VM and live until
+ * vm_destroy. Interface values are (object, vtable) pairs as in the IR, the
+ * vtable half pointing at the module's ir_vtable_t.
+ */
+
+/* Registers of all active frames together */
+#define VM_STACK_SIZE (1 << 20)
+#define VM_MAX_FRAMES (1 << 16)
+
+typedef enum {
+    VM_CONST,  /* d, low, high */
+    VM_MOV,    /* d, s */
+    VM_ADD,    /* d, a, b */
+    VM_SUB,
+    VM_MUL,
+    VM_ADDI,   /* d, a, signed 32-bit immediate */
+    VM_DIVS,   /* d, a, b */
+    VM_DIVU,
+    VM_MODS,
+    VM_MODU,
+    VM_NEG,    /* d, a */
+    VM_NOT,
+    VM_SEXT8,  /* d, wraps in place */
+    VM_SEXT16,
+    VM_SEXT32,
+    VM_ZEXT8,
+    VM_ZEXT16,
+    VM_ZEXT32,
+    VM_EQ,     /* d, a, b; greater-than swaps the operands */
+    VM_NE,
+    VM_LT,
+    VM_LE,
+    VM_LTU,
+    VM_LEU,
+    VM_BT,     /* d, a, b; (b >> a) & 1 */
+    VM_FUNC,   /* d, function */
+    VM_VTABLE, /* d, vtable */
+    VM_METHOD, /* d, vtable register, slot */
+    VM_CALL,   /* d, function, count, count argument registers */
+    VM_CALLI,  /* d, callee register, count, arguments */
+    VM_CALLM,  /* d, vtable register, slot, cache, count, arguments */
+    VM_SECOND, /* d */
+    VM_NEW,    /* d, size */
+    VM_LOAD,   /* d, object, offset */
+    VM_STORE,  /* object, value, offset */
+    VM_JMP,    /* target */
+    VM_BRT,    /* condition, target; taken when non-zero */
+    VM_BRF,
+    VM_BEQ,    /* a, b, target */
+    VM_BNE,
+    VM_BLT,
+    VM_BLE,
+    VM_BLTU,
+    VM_BLEU,
+    VM_JTAB,   /* index, count, count targets */
+    VM_RET,    /* value */
+    VM_RET2,   /* object, vtable */
+    VM_RETV,
+    VM_TRAP,
+    VM_OP_COUNT
+} vm_op_t;
+
+typedef struct
+{
+    uint32_t *code;
+    uint32_t size;
+    /* Registers, the last one is scratch for moves and unused results */
+    uint32_t frame_size;
+    uint32_t param_count;
+} vm_function_t;
+
+/* Monomorphic inline cache of a VM_CALLM site */
+typedef struct
+{
+    const ir_vtable_t *vtable;
+    const vm_function_t *target;
+} vm_cache_t;
+
+typedef struct
+{
+    const uint32_t *pc;
+    uint64_t *base;
+    const vm_function_t *function;
+    uint32_t dest;
+} vm_frame_t;
+
+typedef struct
+{
+    ir_module_t *module;
+    vm_function_t *functions;
+    vm_cache_t *caches;
+    uint32_t cache_count;
+    uint64_t *stack;
+    vm_frame_t *frames;
+    arena_t heap;
+    /* Set when compiling or running fails */
+    const char *error;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+} vm_t;
+
+/*
+ * Compiles every function of `module`, lowering any IR_SWITCH left first.
+ * Fails when a function failed to lower or memory runs out.
+ */
+bool vm_init(vm_t *vm, ir_module_t *module);
+void vm_destroy(vm_t *vm);
+/* Index of the function called `name`, UINT32_MAX if there is none. */
+uint32_t vm_find_function(const vm_t *vm, const char *name);
+/*
+ * Runs function `index`. `result` gets the returned value, or its object
+ * half for interface results, and may be NULL. On a trap (division by
+ * zero, unreachable code, stack overflow, out of memory) returns false
+ * with `error` set.
+ */
+bool vm_call(
+    vm_t *vm, uint32_t index, const uint64_t *args, uint32_t count, uint64_t *result);
+void vm_dump_function(const vm_t *vm, uint32_t index, FILE *out);
+void vm_dump(const vm_t *vm, FILE *out);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _WRITER_H
+#define _WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Buffered output for generated code. Text collects in one large buffer
+ * that leaves with a single write once full; pieces too big for it go out
+ * together with the buffered text in one writev, without being copied.
+ * Integers are formatted by hand, two digits at a time.
+ *
+ * A memory writer has no file descriptor and grows its buffer instead, so
+ * the whole output stays in `data`, NUL terminated after writer_flush.
+ * Errors are sticky: once a write fails everything else is dropped and
+ * writer_flush returns false.
+ */
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    /* -1 for memory writers */
+    int fd;
+    bool failed;
+} writer_t;
+
+bool writer_init(writer_t *writer, int fd);
+bool writer_init_memory(writer_t *writer);
+void writer_write(writer_t *writer, const void *data, size_t size);
+void writer_puts(writer_t *writer, const char *text);
+void writer_putc(writer_t *writer, char c);
+void writer_unsigned(writer_t *writer, uint64_t value);
+void writer_signed(writer_t *writer, int64_t value);
+/* Sends buffered text to the file descriptor; memory writers keep it. */
+bool writer_flush(writer_t *writer);
+/* Flushes and frees the buffer, leaving the file descriptor open. */
+bool writer_destroy(writer_t *writer);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _X86_H
+#define _X86_H
+
+#include <emitter.h>
+#include <ir.h>
+
+/*
+ * x86-64 backend. Writes a module as GNU assembler source in Intel syntax for
+ * Linux and the System V ABI, ready for `cc file.s`.
+ *
+ * Each function gets block liveness, one live interval per value (the hull of
+ * the positions where it is live in reverse postorder) and a linear scan over
+ * eleven registers. Values live across a call only get callee-saved ones;
+ * when registers run out the interval ending last goes to a stack slot.
+ * Constants are never allocated, they become immediates at their uses. Edges
+ * from a block with several successors into a block with phis are split so
+ * every phi move sits before a jump, and the moves of an edge run as one
+ * parallel copy. rax, rdx and r11 stay free as scratch.
+ *
+ * Values are kept sign or zero extended to 64 bits like ir_wrap. Interface
+ * results come back in rax:rdx. Dash function `f` is the symbol `dash.f`;
+ * methods are local and suffixed with their function index. A `main`
+ * without parameters gets a C `main` calling it and exiting with its result.
+ * Objects come from a bump allocator refilled X86_HEAP_CHUNK bytes at a time
+ * with malloc and never freed.
+ */
+
+#define X86_HEAP_CHUNK (1 << 20)
+
+/*
+ * Lowers any IR_SWITCH left in the module first. Returns false when a
+ * function failed to lower, memory runs out or the writer behind `out`
+ * failed; the caller still flushes it.
+ */
+bool x86_emit_module(ir_module_t *module, emitter_t *out);
+/* Whether symbol `name` was already placed, for x86_emit_code */
+typedef bool (*x86_defined_t)(void *context, const char *name);
+
+/*
+ * Emits the functions and vtables of `module` without the runtime or C
+ * entry point, for an emitter feeding the in-process assembler; those for
+ * which `defined` returns true are left out. Every function and vtable is
+ * a symbol, vtables named ".Lvtable<index>", so code emitted earlier can be
+ * linked against. Objects come from `__dash_alloc`, which the caller
+ * provides.
+ */
+bool x86_emit_code(ir_module_t *module, x86_defined_t defined, void *context, emitter_t *out);
+
+#endif
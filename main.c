@@ -1,8 +1,483 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <arena.h>
+#include <ast.h>
+#include <cache.h>
+#include <diagnostic.h>
+#include <driver.h>
+#include <fcntl.h>
+#include <ir.h>
+#include <lower.h>
+#include <opt.h>
+#include <pool.h>
+#include <repl.h>
+#include <sema.h>
+#include <server.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <trace.h>
+#include <unistd.h>
+#include <vm.h>
+#include <x86.h>
+
+#define DEFAULT_TRACE_PATH "dash-trace.json"
+#define DEFAULT_CACHE_PATH ".dash-cache"
+
+typedef struct
+{
+    /* Source files, compiled together as one program */
+    const char **inputs;
+    uint32_t input_count;
+    const char *trace_path;
+    bool time_report;
+    bool dump_ast;
+    bool dump_ir;
+    /* Comma separated optimization passes */
+    const char *passes;
+    /* Worker threads, 0 for one per processor */
+    uint32_t jobs;
+    /* Write x86-64 assembly instead of linking an executable */
+    bool assembly;
+    const char *output;
+    /* Interpret main instead of compiling to native code */
+    bool run;
+    bool dump_bytecode;
+    /* Directory of parsed files kept between compiles, NULL for none */
+    const char *cache_path;
+    /* Read entries from stdin and run them as they come, no input files */
+    bool repl;
+    /* Answer compile requests on stdio or `socket_path`, no input files */
+    bool server;
+    const char *socket_path;
+    /* Where a compile's output and errors go */
+    FILE *out;
+    FILE *err;
+} options_t;
+
+static void _usage(FILE *out, const char *program)
+{
+    fprintf(out, "Usage: %s [options] <file>...\n", program);
+    fprintf(out, "       %s --repl [--passes=<list>]\n", program);
+    fprintf(out, "       %s --server[=<socket>] [-j <n>]\n", program);
+    fprintf(out, "Options:\n");
+    fprintf(out, "  --time-trace[=<file>]  Write a Chrome trace of the compiler phases\n");
+    fprintf(out, "                         (default: " DEFAULT_TRACE_PATH ")\n");
+    fprintf(out, "  --time-report          Print per-phase timings to stderr\n");
+    fprintf(out, "  --dump-ast             Print the parsed syntax tree\n");
+    fprintf(out, "  --dump-ir              Print the optimized IR\n");
+    fprintf(out, "  --passes=<list>        Run these optimization passes, comma separated\n");
+    fprintf(out, "                         (default: " OPT_DEFAULT_PASSES ")\n");
+    fprintf(out, "  --cache[=<dir>]        Reuse the parse of files unchanged since an\n");
+    fprintf(out, "                         earlier compile (default: " DEFAULT_CACHE_PATH ")\n");
+    fprintf(out, "  -j <n>                 Use n worker threads, files are read and parsed\n");
+    fprintf(out, "                         in parallel (default: one per CPU)\n");
+    fprintf(out, "  -S                     Write x86-64 assembly to the output or stdout\n");
+    fprintf(out, "  -o <file>              Write a native executable, linked with $CC\n");
+    fprintf(out, "  --run                  Run main in the bytecode interpreter and exit\n");
+    fprintf(out, "                         with its result\n");
+    fprintf(out, "  --dump-bytecode        Print the interpreter's bytecode\n");
+    fprintf(out, "  --repl                 Compile and run entries from stdin as they are\n");
+    fprintf(out, "                         typed, keeping earlier definitions\n");
+    fprintf(out, "  --server[=<socket>]    Serve compiles, one command line per request, on\n");
+    fprintf(out, "                         stdio or a Unix socket, keeping parsed files\n");
+}
+
+static bool _check_passes(const char *passes, FILE *err)
+{
+    while (*passes != '\0') {
+        size_t length = strcspn(passes, ",");
+        if (length > 0 && !opt_has_pass(passes, length)) {
+            fprintf(err, "Unknown pass '%.*s'\n", (int) length, passes);
+            return false;
+        }
+        passes += length + (passes[length] == ',');
+    }
+    return true;
+}
+
+static bool _parse_options(int argc, char **argv, options_t *options)
+{
+    int i;
+    for (i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--time-trace")) {
+            options->trace_path = DEFAULT_TRACE_PATH;
+        } else if (!strncmp(arg, "--time-trace=", 13)) {
+            options->trace_path = arg + 13;
+        } else if (!strcmp(arg, "--time-report")) {
+            options->time_report = true;
+        } else if (!strcmp(arg, "--dump-ast")) {
+            options->dump_ast = true;
+        } else if (!strcmp(arg, "--dump-ir")) {
+            options->dump_ir = true;
+        } else if (!strcmp(arg, "--run")) {
+            options->run = true;
+        } else if (!strcmp(arg, "--dump-bytecode")) {
+            options->dump_bytecode = true;
+        } else if (!strcmp(arg, "--cache")) {
+            options->cache_path = DEFAULT_CACHE_PATH;
+        } else if (!strncmp(arg, "--cache=", 8)) {
+            options->cache_path = arg + 8;
+        } else if (!strcmp(arg, "--server")) {
+            options->server = true;
+        } else if (!strncmp(arg, "--server=", 9)) {
+            options->server = true;
+            options->socket_path = arg + 9;
+        } else if (!strcmp(arg, "--repl")) {
+            options->repl = true;
+        } else if (!strncmp(arg, "--passes=", 9)) {
+            if (!_check_passes(arg + 9, options->err))
+                return false;
+            options->passes = arg + 9;
+        } else if (!strncmp(arg, "-j", 2)) {
+            const char *count = arg[2] != '\0' ? arg + 2 : (i + 1 < argc ? argv[++i] : "");
+            char *end;
+            long jobs = strtol(count, &end, 10);
+            if (*count == '\0' || *end != '\0' || jobs < 1 || jobs > 1024) {
+                fprintf(options->err, "Invalid job count '%s'\n", count);
+                return false;
+            }
+            options->jobs = (uint32_t) jobs;
+        } else if (!strcmp(arg, "-S")) {
+            options->assembly = true;
+        } else if (!strcmp(arg, "-o")) {
+            if (i + 1 == argc)
+                return false;
+            options->output = argv[++i];
+        } else if (arg[0] == '-') {
+            fprintf(options->err, "Unknown option '%s'\n", arg);
+            return false;
+        } else {
+            options->inputs[options->input_count++] = arg;
+        }
+    }
+    return (options->input_count > 0) + options->repl + options->server == 1;
+}
+
+static bool _link(const char *assembly, const char *output)
+{
+    const char *cc = getenv("CC") != NULL ? getenv("CC") : "cc";
+    int status;
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* Stdout may carry a server's replies */
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        execlp(cc, cc, "-o", output, assembly, (char *) NULL);
+        _exit(127);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) != pid)
+        return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* Writes assembly to -o or stdout with -S, otherwise assembles and links it. */
+static bool _emit_native(const options_t *options, ir_module_t *module)
+{
+    char path[] = "/tmp/dash-XXXXXX.s";
+    const char *target = options->assembly ? options->output : path;
+    bool to_stream = options->assembly && options->output == NULL;
+    int fd;
+    if (to_stream) {
+        /* Anything printed earlier has to come out before the assembly */
+        fflush(options->out);
+        target = "<stdout>";
+        fd = fileno(options->out);
+    } else if (options->assembly) {
+        fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } else {
+        fd = mkstemps(path, 2);
+    }
+
+    /* A stream without a descriptor, like a server's reply, gets the text at the end */
+    writer_t writer;
+    bool in_memory = to_stream && fd < 0;
+    if (in_memory ? !writer_init_memory(&writer) : fd < 0 || !writer_init(&writer, fd)) {
+        if (!to_stream && fd >= 0)
+            close(fd);
+        fprintf(options->err, "Could not write '%s'\n", target);
+        return false;
+    }
+
+    trace_span_t codegen_span = trace_begin("codegen");
+    emitter_t emitter;
+    emitter_init(&emitter, &writer);
+    bool ok = x86_emit_module(module, &emitter);
+    if (in_memory) {
+        ok = writer_flush(&writer) && ok;
+        ok = ok && fwrite(writer.data, 1, writer.size, options->out) == writer.size;
+    }
+    ok = writer_destroy(&writer) && ok;
+    if (!to_stream)
+        ok = close(fd) == 0 && ok;
+    trace_end(&codegen_span);
+    if (!ok)
+        fprintf(options->err, "Could not write '%s'\n", target);
+
+    if (ok && !options->assembly) {
+        trace_span_t link_span = trace_begin("link");
+        ok = _link(path, options->output);
+        trace_end(&link_span);
+        if (!ok)
+            fprintf(options->err, "Could not link '%s'\n", options->output);
+    }
+    if (!options->assembly)
+        unlink(path);
+    return ok;
+}
 
-int main()
+/* Interprets main, its result becomes the exit status like a native build's. */
+static bool _interpret(const options_t *options, ir_module_t *module, int *status)
 {
-    printf("This is a placeholder main.c\n");
-    return EXIT_SUCCESS;
+    vm_t vm;
+    trace_span_t compile_span = trace_begin("bytecode");
+    bool ok = vm_init(&vm, module);
+    trace_end(&compile_span);
+    if (ok && options->dump_bytecode)
+        vm_dump(&vm, options->out);
+
+    uint32_t main_index = ok ? vm_find_function(&vm, "main") : UINT32_MAX;
+    if (ok && options->run && main_index == UINT32_MAX) {
+        vm.error = "no main function";
+        ok = false;
+    }
+    if (ok && options->run) {
+        uint64_t result = 0;
+        fflush(options->out);
+        trace_span_t run_span = trace_begin("run");
+        ok = vm_call(&vm, main_index, NULL, 0, &result);
+        trace_end(&run_span);
+        trace_counter("inline_cache_misses", vm.cache_misses);
+        *status = (int) (result & 0xff);
+    }
+    if (!ok)
+        fprintf(options->err, "%s: %s\n", options->inputs[0], vm.error);
+    vm_destroy(&vm);
+    return ok;
+}
+
+static bool _generate(
+    const options_t *options,
+    const sema_t *sema,
+    pool_t *pool,
+    arena_t *arena,
+    diagnostics_t *diagnostics,
+    int *status)
+{
+    ir_module_t module;
+    if (!ir_module_init(&module, arena, sema->ast, pool->worker_count)) {
+        ir_module_destroy(&module);
+        diagnostics_add(diagnostics, 0, 0, "out of memory");
+        return false;
+    }
+
+    trace_span_t lower_span = trace_begin("lower");
+    bool ok = lower_module(&module, sema, pool, diagnostics);
+    trace_end(&lower_span);
+    trace_counter("ir_functions", module.function_count);
+
+    if (ok) {
+        trace_span_t optimize_span = trace_begin("optimize");
+        opt_run_passes(&module, options->passes, pool);
+        trace_end(&optimize_span);
+    }
+    if (ok && options->dump_ir)
+        ir_dump(&module, options->out);
+    if (ok && (options->assembly || options->output != NULL))
+        ok = _emit_native(options, &module);
+    if (ok && (options->run || options->dump_bytecode))
+        ok = _interpret(options, &module, status);
+
+    ir_module_destroy(&module);
+    return ok;
+}
+
+/* A server's driver and identifiers carry over from earlier compiles */
+static int _compile(const options_t *options, arena_t *arena, pool_t *pool, server_t *server)
+{
+    int status = EXIT_SUCCESS;
+    diagnostics_t diagnostics;
+    diagnostics_init(&diagnostics, arena);
+    driver_t local_driver, *driver = server != NULL ? &server->driver : &local_driver;
+    intern_t local_interner, *interner = server != NULL ? &server->interner : &local_interner;
+    cache_t cache;
+    ast_t ast;
+    if (options->cache_path != NULL
+        && !cache_init(&cache, options->cache_path, DRIVER_PARSE_FLAGS)) {
+        fprintf(options->err, "Could not create cache directory '%s'\n", options->cache_path);
+        return EXIT_FAILURE;
+    }
+    bool ready = server != NULL
+                     ? driver_set_inputs(driver, options->inputs, options->input_count)
+                     : driver_init(driver, options->inputs, options->input_count)
+                           && intern_init(interner, arena);
+    if (!ready) {
+        fprintf(options->err, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    driver->cache = options->cache_path != NULL ? &cache : NULL;
+
+    /* Files are read, lexed and parsed in parallel, then merged in order */
+    bool ok = driver_parse(driver, pool);
+    trace_counter("bytes_read", driver->bytes);
+    trace_counter("tokens", driver->tokens);
+    if (driver->cache != NULL)
+        trace_counter("cache_hits", driver->cache_hits);
+    if (server != NULL)
+        trace_counter("files_reused", driver->reused);
+    driver->cache = NULL;
+    if (!ok)
+        driver_report(driver, options->err);
+    if (ok) {
+        trace_span_t merge_span = trace_begin("merge");
+        ok = ast_init(&ast, arena, interner) && driver_merge(driver, &ast, &diagnostics);
+        trace_end(&merge_span);
+        if (!ok)
+            fprintf(options->err, "Out of memory\n");
+    }
+    if (server == NULL)
+        driver_destroy(driver);
+    if (!ok)
+        return EXIT_FAILURE;
+
+    sema_t sema;
+    if (!sema_init(&sema, &ast, arena, &diagnostics)) {
+        fprintf(options->err, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    sema.pool = pool;
+
+    trace_span_t declare_span = trace_begin("declarations");
+    bool declared = sema_declare(&sema);
+    trace_end(&declare_span);
+
+    /* Keep going after duplicate declarations to report unresolved names too */
+    trace_span_t resolve_span = trace_begin("resolve");
+    ok = sema_resolve(&sema) && declared;
+    trace_end(&resolve_span);
+    if (ok) {
+        trace_span_t check_span = trace_begin("check");
+        ok = sema_check(&sema);
+        trace_end(&check_span);
+        trace_counter("types", sema.types.count);
+    }
+    if (ok)
+        ok = _generate(options, &sema, pool, arena, &diagnostics, &status);
+    trace_counter("identifiers", interner->count - 1);
+    sema_destroy(&sema);
+
+    if (ok && options->dump_ast) {
+        ast_dump(&ast, AST_NONE, options->out);
+        fputc('\n', options->out);
+    }
+    trace_counter("ast_nodes", ast.node_count);
+
+    diagnostics_print(&diagnostics, options->err, options->inputs[0]);
+    return ok ? status : EXIT_FAILURE;
+}
+
+/* One compile, traced as `options` ask */
+static int _run(const options_t *options, arena_t *arena, pool_t *pool, server_t *server)
+{
+    if (options->trace_path != NULL || options->time_report)
+        trace_enable();
+
+    trace_span_t total_span = trace_begin("compile");
+    int status = _compile(options, arena, pool, server);
+    trace_end(&total_span);
+    trace_counter("arena_bytes", arena_used(arena));
+
+    if (options->time_report)
+        trace_report(options->err);
+    if (options->trace_path != NULL && !trace_write_json(options->trace_path)) {
+        fprintf(options->err, "Could not write trace to '%s'\n", options->trace_path);
+        status = EXIT_FAILURE;
+    }
+    trace_destroy();
+    trace_disable();
+    return status;
+}
+
+static int _serve_request(server_t *server, int argc, char **argv, FILE *out, FILE *err)
+{
+    options_t options = {0};
+    int status = EXIT_FAILURE;
+    options.passes = OPT_DEFAULT_PASSES;
+    options.out = out;
+    options.err = err;
+    options.inputs = malloc(argc * sizeof(char *));
+    /* Settings of the server itself, like the worker count, were fixed when it started */
+    if (options.inputs == NULL || !_parse_options(argc, argv, &options)
+        || options.input_count == 0)
+        _usage(err, argv[0]);
+    else
+        status = _run(&options, &server->arena, server->pool, server);
+    free(options.inputs);
+    return status;
+}
+
+static int _serve(const options_t *options)
+{
+    pool_t pool;
+    server_t server;
+    if (!pool_init(&pool, options->jobs) || !server_init(&server, &pool, _serve_request)) {
+        fprintf(stderr, "Could not start the server\n");
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    if (options->socket_path != NULL)
+        ok = server_listen(&server, options->socket_path);
+    else
+        server_serve(&server, stdin, stdout);
+    if (!ok)
+        fprintf(stderr, "Could not listen on '%s'\n", options->socket_path);
+
+    server_destroy(&server);
+    pool_destroy(&pool);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    options_t options = {0};
+    options.passes = OPT_DEFAULT_PASSES;
+    options.out = stdout;
+    options.err = stderr;
+    options.inputs = malloc(argc * sizeof(char *));
+    if (options.inputs == NULL || !_parse_options(argc, argv, &options)) {
+        _usage(stderr, argv[0]);
+        free(options.inputs);
+        return EXIT_FAILURE;
+    }
+
+    int status;
+    if (options.repl) {
+        repl_t repl;
+        if (!repl_init(&repl, options.passes)) {
+            fprintf(stderr, "Could not start the REPL\n");
+            return EXIT_FAILURE;
+        }
+        repl_run(&repl, stdin, stdout, stderr, isatty(STDIN_FILENO));
+        repl_destroy(&repl);
+        status = EXIT_SUCCESS;
+    } else if (options.server) {
+        status = _serve(&options);
+    } else {
+        arena_t arena;
+        pool_t pool;
+        if (!arena_init(&arena) || !pool_init(&pool, options.jobs)) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+        status = _run(&options, &arena, &pool, NULL);
+        pool_destroy(&pool);
+        arena_destroy(&arena);
+    }
+    free(options.inputs);
+    return status;
 }
@@ -84,25 +84,80 @@ bool arena_init(arena_t *arena)
     return true;
 }
 
-void *arena_alloc(arena_t *arena, size_t size)
+/* Moves on to a chunk with room for `size` bytes from its start */
+static bool _arena_next_chunk(arena_t *arena, size_t size)
 {
-    if (size + arena->current->size >= arena->current->capacity) {
-        size_t chunk_capacity = size > arena_chunk_size ? ALIGN_UP(size, arena_chunk_size)
-                                                        : arena_chunk_size;
-        arena_chunk_t *chunk = _arena_new_chunk(chunk_capacity);
-        if (chunk == NULL)
-            return NULL;
-        arena->current->next = chunk;
-        arena->current = chunk;
-        arena->size += chunk_capacity;
+    arena_chunk_t *next = arena->current->next;
+    if (next != NULL && size <= next->capacity) {
+        /* Left over from before arena_reset */
+        arena->current = next;
+        return true;
     }
 
+    size_t chunk_capacity = size > arena_chunk_size ? ALIGN_UP(size, arena_chunk_size)
+                                                    : arena_chunk_size;
+    arena_chunk_t *chunk = _arena_new_chunk(chunk_capacity);
+    if (chunk == NULL)
+        return false;
+    chunk->next = next;
+    arena->current->next = chunk;
+    arena->current = chunk;
+    arena->size += chunk_capacity;
+    return true;
+}
+
+static void *_arena_take(arena_t *arena, size_t size)
+{
     void *ptr = arena->current->data + arena->current->size;
     arena->current->size += size;
-
     return ptr;
 }
 
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    if (size + arena->current->size >= arena->current->capacity
+        && !_arena_next_chunk(arena, size))
+        return NULL;
+    return _arena_take(arena, size);
+}
+
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align)
+{
+    /* Chunks are page aligned, so padding the offset aligns the pointer */
+    size_t padding = ALIGN_UP(arena->current->size, align) - arena->current->size;
+    if (padding + size + arena->current->size < arena->current->capacity)
+        arena->current->size += padding;
+    else if (!_arena_next_chunk(arena, size))
+        return NULL;
+    return _arena_take(arena, size);
+}
+
+void *arena_grow(
+    arena_t *arena, const void *items, size_t count, size_t capacity, size_t element_size)
+{
+    void *grown = arena_alloc_aligned(arena, capacity * element_size, sizeof(void *));
+    if (grown != NULL && count > 0)
+        memcpy(grown, items, count * element_size);
+    return grown;
+}
+
+size_t arena_used(const arena_t *arena)
+{
+    size_t used = 0;
+    const arena_chunk_t *chunk;
+    for (chunk = arena->first; chunk != NULL; chunk = chunk->next)
+        used += chunk->size;
+    return used;
+}
+
+void arena_reset(arena_t *arena)
+{
+    arena_chunk_t *chunk;
+    for (chunk = arena->first; chunk != NULL; chunk = chunk->next)
+        chunk->size = 0;
+    arena->current = arena->first;
+}
+
 void arena_destroy(arena_t *arena)
 {
     arena_chunk_t *chunk = arena->first;
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <assembler.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *_registers[4][16] = {
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b",
+        "r13b", "r14b", "r15b"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w",
+        "r13w", "r14w", "r15w"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d",
+        "r12d", "r13d", "r14d", "r15d"},
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12",
+        "r13", "r14", "r15"}};
+
+/* Condition code suffixes by their encoding, aliases after the first 16 */
+static const char *_conditions[] = {"o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p",
+    "np", "l", "ge", "le", "g", "c", "nc", "z", "nz"};
+static const uint8_t _condition_codes[] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 2, 3, 4, 5};
+
+/* Group 1 arithmetic, the /digit of each in opcode 0x81 */
+static const char *_arithmetic[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"};
+
+void assembler_init(assembler_t *assembler)
+{
+    memset(assembler, 0, sizeof(assembler_t));
+}
+
+void assembler_destroy(assembler_t *assembler)
+{
+    free(assembler->code);
+    free(assembler->labels);
+    free(assembler->fixups);
+    free(assembler->symbols);
+    memset(assembler, 0, sizeof(assembler_t));
+}
+
+bool assembler_register(const char *name, uint8_t *number, uint8_t *size)
+{
+    uint32_t s, r;
+    for (s = 0; s < 4; s++) {
+        for (r = 0; r < 16; r++) {
+            if (strcmp(_registers[s][r], name) == 0) {
+                *number = (uint8_t) r;
+                *size = (uint8_t) (1 << s);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void _fail(assembler_t *assembler, const char *error)
+{
+    if (assembler->error == NULL)
+        assembler->error = error;
+}
+
+/* Grows `*array` to hold one more element of `size` bytes */
+static bool _grow(
+    assembler_t *assembler, void **array, uint32_t *capacity, uint32_t count, size_t size)
+{
+    if (count < *capacity)
+        return true;
+    uint32_t grown = *capacity ? *capacity * 2 : 64;
+    void *data = realloc(*array, grown * size);
+    if (data == NULL) {
+        _fail(assembler, "out of memory");
+        return false;
+    }
+    *array = data;
+    *capacity = grown;
+    return true;
+}
+
+static void _byte(assembler_t *assembler, uint8_t byte)
+{
+    if (assembler->size == assembler->capacity) {
+        size_t capacity = assembler->capacity ? assembler->capacity * 2 : 4096;
+        uint8_t *code = realloc(assembler->code, capacity);
+        if (code == NULL) {
+            _fail(assembler, "out of memory");
+            return;
+        }
+        assembler->code = code;
+        assembler->capacity = capacity;
+    }
+    assembler->code[assembler->size++] = byte;
+}
+
+static void _bytes(assembler_t *assembler, uint64_t value, uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+        _byte(assembler, (uint8_t) (value >> (8 * i)));
+}
+
+static void _fixup(
+    assembler_t *assembler, assembler_fixup_kind_t kind, assembler_target_t target, uint32_t end)
+{
+    if (!_grow(assembler, (void **) &assembler->fixups, &assembler->fixup_capacity,
+            assembler->fixup_count, sizeof(assembler_fixup_t)))
+        return;
+    assembler_fixup_t *fixup = &assembler->fixups[assembler->fixup_count++];
+    memset(fixup, 0, sizeof(assembler_fixup_t));
+    fixup->target = target;
+    fixup->kind = (uint8_t) kind;
+    fixup->at = (uint32_t) assembler->size;
+    fixup->end = end;
+}
+
+static bool _fits8(int64_t value)
+{
+    return value >= -128 && value <= 127;
+}
+
+static bool _fits32(int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/* spl, bpl, sil and dil only exist with a REX prefix */
+static bool _needs_rex(const assembler_operand_t *operand)
+{
+    return operand != NULL && operand->kind == ASSEMBLER_REGISTER && operand->size == 1
+           && operand->reg >= 4 && operand->reg < 8;
+}
+
+/*
+ * Encodes `opcode` (up to three bytes, after an optional REX) with a ModRM
+ * byte naming `reg` (a register number or a /digit) and `rm`, followed by
+ * the SIB byte and displacement. `immediate` bytes come after; rip-relative
+ * fields count from their end.
+ */
+static void _modrm(
+    assembler_t *assembler,
+    bool wide,
+    const uint8_t *opcode,
+    uint32_t length,
+    uint8_t reg,
+    const assembler_operand_t *rm,
+    const assembler_operand_t *other,
+    uint32_t immediate)
+{
+    uint8_t rex = (uint8_t) (0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0));
+    uint32_t i;
+    bool memory = rm->kind == ASSEMBLER_MEMORY;
+    if (memory && rm->index != ASSEMBLER_NO_REGISTER && (rm->index & 8))
+        rex |= 2;
+    if (rm->reg != ASSEMBLER_RIP && (rm->reg & 8))
+        rex |= 1;
+    if (rex != 0x40 || _needs_rex(rm) || _needs_rex(other))
+        _byte(assembler, rex);
+    for (i = 0; i < length; i++)
+        _byte(assembler, opcode[i]);
+
+    uint8_t r = (uint8_t) ((reg & 7) << 3);
+    if (!memory) {
+        _byte(assembler, (uint8_t) (0xc0 | r | (rm->reg & 7)));
+        return;
+    }
+    if (rm->reg == ASSEMBLER_RIP) {
+        _byte(assembler, (uint8_t) (0x05 | r));
+        _fixup(assembler, ASSEMBLER_REL32, rm->target, (uint32_t) assembler->size + 4 + immediate);
+        _bytes(assembler, 0, 4);
+        return;
+    }
+
+    /* rbp and r13 as base always take a displacement, rsp and r12 a SIB byte */
+    uint8_t mod = rm->value == 0 && (rm->reg & 7) != 5 ? 0x00 : _fits8(rm->value) ? 0x40 : 0x80;
+    bool sib = rm->index != ASSEMBLER_NO_REGISTER || (rm->reg & 7) == 4;
+    _byte(assembler, (uint8_t) (mod | r | (sib ? 4 : (rm->reg & 7))));
+    if (sib) {
+        uint8_t scale = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+        uint8_t index = rm->index != ASSEMBLER_NO_REGISTER ? rm->index & 7 : 4;
+        _byte(assembler, (uint8_t) ((scale << 6) | (index << 3) | (rm->reg & 7)));
+    }
+    if (mod == 0x40)
+        _byte(assembler, (uint8_t) rm->value);
+    else if (mod == 0x80)
+        _bytes(assembler, (uint64_t) rm->value, 4);
+}
+
+static void _rm(
+    assembler_t *assembler,
+    bool wide,
+    uint32_t opcode,
+    uint8_t reg,
+    const assembler_operand_t *rm,
+    const assembler_operand_t *other,
+    uint32_t immediate)
+{
+    uint8_t bytes[3];
+    uint32_t length = 0;
+    if (opcode > 0xffff)
+        bytes[length++] = (uint8_t) (opcode >> 16);
+    if (opcode > 0xff)
+        bytes[length++] = (uint8_t) (opcode >> 8);
+    bytes[length++] = (uint8_t) opcode;
+    _modrm(assembler, wide, bytes, length, reg, rm, other, immediate);
+}
+
+/* A register encoded in the low bits of the opcode byte */
+static void _short(assembler_t *assembler, bool wide, uint8_t opcode, uint8_t reg)
+{
+    if (wide || (reg & 8))
+        _byte(assembler, (uint8_t) (0x40 | (wide ? 8 : 0) | ((reg & 8) ? 1 : 0)));
+    _byte(assembler, (uint8_t) (opcode | (reg & 7)));
+}
+
+static void _branch(
+    assembler_t *assembler,
+    const uint8_t *opcode,
+    uint32_t length,
+    const assembler_operand_t *target)
+{
+    uint32_t i;
+    for (i = 0; i < length; i++)
+        _byte(assembler, opcode[i]);
+    _fixup(assembler, ASSEMBLER_REL32, target->target, (uint32_t) assembler->size + 4);
+    _bytes(assembler, 0, 4);
+}
+
+static int _condition(const char *suffix)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(_conditions) / sizeof(_conditions[0]); i++)
+        if (strcmp(_conditions[i], suffix) == 0)
+            return _condition_codes[i];
+    return -1;
+}
+
+static int _arithmetic_digit(const char *mnemonic)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+        if (strcmp(_arithmetic[i], mnemonic) == 0)
+            return i;
+    return -1;
+}
+
+static bool _is(const assembler_operand_t *operand, assembler_kind_t kind)
+{
+    return operand->kind == kind;
+}
+
+/* Register or memory */
+static bool _is_rm(const assembler_operand_t *operand)
+{
+    return operand->kind == ASSEMBLER_REGISTER || operand->kind == ASSEMBLER_MEMORY;
+}
+
+static bool _two_operands(
+    assembler_t *assembler,
+    const char *mnemonic,
+    const assembler_operand_t *a,
+    const assembler_operand_t *b)
+{
+    bool wide = (a->size ? a->size : b->size) == 8;
+    int digit = _arithmetic_digit(mnemonic);
+
+    if (digit >= 0) {
+        uint8_t base = (uint8_t) (digit << 3);
+        if (_is(a, ASSEMBLER_REGISTER) && a->reg == 0 && _is(b, ASSEMBLER_IMMEDIATE)
+            && !_fits8(b->value) && _fits32(b->value)) {
+            /* The short form for the accumulator, as GNU as picks it */
+            if (wide)
+                _byte(assembler, 0x48);
+            _byte(assembler, base | 0x05);
+            _bytes(assembler, (uint64_t) b->value, 4);
+        } else if (_is_rm(a) && _is(b, ASSEMBLER_IMMEDIATE) && _fits32(b->value)) {
+            bool small = _fits8(b->value);
+            _rm(assembler, wide, small ? 0x83 : 0x81, (uint8_t) digit, a, NULL, small ? 1 : 4);
+            _bytes(assembler, (uint64_t) b->value, small ? 1 : 4);
+        } else if (_is_rm(a) && _is(b, ASSEMBLER_REGISTER)) {
+            _rm(assembler, wide, base | 0x01, b->reg, a, b, 0);
+        } else if (_is(a, ASSEMBLER_REGISTER) && _is(b, ASSEMBLER_MEMORY)) {
+            _rm(assembler, wide, base | 0x03, a->reg, b, a, 0);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    if (strcmp(mnemonic, "mov") == 0) {
+        if (_is(a, ASSEMBLER_REGISTER) && _is(b, ASSEMBLER_IMMEDIATE) && a->size == 4) {
+            _short(assembler, false, 0xb8, a->reg);
+            _bytes(assembler, (uint64_t) b->value, 4);
+        } else if (_is_rm(a) && _is(b, ASSEMBLER_IMMEDIATE) && _fits32(b->value)) {
+            _rm(assembler, wide, 0xc7, 0, a, NULL, 4);
+            _bytes(assembler, (uint64_t) b->value, 4);
+        } else if (_is_rm(a) && _is(b, ASSEMBLER_REGISTER)) {
+            _rm(assembler, wide, 0x89, b->reg, a, b, 0);
+        } else if (_is(a, ASSEMBLER_REGISTER) && _is(b, ASSEMBLER_MEMORY)) {
+            _rm(assembler, wide, 0x8b, a->reg, b, a, 0);
+        } else {
+            return false;
+        }
+    } else if (strcmp(mnemonic, "movabs") == 0 && _is(a, ASSEMBLER_REGISTER)
+               && _is(b, ASSEMBLER_IMMEDIATE)) {
+        _short(assembler, true, 0xb8, a->reg);
+        _bytes(assembler, (uint64_t) b->value, 8);
+    } else if ((strcmp(mnemonic, "movsx") == 0 || strcmp(mnemonic, "movzx") == 0)
+               && _is(a, ASSEMBLER_REGISTER) && _is_rm(b) && (b->size == 1 || b->size == 2)) {
+        uint32_t opcode = (mnemonic[3] == 's' ? 0x0fbe : 0x0fb6) | (b->size == 2);
+        _rm(assembler, wide, opcode, a->reg, b, b, 0);
+    } else if (strcmp(mnemonic, "movsxd") == 0 && _is(a, ASSEMBLER_REGISTER) && _is_rm(b)) {
+        _rm(assembler, true, 0x63, a->reg, b, NULL, 0);
+    } else if (strcmp(mnemonic, "lea") == 0 && _is(a, ASSEMBLER_REGISTER)
+               && _is(b, ASSEMBLER_MEMORY)) {
+        _rm(assembler, wide, 0x8d, a->reg, b, NULL, 0);
+    } else if (strcmp(mnemonic, "imul") == 0 && _is(a, ASSEMBLER_REGISTER) && _is_rm(b)) {
+        _rm(assembler, wide, 0x0faf, a->reg, b, NULL, 0);
+    } else if (strcmp(mnemonic, "test") == 0 && _is_rm(a) && _is(b, ASSEMBLER_REGISTER)) {
+        _rm(assembler, wide, 0x85, b->reg, a, b, 0);
+    } else if (strcmp(mnemonic, "bt") == 0 && _is_rm(a) && _is(b, ASSEMBLER_REGISTER)) {
+        _rm(assembler, wide, 0x0fa3, b->reg, a, NULL, 0);
+    } else if (strcmp(mnemonic, "bt") == 0 && _is_rm(a) && _is(b, ASSEMBLER_IMMEDIATE)) {
+        _rm(assembler, wide, 0x0fba, 4, a, NULL, 1);
+        _byte(assembler, (uint8_t) b->value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool _one_operand(assembler_t *assembler, const char *mnemonic, const assembler_operand_t *a)
+{
+    bool wide = a->size == 8;
+    int condition;
+
+    if (mnemonic[0] == 'j' && strcmp(mnemonic, "jmp") != 0
+        && (condition = _condition(mnemonic + 1)) >= 0 && _is(a, ASSEMBLER_TARGET)) {
+        uint8_t opcode[2] = {0x0f, (uint8_t) (0x80 | condition)};
+        _branch(assembler, opcode, 2, a);
+    } else if (strncmp(mnemonic, "set", 3) == 0 && (condition = _condition(mnemonic + 3)) >= 0
+               && _is_rm(a)) {
+        _rm(assembler, false, 0x0f90 | (uint32_t) condition, 0, a, a, 0);
+    } else if (strcmp(mnemonic, "jmp") == 0 || strcmp(mnemonic, "call") == 0) {
+        bool jump = mnemonic[0] == 'j';
+        uint8_t opcode = jump ? 0xe9 : 0xe8;
+        if (_is(a, ASSEMBLER_TARGET))
+            _branch(assembler, &opcode, 1, a);
+        else if (_is_rm(a))
+            _rm(assembler, false, 0xff, jump ? 4 : 2, a, NULL, 0);
+        else
+            return false;
+    } else if (strcmp(mnemonic, "push") == 0) {
+        if (_is(a, ASSEMBLER_REGISTER)) {
+            _short(assembler, false, 0x50, a->reg);
+        } else if (_is(a, ASSEMBLER_IMMEDIATE) && _fits32(a->value)) {
+            _byte(assembler, _fits8(a->value) ? 0x6a : 0x68);
+            _bytes(assembler, (uint64_t) a->value, _fits8(a->value) ? 1 : 4);
+        } else if (_is(a, ASSEMBLER_MEMORY)) {
+            _rm(assembler, false, 0xff, 6, a, NULL, 0);
+        } else {
+            return false;
+        }
+    } else if (strcmp(mnemonic, "pop") == 0 && _is(a, ASSEMBLER_REGISTER)) {
+        _short(assembler, false, 0x58, a->reg);
+    } else if (strcmp(mnemonic, "neg") == 0 && _is_rm(a)) {
+        _rm(assembler, wide, 0xf7, 3, a, NULL, 0);
+    } else if (strcmp(mnemonic, "div") == 0 && _is_rm(a)) {
+        _rm(assembler, wide, 0xf7, 6, a, NULL, 0);
+    } else if (strcmp(mnemonic, "idiv") == 0 && _is_rm(a)) {
+        _rm(assembler, wide, 0xf7, 7, a, NULL, 0);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void assembler_instr(
+    assembler_t *assembler,
+    const char *mnemonic,
+    const assembler_operand_t *operands,
+    uint32_t count)
+{
+    bool ok;
+    if (assembler->error != NULL)
+        return;
+
+    if (count == 0) {
+        static const char *names[] = {"ret", "leave", "cqo", "ud2", "int3"};
+        static const uint8_t codes[][2] = {{0xc3}, {0xc9}, {0x48, 0x99}, {0x0f, 0x0b}, {0xcc}};
+        uint32_t i;
+        for (i = 0; i < 5 && strcmp(names[i], mnemonic) != 0; i++)
+            ;
+        ok = i < 5;
+        if (ok)
+            _bytes(assembler, (uint64_t) codes[i][0] | (uint64_t) codes[i][1] << 8,
+                codes[i][1] != 0 ? 2 : 1);
+    } else if (count == 1) {
+        ok = _one_operand(assembler, mnemonic, &operands[0]);
+    } else if (count == 2) {
+        ok = _two_operands(assembler, mnemonic, &operands[0], &operands[1]);
+    } else {
+        const assembler_operand_t *a = &operands[0], *b = &operands[1], *c = &operands[2];
+        ok = count == 3 && strcmp(mnemonic, "imul") == 0 && _is(a, ASSEMBLER_REGISTER) && _is_rm(b)
+             && _is(c, ASSEMBLER_IMMEDIATE) && _fits32(c->value);
+        if (ok) {
+            bool small = _fits8(c->value);
+            _rm(assembler, a->size == 8, small ? 0x6b : 0x69, a->reg, b, NULL, small ? 1 : 4);
+            _bytes(assembler, (uint64_t) c->value, small ? 1 : 4);
+        }
+    }
+    if (!ok)
+        _fail(assembler, "unsupported instruction");
+}
+
+void assembler_align(assembler_t *assembler, uint32_t alignment)
+{
+    while (assembler->size & (alignment - 1))
+        _byte(assembler, 0xcc);
+}
+
+void assembler_define(assembler_t *assembler, assembler_target_t target)
+{
+    bool symbol = target.symbol != NULL;
+    assembler_definition_t **array = symbol ? &assembler->symbols : &assembler->labels;
+    uint32_t *count = symbol ? &assembler->symbol_count : &assembler->label_count;
+    uint32_t *capacity = symbol ? &assembler->symbol_capacity : &assembler->label_capacity;
+    if (!_grow(assembler, (void **) array, capacity, *count, sizeof(assembler_definition_t)))
+        return;
+    (*array)[*count].target = target;
+    (*array)[(*count)++].offset = (uint32_t) assembler->size;
+}
+
+void assembler_quad(assembler_t *assembler, assembler_target_t target)
+{
+    _fixup(assembler, ASSEMBLER_ABS64, target, 0);
+    _bytes(assembler, 0, 8);
+}
+
+void assembler_difference(
+    assembler_t *assembler, assembler_target_t target, assembler_target_t base)
+{
+    _fixup(assembler, ASSEMBLER_DIFFERENCE, target, 0);
+    if (assembler->error == NULL)
+        assembler->fixups[assembler->fixup_count - 1].base = base;
+    _bytes(assembler, 0, 4);
+}
+
+static int _compare_labels(const assembler_target_t *a, const assembler_target_t *b)
+{
+    int order = strcmp(a->prefix, b->prefix);
+    if (order != 0)
+        return order;
+    if (a->first != b->first)
+        return a->first < b->first ? -1 : 1;
+    if (a->second != b->second)
+        return a->second < b->second ? -1 : 1;
+    return 0;
+}
+
+static int _compare_definitions(const void *a, const void *b)
+{
+    const assembler_definition_t *first = a, *second = b;
+    return _compare_labels(&first->target, &second->target);
+}
+
+/* Offset of local label `target`, -1 when it was never defined */
+static int64_t _label(const assembler_t *assembler, const assembler_target_t *target)
+{
+    uint32_t low = 0, high = assembler->label_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int order = _compare_labels(&assembler->labels[middle].target, target);
+        if (order == 0)
+            return assembler->labels[middle].offset;
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return -1;
+}
+
+static void _patch32(assembler_t *assembler, uint32_t at, int64_t value)
+{
+    uint32_t i;
+    for (i = 0; i < 4; i++)
+        assembler->code[at + i] = (uint8_t) ((uint64_t) value >> (8 * i));
+}
+
+bool assembler_finish(assembler_t *assembler)
+{
+    uint32_t kept = 0, i;
+    if (assembler->error != NULL)
+        return false;
+    if (assembler->label_count > 0)
+        qsort(assembler->labels, assembler->label_count, sizeof(assembler_definition_t),
+            _compare_definitions);
+
+    for (i = 0; i < assembler->fixup_count; i++) {
+        assembler_fixup_t *fixup = &assembler->fixups[i];
+        if (fixup->target.symbol != NULL) {
+            assembler->fixups[kept++] = *fixup;
+            continue;
+        }
+        int64_t target = _label(assembler, &fixup->target);
+        int64_t base = fixup->kind == ASSEMBLER_DIFFERENCE ? _label(assembler, &fixup->base)
+                                                           : (int64_t) fixup->end;
+        if (target < 0 || base < 0 || fixup->kind == ASSEMBLER_ABS64) {
+            _fail(assembler, "undefined label");
+            return false;
+        }
+        _patch32(assembler, fixup->at, target - base);
+    }
+    assembler->fixup_count = kept;
+    return true;
+}
@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <ast.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AST_MIN_CAPACITY 64
+
+bool ast_init(ast_t *ast, arena_t *arena, intern_t *interner)
+{
+    memset(ast, 0, sizeof(ast_t));
+    ast->arena = arena;
+    ast->interner = interner;
+    return ast_add_node(ast, AST_ROOT, 0, 0, 0) == AST_NONE && ast->node_count == 1;
+}
+
+bool ast_reserve(ast_t *ast, uint32_t nodes, uint32_t extra)
+{
+    if (ast->node_count + nodes > ast->node_capacity) {
+        uint32_t capacity = ast->node_count + nodes;
+        ast_node_t *grown = arena_grow(
+            ast->arena, ast->nodes, ast->node_count, capacity, sizeof(ast_node_t));
+        if (grown == NULL)
+            return false;
+        ast->nodes = grown;
+        ast->node_capacity = capacity;
+    }
+    if (ast->extra_count + extra > ast->extra_capacity) {
+        uint32_t capacity = ast->extra_count + extra;
+        uint32_t *grown = arena_grow(
+            ast->arena, ast->extra, ast->extra_count, capacity, sizeof(uint32_t));
+        if (grown == NULL)
+            return false;
+        ast->extra = grown;
+        ast->extra_capacity = capacity;
+    }
+    return true;
+}
+
+ast_index_t ast_add_node(
+    ast_t *ast, ast_kind_t kind, uint32_t token, ast_index_t lhs, ast_index_t rhs)
+{
+    if (ast->node_count == ast->node_capacity) {
+        uint32_t capacity = ast->node_capacity ? ast->node_capacity : AST_MIN_CAPACITY;
+        if (!ast_reserve(ast, capacity, 0))
+            return AST_NONE;
+    }
+
+    ast_index_t index = ast->node_count++;
+    ast_node_t *node = &ast->nodes[index];
+    node->kind = kind;
+    node->op = 0;
+    node->flags = 0;
+    node->token = token;
+    node->lhs = lhs;
+    node->rhs = rhs;
+    return index;
+}
+
+uint32_t ast_add_extra(ast_t *ast, const uint32_t *values, uint32_t count)
+{
+    if (ast->extra_count + count > ast->extra_capacity) {
+        uint32_t capacity = ast->extra_capacity ? ast->extra_capacity : AST_MIN_CAPACITY;
+        while (capacity < count)
+            capacity *= 2;
+        if (!ast_reserve(ast, 0, capacity))
+            return 0;
+    }
+
+    uint32_t index = ast->extra_count;
+    if (count > 0)
+        memcpy(&ast->extra[index], values, count * sizeof(uint32_t));
+    ast->extra_count += count;
+    return index;
+}
+
+/* Parents seen so far of each node of the tree being validated */
+typedef struct
+{
+    const ast_t *ast;
+    uint8_t *parents;
+} ast_validator_t;
+
+/* A child is none, or a node other than the root that has no other parent */
+static bool _check_child(ast_validator_t *validator, ast_index_t node)
+{
+    if (node == AST_NONE)
+        return true;
+    if (node >= validator->ast->node_count || validator->parents[node] != 0)
+        return false;
+    validator->parents[node] = 1;
+    return true;
+}
+
+static bool _check_record(const ast_t *ast, uint32_t at, uint32_t size)
+{
+    return at <= ast->extra_count && size <= ast->extra_count - at;
+}
+
+/* extra[start..end) lists children, none of them missing */
+static bool _check_list(ast_validator_t *validator, uint32_t start, uint32_t end)
+{
+    const ast_t *ast = validator->ast;
+    if (start > end || end > ast->extra_count)
+        return false;
+    for (; start < end; start++)
+        if (ast->extra[start] == AST_NONE || !_check_child(validator, ast->extra[start]))
+            return false;
+    return true;
+}
+
+static bool _check_node(ast_validator_t *validator, const ast_node_t *node)
+{
+    const ast_t *ast = validator->ast;
+    const uint32_t *extra = ast->extra;
+    if (node->token >= ast->token_count)
+        return false;
+    switch ((ast_kind_t) node->kind) {
+    case AST_FUNCTION:
+    case AST_FUNCTION_TYPE:
+        return _check_record(ast, node->lhs, 3)
+               && _check_list(validator, extra[node->lhs], extra[node->lhs + 1])
+               && _check_child(validator, extra[node->lhs + 2])
+               && (node->kind == AST_FUNCTION_TYPE || _check_child(validator, node->rhs));
+    case AST_IMPL:
+        return _check_record(ast, node->lhs, 3) && _check_child(validator, extra[node->lhs])
+               && _check_list(validator, extra[node->lhs + 1], extra[node->lhs + 2]);
+    case AST_CLASS:
+    case AST_INTERFACE:
+    case AST_ENUM:
+    case AST_BLOCK:
+        return _check_list(validator, node->lhs, node->rhs);
+    case AST_LAZY_BODY:
+        return node->lhs < ast->token_count;
+    case AST_IF:
+        return _check_child(validator, node->lhs) && _check_record(ast, node->rhs, 2)
+               && _check_child(validator, extra[node->rhs])
+               && _check_child(validator, extra[node->rhs + 1]);
+    case AST_SWITCH:
+    case AST_CALL:
+        return _check_child(validator, node->lhs) && _check_record(ast, node->rhs, 2)
+               && _check_list(validator, extra[node->rhs], extra[node->rhs + 1]);
+    case AST_CASE:
+        return _check_record(ast, node->lhs, 2)
+               && _check_list(validator, extra[node->lhs], extra[node->lhs + 1])
+               && _check_child(validator, node->rhs);
+    case AST_ENUM_VARIANT:
+    case AST_IDENTIFIER:
+    case AST_INTEGER:
+    case AST_BOOL:
+    case AST_NULL:
+    case AST_TYPE_NAME:
+    case AST_BREAK:
+    case AST_CONTINUE:
+    case AST_FALL:
+    case AST_SKIP:
+        return true;
+    case AST_PARAM:
+    case AST_FIELD:
+    case AST_TYPE_ALIAS:
+    case AST_LET:
+    case AST_RETURN:
+    case AST_FOR:
+    case AST_EXPR_STMT:
+    case AST_ASSIGN:
+    case AST_BINARY:
+    case AST_UNARY:
+    case AST_MEMBER:
+    case AST_PATH:
+        return _check_child(validator, node->lhs) && _check_child(validator, node->rhs);
+    default:
+        /* Including a root anywhere but at 0 */
+        return false;
+    }
+}
+
+bool ast_validate(const ast_t *ast)
+{
+    uint32_t i;
+    if (ast->token_count == 0 || ast->node_count == 0 || ast->nodes[0].kind != AST_ROOT
+        || ast->tokens[ast->token_count - 1].type != TOKEN_EOF)
+        return false;
+    for (i = 0; i < ast->token_count; i++) {
+        const token_t *token = &ast->tokens[i];
+        if (token->type < TOKEN_INVALID || token->type > TOKEN_RIGHT_BRACE
+            || memchr(token->value, '\0', sizeof(token->value)) == NULL
+            || ast->names[i] >= ast->interner->count)
+            return false;
+    }
+
+    /* A node with one parent at most cannot be its own ancestor */
+    ast_validator_t validator = {ast, calloc(ast->node_count, 1)};
+    if (validator.parents == NULL)
+        return false;
+    bool ok = _check_list(&validator, ast->nodes[0].lhs, ast->nodes[0].rhs);
+    for (i = 1; ok && i < ast->node_count; i++)
+        ok = _check_node(&validator, &ast->nodes[i]);
+    free(validator.parents);
+    return ok;
+}
+
+static ast_index_t _relocate(ast_index_t node, uint32_t node_base)
+{
+    return node == AST_NONE ? AST_NONE : node + node_base;
+}
+
+/* Turns the record entries at `at` and `at + 1` back into extra indices */
+static void _relocate_range(uint32_t *extra, const ast_t *part, uint32_t at, uint32_t extra_base)
+{
+    extra[at] = part->extra[at] + extra_base;
+    extra[at + 1] = part->extra[at + 1] + extra_base;
+}
+
+/* Appends everything of `part` but its root, the arrays being reserved already */
+static bool _merge_part(ast_t *ast, const ast_t *part, size_t line_offset)
+{
+    uint32_t token_base = ast->token_count, node_base = ast->node_count - 1;
+    uint32_t extra_base = ast->extra_count, i;
+    const intern_t *interner = part->interner;
+    intern_id_t *ids = malloc(interner->count * sizeof(intern_id_t));
+    if (ids == NULL)
+        return false;
+    ids[INTERN_NONE] = INTERN_NONE;
+    for (i = 1; i < interner->count; i++) {
+        const intern_entry_t *entry = &interner->entries[i];
+        if ((ids[i] = intern(ast->interner, entry->string, entry->length)) == INTERN_NONE) {
+            free(ids);
+            return false;
+        }
+    }
+    for (i = 0; i < part->token_count; i++) {
+        token_t *token = &ast->tokens[token_base + i];
+        *token = part->tokens[i];
+        token->line += line_offset;
+        ast->names[token_base + i] = ids[part->names[i]];
+    }
+    ast->token_count += part->token_count;
+    free(ids);
+
+    /* Extra entries are nodes, except for the ranges inside records fixed below */
+    uint32_t *extra = ast->extra + extra_base;
+    for (i = 0; i < part->extra_count; i++)
+        extra[i] = _relocate(part->extra[i], node_base);
+    ast->extra_count += part->extra_count;
+
+    for (i = 1; i < part->node_count; i++) {
+        const ast_node_t *from = &part->nodes[i];
+        ast_node_t *node = &ast->nodes[node_base + i];
+        *node = *from;
+        node->token += token_base;
+        switch ((ast_kind_t) from->kind) {
+        case AST_FUNCTION:
+            _relocate_range(extra, part, from->lhs, extra_base);
+            node->lhs += extra_base;
+            node->rhs = _relocate(from->rhs, node_base);
+            break;
+        case AST_FUNCTION_TYPE:
+            _relocate_range(extra, part, from->lhs, extra_base);
+            node->lhs += extra_base;
+            break;
+        case AST_IMPL:
+            _relocate_range(extra, part, from->lhs + 1, extra_base);
+            node->lhs += extra_base;
+            break;
+        case AST_CLASS:
+        case AST_INTERFACE:
+        case AST_ENUM:
+        case AST_BLOCK:
+            node->lhs += extra_base;
+            node->rhs += extra_base;
+            break;
+        case AST_LAZY_BODY:
+            node->lhs += token_base;
+            break;
+        case AST_IF:
+            node->lhs = _relocate(from->lhs, node_base);
+            node->rhs += extra_base;
+            break;
+        case AST_SWITCH:
+        case AST_CALL:
+            _relocate_range(extra, part, from->rhs, extra_base);
+            node->lhs = _relocate(from->lhs, node_base);
+            node->rhs += extra_base;
+            break;
+        case AST_CASE:
+            _relocate_range(extra, part, from->lhs, extra_base);
+            node->lhs += extra_base;
+            node->rhs = _relocate(from->rhs, node_base);
+            break;
+        case AST_ENUM_VARIANT:
+        case AST_IDENTIFIER:
+        case AST_INTEGER:
+        case AST_BOOL:
+        case AST_NULL:
+        case AST_TYPE_NAME:
+        case AST_BREAK:
+        case AST_CONTINUE:
+        case AST_FALL:
+        case AST_SKIP:
+            break;
+        default:
+            node->lhs = _relocate(from->lhs, node_base);
+            node->rhs = _relocate(from->rhs, node_base);
+            break;
+        }
+    }
+    ast->node_count += part->node_count - 1;
+    return true;
+}
+
+bool ast_merge(ast_t *ast, const ast_t *const *parts, uint32_t count, const size_t *line_offsets)
+{
+    uint32_t tokens = 0, nodes = 0, extra = 0, declarations = 0, i;
+    for (i = 0; i < count; i++) {
+        tokens += parts[i]->token_count;
+        nodes += parts[i]->node_count - 1;
+        extra += parts[i]->extra_count;
+        declarations += parts[i]->nodes[0].rhs - parts[i]->nodes[0].lhs;
+    }
+
+    ast->tokens = arena_alloc_aligned(ast->arena, tokens * sizeof(token_t), sizeof(size_t));
+    ast->names = arena_alloc_aligned(
+        ast->arena, tokens * sizeof(intern_id_t), sizeof(intern_id_t));
+    ast->token_count = 0;
+    if (ast->tokens == NULL || ast->names == NULL || !ast_reserve(ast, nodes, extra + declarations))
+        return false;
+
+    uint32_t extra_base = ast->extra_count;
+    for (i = 0; i < count; i++)
+        if (!_merge_part(ast, parts[i], line_offsets[i]))
+            return false;
+
+    /* Every part's declarations, in order, make up the root */
+    ast_node_t *root = &ast->nodes[0];
+    root->lhs = ast->extra_count;
+    for (i = 0; i < count; i++) {
+        const ast_node_t *part_root = &parts[i]->nodes[0];
+        memcpy(&ast->extra[ast->extra_count], &ast->extra[extra_base + part_root->lhs],
+            (part_root->rhs - part_root->lhs) * sizeof(uint32_t));
+        ast->extra_count += part_root->rhs - part_root->lhs;
+        extra_base += parts[i]->extra_count;
+    }
+    root->rhs = ast->extra_count;
+    return true;
+}
+
+const char *ast_kind_name(ast_kind_t kind)
+{
+    switch (kind) {
+    case AST_ROOT:
+        return "root";
+    case AST_FUNCTION:
+        return "function";
+    case AST_PARAM:
+        return "param";
+    case AST_CLASS:
+        return "class";
+    case AST_FIELD:
+        return "field";
+    case AST_INTERFACE:
+        return "interface";
+    case AST_IMPL:
+        return "impl";
+    case AST_ENUM:
+        return "enum";
+    case AST_ENUM_VARIANT:
+        return "variant";
+    case AST_TYPE_ALIAS:
+        return "type";
+    case AST_LET:
+        return "let";
+    case AST_BLOCK:
+        return "block";
+    case AST_LAZY_BODY:
+        return "lazy_body";
+    case AST_RETURN:
+        return "return";
+    case AST_IF:
+        return "if";
+    case AST_FOR:
+        return "for";
+    case AST_SWITCH:
+        return "switch";
+    case AST_CASE:
+        return "case";
+    case AST_BREAK:
+        return "break";
+    case AST_CONTINUE:
+        return "continue";
+    case AST_FALL:
+        return "fall";
+    case AST_SKIP:
+        return "skip";
+    case AST_EXPR_STMT:
+        return "expr";
+    case AST_ASSIGN:
+        return "assign";
+    case AST_BINARY:
+        return "binary";
+    case AST_UNARY:
+        return "unary";
+    case AST_CALL:
+        return "call";
+    case AST_MEMBER:
+        return "member";
+    case AST_PATH:
+        return "path";
+    case AST_IDENTIFIER:
+        return "identifier";
+    case AST_INTEGER:
+        return "integer";
+    case AST_BOOL:
+        return "bool";
+    case AST_NULL:
+        return "null";
+    case AST_TYPE_NAME:
+        return "type_name";
+    case AST_FUNCTION_TYPE:
+        return "function_type";
+    }
+    return "unknown";
+}
+
+static void _dump_range(const ast_t *ast, uint32_t start, uint32_t end, FILE *out)
+{
+    uint32_t i;
+    for (i = start; i < end; i++) {
+        fputc(' ', out);
+        ast_dump(ast, ast->extra[i], out);
+    }
+}
+
+static void _dump_child(const ast_t *ast, ast_index_t child, FILE *out)
+{
+    fputc(' ', out);
+    if (child == AST_NONE)
+        fputs("_", out);
+    else
+        ast_dump(ast, child, out);
+}
+
+/* Prints `node` as an s-expression, mostly for tests and --dump-ast. */
+void ast_dump(const ast_t *ast, ast_index_t node_index, FILE *out)
+{
+    const ast_node_t *node = ast_node(ast, node_index);
+    const token_t *token = ast_token(ast, node_index);
+    const uint32_t *extra = ast->extra;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_IDENTIFIER:
+    case AST_TYPE_NAME:
+    case AST_ENUM_VARIANT:
+        fputs(token->value, out);
+        return;
+    case AST_INTEGER:
+        fprintf(out, "%llu", ((unsigned long long) node->rhs << 32) | node->lhs);
+        return;
+    case AST_BOOL:
+        fputs(node->lhs ? "true" : "false", out);
+        return;
+    case AST_NULL:
+    case AST_BREAK:
+    case AST_CONTINUE:
+    case AST_FALL:
+    case AST_SKIP:
+        fputs(ast_kind_name(node->kind), out);
+        return;
+    default:
+        break;
+    }
+
+    fprintf(out, "(%s", ast_kind_name(node->kind));
+    switch ((ast_kind_t) node->kind) {
+    case AST_ROOT:
+    case AST_BLOCK:
+        _dump_range(ast, node->lhs, node->rhs, out);
+        break;
+    case AST_LAZY_BODY:
+        fprintf(out, " %u..%u", (unsigned) node->token, (unsigned) node->lhs);
+        break;
+    case AST_CLASS:
+    case AST_INTERFACE:
+    case AST_ENUM:
+        fprintf(out, " %s", token->value);
+        _dump_range(ast, node->lhs, node->rhs, out);
+        break;
+    case AST_FUNCTION:
+        fprintf(out, " %s (", token->value);
+        _dump_range(ast, extra[node->lhs], extra[node->lhs + 1], out);
+        fputs(" )", out);
+        _dump_child(ast, extra[node->lhs + 2], out);
+        _dump_child(ast, node->rhs, out);
+        break;
+    case AST_FUNCTION_TYPE:
+        fputs(" (", out);
+        _dump_range(ast, extra[node->lhs], extra[node->lhs + 1], out);
+        fputs(" )", out);
+        _dump_child(ast, extra[node->lhs + 2], out);
+        break;
+    case AST_IMPL:
+        fprintf(out, " %s", token->value);
+        _dump_child(ast, extra[node->lhs], out);
+        _dump_range(ast, extra[node->lhs + 1], extra[node->lhs + 2], out);
+        break;
+    case AST_PARAM:
+    case AST_FIELD:
+    case AST_TYPE_ALIAS:
+        fprintf(out, " %s", token->value);
+        _dump_child(ast, node->lhs, out);
+        break;
+    case AST_LET:
+        fprintf(out, " %s", token->value);
+        _dump_child(ast, node->lhs, out);
+        _dump_child(ast, node->rhs, out);
+        break;
+    case AST_RETURN:
+    case AST_EXPR_STMT:
+        _dump_child(ast, node->lhs, out);
+        break;
+    case AST_IF:
+        _dump_child(ast, node->lhs, out);
+        _dump_child(ast, extra[node->rhs], out);
+        _dump_child(ast, extra[node->rhs + 1], out);
+        break;
+    case AST_FOR:
+        _dump_child(ast, node->lhs, out);
+        _dump_child(ast, node->rhs, out);
+        break;
+    case AST_SWITCH:
+        _dump_child(ast, node->lhs, out);
+        _dump_range(ast, extra[node->rhs], extra[node->rhs + 1], out);
+        break;
+    case AST_CASE:
+        if (node->flags & AST_FLAG_DEFAULT)
+            fputs(" default", out);
+        _dump_range(ast, extra[node->lhs], extra[node->lhs + 1], out);
+        _dump_child(ast, node->rhs, out);
+        break;
+    case AST_ASSIGN:
+    case AST_BINARY:
+        fprintf(out, " %s", token->value);
+        _dump_child(ast, node->lhs, out);
+        _dump_child(ast, node->rhs, out);
+        break;
+    case AST_UNARY:
+        fprintf(out, " %s", token->value);
+        _dump_child(ast, node->lhs, out);
+        break;
+    case AST_CALL:
+        _dump_child(ast, node->lhs, out);
+        _dump_range(ast, extra[node->rhs], extra[node->rhs + 1], out);
+        break;
+    case AST_MEMBER:
+    case AST_PATH:
+        _dump_child(ast, node->lhs, out);
+        fprintf(out, " %s", token->value);
+        break;
+    default:
+        break;
+    }
+    fputc(')', out);
+}
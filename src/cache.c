@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <cache.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils.h>
+#include <writer.h>
+
+#define CACHE_MAGIC "dashast"
+#define CACHE_PATH_MAX 4096
+
+#define CACHE_PRIME_1 ((uint64_t) 0x9e3779b185ebca87)
+#define CACHE_PRIME_2 ((uint64_t) 0xc2b2ae3d27d4eb4f)
+#define CACHE_PRIME_3 ((uint64_t) 0x165667b19e3779f9)
+
+typedef struct
+{
+    char magic[8];
+    uint64_t salt;
+    uint64_t key;
+    /* Of everything after the header, padding aside */
+    uint64_t payload_hash;
+    uint64_t string_bytes;
+    uint32_t token_count;
+    uint32_t node_count;
+    uint32_t extra_count;
+    uint32_t string_count;
+} cache_header_t;
+
+/* Identifier `i + 1` of the entry, as a NUL terminated range of its string bytes */
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+} cache_string_t;
+
+/* Offsets of the sections of an entry, each 8-byte aligned */
+typedef struct
+{
+    size_t tokens;
+    size_t names;
+    size_t nodes;
+    size_t extra;
+    size_t strings;
+    size_t bytes;
+    size_t size;
+} cache_layout_t;
+
+static uint64_t _rotate(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t cache_hash(const void *data, size_t size, uint64_t seed)
+{
+    /* One lane of XXH64: a multiply and a rotate per word, then an avalanche */
+    const unsigned char *bytes = data;
+    uint64_t hash = seed + CACHE_PRIME_3 + size, word;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        memcpy(&word, bytes, 8);
+        hash ^= _rotate(word * CACHE_PRIME_2, 31) * CACHE_PRIME_1;
+        hash = _rotate(hash, 27) * CACHE_PRIME_1 + CACHE_PRIME_3;
+    }
+    for (; size > 0; bytes++, size--) {
+        hash ^= *bytes * CACHE_PRIME_3;
+        hash = _rotate(hash, 11) * CACHE_PRIME_1;
+    }
+    hash ^= hash >> 33;
+    hash *= CACHE_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= CACHE_PRIME_3;
+    return hash ^ (hash >> 32);
+}
+
+bool cache_init(cache_t *cache, const char *directory, unsigned flags)
+{
+    /* The layout of the structures is part of the format too */
+    uint64_t layout[] = {flags, sizeof(token_t), sizeof(ast_node_t), sizeof(cache_header_t)};
+    cache->directory = directory;
+    cache->salt = cache_hash(CACHE_VERSION, strlen(CACHE_VERSION), 0);
+    cache->salt = cache_hash(layout, sizeof(layout), cache->salt);
+    return mkdir(directory, 0755) == 0 || errno == EEXIST;
+}
+
+uint64_t cache_key(const cache_t *cache, uint64_t hash)
+{
+    return cache_hash(&hash, sizeof(hash), cache->salt);
+}
+
+static void _entry_path(const cache_t *cache, uint64_t key, char *path)
+{
+    snprintf(path, CACHE_PATH_MAX, "%s/%016llx.ast", cache->directory, (unsigned long long) key);
+}
+
+static cache_layout_t _layout(const cache_header_t *header)
+{
+    cache_layout_t layout;
+    layout.tokens = sizeof(cache_header_t);
+    layout.names = ALIGN_UP(layout.tokens + header->token_count * sizeof(token_t), 8);
+    layout.nodes = ALIGN_UP(layout.names + header->token_count * sizeof(intern_id_t), 8);
+    layout.extra = ALIGN_UP(layout.nodes + header->node_count * sizeof(ast_node_t), 8);
+    layout.strings = ALIGN_UP(layout.extra + header->extra_count * sizeof(uint32_t), 8);
+    layout.bytes = layout.strings + header->string_count * sizeof(cache_string_t);
+    layout.size = layout.bytes + header->string_bytes;
+    return layout;
+}
+
+static uint64_t _payload_hash(
+    const cache_header_t *header, const ast_t *ast, const cache_string_t *strings,
+    const char *bytes)
+{
+    uint64_t hash = header->key;
+    hash = cache_hash(ast->tokens, header->token_count * sizeof(token_t), hash);
+    hash = cache_hash(ast->names, header->token_count * sizeof(intern_id_t), hash);
+    hash = cache_hash(ast->nodes, header->node_count * sizeof(ast_node_t), hash);
+    hash = cache_hash(ast->extra, header->extra_count * sizeof(uint32_t), hash);
+    hash = cache_hash(strings, header->string_count * sizeof(cache_string_t), hash);
+    return cache_hash(bytes, header->string_bytes, hash);
+}
+
+void cache_release(cache_entry_t *entry)
+{
+    if (entry->data != NULL)
+        munmap(entry->data, entry->size);
+    entry->data = NULL;
+    entry->size = 0;
+}
+
+/* Interns the entry's identifiers, which must get back their original ids */
+static bool _load_strings(const cache_header_t *header, const cache_layout_t *layout, ast_t *ast)
+{
+    const char *base = (const char *) header;
+    const cache_string_t *strings = (const cache_string_t *) (base + layout->strings);
+    const char *bytes = base + layout->bytes;
+    uint32_t i;
+    for (i = 0; i < header->string_count; i++) {
+        const cache_string_t *string = &strings[i];
+        if ((uint64_t) string->offset + string->length >= header->string_bytes
+            || bytes[string->offset + string->length] != '\0'
+            || intern(ast->interner, bytes + string->offset, string->length) != i + 1)
+            return false;
+    }
+    return true;
+}
+
+bool cache_load(const cache_t *cache, uint64_t key, ast_t *ast, cache_entry_t *entry)
+{
+    char path[CACHE_PATH_MAX];
+    struct stat status;
+    _entry_path(cache, key, path);
+    entry->data = NULL;
+    entry->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(cache_header_t)) {
+        void *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            entry->data = data;
+            entry->size = (size_t) status.st_size;
+        }
+    }
+    close(fd);
+    if (entry->data == NULL)
+        return false;
+
+    const cache_header_t *header = entry->data;
+    cache_layout_t layout = _layout(header);
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->salt != cache->salt || header->key != key || layout.size != entry->size) {
+        cache_release(entry);
+        return false;
+    }
+
+    /* The mapping is read-only, the tree must not grow */
+    char *base = entry->data;
+    ast_t mapped = *ast;
+    mapped.tokens = (token_t *) (base + layout.tokens);
+    mapped.names = (intern_id_t *) (base + layout.names);
+    mapped.token_count = header->token_count;
+    mapped.nodes = (ast_node_t *) (base + layout.nodes);
+    mapped.node_count = mapped.node_capacity = header->node_count;
+    mapped.extra = (uint32_t *) (base + layout.extra);
+    mapped.extra_count = mapped.extra_capacity = header->extra_count;
+
+    /* A damaged entry is a miss, the file gets parsed again */
+    const cache_string_t *strings = (const cache_string_t *) (base + layout.strings);
+    if (_payload_hash(header, &mapped, strings, base + layout.bytes) != header->payload_hash
+        || !_load_strings(header, &layout, ast) || !ast_validate(&mapped)) {
+        cache_release(entry);
+        return false;
+    }
+    *ast = mapped;
+    return true;
+}
+
+/* Writes `size` bytes at `offset`, padding from what was written so far */
+static void _write_at(
+    writer_t *writer, size_t *written, size_t offset, const void *data, size_t size)
+{
+    static const char padding[8];
+    writer_write(writer, padding, offset - *written);
+    if (size > 0)
+        writer_write(writer, data, size);
+    *written = offset + size;
+}
+
+bool cache_store(const cache_t *cache, uint64_t key, const ast_t *ast)
+{
+    const intern_t *interner = ast->interner;
+    cache_header_t header;
+    uint32_t i;
+    memset(&header, 0, sizeof(cache_header_t));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.salt = cache->salt;
+    header.key = key;
+    header.token_count = ast->token_count;
+    header.node_count = ast->node_count;
+    header.extra_count = ast->extra_count;
+    header.string_count = interner->count - 1;
+
+    cache_string_t *strings = malloc((header.string_count + 1) * sizeof(cache_string_t));
+    if (strings == NULL)
+        return false;
+    for (i = 0; i < header.string_count; i++) {
+        strings[i].offset = (uint32_t) header.string_bytes;
+        strings[i].length = interner->entries[i + 1].length;
+        header.string_bytes += strings[i].length + 1;
+    }
+    char *bytes = malloc(header.string_bytes + 1);
+    if (bytes == NULL) {
+        free(strings);
+        return false;
+    }
+    for (i = 0; i < header.string_count; i++)
+        memcpy(bytes + strings[i].offset, interner->entries[i + 1].string, strings[i].length + 1);
+    header.payload_hash = _payload_hash(&header, ast, strings, bytes);
+
+    char path[CACHE_PATH_MAX], temporary[CACHE_PATH_MAX];
+    _entry_path(cache, key, path);
+    snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path);
+    int fd = mkstemp(temporary);
+    writer_t writer;
+    if (fd < 0 || !writer_init(&writer, fd)) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(temporary);
+        }
+        free(strings);
+        free(bytes);
+        return false;
+    }
+
+    cache_layout_t layout = _layout(&header);
+    size_t written = 0;
+    _write_at(&writer, &written, 0, &header, sizeof(cache_header_t));
+    _write_at(&writer, &written, layout.tokens, ast->tokens, ast->token_count * sizeof(token_t));
+    _write_at(
+        &writer, &written, layout.names, ast->names, ast->token_count * sizeof(intern_id_t));
+    _write_at(&writer, &written, layout.nodes, ast->nodes, ast->node_count * sizeof(ast_node_t));
+    _write_at(&writer, &written, layout.extra, ast->extra, ast->extra_count * sizeof(uint32_t));
+    _write_at(&writer, &written, layout.strings, strings,
+        header.string_count * sizeof(cache_string_t));
+    _write_at(&writer, &written, layout.bytes, bytes, header.string_bytes);
+    free(strings);
+    free(bytes);
+
+    /* Renaming publishes the entry whole, or not at all */
+    bool ok = writer_destroy(&writer);
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temporary, path) == 0;
+    if (!ok)
+        unlink(temporary);
+    return ok;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <diagnostic.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define DIAGNOSTIC_MESSAGE_MAX 256
+
+void diagnostics_init(diagnostics_t *diagnostics, arena_t *arena)
+{
+    diagnostics->arena = arena;
+    diagnostics->items = NULL;
+    diagnostics->count = 0;
+    diagnostics->capacity = 0;
+    diagnostics->sources = NULL;
+    diagnostics->source_count = 0;
+}
+
+void diagnostics_add(
+    diagnostics_t *diagnostics, size_t line, size_t column, const char *format, ...)
+{
+    if (diagnostics->count == diagnostics->capacity) {
+        uint32_t capacity = diagnostics->capacity ? diagnostics->capacity * 2 : 16;
+        diagnostic_t *items = arena_alloc_aligned(
+            diagnostics->arena, capacity * sizeof(diagnostic_t), sizeof(void *));
+        if (items == NULL)
+            return;
+        if (diagnostics->count > 0)
+            memcpy(items, diagnostics->items, diagnostics->count * sizeof(diagnostic_t));
+        diagnostics->items = items;
+        diagnostics->capacity = capacity;
+    }
+
+    char buffer[DIAGNOSTIC_MESSAGE_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    size_t length = strlen(buffer) + 1;
+    char *message = arena_alloc(diagnostics->arena, length);
+    if (message == NULL)
+        return;
+    memcpy(message, buffer, length);
+
+    diagnostic_t *diagnostic = &diagnostics->items[diagnostics->count++];
+    diagnostic->line = line;
+    diagnostic->column = column;
+    diagnostic->message = message;
+}
+
+size_t diagnostics_locate(const diagnostics_t *diagnostics, size_t line, const char **path)
+{
+    *path = NULL;
+    if (diagnostics->source_count == 0)
+        return line;
+
+    /* Last source starting before `line`, lines without a location stay 0 in the first */
+    uint32_t low = 0, high = diagnostics->source_count - 1;
+    while (low < high) {
+        uint32_t middle = low + (high - low + 1) / 2;
+        if (diagnostics->sources[middle].first_line < line)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    const diagnostic_source_t *source = &diagnostics->sources[low];
+    *path = source->path;
+    return line > source->first_line ? line - source->first_line : 0;
+}
+
+void diagnostics_print(const diagnostics_t *diagnostics, FILE *out, const char *path)
+{
+    uint32_t i;
+    for (i = 0; i < diagnostics->count; i++) {
+        const diagnostic_t *diagnostic = &diagnostics->items[i];
+        const char *source;
+        size_t line = diagnostics_locate(diagnostics, diagnostic->line, &source);
+        fprintf(
+            out,
+            "%s:%zu:%zu: error: %s\n",
+            source != NULL ? source : path,
+            line,
+            diagnostic->column,
+            diagnostic->message);
+    }
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <driver.h>
+#include <lexer.h>
+#include <parser.h>
+#include <reader.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <trace.h>
+
+bool driver_init(driver_t *driver, const char *const *paths, uint32_t count)
+{
+    uint32_t i;
+    memset(driver, 0, sizeof(driver_t));
+    driver->files = calloc(count, sizeof(driver_file_t *));
+    if (driver->files == NULL)
+        return false;
+    for (i = 0; i < count; i++) {
+        if ((driver->files[i] = calloc(1, sizeof(driver_file_t))) == NULL)
+            return false;
+        driver->files[i]->path = paths[i];
+        driver->file_count++;
+    }
+    return true;
+}
+
+static void _release(driver_file_t *file)
+{
+    if (file->loaded)
+        arena_destroy(&file->arena);
+    cache_release(&file->entry);
+    file->loaded = false;
+    file->ok = false;
+}
+
+static void _free_file(driver_file_t *file)
+{
+    _release(file);
+    free(file);
+}
+
+/* Finds or adds the file for `path`, NULL when out of memory */
+static driver_file_t *_lookup(driver_t *driver, const char *path)
+{
+    intern_id_t id = intern(&driver->paths, path, strlen(path));
+    if (id == INTERN_NONE)
+        return NULL;
+    if (id >= driver->path_capacity) {
+        uint32_t capacity = driver->path_capacity ? driver->path_capacity * 2 : 64;
+        while (capacity <= id)
+            capacity *= 2;
+        driver_file_t **by_path = realloc(driver->by_path, capacity * sizeof(driver_file_t *));
+        if (by_path == NULL)
+            return NULL;
+        memset(by_path + driver->path_capacity, 0,
+            (capacity - driver->path_capacity) * sizeof(driver_file_t *));
+        driver->by_path = by_path;
+        driver->path_capacity = capacity;
+    }
+    if (driver->by_path[id] == NULL && (driver->by_path[id] = calloc(1, sizeof(driver_file_t)))) {
+        driver->by_path[id]->path = intern_string(&driver->paths, id);
+        driver->by_path[id]->path_id = id;
+    }
+    return driver->by_path[id];
+}
+
+bool driver_set_inputs(driver_t *driver, const char *const *paths, uint32_t count)
+{
+    uint32_t i, kept = 0;
+    if (!driver->persistent) {
+        if (!arena_init(&driver->arena))
+            return false;
+        driver->persistent = true;
+        if (!intern_init(&driver->paths, &driver->arena))
+            return false;
+    }
+
+    driver_file_t **files = malloc((count + 1) * sizeof(driver_file_t *));
+    if (files == NULL)
+        return false;
+    for (i = 0; i < count; i++) {
+        driver_file_t *file = _lookup(driver, paths[i]);
+        if (file == NULL) {
+            for (; kept > 0; kept--)
+                files[kept - 1]->listed = false;
+            free(files);
+            return false;
+        }
+        if (!file->listed)
+            files[kept++] = file;
+        file->listed = true;
+    }
+
+    /* Files that are not inputs anymore would only hold on to memory */
+    for (i = 0; i < driver->file_count; i++) {
+        driver_file_t *file = driver->files[i];
+        if (!file->listed) {
+            driver->by_path[file->path_id] = NULL;
+            _free_file(file);
+        }
+    }
+    for (i = 0; i < kept; i++)
+        files[i]->listed = false;
+    free(driver->files);
+    driver->files = files;
+    driver->file_count = kept;
+    return true;
+}
+
+void driver_destroy(driver_t *driver)
+{
+    uint32_t i;
+    for (i = 0; i < driver->file_count; i++)
+        _free_file(driver->files[i]);
+    free(driver->files);
+    free(driver->by_path);
+    if (driver->persistent)
+        arena_destroy(&driver->arena);
+    memset(driver, 0, sizeof(driver_t));
+}
+
+static bool _stamp(const char *path, driver_stamp_t *stamp)
+{
+    struct stat status;
+    memset(stamp, 0, sizeof(driver_stamp_t));
+    if (stat(path, &status) != 0)
+        return false;
+    stamp->inode = (uint64_t) status.st_ino;
+    stamp->size = (uint64_t) status.st_size;
+    stamp->seconds = (int64_t) status.st_mtim.tv_sec;
+    stamp->nanoseconds = (int64_t) status.st_mtim.tv_nsec;
+    return true;
+}
+
+static char *_read_file(arena_t *arena, const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    char *buffer = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long length = ftell(file);
+        if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            buffer = arena_alloc(arena, (size_t) length + 1);
+            if (buffer != NULL) {
+                *size = fread(buffer, 1, (size_t) length, file);
+                buffer[*size] = '\0';
+            }
+        }
+    }
+
+    fclose(file);
+    return buffer;
+}
+
+/* Lexes and parses `source`, or maps the tree from the cache */
+static bool _parse_source(driver_file_t *file, const cache_t *cache, const char *source)
+{
+    diagnostics_init(&file->diagnostics, &file->arena);
+    if (!intern_init(&file->interner, &file->arena)
+        || !ast_init(&file->ast, &file->arena, &file->interner)) {
+        file->error = "Out of memory reading";
+        return false;
+    }
+
+    uint64_t key = 0;
+    if (cache != NULL) {
+        trace_span_t load_span = trace_begin("cache_load");
+        key = cache_key(cache, file->hash);
+        file->cached = cache_load(cache, key, &file->ast, &file->entry);
+        trace_end(&load_span);
+        if (file->cached)
+            return true;
+    }
+
+    trace_span_t lex_span = trace_begin("lex");
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    bool ok = parser_tokenize(&file->ast, &lexer, &file->diagnostics);
+    trace_end(&lex_span);
+    if (!ok)
+        return false;
+
+    /* Bodies are parsed right away, they are the bulk of the work to spread */
+    trace_span_t parse_span = trace_begin("parse");
+    ok = parser_parse(&file->ast, &file->diagnostics, DRIVER_PARSE_FLAGS);
+    trace_end(&parse_span);
+
+    /* A failed store only costs the next compile a parse */
+    if (ok && cache != NULL) {
+        trace_span_t store_span = trace_begin("cache_store");
+        cache_store(cache, key, &file->ast);
+        trace_end(&store_span);
+    }
+    return ok;
+}
+
+static bool _parse_file(driver_file_t *file, const cache_t *cache)
+{
+    driver_stamp_t stamp;
+    bool stamped = _stamp(file->path, &stamp);
+    file->reused = file->ok && stamped && !memcmp(&stamp, &file->stamp, sizeof(driver_stamp_t));
+    if (file->reused)
+        return true;
+
+    arena_t arena;
+    size_t size = 0;
+    if (!arena_init(&arena)) {
+        _release(file);
+        file->error = "Out of memory reading";
+        return false;
+    }
+    trace_span_t read_span = trace_begin("read");
+    char *source = _read_file(&arena, file->path, &size);
+    trace_end(&read_span);
+    uint64_t hash = source != NULL ? cache_hash(source, size, 0) : 0;
+
+    /* Touched but not changed */
+    if (source != NULL && file->ok && hash == file->hash && size == file->size) {
+        arena_destroy(&arena);
+        file->stamp = stamp;
+        file->reused = true;
+        return true;
+    }
+
+    _release(file);
+    file->arena = arena;
+    file->loaded = true;
+    file->stamp = stamp;
+    file->hash = hash;
+    file->size = size;
+    file->cached = false;
+    file->error = NULL;
+    if (source == NULL) {
+        file->error = "Could not read";
+        return false;
+    }
+    return _parse_source(file, cache, source);
+}
+
+static void _parse_task(void *context, uint32_t worker, uint32_t task)
+{
+    driver_t *driver = context;
+    driver_file_t *file = driver->files[task];
+    (void) worker;
+    file->ok = _parse_file(file, driver->cache);
+}
+
+bool driver_parse(driver_t *driver, pool_t *pool)
+{
+    bool ok = true;
+    uint32_t i;
+    pool_run(pool, "parse_files", driver->file_count, _parse_task, driver);
+    driver->bytes = 0;
+    driver->tokens = driver->cache_hits = driver->reused = 0;
+    for (i = 0; i < driver->file_count; i++) {
+        const driver_file_t *file = driver->files[i];
+        driver->bytes += file->size;
+        driver->tokens += file->ast.token_count;
+        driver->cache_hits += file->cached && !file->reused;
+        driver->reused += file->reused;
+        ok = file->ok && ok;
+    }
+    return ok;
+}
+
+void driver_report(const driver_t *driver, FILE *out)
+{
+    uint32_t i;
+    for (i = 0; i < driver->file_count; i++) {
+        const driver_file_t *file = driver->files[i];
+        if (file->error != NULL)
+            fprintf(out, "%s '%s'\n", file->error, file->path);
+        else if (file->loaded)
+            diagnostics_print(&file->diagnostics, out, file->path);
+    }
+}
+
+bool driver_merge(driver_t *driver, ast_t *ast, diagnostics_t *diagnostics)
+{
+    uint32_t count = driver->file_count, i;
+    const ast_t **parts = malloc(count * sizeof(ast_t *));
+    size_t *line_offsets = malloc(count * sizeof(size_t));
+    diagnostic_source_t *sources = arena_alloc_aligned(
+        diagnostics->arena, count * sizeof(diagnostic_source_t), sizeof(void *));
+    bool ok = parts != NULL && line_offsets != NULL && sources != NULL;
+
+    size_t line_count = 0;
+    for (i = 0; ok && i < count; i++) {
+        const ast_t *part = &driver->files[i]->ast;
+        parts[i] = part;
+        line_offsets[i] = line_count;
+        sources[i].path = driver->files[i]->path;
+        sources[i].first_line = line_count;
+        /* No token comes after the EOF one, so no two files share a line */
+        line_count += part->tokens[part->token_count - 1].line;
+    }
+    ok = ok && ast_merge(ast, parts, count, line_offsets);
+    if (ok && count > 1) {
+        diagnostics->sources = sources;
+        diagnostics->source_count = count;
+    }
+
+    for (i = 0; !driver->persistent && i < count; i++)
+        _release(driver->files[i]);
+    free(parts);
+    free(line_offsets);
+    return ok;
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <emitter.h>
+#include <string.h>
+
+void emitter_init(emitter_t *emitter, writer_t *writer)
+{
+    memset(emitter, 0, sizeof(emitter_t));
+    emitter->writer = writer;
+}
+
+void emitter_init_assembler(emitter_t *emitter, assembler_t *assembler)
+{
+    memset(emitter, 0, sizeof(emitter_t));
+    emitter->assembler = assembler;
+}
+
+bool emitter_failed(const emitter_t *emitter)
+{
+    return emitter->assembler != NULL ? emitter->assembler->error != NULL
+                                      : emitter->writer->failed;
+}
+
+/* Fragments cannot be encoded, true when the emitter writes text */
+static bool _text(emitter_t *emitter)
+{
+    if (emitter->assembler == NULL)
+        return true;
+    if (emitter->assembler->error == NULL)
+        emitter->assembler->error = "text fragment in machine code";
+    return false;
+}
+
+/* The next operand slot of the instruction being built */
+static assembler_operand_t *_pending(emitter_t *emitter, uint8_t kind)
+{
+    static assembler_operand_t overflow;
+    assembler_operand_t *operand = emitter->operands < 3 ? &emitter->pending[emitter->operands]
+                                                         : &overflow;
+    emitter->operands++;
+    memset(operand, 0, sizeof(assembler_operand_t));
+    operand->kind = kind;
+    operand->index = ASSEMBLER_NO_REGISTER;
+    return operand;
+}
+
+static uint8_t _register_number(emitter_t *emitter, const char *name, uint8_t *size)
+{
+    uint8_t number = 0, ignored;
+    if (!assembler_register(name, &number, size != NULL ? size : &ignored)
+        && emitter->assembler->error == NULL)
+        emitter->assembler->error = "unknown register";
+    return number;
+}
+
+static assembler_target_t _local(const char *prefix, uint32_t first, uint32_t second)
+{
+    assembler_target_t target = {NULL, prefix, first, second};
+    return target;
+}
+
+static assembler_target_t _symbol(const char *name)
+{
+    assembler_target_t target = {name, NULL, 0, 0};
+    return target;
+}
+
+void emitter_text(emitter_t *emitter, const char *text)
+{
+    if (_text(emitter))
+        writer_puts(emitter->writer, text);
+}
+
+void emitter_unsigned(emitter_t *emitter, uint64_t value)
+{
+    if (_text(emitter))
+        writer_unsigned(emitter->writer, value);
+}
+
+void emitter_signed(emitter_t *emitter, int64_t value)
+{
+    if (_text(emitter))
+        writer_signed(emitter->writer, value);
+}
+
+void emitter_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second)
+{
+    if (!_text(emitter))
+        return;
+    writer_puts(emitter->writer, prefix);
+    writer_unsigned(emitter->writer, first);
+    if (second != EMITTER_NO_NUMBER) {
+        writer_putc(emitter->writer, '_');
+        writer_unsigned(emitter->writer, second);
+    }
+}
+
+void emitter_instr(emitter_t *emitter, const char *mnemonic)
+{
+    emitter->operands = 0;
+    if (emitter->assembler != NULL) {
+        emitter->mnemonic = mnemonic;
+        return;
+    }
+    writer_putc(emitter->writer, '\t');
+    writer_puts(emitter->writer, mnemonic);
+}
+
+void emitter_end(emitter_t *emitter)
+{
+    if (emitter->assembler == NULL) {
+        writer_putc(emitter->writer, '\n');
+    } else if (emitter->mnemonic != NULL) {
+        if (emitter->operands > 3 && emitter->assembler->error == NULL)
+            emitter->assembler->error = "too many operands";
+        assembler_instr(emitter->assembler, emitter->mnemonic, emitter->pending, emitter->operands);
+        emitter->mnemonic = NULL;
+    }
+}
+
+void emitter_line(emitter_t *emitter, const char *text)
+{
+    if (emitter->assembler != NULL)
+        return;
+    emitter_instr(emitter, text);
+    emitter_end(emitter);
+}
+
+void emitter_define_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second)
+{
+    if (emitter->assembler != NULL) {
+        assembler_define(emitter->assembler, _local(prefix, first, second));
+        return;
+    }
+    emitter_local(emitter, prefix, first, second);
+    writer_puts(emitter->writer, ":\n");
+}
+
+void emitter_define_symbol(emitter_t *emitter, const char *name)
+{
+    if (emitter->assembler != NULL) {
+        assembler_define(emitter->assembler, _symbol(name));
+        return;
+    }
+    writer_puts(emitter->writer, name);
+    writer_puts(emitter->writer, ":\n");
+}
+
+void emitter_align(emitter_t *emitter, uint32_t log2)
+{
+    if (emitter->assembler != NULL) {
+        assembler_align(emitter->assembler, 1u << log2);
+        return;
+    }
+    writer_puts(emitter->writer, "\t.p2align ");
+    writer_unsigned(emitter->writer, log2);
+    writer_putc(emitter->writer, '\n');
+}
+
+void emitter_begin_function(emitter_t *emitter, const char *name, bool global)
+{
+    writer_t *writer = emitter->writer;
+    if (emitter->assembler != NULL) {
+        emitter_align(emitter, 4);
+        emitter_define_symbol(emitter, name);
+        return;
+    }
+    if (global) {
+        writer_puts(writer, "\t.globl ");
+        writer_puts(writer, name);
+        writer_putc(writer, '\n');
+    }
+    emitter_align(emitter, 4);
+    writer_puts(writer, "\t.type ");
+    writer_puts(writer, name);
+    writer_puts(writer, ", @function\n");
+    emitter_define_symbol(emitter, name);
+}
+
+void emitter_end_function(emitter_t *emitter, const char *name)
+{
+    writer_t *writer = emitter->writer;
+    if (emitter->assembler != NULL)
+        return;
+    writer_puts(writer, "\t.size ");
+    writer_puts(writer, name);
+    writer_puts(writer, ", .-");
+    writer_puts(writer, name);
+    writer_putc(writer, '\n');
+}
+
+void emitter_quad_symbol(emitter_t *emitter, const char *name)
+{
+    if (emitter->assembler != NULL) {
+        assembler_quad(emitter->assembler, _symbol(name));
+        return;
+    }
+    writer_puts(emitter->writer, "\t.quad ");
+    writer_puts(emitter->writer, name);
+    writer_putc(emitter->writer, '\n');
+}
+
+void emitter_long_difference(
+    emitter_t *emitter,
+    const char *prefix,
+    uint32_t first,
+    uint32_t second,
+    const char *base_prefix,
+    uint32_t base_first,
+    uint32_t base_second)
+{
+    if (emitter->assembler != NULL) {
+        assembler_difference(emitter->assembler, _local(prefix, first, second),
+            _local(base_prefix, base_first, base_second));
+        return;
+    }
+    writer_puts(emitter->writer, "\t.long ");
+    emitter_local(emitter, prefix, first, second);
+    writer_puts(emitter->writer, " - ");
+    emitter_local(emitter, base_prefix, base_first, base_second);
+    writer_putc(emitter->writer, '\n');
+}
+
+void emitter_operand(emitter_t *emitter)
+{
+    if (_text(emitter))
+        writer_puts(emitter->writer, emitter->operands++ == 0 ? " " : ", ");
+}
+
+void emitter_register(emitter_t *emitter, const char *name)
+{
+    if (emitter->assembler != NULL) {
+        assembler_operand_t *operand = _pending(emitter, ASSEMBLER_REGISTER);
+        operand->reg = _register_number(emitter, name, &operand->size);
+        return;
+    }
+    emitter_operand(emitter);
+    writer_puts(emitter->writer, name);
+}
+
+void emitter_immediate(emitter_t *emitter, int64_t value)
+{
+    if (emitter->assembler != NULL) {
+        _pending(emitter, ASSEMBLER_IMMEDIATE)->value = value;
+        return;
+    }
+    emitter_operand(emitter);
+    writer_signed(emitter->writer, value);
+}
+
+static uint8_t _size(const char *size)
+{
+    if (size == NULL)
+        return 0;
+    if (strcmp(size, "qword") == 0)
+        return 8;
+    if (strcmp(size, "dword") == 0)
+        return 4;
+    return strcmp(size, "word") == 0 ? 2 : 1;
+}
+
+void emitter_memory(
+    emitter_t *emitter,
+    const char *size,
+    const char *base,
+    const char *index,
+    uint32_t scale,
+    int64_t displacement)
+{
+    writer_t *writer = emitter->writer;
+    if (emitter->assembler != NULL) {
+        assembler_operand_t *operand = _pending(emitter, ASSEMBLER_MEMORY);
+        operand->size = _size(size);
+        operand->reg = _register_number(emitter, base, NULL);
+        if (index != NULL)
+            operand->index = _register_number(emitter, index, NULL);
+        operand->scale = (uint8_t) scale;
+        operand->value = displacement;
+        return;
+    }
+    emitter_operand(emitter);
+    if (size != NULL) {
+        writer_puts(writer, size);
+        writer_puts(writer, " ptr ");
+    }
+    writer_putc(writer, '[');
+    writer_puts(writer, base);
+    if (index != NULL) {
+        writer_puts(writer, " + ");
+        writer_puts(writer, index);
+        if (scale != 1) {
+            writer_putc(writer, '*');
+            writer_unsigned(writer, scale);
+        }
+    }
+    if (displacement != 0) {
+        writer_puts(writer, displacement < 0 ? " - " : " + ");
+        writer_unsigned(
+            writer, displacement < 0 ? 0 - (uint64_t) displacement : (uint64_t) displacement);
+    }
+    writer_putc(writer, ']');
+}
+
+void emitter_local_operand(
+    emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second)
+{
+    if (emitter->assembler != NULL) {
+        _pending(emitter, ASSEMBLER_TARGET)->target = _local(prefix, first, second);
+        return;
+    }
+    emitter_operand(emitter);
+    emitter_local(emitter, prefix, first, second);
+}
+
+void emitter_symbol_operand(emitter_t *emitter, const char *name)
+{
+    if (emitter->assembler != NULL) {
+        _pending(emitter, ASSEMBLER_TARGET)->target = _symbol(name);
+        return;
+    }
+    emitter_operand(emitter);
+    writer_puts(emitter->writer, name);
+}
+
+static void _rip(emitter_t *emitter, assembler_target_t target)
+{
+    assembler_operand_t *operand = _pending(emitter, ASSEMBLER_MEMORY);
+    operand->reg = ASSEMBLER_RIP;
+    operand->target = target;
+}
+
+void emitter_rip_local(emitter_t *emitter, const char *prefix, uint32_t first, uint32_t second)
+{
+    if (emitter->assembler != NULL) {
+        _rip(emitter, _local(prefix, first, second));
+        return;
+    }
+    emitter_operand(emitter);
+    writer_puts(emitter->writer, "[rip + ");
+    emitter_local(emitter, prefix, first, second);
+    writer_putc(emitter->writer, ']');
+}
+
+void emitter_rip_symbol(emitter_t *emitter, const char *name)
+{
+    if (emitter->assembler != NULL) {
+        _rip(emitter, _symbol(name));
+        return;
+    }
+    emitter_operand(emitter);
+    writer_puts(emitter->writer, "[rip + ");
+    writer_puts(emitter->writer, name);
+    writer_putc(emitter->writer, ']');
+}
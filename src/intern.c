@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <intern.h>
+#include <string.h>
+
+#define INTERN_MIN_SLOTS 256
+
+static uint32_t _hash(const char *string, size_t length)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char) string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool _rehash(intern_t *interner, uint32_t slot_count)
+{
+    intern_id_t *slots = arena_alloc_aligned(
+        interner->arena, slot_count * sizeof(intern_id_t), sizeof(intern_id_t));
+    intern_entry_t *entries = arena_alloc_aligned(
+        interner->arena, (slot_count / 2) * sizeof(intern_entry_t), sizeof(void *));
+    if (slots == NULL || entries == NULL)
+        return false;
+
+    memset(slots, 0, slot_count * sizeof(intern_id_t));
+    if (interner->count > 0)
+        memcpy(entries, interner->entries, interner->count * sizeof(intern_entry_t));
+
+    uint32_t mask = slot_count - 1;
+    uint32_t id;
+    for (id = 1; id < interner->count; id++) {
+        uint32_t slot = entries[id].hash & mask;
+        while (slots[slot] != INTERN_NONE)
+            slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+
+    interner->slots = slots;
+    interner->slot_mask = mask;
+    interner->entries = entries;
+    interner->capacity = slot_count / 2;
+    return true;
+}
+
+bool intern_init(intern_t *interner, arena_t *arena)
+{
+    memset(interner, 0, sizeof(intern_t));
+    interner->arena = arena;
+    if (!_rehash(interner, INTERN_MIN_SLOTS))
+        return false;
+    /* Entry 0 backs INTERN_NONE */
+    interner->entries[0].string = "";
+    interner->count = 1;
+    return true;
+}
+
+static uint32_t _find_slot(
+    const intern_t *interner, const char *string, size_t length, uint32_t hash)
+{
+    uint32_t slot = hash & interner->slot_mask;
+    while (1) {
+        intern_id_t id = interner->slots[slot];
+        if (id == INTERN_NONE)
+            return slot;
+        const intern_entry_t *entry = &interner->entries[id];
+        if (entry->hash == hash && entry->length == length
+            && !memcmp(entry->string, string, length))
+            return slot;
+        slot = (slot + 1) & interner->slot_mask;
+    }
+}
+
+intern_id_t intern_find(const intern_t *interner, const char *string, size_t length)
+{
+    return interner->slots[_find_slot(interner, string, length, _hash(string, length))];
+}
+
+intern_id_t intern(intern_t *interner, const char *string, size_t length)
+{
+    uint32_t hash = _hash(string, length);
+    uint32_t slot = _find_slot(interner, string, length, hash);
+    if (interner->slots[slot] != INTERN_NONE)
+        return interner->slots[slot];
+
+    /* Keep the load factor at or below 1/2 */
+    if (interner->count == interner->capacity) {
+        if (!_rehash(interner, (interner->slot_mask + 1) * 2))
+            return INTERN_NONE;
+        slot = _find_slot(interner, string, length, hash);
+    }
+
+    char *copy = arena_alloc(interner->arena, length + 1);
+    if (copy == NULL)
+        return INTERN_NONE;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    intern_id_t id = interner->count++;
+    interner->entries[id].string = copy;
+    interner->entries[id].hash = hash;
+    interner->entries[id].length = (uint32_t) length;
+    interner->slots[slot] = id;
+    return id;
+}
+
+const char *intern_string(const intern_t *interner, intern_id_t id)
+{
+    return interner->entries[id].string;
+}
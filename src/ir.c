@@ -0,0 +1,818 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <ir.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IR_MIN_CAPACITY 16
+
+bool ir_module_init(ir_module_t *module, arena_t *arena, const ast_t *ast, uint32_t workers)
+{
+    uint32_t i;
+    memset(module, 0, sizeof(ir_module_t));
+    module->arena = arena;
+    module->ast = ast;
+    module->function_of_node = arena_alloc_aligned(
+        arena, ast->node_count * sizeof(uint32_t), sizeof(uint32_t));
+    module->worker_arenas = calloc(workers ? workers : 1, sizeof(arena_t));
+    if (module->function_of_node == NULL || module->worker_arenas == NULL)
+        return false;
+    memset(module->function_of_node, 0xff, ast->node_count * sizeof(uint32_t));
+
+    for (i = 0; i < (workers ? workers : 1); i++) {
+        if (!arena_init(&module->worker_arenas[i]))
+            return false;
+        module->worker_count = i + 1;
+    }
+    return true;
+}
+
+void ir_module_destroy(ir_module_t *module)
+{
+    uint32_t i;
+    for (i = 0; i < module->worker_count; i++)
+        arena_destroy(&module->worker_arenas[i]);
+    free(module->worker_arenas);
+    module->worker_arenas = NULL;
+    module->worker_count = 0;
+}
+
+uint32_t ir_find_vtable(const ir_module_t *module, ast_index_t impl)
+{
+    uint32_t low = 0, high = module->vtable_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (module->vtables[middle].impl < impl)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < module->vtable_count && module->vtables[low].impl == impl ? low : UINT32_MAX;
+}
+
+uint32_t ir_add_block(ir_function_t *function, arena_t *arena)
+{
+    if (function->block_count == function->block_capacity) {
+        uint32_t capacity = function->block_capacity ? function->block_capacity * 2
+                                                     : IR_MIN_CAPACITY;
+        ir_block_t *blocks = arena_grow(
+            arena, function->blocks, function->block_count, capacity, sizeof(ir_block_t));
+        if (blocks == NULL)
+            return UINT32_MAX;
+        function->blocks = blocks;
+        function->block_capacity = capacity;
+    }
+    memset(&function->blocks[function->block_count], 0, sizeof(ir_block_t));
+    return function->block_count++;
+}
+
+ir_value_t ir_add_instr(
+    ir_function_t *function,
+    arena_t *arena,
+    ir_op_t op,
+    ir_type_t type,
+    uint32_t a,
+    uint32_t b,
+    uint32_t c)
+{
+    if (function->instr_count == function->instr_capacity) {
+        uint32_t capacity = function->instr_capacity ? function->instr_capacity * 2
+                                                     : IR_MIN_CAPACITY * 4;
+        ir_instr_t *instrs = arena_grow(
+            arena, function->instrs, function->instr_count, capacity, sizeof(ir_instr_t));
+        if (instrs == NULL)
+            return IR_NONE;
+        function->instrs = instrs;
+        function->instr_capacity = capacity;
+        if (function->instr_count == 0) {
+            /* Value 0 means "none" */
+            memset(&instrs[0], 0, sizeof(ir_instr_t));
+            function->instr_count = 1;
+        }
+    }
+
+    ir_value_t value = function->instr_count++;
+    ir_instr_t *instr = &function->instrs[value];
+    instr->op = (uint8_t) op;
+    instr->type = (uint8_t) type;
+    instr->flags = 0;
+    instr->block = UINT32_MAX;
+    instr->a = a;
+    instr->b = b;
+    instr->c = c;
+    return value;
+}
+
+bool ir_block_push(ir_function_t *function, arena_t *arena, uint32_t block, ir_value_t value)
+{
+    ir_block_t *target = &function->blocks[block];
+    if (target->count == target->capacity) {
+        uint32_t capacity = target->capacity ? target->capacity * 2 : IR_MIN_CAPACITY;
+        ir_value_t *instrs = arena_grow(
+            arena, target->instrs, target->count, capacity, sizeof(ir_value_t));
+        if (instrs == NULL)
+            return false;
+        target->instrs = instrs;
+        target->capacity = capacity;
+    }
+    target->instrs[target->count++] = value;
+    function->instrs[value].block = block;
+    return true;
+}
+
+ir_value_t ir_append(
+    ir_function_t *function,
+    arena_t *arena,
+    uint32_t block,
+    ir_op_t op,
+    ir_type_t type,
+    uint32_t a,
+    uint32_t b,
+    uint32_t c)
+{
+    ir_value_t value = ir_add_instr(function, arena, op, type, a, b, c);
+    if (value == IR_NONE || !ir_block_push(function, arena, block, value))
+        return IR_NONE;
+    return value;
+}
+
+ir_value_t ir_append_const(
+    ir_function_t *function, arena_t *arena, uint32_t block, ir_type_t type, uint64_t value)
+{
+    value = ir_wrap(type, value);
+    return ir_append(
+        function, arena, block, IR_CONST, type, (uint32_t) value, (uint32_t) (value >> 32), 0);
+}
+
+bool ir_add_pred(ir_function_t *function, arena_t *arena, uint32_t block, uint32_t pred)
+{
+    ir_block_t *target = &function->blocks[block];
+    if (target->pred_count == target->pred_capacity) {
+        uint32_t capacity = target->pred_capacity ? target->pred_capacity * 2 : 4;
+        uint32_t *preds = arena_grow(
+            arena, target->preds, target->pred_count, capacity, sizeof(uint32_t));
+        if (preds == NULL)
+            return false;
+        target->preds = preds;
+        target->pred_capacity = capacity;
+    }
+    target->preds[target->pred_count++] = pred;
+    return true;
+}
+
+uint32_t ir_add_operands(
+    ir_function_t *function, arena_t *arena, const uint32_t *values, uint32_t count)
+{
+    if (function->operand_count + count > function->operand_capacity) {
+        uint32_t capacity = function->operand_capacity ? function->operand_capacity
+                                                       : IR_MIN_CAPACITY * 4;
+        while (capacity < function->operand_count + count)
+            capacity *= 2;
+        uint32_t *operands = arena_grow(
+            arena, function->operands, function->operand_count, capacity, sizeof(uint32_t));
+        if (operands == NULL)
+            return UINT32_MAX;
+        function->operands = operands;
+        function->operand_capacity = capacity;
+    }
+
+    uint32_t first = function->operand_count;
+    if (values != NULL && count > 0)
+        memcpy(&function->operands[first], values, count * sizeof(uint32_t));
+    else if (count > 0)
+        memset(&function->operands[first], 0, count * sizeof(uint32_t));
+    function->operand_count += count;
+    return first;
+}
+
+uint32_t ir_pred_index(const ir_function_t *function, uint32_t block, uint32_t pred)
+{
+    const ir_block_t *target = &function->blocks[block];
+    uint32_t i;
+    for (i = 0; i < target->pred_count; i++)
+        if (target->preds[i] == pred)
+            return i;
+    return UINT32_MAX;
+}
+
+void ir_remove_pred(ir_function_t *function, uint32_t block, uint32_t index)
+{
+    ir_block_t *target = &function->blocks[block];
+    uint32_t i;
+
+    for (i = 0; i < target->count; i++) {
+        ir_instr_t *phi = &function->instrs[target->instrs[i]];
+        if (phi->op != IR_PHI)
+            continue;
+        uint32_t *inputs = &function->operands[phi->a];
+        memmove(&inputs[index], &inputs[index + 1], (phi->b - index - 1) * sizeof(uint32_t));
+        phi->b--;
+    }
+    memmove(
+        &target->preds[index],
+        &target->preds[index + 1],
+        (target->pred_count - index - 1) * sizeof(uint32_t));
+    target->pred_count--;
+}
+
+uint64_t ir_const_value(const ir_instr_t *instr)
+{
+    return ((uint64_t) instr->b << 32) | instr->a;
+}
+
+void ir_set_const(ir_instr_t *instr, uint64_t value)
+{
+    value = ir_wrap((ir_type_t) instr->type, value);
+    instr->op = IR_CONST;
+    instr->a = (uint32_t) value;
+    instr->b = (uint32_t) (value >> 32);
+    instr->c = 0;
+}
+
+unsigned ir_type_bits(ir_type_t type)
+{
+    switch (type) {
+    case IR_BOOL:
+        return 1;
+    case IR_I8:
+    case IR_U8:
+        return 8;
+    case IR_I16:
+    case IR_U16:
+        return 16;
+    case IR_I32:
+    case IR_U32:
+        return 32;
+    case IR_I64:
+    case IR_U64:
+    case IR_PTR:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+bool ir_type_signed(ir_type_t type)
+{
+    return type >= IR_I8 && type <= IR_I64;
+}
+
+uint64_t ir_wrap(ir_type_t type, uint64_t value)
+{
+    unsigned bits = ir_type_bits(type);
+    if (bits == 0 || bits == 64)
+        return value;
+
+    uint64_t mask = (1ull << bits) - 1;
+    value &= mask;
+    if (ir_type_signed(type) && (value >> (bits - 1)))
+        value |= ~mask;
+    return value;
+}
+
+bool ir_is_terminator(ir_op_t op)
+{
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_SWITCH || op == IR_JUMP_TABLE
+           || op == IR_RETURN || op == IR_UNREACHABLE;
+}
+
+bool ir_has_side_effects(const ir_function_t *function, ir_value_t value)
+{
+    const ir_instr_t *instr = &function->instrs[value];
+    switch ((ir_op_t) instr->op) {
+    case IR_CALL:
+    case IR_CALL_INDIRECT:
+    case IR_STORE:
+    case IR_JUMP:
+    case IR_BRANCH:
+    case IR_SWITCH:
+    case IR_JUMP_TABLE:
+    case IR_RETURN:
+    case IR_UNREACHABLE:
+        return true;
+    case IR_DIV:
+    case IR_MOD:
+        /* Division traps on zero unless the divisor is a known non-zero constant */
+        return function->instrs[instr->b].op != IR_CONST
+               || ir_const_value(&function->instrs[instr->b]) == 0;
+    case IR_LOAD:
+        /* Loads through null trap */
+        return function->instrs[instr->a].op != IR_NEW;
+    default:
+        return false;
+    }
+}
+
+const char *ir_op_name(ir_op_t op)
+{
+    static const char *names[] = {
+        "nop", "const", "param", "phi", "copy", "add", "sub", "mul", "div", "mod", "neg", "not",
+        "eq", "ne", "lt", "le", "gt", "ge", "bittest", "func", "vtable", "method", "call",
+        "call_indirect", "second", "new", "load", "store", "jump", "br", "switch", "jumptable",
+        "ret", "unreachable"};
+    return op <= IR_UNREACHABLE ? names[op] : "?";
+}
+
+ir_value_t ir_terminator(const ir_function_t *function, uint32_t block)
+{
+    const ir_block_t *target = &function->blocks[block];
+    if (target->count == 0)
+        return IR_NONE;
+    ir_value_t last = target->instrs[target->count - 1];
+    return ir_is_terminator(function->instrs[last].op) ? last : IR_NONE;
+}
+
+uint32_t ir_successor_count(const ir_function_t *function, uint32_t block)
+{
+    ir_value_t terminator = ir_terminator(function, block);
+    if (terminator == IR_NONE)
+        return 0;
+    switch ((ir_op_t) function->instrs[terminator].op) {
+    case IR_JUMP:
+        return 1;
+    case IR_BRANCH:
+        return 2;
+    case IR_SWITCH:
+        return function->instrs[terminator].c + 1;
+    case IR_JUMP_TABLE:
+        return function->instrs[terminator].c;
+    default:
+        return 0;
+    }
+}
+
+uint32_t ir_successor(const ir_function_t *function, uint32_t block, uint32_t index)
+{
+    const ir_instr_t *terminator = &function->instrs[ir_terminator(function, block)];
+    switch ((ir_op_t) terminator->op) {
+    case IR_JUMP:
+        return terminator->a;
+    case IR_SWITCH:
+        return index == 0 ? function->operands[terminator->b]
+                          : ir_switch_target(function, terminator, index - 1);
+    case IR_JUMP_TABLE:
+        return function->operands[terminator->b + index];
+    default:
+        return index == 0 ? terminator->b : terminator->c;
+    }
+}
+
+uint64_t ir_switch_value(const ir_function_t *function, const ir_instr_t *instr, uint32_t index)
+{
+    const uint32_t *cases = &function->operands[instr->b + 1 + index * 3];
+    return ((uint64_t) cases[1] << 32) | cases[0];
+}
+
+uint32_t ir_switch_target(const ir_function_t *function, const ir_instr_t *instr, uint32_t index)
+{
+    return function->operands[instr->b + 1 + index * 3 + 2];
+}
+
+void ir_for_each_operand(
+    ir_function_t *function, ir_value_t value, void (*visit)(void *, uint32_t *), void *context)
+{
+    ir_instr_t *instr = &function->instrs[value];
+    uint32_t i;
+
+    switch ((ir_op_t) instr->op) {
+    case IR_PHI:
+        for (i = 0; i < instr->b; i++)
+            visit(context, &function->operands[instr->a + i]);
+        break;
+    case IR_COPY:
+    case IR_NEG:
+    case IR_NOT:
+    case IR_METHOD:
+    case IR_CALL_SECOND:
+    case IR_LOAD:
+    case IR_BRANCH:
+    case IR_SWITCH:
+    case IR_JUMP_TABLE:
+        visit(context, &instr->a);
+        break;
+    case IR_RETURN:
+        if (instr->a != IR_NONE)
+            visit(context, &instr->a);
+        if (instr->b != IR_NONE)
+            visit(context, &instr->b);
+        break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_BIT_TEST:
+    case IR_STORE:
+        visit(context, &instr->a);
+        visit(context, &instr->b);
+        break;
+    case IR_CALL_INDIRECT:
+        visit(context, &instr->a);
+        /* fall through */
+    case IR_CALL:
+        for (i = 0; i < instr->c; i++)
+            visit(context, &function->operands[instr->b + i]);
+        break;
+    default:
+        break;
+    }
+}
+
+void ir_for_each_target(
+    ir_function_t *function, ir_value_t value, void (*visit)(void *, uint32_t *), void *context)
+{
+    ir_instr_t *instr = &function->instrs[value];
+    uint32_t i;
+
+    switch ((ir_op_t) instr->op) {
+    case IR_JUMP:
+        visit(context, &instr->a);
+        break;
+    case IR_BRANCH:
+        visit(context, &instr->b);
+        visit(context, &instr->c);
+        break;
+    case IR_SWITCH:
+        visit(context, &function->operands[instr->b]);
+        for (i = 0; i < instr->c; i++)
+            visit(context, &function->operands[instr->b + 1 + i * 3 + 2]);
+        break;
+    case IR_JUMP_TABLE:
+        for (i = 0; i < instr->c; i++)
+            visit(context, &function->operands[instr->b + i]);
+        break;
+    default:
+        break;
+    }
+}
+
+bool ir_replace_pred(
+    ir_function_t *function,
+    arena_t *arena,
+    uint32_t block,
+    uint32_t old,
+    const uint32_t *preds,
+    uint32_t count)
+{
+    ir_block_t *target = &function->blocks[block];
+    uint32_t index = ir_pred_index(function, block, old), kept = 0, i, j;
+    if (index == UINT32_MAX)
+        return false;
+
+    /* Rebuild each phi's inputs: surviving edges first, then the new ones */
+    uint32_t pred_count = target->pred_count;
+    for (i = 0; i < target->count; i++) {
+        ir_value_t phi = target->instrs[i];
+        if (function->instrs[phi].op != IR_PHI)
+            continue;
+        uint32_t first = ir_add_operands(function, arena, NULL, pred_count + count);
+        if (first == UINT32_MAX)
+            return false;
+        const ir_instr_t *instr = &function->instrs[phi];
+        uint32_t incoming = function->operands[instr->a + index], n = 0;
+        for (j = 0; j < pred_count; j++)
+            if (target->preds[j] != old)
+                function->operands[first + n++] = function->operands[instr->a + j];
+        for (j = 0; j < count; j++)
+            function->operands[first + n++] = incoming;
+        function->instrs[phi].a = first;
+        function->instrs[phi].b = n;
+    }
+
+    for (j = 0; j < pred_count; j++)
+        if (target->preds[j] != old)
+            target->preds[kept++] = target->preds[j];
+    target->pred_count = kept;
+    for (j = 0; j < count; j++)
+        if (!ir_add_pred(function, arena, block, preds[j]))
+            return false;
+    return true;
+}
+
+uint32_t ir_reverse_postorder(const ir_function_t *function, uint32_t *order)
+{
+    uint32_t count = function->block_count, done = 0, depth = 0;
+    uint8_t *visited = calloc(count, 1);
+    /* Explicit DFS stack of (block, next successor) */
+    uint32_t *stack = malloc(count * 2 * sizeof(uint32_t));
+    if (visited == NULL || stack == NULL || count == 0) {
+        free(visited);
+        free(stack);
+        return 0;
+    }
+
+    visited[0] = 1;
+    stack[0] = 0;
+    stack[1] = 0;
+    depth = 1;
+    while (depth > 0) {
+        uint32_t *top = &stack[(depth - 1) * 2];
+        uint32_t block = top[0];
+        if (top[1] < ir_successor_count(function, block)) {
+            uint32_t next = ir_successor(function, block, top[1]++);
+            if (!visited[next]) {
+                visited[next] = 1;
+                stack[depth * 2] = next;
+                stack[depth * 2 + 1] = 0;
+                depth++;
+            }
+        } else {
+            /* Postorder, reversed in place below */
+            order[done++] = block;
+            depth--;
+        }
+    }
+
+    uint32_t i;
+    for (i = 0; i < done / 2; i++) {
+        uint32_t swap = order[i];
+        order[i] = order[done - 1 - i];
+        order[done - 1 - i] = swap;
+    }
+    free(visited);
+    free(stack);
+    return done;
+}
+
+void ir_dominators(
+    const ir_function_t *function, const uint32_t *order, uint32_t count, uint32_t *idom)
+{
+    uint32_t *position = malloc(function->block_count * sizeof(uint32_t));
+    uint32_t i, j;
+    bool changed = true;
+
+    if (position == NULL)
+        return;
+    for (i = 0; i < function->block_count; i++) {
+        idom[i] = UINT32_MAX;
+        position[i] = UINT32_MAX;
+    }
+    for (i = 0; i < count; i++)
+        position[order[i]] = i;
+    idom[order[0]] = order[0];
+
+    while (changed) {
+        changed = false;
+        for (i = 1; i < count; i++) {
+            const ir_block_t *block = &function->blocks[order[i]];
+            uint32_t dominator = UINT32_MAX;
+            for (j = 0; j < block->pred_count; j++) {
+                uint32_t pred = block->preds[j];
+                if (position[pred] == UINT32_MAX || idom[pred] == UINT32_MAX)
+                    continue;
+                if (dominator == UINT32_MAX) {
+                    dominator = pred;
+                    continue;
+                }
+                /* Walk both fingers up to their common dominator */
+                uint32_t a = pred, b = dominator;
+                while (a != b) {
+                    while (position[a] > position[b])
+                        a = idom[a];
+                    while (position[b] > position[a])
+                        b = idom[b];
+                }
+                dominator = a;
+            }
+            if (idom[order[i]] != dominator) {
+                idom[order[i]] = dominator;
+                changed = true;
+            }
+        }
+    }
+    free(position);
+}
+
+bool ir_verify(const ir_function_t *function, char *error, size_t size)
+{
+    uint32_t b, i, j;
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        bool phis = true;
+        if (block->count == 0 || ir_terminator(function, b) == IR_NONE) {
+            snprintf(error, size, "block %u has no terminator", (unsigned) b);
+            return false;
+        }
+        for (i = 0; i < block->count; i++) {
+            const ir_instr_t *instr = &function->instrs[block->instrs[i]];
+            if (instr->block != b) {
+                snprintf(error, size, "%%%u is listed in the wrong block", block->instrs[i]);
+                return false;
+            }
+            if (ir_is_terminator(instr->op) && i + 1 != block->count) {
+                snprintf(error, size, "terminator in the middle of block %u", (unsigned) b);
+                return false;
+            }
+            if (instr->op == IR_PHI && !phis) {
+                snprintf(error, size, "phi %%%u after other instructions", block->instrs[i]);
+                return false;
+            }
+            if (instr->op == IR_PHI && instr->b != block->pred_count) {
+                snprintf(
+                    error,
+                    size,
+                    "phi %%%u has %u inputs for %u predecessors",
+                    block->instrs[i],
+                    (unsigned) instr->b,
+                    (unsigned) block->pred_count);
+                return false;
+            }
+            if (instr->op == IR_CALL_SECOND && (i == 0 || block->instrs[i - 1] != instr->a)) {
+                snprintf(error, size, "%%%u does not follow its call", block->instrs[i]);
+                return false;
+            }
+            phis = phis && instr->op == IR_PHI;
+        }
+        for (i = 0; i < ir_successor_count(function, b); i++) {
+            uint32_t successor = ir_successor(function, b, i);
+            if (successor >= function->block_count
+                || ir_pred_index(function, successor, b) == UINT32_MAX) {
+                snprintf(
+                    error,
+                    size,
+                    "edge %u -> %u is missing a predecessor",
+                    (unsigned) b,
+                    (unsigned) successor);
+                return false;
+            }
+        }
+        for (j = 0; j < block->pred_count; j++) {
+            uint32_t pred = block->preds[j];
+            bool found = false;
+            for (i = 0; pred < function->block_count && i < ir_successor_count(function, pred);
+                 i++)
+                found = found || ir_successor(function, pred, i) == b;
+            if (!found) {
+                snprintf(
+                    error,
+                    size,
+                    "block %u lists %u as a predecessor",
+                    (unsigned) b,
+                    (unsigned) pred);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static const char *_type_name(ir_type_t type)
+{
+    static const char *names[] = {
+        "void", "bool", "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "ptr"};
+    return type <= IR_PTR ? names[type] : "?";
+}
+
+static void _dump_instr(
+    const ir_module_t *module, const ir_function_t *function, ir_value_t value, FILE *out)
+{
+    const ir_instr_t *instr = &function->instrs[value];
+    const uint32_t *operands = function->operands;
+    uint32_t i;
+
+    fputs("  ", out);
+    if (instr->type != IR_VOID)
+        fprintf(out, "%%%u = ", (unsigned) value);
+    fputs(ir_op_name(instr->op), out);
+    if (instr->type != IR_VOID)
+        fprintf(out, " %s", _type_name(instr->type));
+
+    switch ((ir_op_t) instr->op) {
+    case IR_CONST:
+        if (ir_type_signed(instr->type))
+            fprintf(out, " %lld", (long long) ir_const_value(instr));
+        else
+            fprintf(out, " %llu", (unsigned long long) ir_const_value(instr));
+        break;
+    case IR_PARAM:
+        fprintf(out, " %u", (unsigned) instr->a);
+        break;
+    case IR_PHI:
+        for (i = 0; i < instr->b; i++)
+            fprintf(
+                out,
+                "%s [b%u: %%%u]",
+                i ? "," : "",
+                (unsigned) function->blocks[instr->block].preds[i],
+                (unsigned) operands[instr->a + i]);
+        break;
+    case IR_FUNC_ADDR:
+        fprintf(out, " @%s", module->functions[instr->a].name);
+        break;
+    case IR_VTABLE:
+        fprintf(
+            out,
+            " @%s:%s",
+            ast_token(module->ast, module->vtables[instr->a].class)->value,
+            ast_token(module->ast, module->vtables[instr->a].interface)->value);
+        break;
+    case IR_METHOD:
+        fprintf(out, " %%%u[%u]", (unsigned) instr->a, (unsigned) instr->b);
+        break;
+    case IR_CALL:
+    case IR_CALL_INDIRECT:
+        if (instr->op == IR_CALL)
+            fprintf(out, " @%s(", module->functions[instr->a].name);
+        else
+            fprintf(out, " %%%u(", (unsigned) instr->a);
+        for (i = 0; i < instr->c; i++)
+            fprintf(out, "%s%%%u", i ? ", " : "", (unsigned) operands[instr->b + i]);
+        fputc(')', out);
+        break;
+    case IR_NEW:
+        fprintf(out, " %u", (unsigned) instr->a);
+        break;
+    case IR_LOAD:
+        fprintf(out, " %%%u+%u", (unsigned) instr->a, (unsigned) instr->b);
+        break;
+    case IR_STORE:
+        fprintf(
+            out, " %%%u+%u, %%%u", (unsigned) instr->a, (unsigned) instr->c, (unsigned) instr->b);
+        break;
+    case IR_JUMP:
+        fprintf(out, " b%u", (unsigned) instr->a);
+        break;
+    case IR_BRANCH:
+        fprintf(
+            out, " %%%u, b%u, b%u", (unsigned) instr->a, (unsigned) instr->b, (unsigned) instr->c);
+        break;
+    case IR_SWITCH:
+        fprintf(out, " %%%u, default b%u", (unsigned) instr->a, (unsigned) operands[instr->b]);
+        for (i = 0; i < instr->c; i++)
+            fprintf(
+                out,
+                ir_type_signed(function->instrs[instr->a].type) ? ", %lld: b%u" : ", %llu: b%u",
+                (unsigned long long) ir_switch_value(function, instr, i),
+                (unsigned) ir_switch_target(function, instr, i));
+        break;
+    case IR_JUMP_TABLE:
+        fprintf(out, " %%%u, [", (unsigned) instr->a);
+        for (i = 0; i < instr->c; i++)
+            fprintf(out, "%sb%u", i ? ", " : "", (unsigned) operands[instr->b + i]);
+        fputc(']', out);
+        break;
+    case IR_RETURN:
+        if (instr->a != IR_NONE)
+            fprintf(out, " %%%u", (unsigned) instr->a);
+        if (instr->b != IR_NONE)
+            fprintf(out, ", %%%u", (unsigned) instr->b);
+        break;
+    case IR_COPY:
+    case IR_CALL_SECOND:
+    case IR_NEG:
+    case IR_NOT:
+        fprintf(out, " %%%u", (unsigned) instr->a);
+        break;
+    case IR_NOP:
+    case IR_UNREACHABLE:
+        break;
+    default:
+        fprintf(out, " %%%u, %%%u", (unsigned) instr->a, (unsigned) instr->b);
+        break;
+    }
+    fputc('\n', out);
+}
+
+void ir_dump_function(const ir_module_t *module, const ir_function_t *function, FILE *out)
+{
+    uint32_t b, i;
+    fprintf(out, "function %s(", function->name);
+    for (i = 0; i < function->param_count; i++)
+        fprintf(out, "%s%s", i ? ", " : "", _type_name(function->param_types[i]));
+    if (function->returns_pair)
+        fputs(") -> (ptr, ptr) {\n", out);
+    else
+        fprintf(out, ") -> %s {\n", _type_name(function->result));
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        fprintf(out, "b%u:", (unsigned) b);
+        if (block->pred_count > 0) {
+            fputs(" ; preds", out);
+            for (i = 0; i < block->pred_count; i++)
+                fprintf(out, " b%u", (unsigned) block->preds[i]);
+        }
+        fputc('\n', out);
+        for (i = 0; i < block->count; i++)
+            _dump_instr(module, function, block->instrs[i], out);
+    }
+    fputs("}\n", out);
+}
+
+void ir_dump(const ir_module_t *module, FILE *out)
+{
+    uint32_t i;
+    for (i = 0; i < module->function_count; i++) {
+        if (i > 0)
+            fputc('\n', out);
+        ir_dump_function(module, &module->functions[i], out);
+    }
+}
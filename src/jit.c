@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <assembler.h>
+#include <emitter.h>
+#include <jit.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <x86.h>
+
+/* Stack the crash handler runs on, the overflowed one has no room left */
+#define JIT_SIGNAL_STACK (64 << 10)
+
+static sigjmp_buf _trap;
+static const char *_trap_error;
+
+static void *_allocate(uint64_t size, jit_t *jit)
+{
+    void *object = arena_alloc_aligned(&jit->heap, size ? size : 1, 8);
+    /* Native builds abort too, there is no way to report it to Dash code */
+    if (object == NULL)
+        abort();
+    return object;
+}
+
+static size_t _round(size_t size, size_t page_size)
+{
+    return (size + page_size - 1) & ~(page_size - 1);
+}
+
+static uint8_t **_address(jit_t *jit, const char *name, bool create)
+{
+    size_t length = strlen(name);
+    intern_id_t id = create ? intern(&jit->symbols, name, length)
+                            : intern_find(&jit->symbols, name, length);
+    if (id == INTERN_NONE)
+        return NULL;
+    if (id >= jit->address_capacity) {
+        uint32_t capacity = jit->address_capacity ? jit->address_capacity : 256;
+        while (capacity <= id)
+            capacity *= 2;
+        uint8_t **addresses = realloc(jit->addresses, capacity * sizeof(uint8_t *));
+        if (addresses == NULL)
+            return NULL;
+        memset(addresses + jit->address_capacity, 0,
+            (capacity - jit->address_capacity) * sizeof(uint8_t *));
+        jit->addresses = addresses;
+        jit->address_capacity = capacity;
+    }
+    return &jit->addresses[id];
+}
+
+static bool _defined(void *context, const char *name)
+{
+    uint8_t **address = _address(context, name, false);
+    return address != NULL && *address != NULL;
+}
+
+/*
+ * Copies the finished code of `assembler` to the next free pages, defines
+ * its symbols and links its references. Undoes the definitions on failure.
+ */
+static bool _place(jit_t *jit, assembler_t *assembler)
+{
+    size_t offset = _round(jit->size, jit->page_size);
+    size_t length = _round(assembler->size, jit->page_size);
+    uint8_t *base = jit->code + offset;
+    uint32_t defined = 0, i;
+    bool ok = true;
+
+    if (!assembler_finish(assembler)) {
+        jit->error = assembler->error;
+        return false;
+    }
+    if (assembler->size == 0)
+        return true;
+    if (length > JIT_CODE_SIZE - offset) {
+        jit->error = "out of code space";
+        return false;
+    }
+    if (mprotect(base, length, PROT_READ | PROT_WRITE) != 0) {
+        jit->error = "could not map code";
+        return false;
+    }
+    memcpy(base, assembler->code, assembler->size);
+
+    for (; defined < assembler->symbol_count && ok; defined++) {
+        const assembler_definition_t *symbol = &assembler->symbols[defined];
+        uint8_t **address = _address(jit, symbol->target.symbol, true);
+        if (address == NULL)
+            jit->error = "out of memory";
+        else if (*address != NULL)
+            jit->error = "symbol defined twice";
+        else
+            *address = base + symbol->offset;
+        ok = address != NULL && *address == base + symbol->offset;
+    }
+
+    for (i = 0; i < assembler->fixup_count && ok; i++) {
+        const assembler_fixup_t *fixup = &assembler->fixups[i];
+        uint8_t **address = _address(jit, fixup->target.symbol, false);
+        if (address == NULL || *address == NULL) {
+            jit->error = "undefined symbol";
+            ok = false;
+        } else if (fixup->kind == ASSEMBLER_ABS64) {
+            uint64_t value = (uint64_t) (uintptr_t) *address;
+            memcpy(base + fixup->at, &value, 8);
+        } else {
+            /* The mapping is smaller than 2 GiB, so every rel32 reaches */
+            int32_t value = (int32_t) (*address - (base + fixup->end));
+            memcpy(base + fixup->at, &value, 4);
+        }
+    }
+
+    if (!ok) {
+        for (i = 0; i < defined; i++) {
+            uint8_t **address = _address(jit, assembler->symbols[i].target.symbol, false);
+            if (address != NULL && *address == base + assembler->symbols[i].offset)
+                *address = NULL;
+        }
+        mprotect(base, length, PROT_NONE);
+        return false;
+    }
+    if (mprotect(base, length, PROT_READ | PROT_EXEC) != 0) {
+        jit->error = "could not map code";
+        return false;
+    }
+    jit->size = offset + assembler->size;
+    return true;
+}
+
+/* __dash_alloc: rdi holds the size, the jit goes in rsi for _allocate */
+static bool _place_runtime(jit_t *jit)
+{
+    assembler_t assembler;
+    assembler_operand_t operands[2] = {{0}};
+    assembler_init(&assembler);
+    assembler_define(&assembler, (assembler_target_t){"__dash_alloc", NULL, 0, 0});
+
+    operands[0].kind = ASSEMBLER_REGISTER;
+    operands[0].size = 8;
+    operands[0].reg = 6;
+    operands[1].kind = ASSEMBLER_IMMEDIATE;
+    operands[1].value = (int64_t) (uintptr_t) jit;
+    assembler_instr(&assembler, "movabs", operands, 2);
+    operands[0].reg = 0;
+    operands[1].value = (int64_t) (uintptr_t) &_allocate;
+    assembler_instr(&assembler, "movabs", operands, 2);
+    assembler_instr(&assembler, "jmp", operands, 1);
+
+    bool ok = _place(jit, &assembler);
+    assembler_destroy(&assembler);
+    return ok;
+}
+
+bool jit_init(jit_t *jit)
+{
+    memset(jit, 0, sizeof(jit_t));
+    jit->page_size = (size_t) sysconf(_SC_PAGESIZE);
+    jit->code = mmap(
+        NULL, JIT_CODE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        jit->code = NULL;
+        return false;
+    }
+    if (!arena_init(&jit->arena) || !arena_init(&jit->heap)
+        || !intern_init(&jit->symbols, &jit->arena))
+        return false;
+    return _place_runtime(jit);
+}
+
+void jit_destroy(jit_t *jit)
+{
+    if (jit->code != NULL)
+        munmap(jit->code, JIT_CODE_SIZE);
+    free(jit->addresses);
+    arena_destroy(&jit->arena);
+    arena_destroy(&jit->heap);
+    memset(jit, 0, sizeof(jit_t));
+}
+
+bool jit_add_module(jit_t *jit, ir_module_t *module)
+{
+    assembler_t assembler;
+    emitter_t emitter;
+    assembler_init(&assembler);
+    emitter_init_assembler(&emitter, &assembler);
+
+    bool ok = x86_emit_code(module, _defined, jit, &emitter);
+    if (!ok)
+        jit->error = assembler.error != NULL ? assembler.error : "could not compile";
+    ok = ok && _place(jit, &assembler);
+    assembler_destroy(&assembler);
+    return ok;
+}
+
+void *jit_find_function(const jit_t *jit, const char *name)
+{
+    size_t length = strlen(name);
+    char *symbol = malloc(length + 6);
+    if (symbol == NULL)
+        return NULL;
+    memcpy(symbol, "dash.", 5);
+    memcpy(symbol + 5, name, length + 1);
+    intern_id_t id = intern_find(&jit->symbols, symbol, length + 5);
+    free(symbol);
+    return id != INTERN_NONE && id < jit->address_capacity ? jit->addresses[id] : NULL;
+}
+
+static void _on_signal(int signal)
+{
+    _trap_error = signal == SIGFPE   ? "division by zero"
+                  : signal == SIGILL ? "reached unreachable code"
+                                     : "crashed, stack overflow or bad memory access";
+    siglongjmp(_trap, 1);
+}
+
+bool jit_call(jit_t *jit, const char *name, uint64_t *result)
+{
+    static const int signals[] = {SIGFPE, SIGILL, SIGSEGV, SIGBUS};
+    struct sigaction action, saved[4];
+    stack_t stack, saved_stack;
+    uint32_t i;
+    bool ok = false;
+    union
+    {
+        void *address;
+        uint64_t (*function)(void);
+    } entry;
+
+    entry.address = jit_find_function(jit, name);
+    if (entry.address == NULL) {
+        jit->error = "no such function";
+        return false;
+    }
+
+    stack.ss_sp = malloc(JIT_SIGNAL_STACK);
+    stack.ss_size = JIT_SIGNAL_STACK;
+    stack.ss_flags = 0;
+    if (stack.ss_sp == NULL || sigaltstack(&stack, &saved_stack) != 0) {
+        free(stack.ss_sp);
+        jit->error = "out of memory";
+        return false;
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _on_signal;
+    action.sa_flags = SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    for (i = 0; i < 4; i++)
+        sigaction(signals[i], &action, &saved[i]);
+
+    if (sigsetjmp(_trap, 1) == 0) {
+        uint64_t value = entry.function();
+        if (result != NULL)
+            *result = value;
+        ok = true;
+    } else {
+        jit->error = _trap_error;
+    }
+
+    for (i = 0; i < 4; i++)
+        sigaction(signals[i], &saved[i], NULL);
+    sigaltstack(&saved_stack, NULL);
+    free(stack.ss_sp);
+    return ok;
+}
@@ -183,13 +183,20 @@ token_t lexer_next(lexer_t *lexer)
         token.value[i++] = current;
 
         char next;
+        token.type = TOKEN_INTEGER;
         while (isdigit((next = reader_peek(lexer->reader)))) {
             current = reader_next(lexer->reader);
             lexer->column++;
-            token.value[i++] = current;
+            /*
+             * Leading zeros are dropped, so digits that do not fit anymore
+             * can only belong to a literal the parser rejects as too large.
+             */
+            if (i == 1 && token.value[0] == '0')
+                token.value[0] = current;
+            else if (i < sizeof(token.value) - 1)
+                token.value[i++] = current;
         }
         token.value[i] = '\0';
-        token.type = TOKEN_INTEGER;
         return token;
     }
 
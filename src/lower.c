@@ -0,0 +1,1271 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <lower.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+
+/*
+ * Every field takes one 8-byte slot, values are kept extended to 64 bits.
+ * Interface fields take two: the object, then its vtable.
+ */
+#define LOWER_SLOT_SIZE 8
+
+typedef struct
+{
+    uint32_t block;
+    ast_index_t variable;
+    ir_value_t value;
+} lower_def_t;
+
+typedef struct
+{
+    uint32_t block;
+    ast_index_t variable;
+    ir_value_t phi;
+} lower_pending_t;
+
+typedef struct
+{
+    uint32_t exit;
+    uint32_t header;
+} lower_loop_t;
+
+typedef struct
+{
+    const sema_t *sema;
+    const ast_t *ast;
+    ir_module_t *module;
+    ir_function_t *function;
+    /* Declared result type of the function being lowered */
+    type_id_t result;
+    arena_t *arena;
+    uint32_t block;
+    /* Current definition of each variable per block, open addressing */
+    lower_def_t *defs;
+    uint32_t def_mask;
+    uint32_t def_count;
+    uint8_t *sealed;
+    uint32_t sealed_capacity;
+    /* Phis created in unsealed blocks, completed when the block is sealed */
+    lower_pending_t *pending;
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+    lower_loop_t *loops;
+    uint32_t loop_count;
+    uint32_t loop_capacity;
+    bool failed;
+} lowerer_t;
+
+static bool _is_interface(const sema_t *sema, type_id_t type)
+{
+    return types_get(&sema->types, type)->kind == TYPE_INTERFACE;
+}
+
+static uint32_t _value_size(const sema_t *sema, type_id_t type)
+{
+    return _is_interface(sema, type) ? 2 * LOWER_SLOT_SIZE : LOWER_SLOT_SIZE;
+}
+
+uint32_t lower_field_offset(const sema_t *sema, ast_index_t class, ast_index_t field)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *node = &ast->nodes[class];
+    uint32_t offset = 0, i;
+    for (i = node->lhs; i < node->rhs && ast->extra[i] != field; i++)
+        offset += _value_size(sema, sema->node_types[ast->extra[i]]);
+    return offset;
+}
+
+uint32_t lower_class_size(const sema_t *sema, ast_index_t class)
+{
+    const ast_node_t *node = &sema->ast->nodes[class];
+    uint32_t size = lower_field_offset(sema, class, AST_NONE);
+    return node->lhs < node->rhs ? size : LOWER_SLOT_SIZE;
+}
+
+static void _fail(lowerer_t *lowerer, ast_index_t node, const char *message)
+{
+    if (!lowerer->failed) {
+        lowerer->function->error = message;
+        lowerer->function->error_node = node;
+    }
+    lowerer->failed = true;
+}
+
+static ir_type_t _ir_type(const sema_t *sema, type_id_t type)
+{
+    switch ((type_kind_t) types_get(&sema->types, type)->kind) {
+    case TYPE_VOID:
+        return IR_VOID;
+    case TYPE_BOOL:
+        return IR_BOOL;
+    case TYPE_I8:
+        return IR_I8;
+    case TYPE_I16:
+        return IR_I16;
+    case TYPE_I32:
+        return IR_I32;
+    case TYPE_I64:
+    case TYPE_ENUM:
+        return IR_I64;
+    case TYPE_U8:
+        return IR_U8;
+    case TYPE_U16:
+        return IR_U16;
+    case TYPE_U32:
+        return IR_U32;
+    case TYPE_U64:
+        return IR_U64;
+    case TYPE_STRING:
+    case TYPE_NULL:
+    case TYPE_CLASS:
+    case TYPE_INTERFACE:
+    case TYPE_FUNCTION:
+        /* An interface's object half, see _lower_interface */
+        return IR_PTR;
+    default:
+        /* Floats have no lowering yet */
+        return IR_VOID;
+    }
+}
+
+static bool _supported(const sema_t *sema, type_id_t type)
+{
+    return type != TYPE_ERROR && (type == TYPE_VOID || _ir_type(sema, type) != IR_VOID);
+}
+
+static ir_type_t _node_type(lowerer_t *lowerer, ast_index_t node)
+{
+    type_id_t type = lowerer->sema->node_types[node];
+    if (!_supported(lowerer->sema, type))
+        _fail(lowerer, node, "values of this type are not supported by the code generator yet");
+    return _ir_type(lowerer->sema, type);
+}
+
+/* Blocks and SSA construction */
+
+static uint32_t _new_block(lowerer_t *lowerer)
+{
+    uint32_t block = ir_add_block(lowerer->function, lowerer->arena);
+    if (block == UINT32_MAX) {
+        lowerer->failed = true;
+        return 0;
+    }
+    if (block >= lowerer->sealed_capacity) {
+        uint32_t capacity = lowerer->sealed_capacity ? lowerer->sealed_capacity * 2 : 64;
+        uint8_t *sealed = realloc(lowerer->sealed, capacity);
+        if (sealed == NULL) {
+            lowerer->failed = true;
+            return 0;
+        }
+        memset(sealed + lowerer->sealed_capacity, 0, capacity - lowerer->sealed_capacity);
+        lowerer->sealed = sealed;
+        lowerer->sealed_capacity = capacity;
+    }
+    lowerer->sealed[block] = 0;
+    return block;
+}
+
+static ir_value_t _emit(
+    lowerer_t *lowerer, ir_op_t op, ir_type_t type, uint32_t a, uint32_t b, uint32_t c)
+{
+    ir_value_t value = ir_append(
+        lowerer->function, lowerer->arena, lowerer->block, op, type, a, b, c);
+    if (value == IR_NONE)
+        lowerer->failed = true;
+    return value;
+}
+
+static ir_value_t _const(lowerer_t *lowerer, ir_type_t type, uint64_t value)
+{
+    ir_value_t result = ir_append_const(
+        lowerer->function, lowerer->arena, lowerer->block, type, value);
+    if (result == IR_NONE)
+        lowerer->failed = true;
+    return result;
+}
+
+static bool _is_open(const lowerer_t *lowerer)
+{
+    return ir_terminator(lowerer->function, lowerer->block) == IR_NONE;
+}
+
+static void _edge(lowerer_t *lowerer, uint32_t from, uint32_t to)
+{
+    if (!ir_add_pred(lowerer->function, lowerer->arena, to, from))
+        lowerer->failed = true;
+}
+
+static void _jump(lowerer_t *lowerer, uint32_t target)
+{
+    if (!_is_open(lowerer))
+        return;
+    _emit(lowerer, IR_JUMP, IR_VOID, target, 0, 0);
+    _edge(lowerer, lowerer->block, target);
+}
+
+static void _branch(lowerer_t *lowerer, ir_value_t condition, uint32_t then, uint32_t otherwise)
+{
+    _emit(lowerer, IR_BRANCH, IR_VOID, condition, then, otherwise);
+    _edge(lowerer, lowerer->block, then);
+    _edge(lowerer, lowerer->block, otherwise);
+}
+
+/* Code after return/break/continue goes to a fresh block without predecessors */
+static void _ensure_open(lowerer_t *lowerer)
+{
+    if (_is_open(lowerer))
+        return;
+    lowerer->block = _new_block(lowerer);
+    lowerer->sealed[lowerer->block] = 1;
+}
+
+static uint32_t _def_hash(uint32_t block, ast_index_t variable)
+{
+    return (variable * 0x9e3779b1u) ^ (block * 0x85ebca77u);
+}
+
+static lower_def_t *_def_slot(lowerer_t *lowerer, uint32_t block, ast_index_t variable)
+{
+    uint32_t slot = _def_hash(block, variable) & lowerer->def_mask;
+    while (lowerer->defs[slot].variable != AST_NONE) {
+        lower_def_t *def = &lowerer->defs[slot];
+        if (def->block == block && def->variable == variable)
+            return def;
+        slot = (slot + 1) & lowerer->def_mask;
+    }
+    return &lowerer->defs[slot];
+}
+
+static void _write_variable(
+    lowerer_t *lowerer, ast_index_t variable, uint32_t block, ir_value_t value)
+{
+    if ((lowerer->def_count + 1) * 2 > lowerer->def_mask + 1) {
+        uint32_t old_size = lowerer->def_mask + 1, i;
+        lower_def_t *old = lowerer->defs;
+        lower_def_t *defs = calloc(old_size * 2, sizeof(lower_def_t));
+        if (defs == NULL) {
+            lowerer->failed = true;
+            return;
+        }
+        lowerer->defs = defs;
+        lowerer->def_mask = old_size * 2 - 1;
+        for (i = 0; i < old_size; i++)
+            if (old[i].variable != AST_NONE)
+                *_def_slot(lowerer, old[i].block, old[i].variable) = old[i];
+        free(old);
+    }
+
+    lower_def_t *def = _def_slot(lowerer, block, variable);
+    if (def->variable == AST_NONE)
+        lowerer->def_count++;
+    def->block = block;
+    def->variable = variable;
+    def->value = value;
+}
+
+/* Creates an instruction at the start of `block`, which may already be terminated */
+static ir_value_t _insert_front(
+    lowerer_t *lowerer, uint32_t block, ir_op_t op, ir_type_t type, uint32_t a, uint32_t b)
+{
+    ir_function_t *function = lowerer->function;
+    ir_value_t value = ir_add_instr(function, lowerer->arena, op, type, a, b, 0);
+    if (value == IR_NONE || !ir_block_push(function, lowerer->arena, block, value)) {
+        lowerer->failed = true;
+        return IR_NONE;
+    }
+
+    ir_block_t *target = &function->blocks[block];
+    memmove(&target->instrs[1], &target->instrs[0], (target->count - 1) * sizeof(ir_value_t));
+    target->instrs[0] = value;
+    return value;
+}
+
+static ir_value_t _new_phi(lowerer_t *lowerer, uint32_t block, ir_type_t type)
+{
+    return _insert_front(lowerer, block, IR_PHI, type, 0, 0);
+}
+
+static ir_value_t _read_variable(
+    lowerer_t *lowerer, ast_index_t variable, uint32_t block, ir_type_t type);
+
+/* A phi whose inputs are all one value (or itself) is that value */
+static ir_value_t _try_remove_trivial_phi(lowerer_t *lowerer, ir_value_t phi)
+{
+    ir_function_t *function = lowerer->function;
+    ir_instr_t *instr = &function->instrs[phi];
+    ir_value_t same = IR_NONE;
+    uint32_t i;
+
+    for (i = 0; i < instr->b; i++) {
+        ir_value_t input = function->operands[instr->a + i];
+        if (input == same || input == phi)
+            continue;
+        if (same != IR_NONE)
+            return phi;
+        same = input;
+    }
+    if (same == IR_NONE)
+        return phi;
+
+    instr->op = IR_COPY;
+    instr->a = same;
+    instr->b = 0;
+    return phi;
+}
+
+static ir_value_t _add_phi_operands(
+    lowerer_t *lowerer, ast_index_t variable, ir_value_t phi, ir_type_t type)
+{
+    ir_function_t *function = lowerer->function;
+    uint32_t block = function->instrs[phi].block;
+    uint32_t count = function->blocks[block].pred_count, i;
+    uint32_t first = ir_add_operands(function, lowerer->arena, NULL, count);
+
+    if (first == UINT32_MAX) {
+        lowerer->failed = true;
+        return phi;
+    }
+    function->instrs[phi].a = first;
+    function->instrs[phi].b = count;
+    for (i = 0; i < count; i++) {
+        ir_value_t input = _read_variable(
+            lowerer, variable, function->blocks[block].preds[i], type);
+        function->operands[first + i] = input;
+    }
+    return _try_remove_trivial_phi(lowerer, phi);
+}
+
+static ir_value_t _read_variable(
+    lowerer_t *lowerer, ast_index_t variable, uint32_t block, ir_type_t type)
+{
+    const lower_def_t *def = _def_slot(lowerer, block, variable);
+    const ir_block_t *target = &lowerer->function->blocks[block];
+    ir_value_t value;
+
+    if (def->variable == variable)
+        return def->value;
+
+    if (!lowerer->sealed[block]) {
+        value = _new_phi(lowerer, block, type);
+        if (lowerer->pending_count == lowerer->pending_capacity) {
+            uint32_t capacity = lowerer->pending_capacity ? lowerer->pending_capacity * 2 : 16;
+            lower_pending_t *pending = realloc(
+                lowerer->pending, capacity * sizeof(lower_pending_t));
+            if (pending == NULL) {
+                lowerer->failed = true;
+                return value;
+            }
+            lowerer->pending = pending;
+            lowerer->pending_capacity = capacity;
+        }
+        lower_pending_t *entry = &lowerer->pending[lowerer->pending_count++];
+        entry->block = block;
+        entry->variable = variable;
+        entry->phi = value;
+    } else if (target->pred_count == 1) {
+        value = _read_variable(lowerer, variable, target->preds[0], type);
+    } else if (target->pred_count == 0) {
+        /* Unreachable code, any value will do */
+        value = _insert_front(lowerer, block, IR_CONST, type, 0, 0);
+    } else {
+        /* Break cycles through loops by writing the phi before reading the inputs */
+        value = _new_phi(lowerer, block, type);
+        _write_variable(lowerer, variable, block, value);
+        value = _add_phi_operands(lowerer, variable, value, type);
+    }
+    _write_variable(lowerer, variable, block, value);
+    return value;
+}
+
+static void _seal(lowerer_t *lowerer, uint32_t block)
+{
+    uint32_t i = 0;
+    lowerer->sealed[block] = 1;
+    while (i < lowerer->pending_count) {
+        lower_pending_t entry = lowerer->pending[i];
+        if (entry.block != block) {
+            i++;
+            continue;
+        }
+        lowerer->pending[i] = lowerer->pending[--lowerer->pending_count];
+        _add_phi_operands(
+            lowerer,
+            entry.variable,
+            entry.phi,
+            (ir_type_t) lowerer->function->instrs[entry.phi].type);
+    }
+}
+
+static ir_value_t _read(lowerer_t *lowerer, ast_index_t variable, ir_type_t type)
+{
+    return _read_variable(lowerer, variable, lowerer->block, type);
+}
+
+static void _write(lowerer_t *lowerer, ast_index_t variable, ir_value_t value)
+{
+    _write_variable(lowerer, variable, lowerer->block, value);
+}
+
+/* The vtable half of an interface variable is a variable of its own */
+static ast_index_t _vtable_key(const lowerer_t *lowerer, ast_index_t variable)
+{
+    return variable + lowerer->ast->node_count;
+}
+
+/* Expressions */
+
+static ir_value_t _lower_expression(lowerer_t *lowerer, ast_index_t index);
+static void _lower_statement(lowerer_t *lowerer, ast_index_t index);
+static ir_value_t _lower_call(lowerer_t *lowerer, ast_index_t index);
+
+static uint32_t _function_index(const lowerer_t *lowerer, ast_index_t function)
+{
+    return lowerer->module->function_of_node[function];
+}
+
+static ir_value_t _lower_constant(lowerer_t *lowerer, ast_index_t index)
+{
+    uint64_t value = 0;
+    ir_type_t type = _node_type(lowerer, index);
+    if (!sema_eval_constant(lowerer->sema, index, &value))
+        _fail(lowerer, index, "expected a constant expression");
+    return _const(lowerer, type, value);
+}
+
+static ir_value_t _lower_identifier(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_t *ast = lowerer->ast;
+    ast_index_t declaration = lowerer->sema->declarations[index];
+    const ast_node_t *node = &ast->nodes[declaration];
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_LET:
+        if (node->flags & AST_FLAG_GLOBAL)
+            return _lower_constant(lowerer, index);
+        /* fall through */
+    case AST_PARAM:
+    case AST_IMPL:
+        return _read(lowerer, declaration, _node_type(lowerer, index));
+    case AST_FUNCTION:
+        if (_function_index(lowerer, declaration) == UINT32_MAX)
+            break;
+        return _emit(
+            lowerer, IR_FUNC_ADDR, IR_PTR, _function_index(lowerer, declaration), 0, 0);
+    default:
+        break;
+    }
+    _fail(lowerer, index, "cannot generate code for this name");
+    return IR_NONE;
+}
+
+static ir_value_t _field_address(lowerer_t *lowerer, ast_index_t member, uint32_t *offset)
+{
+    const sema_t *sema = lowerer->sema;
+    ast_index_t object = lowerer->ast->nodes[member].lhs;
+    ast_index_t class = types_get(&sema->types, sema->node_types[object])->operand;
+    *offset = lower_field_offset(sema, class, sema->declarations[member]);
+    return _lower_expression(lowerer, object);
+}
+
+/* Lowers an interface-typed expression to its object and, in `vtable`, its vtable */
+static ir_value_t _lower_interface(lowerer_t *lowerer, ast_index_t index, ir_value_t *vtable)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    ast_index_t declaration = lowerer->sema->declarations[index];
+    uint32_t offset;
+    ir_value_t object, address;
+
+    *vtable = IR_NONE;
+    if (lowerer->failed)
+        return IR_NONE;
+    switch ((ast_kind_t) node->kind) {
+    case AST_IDENTIFIER:
+        if (lowerer->ast->nodes[declaration].kind != AST_LET
+            && lowerer->ast->nodes[declaration].kind != AST_PARAM)
+            break;
+        object = _read(lowerer, declaration, IR_PTR);
+        *vtable = _read(lowerer, _vtable_key(lowerer, declaration), IR_PTR);
+        return object;
+    case AST_MEMBER:
+        address = _field_address(lowerer, index, &offset);
+        object = _emit(lowerer, IR_LOAD, IR_PTR, address, offset, 0);
+        *vtable = _emit(lowerer, IR_LOAD, IR_PTR, address, offset + LOWER_SLOT_SIZE, 0);
+        return object;
+    case AST_CALL:
+        object = _lower_call(lowerer, index);
+        *vtable = _emit(lowerer, IR_CALL_SECOND, IR_PTR, object, 0, 0);
+        return object;
+    default:
+        break;
+    }
+    _fail(lowerer, index, "cannot generate code for this expression");
+    return IR_NONE;
+}
+
+/*
+ * Lowers `index` for a destination of type `expected`. Interface
+ * destinations also get a vtable: classes convert through the vtable of
+ * their impl, null gets a null vtable.
+ */
+static ir_value_t _lower_value(
+    lowerer_t *lowerer, ast_index_t index, type_id_t expected, ir_value_t *vtable)
+{
+    const sema_t *sema = lowerer->sema;
+    type_id_t type = sema->node_types[index];
+
+    *vtable = IR_NONE;
+    if (!_is_interface(sema, expected))
+        return _lower_expression(lowerer, index);
+    if (_is_interface(sema, type))
+        return _lower_interface(lowerer, index, vtable);
+
+    ir_value_t object = _lower_expression(lowerer, index);
+    if (type == TYPE_NULL) {
+        *vtable = _const(lowerer, IR_PTR, 0);
+        return object;
+    }
+    ast_index_t impl = sema_map_find(
+        &sema->implements,
+        types_get(&sema->types, type)->operand,
+        types_get(&sema->types, expected)->operand);
+    uint32_t table = ir_find_vtable(lowerer->module, impl);
+    if (table == UINT32_MAX) {
+        _fail(lowerer, index, "cannot generate code for this conversion");
+        return IR_NONE;
+    }
+    *vtable = _emit(lowerer, IR_VTABLE, IR_PTR, table, 0, 0);
+    return object;
+}
+
+/* Arguments for the parameters of the callee's type, interfaces taking two */
+static uint32_t _lower_arguments(
+    lowerer_t *lowerer, ast_index_t call, ir_value_t self, uint32_t *count)
+{
+    const sema_t *sema = lowerer->sema;
+    const ast_t *ast = lowerer->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[call].rhs];
+    const type_id_t *params = types_params(&sema->types, sema->node_types[ast->nodes[call].lhs]);
+    uint32_t argument_count = record[1] - record[0], total = 0, i;
+    uint32_t capacity = argument_count * 2 + 1;
+    ir_value_t stack_values[16];
+    ir_value_t *values = stack_values;
+
+    if (capacity > 16 && (values = malloc(capacity * sizeof(ir_value_t))) == NULL) {
+        lowerer->failed = true;
+        return 0;
+    }
+    if (self != IR_NONE)
+        values[total++] = self;
+    for (i = 0; i < argument_count; i++) {
+        ir_value_t vtable;
+        values[total++] = _lower_value(lowerer, ast->extra[record[0] + i], params[i], &vtable);
+        if (vtable != IR_NONE)
+            values[total++] = vtable;
+    }
+
+    uint32_t first = ir_add_operands(lowerer->function, lowerer->arena, values, total);
+    if (first == UINT32_MAX)
+        lowerer->failed = true;
+    if (values != stack_values)
+        free(values);
+    *count = total;
+    return first;
+}
+
+static ir_value_t _lower_construction(lowerer_t *lowerer, ast_index_t call, ast_index_t class)
+{
+    const sema_t *sema = lowerer->sema;
+    const ast_t *ast = lowerer->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[call].rhs];
+    const ast_node_t *node = &ast->nodes[class];
+    uint32_t offset = 0, i;
+
+    ir_value_t object = _emit(lowerer, IR_NEW, IR_PTR, lower_class_size(sema, class), class, 0);
+    for (i = record[0]; i < record[1]; i++) {
+        type_id_t type = sema->node_types[ast->extra[node->lhs + i - record[0]]];
+        ir_value_t vtable;
+        ir_value_t value = _lower_value(lowerer, ast->extra[i], type, &vtable);
+        _emit(lowerer, IR_STORE, IR_VOID, object, value, offset);
+        if (vtable != IR_NONE)
+            _emit(lowerer, IR_STORE, IR_VOID, object, vtable, offset + LOWER_SLOT_SIZE);
+        offset += _value_size(sema, type);
+    }
+    return object;
+}
+
+/* Interface calls load the method from the slot at its position in the interface */
+static ir_value_t _lower_dispatch(lowerer_t *lowerer, ast_index_t call)
+{
+    const sema_t *sema = lowerer->sema;
+    const ast_t *ast = lowerer->ast;
+    ast_index_t callee = ast->nodes[call].lhs;
+    ast_index_t receiver = ast->nodes[callee].lhs;
+    ast_index_t interface = types_get(&sema->types, sema->node_types[receiver])->operand;
+    const ast_node_t *node = &ast->nodes[interface];
+    ir_type_t type = _node_type(lowerer, call);
+    uint32_t slot = 0, first, count;
+    ir_value_t vtable;
+
+    while (node->lhs + slot < node->rhs
+           && ast->extra[node->lhs + slot] != sema->declarations[callee])
+        slot++;
+    ir_value_t object = _lower_interface(lowerer, receiver, &vtable);
+    ir_value_t method = _emit(lowerer, IR_METHOD, IR_PTR, vtable, slot, interface);
+    first = _lower_arguments(lowerer, call, object, &count);
+    return _emit(lowerer, IR_CALL_INDIRECT, type, method, first, count);
+}
+
+static ir_value_t _lower_call(lowerer_t *lowerer, ast_index_t index)
+{
+    const sema_t *sema = lowerer->sema;
+    const ast_t *ast = lowerer->ast;
+    ast_index_t callee = ast->nodes[index].lhs;
+    ast_index_t target = sema->declarations[callee];
+    ir_type_t type = _node_type(lowerer, index);
+    uint32_t first, count;
+
+    if (ast->nodes[callee].kind == AST_IDENTIFIER && ast->nodes[target].kind == AST_CLASS)
+        return _lower_construction(lowerer, index, target);
+
+    if (ast->nodes[target].kind == AST_FUNCTION && ast->nodes[callee].kind == AST_MEMBER) {
+        if (_function_index(lowerer, target) == UINT32_MAX)
+            return _lower_dispatch(lowerer, index);
+        ir_value_t self = _lower_expression(lowerer, ast->nodes[callee].lhs);
+        first = _lower_arguments(lowerer, index, self, &count);
+        return _emit(lowerer, IR_CALL, type, _function_index(lowerer, target), first, count);
+    }
+    if (ast->nodes[callee].kind == AST_IDENTIFIER && ast->nodes[target].kind == AST_FUNCTION
+        && _function_index(lowerer, target) != UINT32_MAX) {
+        first = _lower_arguments(lowerer, index, IR_NONE, &count);
+        return _emit(lowerer, IR_CALL, type, _function_index(lowerer, target), first, count);
+    }
+
+    ir_value_t function = _lower_expression(lowerer, callee);
+    first = _lower_arguments(lowerer, index, IR_NONE, &count);
+    return _emit(lowerer, IR_CALL_INDIRECT, type, function, first, count);
+}
+
+static ir_op_t _binary_op(uint8_t token)
+{
+    switch ((token_type_t) token) {
+    case TOKEN_PLUS:
+    case TOKEN_PLUS_EQUAL:
+        return IR_ADD;
+    case TOKEN_MINUS:
+    case TOKEN_MINUS_EQUAL:
+        return IR_SUB;
+    case TOKEN_STAR:
+    case TOKEN_STAR_EQUAL:
+        return IR_MUL;
+    case TOKEN_SLASH:
+    case TOKEN_SLASH_EQUAL:
+        return IR_DIV;
+    case TOKEN_PERCENT:
+    case TOKEN_PERCENT_EQUAL:
+        return IR_MOD;
+    case TOKEN_EQUAL_EQUAL:
+        return IR_EQ;
+    case TOKEN_NOT_EQUAL:
+        return IR_NE;
+    case TOKEN_LESS_THAN:
+        return IR_LT;
+    case TOKEN_LESS_EQUAL:
+        return IR_LE;
+    case TOKEN_GREATER_THAN:
+        return IR_GT;
+    case TOKEN_GREATER_EQUAL:
+        return IR_GE;
+    default:
+        return IR_NOP;
+    }
+}
+
+/* `a && b` and `a || b` only evaluate b when needed, merging with a phi */
+static ir_value_t _lower_logical(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    bool is_and = node->op == TOKEN_AND;
+    uint32_t right = _new_block(lowerer);
+    uint32_t join = _new_block(lowerer);
+
+    ir_value_t lhs = _lower_expression(lowerer, node->lhs);
+    uint32_t lhs_block = lowerer->block;
+    if (is_and)
+        _branch(lowerer, lhs, right, join);
+    else
+        _branch(lowerer, lhs, join, right);
+    _seal(lowerer, right);
+
+    lowerer->block = right;
+    ir_value_t rhs = _lower_expression(lowerer, node->rhs);
+    uint32_t rhs_block = lowerer->block;
+    _jump(lowerer, join);
+    _seal(lowerer, join);
+
+    lowerer->block = join;
+    ir_function_t *function = lowerer->function;
+    ir_value_t phi = _new_phi(lowerer, join, IR_BOOL);
+    uint32_t first = ir_add_operands(function, lowerer->arena, NULL, 2);
+    if (phi == IR_NONE || first == UINT32_MAX) {
+        lowerer->failed = true;
+        return IR_NONE;
+    }
+
+    function->instrs[phi].a = first;
+    function->instrs[phi].b = 2;
+    uint32_t lhs_index = ir_pred_index(function, join, lhs_block);
+    uint32_t rhs_index = ir_pred_index(function, join, rhs_block);
+    function->operands[first + lhs_index] = lhs;
+    function->operands[first + rhs_index] = rhs;
+    return phi;
+}
+
+static ir_value_t _lower_binary(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    if (node->op == TOKEN_AND || node->op == TOKEN_OR)
+        return _lower_logical(lowerer, index);
+
+    ir_type_t type = _node_type(lowerer, index);
+    ir_value_t lhs = _lower_expression(lowerer, node->lhs);
+    ir_value_t rhs = _lower_expression(lowerer, node->rhs);
+    return _emit(lowerer, _binary_op(node->op), type, lhs, rhs, 0);
+}
+
+static ir_value_t _lower_expression(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    uint32_t offset;
+    ir_value_t value;
+
+    if (lowerer->failed)
+        return IR_NONE;
+    switch ((ast_kind_t) node->kind) {
+    case AST_INTEGER:
+        return _const(
+            lowerer, _node_type(lowerer, index), ((uint64_t) node->rhs << 32) | node->lhs);
+    case AST_BOOL:
+        return _const(lowerer, IR_BOOL, node->lhs != 0);
+    case AST_NULL:
+        return _const(lowerer, IR_PTR, 0);
+    case AST_PATH:
+        return _lower_constant(lowerer, index);
+    case AST_IDENTIFIER:
+        return _lower_identifier(lowerer, index);
+    case AST_MEMBER:
+        value = _field_address(lowerer, index, &offset);
+        return _emit(lowerer, IR_LOAD, _node_type(lowerer, index), value, offset, 0);
+    case AST_CALL:
+        return _lower_call(lowerer, index);
+    case AST_UNARY:
+        value = _lower_expression(lowerer, node->lhs);
+        return _emit(
+            lowerer,
+            node->op == TOKEN_NOT ? IR_NOT : IR_NEG,
+            _node_type(lowerer, index),
+            value,
+            0,
+            0);
+    case AST_BINARY:
+        return _lower_binary(lowerer, index);
+    default:
+        _fail(lowerer, index, "cannot generate code for this expression");
+        return IR_NONE;
+    }
+}
+
+/* Statements */
+
+static void _lower_range(lowerer_t *lowerer, uint32_t start, uint32_t end)
+{
+    uint32_t i;
+    for (i = start; i < end && !lowerer->failed; i++)
+        _lower_statement(lowerer, lowerer->ast->extra[i]);
+}
+
+static void _lower_assign(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    const ast_node_t *target = &lowerer->ast->nodes[node->lhs];
+    type_id_t target_type = lowerer->sema->node_types[node->lhs];
+    ir_type_t type = _node_type(lowerer, node->lhs);
+    ir_op_t op = node->op == TOKEN_EQUAL ? IR_NOP : _binary_op(node->op);
+    ir_value_t vtable;
+
+    if (target->kind == AST_MEMBER) {
+        uint32_t offset;
+        ir_value_t object = _field_address(lowerer, node->lhs, &offset);
+        ir_value_t value = _lower_value(lowerer, node->rhs, target_type, &vtable);
+        if (op != IR_NOP) {
+            ir_value_t current = _emit(lowerer, IR_LOAD, type, object, offset, 0);
+            value = _emit(lowerer, op, type, current, value, 0);
+        }
+        _emit(lowerer, IR_STORE, IR_VOID, object, value, offset);
+        if (vtable != IR_NONE)
+            _emit(lowerer, IR_STORE, IR_VOID, object, vtable, offset + LOWER_SLOT_SIZE);
+        return;
+    }
+
+    ast_index_t variable = lowerer->sema->declarations[node->lhs];
+    ir_value_t value = _lower_value(lowerer, node->rhs, target_type, &vtable);
+    if (op != IR_NOP)
+        value = _emit(lowerer, op, type, _read(lowerer, variable, type), value, 0);
+    _write(lowerer, variable, value);
+    if (vtable != IR_NONE)
+        _write(lowerer, _vtable_key(lowerer, variable), vtable);
+}
+
+static void _lower_if(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_t *ast = lowerer->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    ast_index_t otherwise = ast->extra[node->rhs + 1];
+    uint32_t then_block = _new_block(lowerer);
+    uint32_t else_block = otherwise != AST_NONE ? _new_block(lowerer) : 0;
+    uint32_t join = _new_block(lowerer);
+
+    ir_value_t condition = _lower_expression(lowerer, node->lhs);
+    _branch(lowerer, condition, then_block, otherwise != AST_NONE ? else_block : join);
+    _seal(lowerer, then_block);
+
+    lowerer->block = then_block;
+    _lower_statement(lowerer, ast->extra[node->rhs]);
+    _jump(lowerer, join);
+
+    if (otherwise != AST_NONE) {
+        _seal(lowerer, else_block);
+        lowerer->block = else_block;
+        _lower_statement(lowerer, otherwise);
+        _jump(lowerer, join);
+    }
+    _seal(lowerer, join);
+    lowerer->block = join;
+}
+
+static void _lower_for(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    uint32_t header = _new_block(lowerer);
+    uint32_t body = _new_block(lowerer);
+    uint32_t exit = _new_block(lowerer);
+
+    _jump(lowerer, header);
+    lowerer->block = header;
+    if (node->lhs != AST_NONE) {
+        ir_value_t condition = _lower_expression(lowerer, node->lhs);
+        _branch(lowerer, condition, body, exit);
+    } else {
+        _jump(lowerer, body);
+    }
+    _seal(lowerer, body);
+
+    if (lowerer->loop_count == lowerer->loop_capacity) {
+        uint32_t capacity = lowerer->loop_capacity ? lowerer->loop_capacity * 2 : 8;
+        lower_loop_t *loops = realloc(lowerer->loops, capacity * sizeof(lower_loop_t));
+        if (loops == NULL) {
+            lowerer->failed = true;
+            return;
+        }
+        lowerer->loops = loops;
+        lowerer->loop_capacity = capacity;
+    }
+    lowerer->loops[lowerer->loop_count].exit = exit;
+    lowerer->loops[lowerer->loop_count].header = header;
+    lowerer->loop_count++;
+
+    lowerer->block = body;
+    _lower_statement(lowerer, node->rhs);
+    _jump(lowerer, header);
+    lowerer->loop_count--;
+
+    /* Every back edge and break is known now */
+    _seal(lowerer, header);
+    _seal(lowerer, exit);
+    lowerer->block = exit;
+}
+
+/*
+ * Emits one IR_SWITCH for the whole statement, the "switch" pass picks how
+ * to dispatch. A trailing `fall` jumps into the next case's body.
+ */
+static void _lower_switch(lowerer_t *lowerer, ast_index_t index)
+{
+    const sema_t *sema = lowerer->sema;
+    const ast_t *ast = lowerer->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    const uint32_t *cases = &ast->extra[node->rhs];
+    uint32_t case_count = cases[1] - cases[0], label_count = 0, i, j;
+    uint32_t exit = _new_block(lowerer);
+    uint32_t fallback = exit;
+    uint32_t *bodies = malloc((case_count ? case_count : 1) * sizeof(uint32_t));
+
+    if (bodies == NULL) {
+        lowerer->failed = true;
+        return;
+    }
+    ir_type_t type = _node_type(lowerer, node->lhs);
+    ir_value_t value = _lower_expression(lowerer, node->lhs);
+    for (i = 0; i < case_count; i++) {
+        const ast_node_t *arm = &ast->nodes[ast->extra[cases[0] + i]];
+        bodies[i] = _new_block(lowerer);
+        if (arm->flags & AST_FLAG_DEFAULT)
+            fallback = bodies[i];
+        label_count += ast->extra[arm->lhs + 1] - ast->extra[arm->lhs];
+    }
+
+    uint32_t first = ir_add_operands(lowerer->function, lowerer->arena, NULL, 1 + label_count * 3);
+    if (first == UINT32_MAX || lowerer->failed) {
+        lowerer->failed = true;
+        free(bodies);
+        return;
+    }
+    uint32_t *operands = &lowerer->function->operands[first];
+    *operands++ = fallback;
+    for (i = 0; i < case_count; i++) {
+        const ast_node_t *arm = &ast->nodes[ast->extra[cases[0] + i]];
+        const uint32_t *labels = &ast->extra[arm->lhs];
+        for (j = labels[0]; j < labels[1]; j++) {
+            uint64_t constant = 0;
+            sema_eval_constant(sema, ast->extra[j], &constant);
+            constant = ir_wrap(type, constant);
+            *operands++ = (uint32_t) constant;
+            *operands++ = (uint32_t) (constant >> 32);
+            *operands++ = bodies[i];
+        }
+    }
+    uint32_t dispatch = lowerer->block;
+    _emit(lowerer, IR_SWITCH, IR_VOID, value, first, label_count);
+    for (i = 0; i < ir_successor_count(lowerer->function, dispatch); i++)
+        _edge(lowerer, dispatch, ir_successor(lowerer->function, dispatch, i));
+
+    for (i = 0; i < case_count && !lowerer->failed; i++) {
+        const ast_node_t *arm = &ast->nodes[ast->extra[cases[0] + i]];
+        const ast_node_t *body = &ast->nodes[arm->rhs];
+        uint32_t end = body->rhs;
+        bool falls = body->lhs < end && ast->nodes[ast->extra[end - 1]].kind == AST_FALL;
+
+        _seal(lowerer, bodies[i]);
+        lowerer->block = bodies[i];
+        _lower_range(lowerer, body->lhs, falls ? end - 1 : end);
+        _jump(lowerer, falls && i + 1 < case_count ? bodies[i + 1] : exit);
+    }
+    free(bodies);
+    _seal(lowerer, exit);
+    lowerer->block = exit;
+}
+
+static void _lower_statement(lowerer_t *lowerer, ast_index_t index)
+{
+    const ast_node_t *node = &lowerer->ast->nodes[index];
+    ir_value_t value, vtable = IR_NONE;
+
+    if (lowerer->failed)
+        return;
+    _ensure_open(lowerer);
+    switch ((ast_kind_t) node->kind) {
+    case AST_BLOCK:
+        _lower_range(lowerer, node->lhs, node->rhs);
+        break;
+    case AST_LET:
+        if (node->rhs != AST_NONE) {
+            value = _lower_value(lowerer, node->rhs, lowerer->sema->node_types[index], &vtable);
+        } else {
+            value = _const(lowerer, _node_type(lowerer, index), 0);
+            if (_is_interface(lowerer->sema, lowerer->sema->node_types[index]))
+                vtable = _const(lowerer, IR_PTR, 0);
+        }
+        _write(lowerer, index, value);
+        if (vtable != IR_NONE)
+            _write(lowerer, _vtable_key(lowerer, index), vtable);
+        break;
+    case AST_RETURN:
+        value = IR_NONE;
+        if (node->lhs != AST_NONE)
+            value = _lower_value(lowerer, node->lhs, lowerer->result, &vtable);
+        _emit(lowerer, IR_RETURN, IR_VOID, value, vtable, 0);
+        break;
+    case AST_IF:
+        _lower_if(lowerer, index);
+        break;
+    case AST_FOR:
+        _lower_for(lowerer, index);
+        break;
+    case AST_SWITCH:
+        _lower_switch(lowerer, index);
+        break;
+    case AST_BREAK:
+        _jump(lowerer, lowerer->loops[lowerer->loop_count - 1].exit);
+        break;
+    case AST_CONTINUE:
+        _jump(lowerer, lowerer->loops[lowerer->loop_count - 1].header);
+        break;
+    case AST_EXPR_STMT:
+        _lower_expression(lowerer, node->lhs);
+        break;
+    case AST_ASSIGN:
+        _lower_assign(lowerer, index);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Moves phis that became copies behind the remaining phis of their block */
+static void _sort_phis(ir_function_t *function)
+{
+    uint32_t b, i;
+    for (b = 0; b < function->block_count; b++) {
+        ir_block_t *block = &function->blocks[b];
+        uint32_t phis = 0;
+        for (i = 0; i < block->count; i++) {
+            if (function->instrs[block->instrs[i]].op != IR_PHI)
+                continue;
+            ir_value_t phi = block->instrs[i];
+            memmove(
+                &block->instrs[phis + 1], &block->instrs[phis], (i - phis) * sizeof(ir_value_t));
+            block->instrs[phis++] = phi;
+        }
+    }
+}
+
+static void _lower_function(lowerer_t *lowerer, ir_function_t *function, ast_index_t owner)
+{
+    const ast_t *ast = lowerer->ast;
+    const ast_node_t *node = &ast->nodes[function->declaration];
+    const uint32_t *signature = &ast->extra[node->lhs];
+    uint32_t position = 0, i;
+
+    lowerer->function = function;
+    lowerer->result = types_get(
+        &lowerer->sema->types, lowerer->sema->node_types[function->declaration])->operand;
+    lowerer->failed = false;
+    lowerer->def_count = 0;
+    lowerer->pending_count = 0;
+    lowerer->loop_count = 0;
+    memset(lowerer->defs, 0, (lowerer->def_mask + 1) * sizeof(lower_def_t));
+
+    lowerer->block = _new_block(lowerer);
+    lowerer->sealed[lowerer->block] = 1;
+    if (owner != AST_NONE)
+        _write(lowerer, owner, _emit(lowerer, IR_PARAM, IR_PTR, position++, 0, 0));
+    for (i = signature[0]; i < signature[1]; i++) {
+        ir_value_t param = _emit(
+            lowerer, IR_PARAM, (ir_type_t) function->param_types[position], position, 0, 0);
+        _write(lowerer, ast->extra[i], param);
+        position++;
+        if (_is_interface(lowerer->sema, lowerer->sema->node_types[ast->extra[i]])) {
+            param = _emit(lowerer, IR_PARAM, IR_PTR, position, 0, 0);
+            _write(lowerer, _vtable_key(lowerer, ast->extra[i]), param);
+            position++;
+        }
+    }
+
+    _lower_statement(lowerer, node->rhs);
+    if (_is_open(lowerer))
+        _emit(lowerer, function->result == IR_VOID ? IR_RETURN : IR_UNREACHABLE, IR_VOID, 0, 0, 0);
+    _sort_phis(function);
+    if (lowerer->failed && function->error == NULL) {
+        function->error = "out of memory";
+        function->error_node = function->declaration;
+    }
+}
+
+/* Module */
+
+typedef struct
+{
+    ir_module_t *module;
+    const sema_t *sema;
+    /* Task each function comes from */
+    const uint32_t *tasks;
+    /* Scratch tables reused by every function a worker lowers */
+    lowerer_t *lowerers;
+} lower_job_t;
+
+static void _lower_task(void *context, uint32_t worker, uint32_t index)
+{
+    lower_job_t *job = context;
+    ir_function_t *function = &job->module->functions[index];
+    const sema_task_t *task = &job->sema->tasks[job->tasks[index]];
+    lowerer_t *lowerer = &job->lowerers[worker % job->module->worker_count];
+
+    /* Settled bodies were compiled before, only their signatures are needed */
+    if (task->settled)
+        return;
+    if (lowerer->defs == NULL) {
+        lowerer->sema = job->sema;
+        lowerer->ast = job->sema->ast;
+        lowerer->module = job->module;
+        lowerer->arena = &job->module->worker_arenas[worker % job->module->worker_count];
+        lowerer->def_mask = 255;
+        lowerer->defs = calloc(lowerer->def_mask + 1, sizeof(lower_def_t));
+    }
+    if (lowerer->defs == NULL) {
+        function->error = "out of memory";
+        function->error_node = function->declaration;
+        return;
+    }
+    _lower_function(lowerer, function, task->owner);
+}
+
+static bool _signature(
+    ir_module_t *module, const sema_t *sema, ir_function_t *function, ast_index_t owner)
+{
+    const ast_t *ast = sema->ast;
+    const uint32_t *signature = &ast->extra[ast->nodes[function->declaration].lhs];
+    uint32_t position = 0, i;
+    type_id_t type = sema->node_types[function->declaration];
+    type_id_t result = types_get(&sema->types, type)->operand;
+
+    /* Interface parameters take two, the object and its vtable */
+    function->param_count = owner != AST_NONE;
+    for (i = signature[0]; i < signature[1]; i++)
+        function->param_count += 1 + _is_interface(sema, sema->node_types[ast->extra[i]]);
+    function->param_types = arena_alloc(module->arena, function->param_count + 1);
+    if (function->param_types == NULL)
+        return false;
+    if (owner != AST_NONE)
+        function->param_types[position++] = IR_PTR;
+    for (i = signature[0]; i < signature[1]; i++) {
+        type_id_t param = sema->node_types[ast->extra[i]];
+        if (!_supported(sema, param) && function->error == NULL) {
+            function->error = "parameters of this type are not supported by the code generator yet";
+            function->error_node = ast->extra[i];
+        }
+        function->param_types[position++] = _ir_type(sema, param);
+        if (_is_interface(sema, param))
+            function->param_types[position++] = IR_PTR;
+    }
+    if (!_supported(sema, result) && function->error == NULL) {
+        function->error = "results of this type are not supported by the code generator yet";
+        function->error_node = function->declaration;
+    }
+    function->result = _ir_type(sema, result);
+    function->returns_pair = _is_interface(sema, result);
+
+    if (owner == AST_NONE) {
+        function->name = ast_token(ast, function->declaration)->value;
+        return true;
+    }
+    const char *class = ast_token(ast, owner)->value;
+    const char *method = ast_token(ast, function->declaration)->value;
+    size_t length = strlen(class) + strlen(method) + 2;
+    char *name = arena_alloc(module->arena, length);
+    if (name == NULL)
+        return false;
+    snprintf(name, length, "%s.%s", class, method);
+    function->name = name;
+    return true;
+}
+
+/* One vtable per impl of an interface, in declaration order and so sorted by impl */
+static bool _build_vtables(ir_module_t *module, const sema_t *sema)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *root = &ast->nodes[0];
+    uint32_t count = 0, i, j;
+
+    for (i = root->lhs; i < root->rhs; i++) {
+        const ast_node_t *node = &ast->nodes[ast->extra[i]];
+        count += node->kind == AST_IMPL && ast->extra[node->lhs] != AST_NONE;
+    }
+    module->vtables = arena_alloc_aligned(
+        module->arena, (count ? count : 1) * sizeof(ir_vtable_t), sizeof(void *));
+    if (module->vtables == NULL)
+        return false;
+
+    for (i = root->lhs; i < root->rhs; i++) {
+        ast_index_t impl = ast->extra[i];
+        const ast_node_t *node = &ast->nodes[impl];
+        if (node->kind != AST_IMPL || ast->extra[node->lhs] == AST_NONE)
+            continue;
+        ir_vtable_t *vtable = &module->vtables[module->vtable_count++];
+        const ast_node_t *interface;
+        vtable->impl = impl;
+        vtable->class = sema->declarations[impl];
+        vtable->interface = sema->declarations[ast->extra[node->lhs]];
+        interface = &ast->nodes[vtable->interface];
+        vtable->method_count = interface->rhs - interface->lhs;
+        vtable->methods = arena_alloc_aligned(
+            module->arena, (vtable->method_count + 1) * sizeof(uint32_t), sizeof(uint32_t));
+        if (vtable->methods == NULL)
+            return false;
+        for (j = 0; j < vtable->method_count; j++) {
+            ast_index_t method = sema_map_find(
+                &sema->methods, vtable->class, ast_name(ast, ast->extra[interface->lhs + j]));
+            vtable->methods[j] = module->function_of_node[method];
+        }
+    }
+    return true;
+}
+
+bool lower_module(
+    ir_module_t *module, const sema_t *sema, pool_t *pool, diagnostics_t *diagnostics)
+{
+    uint32_t count = 0, i;
+    bool ok = true;
+
+    /* Functions with a body, methods included, in declaration order */
+    for (i = 0; i < sema->task_count; i++) {
+        ast_index_t node = sema->tasks[i].node;
+        if (sema->ast->nodes[node].kind == AST_FUNCTION && sema->ast->nodes[node].rhs != AST_NONE)
+            count++;
+    }
+
+    module->functions = arena_alloc_aligned(
+        module->arena, (count ? count : 1) * sizeof(ir_function_t), sizeof(void *));
+    uint32_t *tasks = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (module->functions == NULL || tasks == NULL) {
+        free(tasks);
+        return false;
+    }
+    memset(module->functions, 0, count * sizeof(ir_function_t));
+
+    for (i = 0; i < sema->task_count; i++) {
+        const sema_task_t *task = &sema->tasks[i];
+        if (sema->ast->nodes[task->node].kind != AST_FUNCTION
+            || sema->ast->nodes[task->node].rhs == AST_NONE)
+            continue;
+        ir_function_t *function = &module->functions[module->function_count];
+        function->declaration = task->node;
+        tasks[module->function_count] = i;
+        module->function_of_node[task->node] = module->function_count++;
+    }
+    for (i = 0; i < module->function_count && ok; i++)
+        ok = _signature(module, sema, &module->functions[i], sema->tasks[tasks[i]].owner);
+    ok = ok && _build_vtables(module, sema);
+
+    lower_job_t job = {.module = module, .sema = sema, .tasks = tasks};
+    job.lowerers = calloc(module->worker_count, sizeof(lowerer_t));
+    ok = ok && job.lowerers != NULL;
+    if (ok && pool != NULL) {
+        pool_run(pool, "lower_worker", module->function_count, _lower_task, &job);
+    } else if (ok) {
+        for (i = 0; i < module->function_count; i++)
+            _lower_task(&job, 0, i);
+    }
+    for (i = 0; job.lowerers != NULL && i < module->worker_count; i++) {
+        free(job.lowerers[i].defs);
+        free(job.lowerers[i].sealed);
+        free(job.lowerers[i].pending);
+        free(job.lowerers[i].loops);
+    }
+    free(job.lowerers);
+    free(tasks);
+
+    for (i = 0; i < module->function_count; i++) {
+        const ir_function_t *function = &module->functions[i];
+        if (function->error == NULL)
+            continue;
+        const token_t *token = ast_token(sema->ast, function->error_node);
+        diagnostics_add(diagnostics, token->line, token->column, "%s", function->error);
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,1498 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <opt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+
+typedef struct
+{
+    const char *name;
+    /* Function passes run in parallel; module passes get the whole module */
+    void (*run_function)(ir_function_t *function, arena_t *arena);
+    void (*run_module)(ir_module_t *module);
+} opt_pass_t;
+
+typedef struct
+{
+    ir_module_t *module;
+    const opt_pass_t *pass;
+} opt_job_t;
+
+/* Shared helpers */
+
+static ir_value_t _resolve(uint32_t *replace, ir_value_t value)
+{
+    while (replace[value] != value) {
+        replace[value] = replace[replace[value]];
+        value = replace[value];
+    }
+    return value;
+}
+
+static void _rewrite_operand(void *context, uint32_t *operand)
+{
+    *operand = _resolve(context, *operand);
+}
+
+static void _map_operand(void *context, uint32_t *operand)
+{
+    const uint32_t *map = context;
+    *operand = map[*operand];
+}
+
+static void _rewrite_uses(ir_function_t *function, uint32_t *replace)
+{
+    uint32_t b, i;
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++)
+            ir_for_each_operand(function, block->instrs[i], _rewrite_operand, replace);
+    }
+}
+
+/* Drops instructions turned into IR_NOP from their blocks */
+static void _compact_blocks(ir_function_t *function)
+{
+    uint32_t b, i;
+    for (b = 0; b < function->block_count; b++) {
+        ir_block_t *block = &function->blocks[b];
+        uint32_t kept = 0;
+        for (i = 0; i < block->count; i++)
+            if (function->instrs[block->instrs[i]].op != IR_NOP)
+                block->instrs[kept++] = block->instrs[i];
+        block->count = kept;
+    }
+}
+
+static uint32_t *_identity_map(uint32_t count)
+{
+    uint32_t *map = malloc((count ? count : 1) * sizeof(uint32_t)), i;
+    if (map != NULL)
+        for (i = 0; i < count; i++)
+            map[i] = i;
+    return map;
+}
+
+static void _make_copy(ir_instr_t *instr, ir_value_t value)
+{
+    instr->op = IR_COPY;
+    instr->a = value;
+    instr->b = 0;
+    instr->c = 0;
+}
+
+/* Constant folding */
+
+static ir_value_t _skip_copies(const ir_function_t *function, ir_value_t value)
+{
+    while (function->instrs[value].op == IR_COPY)
+        value = function->instrs[value].a;
+    return value;
+}
+
+static bool _constant(const ir_function_t *function, ir_value_t value, uint64_t *result)
+{
+    const ir_instr_t *instr = &function->instrs[_skip_copies(function, value)];
+    if (instr->op != IR_CONST)
+        return false;
+    *result = ir_const_value(instr);
+    return true;
+}
+
+static bool _evaluate(
+    ir_op_t op, ir_type_t type, ir_type_t operand_type, uint64_t a, uint64_t b, uint64_t *result)
+{
+    bool is_signed = ir_type_signed(operand_type);
+    switch (op) {
+    case IR_ADD:
+        *result = a + b;
+        break;
+    case IR_SUB:
+        *result = a - b;
+        break;
+    case IR_MUL:
+        *result = a * b;
+        break;
+    case IR_DIV:
+    case IR_MOD:
+        /* Division by zero is left to trap at run time */
+        if (b == 0)
+            return false;
+        if (is_signed && (int64_t) b == -1)
+            *result = op == IR_DIV ? 0 - a : 0;
+        else if (is_signed)
+            *result = op == IR_DIV ? (uint64_t) ((int64_t) a / (int64_t) b)
+                                   : (uint64_t) ((int64_t) a % (int64_t) b);
+        else
+            *result = op == IR_DIV ? a / b : a % b;
+        break;
+    case IR_EQ:
+        *result = a == b;
+        break;
+    case IR_NE:
+        *result = a != b;
+        break;
+    case IR_LT:
+        *result = is_signed ? (int64_t) a < (int64_t) b : a < b;
+        break;
+    case IR_LE:
+        *result = is_signed ? (int64_t) a <= (int64_t) b : a <= b;
+        break;
+    case IR_GT:
+        *result = is_signed ? (int64_t) a > (int64_t) b : a > b;
+        break;
+    case IR_GE:
+        *result = is_signed ? (int64_t) a >= (int64_t) b : a >= b;
+        break;
+    default:
+        return false;
+    }
+    *result = ir_wrap(type, *result);
+    return true;
+}
+
+/* x + 0, x * 1, x - x and friends */
+static bool _simplify(ir_function_t *function, ir_instr_t *instr)
+{
+    ir_value_t a = _skip_copies(function, instr->a);
+    ir_value_t b = _skip_copies(function, instr->b);
+    uint64_t constant;
+    bool b_const = _constant(function, b, &constant);
+
+    switch ((ir_op_t) instr->op) {
+    case IR_ADD:
+    case IR_MUL:
+        if (!b_const && _constant(function, a, &constant)) {
+            ir_value_t swap = a;
+            a = b;
+            b = swap;
+            b_const = true;
+        }
+        if (b_const && constant == (instr->op == IR_MUL)) {
+            _make_copy(instr, a);
+            return true;
+        }
+        if (b_const && instr->op == IR_MUL && constant == 0) {
+            ir_set_const(instr, 0);
+            return true;
+        }
+        return false;
+    case IR_SUB:
+    case IR_DIV:
+        if (b_const && constant == (instr->op == IR_DIV)) {
+            _make_copy(instr, a);
+            return true;
+        }
+        if (instr->op == IR_SUB && a == b) {
+            ir_set_const(instr, 0);
+            return true;
+        }
+        return false;
+    case IR_EQ:
+    case IR_LE:
+    case IR_GE:
+    case IR_NE:
+    case IR_LT:
+    case IR_GT:
+        if (a != b)
+            return false;
+        ir_set_const(instr, instr->op == IR_EQ || instr->op == IR_LE || instr->op == IR_GE);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool _fold_branch(ir_function_t *function, ir_value_t value)
+{
+    ir_instr_t *instr = &function->instrs[value];
+    uint64_t condition;
+    if (!_constant(function, instr->a, &condition))
+        return false;
+
+    uint32_t taken = condition ? instr->b : instr->c;
+    uint32_t dropped = condition ? instr->c : instr->b;
+    uint32_t block = instr->block;
+    instr->op = IR_JUMP;
+    instr->a = taken;
+    instr->b = 0;
+    instr->c = 0;
+    /* With both edges to one block, drop the duplicate predecessor */
+    ir_remove_pred(function, dropped, ir_pred_index(function, dropped, block));
+    return true;
+}
+
+static bool _fold_switch(ir_function_t *function, ir_value_t value)
+{
+    ir_instr_t *instr = &function->instrs[value];
+    uint32_t block = instr->block, count = ir_successor_count(function, block), taken = 0, i;
+    uint64_t constant;
+    if (!_constant(function, instr->a, &constant))
+        return false;
+
+    uint32_t *targets = malloc(count * sizeof(uint32_t));
+    if (targets == NULL)
+        return false;
+    for (i = 0; i < count; i++)
+        targets[i] = ir_successor(function, block, i);
+    for (i = 0; i < instr->c; i++)
+        if (ir_switch_value(function, instr, i) == constant)
+            taken = i + 1;
+
+    for (i = 0; i < count; i++)
+        if (i != taken)
+            ir_remove_pred(function, targets[i], ir_pred_index(function, targets[i], block));
+    instr->op = IR_JUMP;
+    instr->a = targets[taken];
+    instr->b = 0;
+    instr->c = 0;
+    free(targets);
+    return true;
+}
+
+static bool _fold_instr(ir_function_t *function, ir_value_t value)
+{
+    ir_instr_t *instr = &function->instrs[value];
+    uint64_t a, b, result;
+
+    switch ((ir_op_t) instr->op) {
+    case IR_NEG:
+        if (!_constant(function, instr->a, &a))
+            return false;
+        ir_set_const(instr, 0 - a);
+        return true;
+    case IR_NOT:
+        if (!_constant(function, instr->a, &a))
+            return false;
+        ir_set_const(instr, a == 0);
+        return true;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        if (_constant(function, instr->a, &a) && _constant(function, instr->b, &b)
+            && _evaluate(
+                (ir_op_t) instr->op,
+                (ir_type_t) instr->type,
+                (ir_type_t) function->instrs[instr->a].type,
+                a,
+                b,
+                &result)) {
+            ir_set_const(instr, result);
+            return true;
+        }
+        return _simplify(function, instr);
+    case IR_BIT_TEST:
+        if (!_constant(function, instr->a, &a) || !_constant(function, instr->b, &b) || a >= 64)
+            return false;
+        ir_set_const(instr, (b >> a) & 1);
+        return true;
+    case IR_BRANCH:
+        return _fold_branch(function, value);
+    case IR_SWITCH:
+        return _fold_switch(function, value);
+    default:
+        return false;
+    }
+}
+
+static void _fold(ir_function_t *function, arena_t *arena)
+{
+    (void) arena;
+    bool changed = true;
+    uint32_t b, i;
+    while (changed) {
+        changed = false;
+        for (b = 0; b < function->block_count; b++) {
+            const ir_block_t *block = &function->blocks[b];
+            for (i = 0; i < block->count; i++)
+                changed = _fold_instr(function, block->instrs[i]) || changed;
+        }
+    }
+}
+
+/* Copy propagation */
+
+static void _copyprop(ir_function_t *function, arena_t *arena)
+{
+    (void) arena;
+    uint32_t *replace = _identity_map(function->instr_count);
+    bool changed = true;
+    uint32_t b, i, j;
+
+    if (replace == NULL)
+        return;
+    while (changed) {
+        changed = false;
+        for (b = 0; b < function->block_count; b++) {
+            const ir_block_t *block = &function->blocks[b];
+            for (i = 0; i < block->count; i++) {
+                ir_value_t value = block->instrs[i];
+                const ir_instr_t *instr = &function->instrs[value];
+                ir_value_t same = IR_NONE;
+                if (replace[value] != value)
+                    continue;
+
+                if (instr->op == IR_COPY) {
+                    same = _resolve(replace, instr->a);
+                } else if (instr->op == IR_PHI) {
+                    /* A phi merging one value (besides itself) is that value */
+                    for (j = 0; j < instr->b; j++) {
+                        ir_value_t input = _resolve(replace, function->operands[instr->a + j]);
+                        if (input == value || input == same)
+                            continue;
+                        if (same != IR_NONE)
+                            break;
+                        same = input;
+                    }
+                    if (j < instr->b)
+                        same = IR_NONE;
+                }
+                if (same == IR_NONE || same == value)
+                    continue;
+                replace[value] = same;
+                changed = true;
+            }
+        }
+    }
+
+    _rewrite_uses(function, replace);
+    for (i = 1; i < function->instr_count; i++)
+        if (replace[i] != i)
+            function->instrs[i].op = IR_NOP;
+    _compact_blocks(function);
+    free(replace);
+}
+
+/* Dead code elimination */
+
+static void _remove_unreachable(ir_function_t *function)
+{
+    uint32_t count = function->block_count, b, i;
+    uint32_t *order = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t *renumber = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t reached;
+
+    if (order == NULL || renumber == NULL || (reached = ir_reverse_postorder(function, order)) == 0
+        || reached == count) {
+        free(order);
+        free(renumber);
+        return;
+    }
+
+    for (b = 0; b < count; b++)
+        renumber[b] = UINT32_MAX;
+    for (i = 0; i < reached; i++)
+        renumber[order[i]] = 0;
+
+    /* Forget edges leaving dead blocks, then their instructions */
+    for (b = 0; b < count; b++) {
+        if (renumber[b] != UINT32_MAX)
+            continue;
+        for (i = 0; i < ir_successor_count(function, b); i++) {
+            uint32_t successor = ir_successor(function, b, i);
+            uint32_t index = ir_pred_index(function, successor, b);
+            if (renumber[successor] != UINT32_MAX && index != UINT32_MAX)
+                ir_remove_pred(function, successor, index);
+        }
+        for (i = 0; i < function->blocks[b].count; i++)
+            function->instrs[function->blocks[b].instrs[i]].op = IR_NOP;
+    }
+
+    /* Keep the surviving blocks in their original order */
+    uint32_t kept = 0;
+    for (b = 0; b < count; b++)
+        if (renumber[b] != UINT32_MAX)
+            renumber[b] = kept++;
+    for (b = 0; b < count; b++) {
+        if (renumber[b] == UINT32_MAX)
+            continue;
+        ir_block_t *block = &function->blocks[renumber[b]];
+        *block = function->blocks[b];
+        for (i = 0; i < block->pred_count; i++)
+            block->preds[i] = renumber[block->preds[i]];
+        for (i = 0; i < block->count; i++)
+            function->instrs[block->instrs[i]].block = renumber[b];
+        if (block->count > 0)
+            ir_for_each_target(function, block->instrs[block->count - 1], _map_operand, renumber);
+    }
+    function->block_count = kept;
+    free(order);
+    free(renumber);
+}
+
+/* Appends a jump target with no other predecessors to its only predecessor */
+static void _merge_blocks(ir_function_t *function, arena_t *arena)
+{
+    uint32_t b, i;
+    for (b = 0; b < function->block_count; b++) {
+        ir_value_t jump;
+        while ((jump = ir_terminator(function, b)) != IR_NONE
+               && function->instrs[jump].op == IR_JUMP) {
+            uint32_t target = function->instrs[jump].a;
+            ir_block_t *next = &function->blocks[target];
+            if (target == b || target == 0 || next->pred_count != 1
+                || (next->count > 0 && function->instrs[next->instrs[0]].op == IR_PHI))
+                break;
+
+            function->blocks[b].count--;
+            function->instrs[jump].op = IR_NOP;
+            for (i = 0; i < next->count; i++) {
+                if (!ir_block_push(function, arena, b, next->instrs[i]))
+                    return;
+                function->instrs[next->instrs[i]].block = b;
+            }
+            for (i = 0; i < ir_successor_count(function, b); i++) {
+                ir_block_t *successor = &function->blocks[ir_successor(function, b, i)];
+                uint32_t j;
+                for (j = 0; j < successor->pred_count; j++)
+                    if (successor->preds[j] == target)
+                        successor->preds[j] = b;
+            }
+            /* Left without instructions or predecessors for _remove_unreachable */
+            next->count = 0;
+            next->pred_count = 0;
+        }
+    }
+}
+
+typedef struct
+{
+    uint8_t *live;
+    uint32_t *worklist;
+    uint32_t count;
+} opt_liveness_t;
+
+static void _mark_live(void *context, uint32_t *operand)
+{
+    opt_liveness_t *liveness = context;
+    if (liveness->live[*operand])
+        return;
+    liveness->live[*operand] = 1;
+    liveness->worklist[liveness->count++] = *operand;
+}
+
+static void _dce(ir_function_t *function, arena_t *arena)
+{
+    opt_liveness_t liveness;
+    uint32_t b, i;
+
+    _merge_blocks(function, arena);
+    _remove_unreachable(function);
+    liveness.live = calloc(function->instr_count, 1);
+    liveness.worklist = malloc(function->instr_count * sizeof(uint32_t));
+    liveness.count = 0;
+    if (liveness.live == NULL || liveness.worklist == NULL) {
+        free(liveness.live);
+        free(liveness.worklist);
+        return;
+    }
+
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++)
+            if (ir_has_side_effects(function, block->instrs[i]))
+                _mark_live(&liveness, &block->instrs[i]);
+    }
+    while (liveness.count > 0) {
+        ir_value_t value = liveness.worklist[--liveness.count];
+        ir_for_each_operand(function, value, _mark_live, &liveness);
+    }
+
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++)
+            if (!liveness.live[block->instrs[i]])
+                function->instrs[block->instrs[i]].op = IR_NOP;
+    }
+    _compact_blocks(function);
+    free(liveness.live);
+    free(liveness.worklist);
+}
+
+/* Common subexpression elimination */
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t type;
+    uint32_t a;
+    uint32_t b;
+    ir_value_t value;
+} opt_expression_t;
+
+typedef struct
+{
+    uint32_t slot;
+    ir_value_t previous;
+} opt_undo_t;
+
+static bool _is_pure(ir_op_t op)
+{
+    /* Vtables never change, so method loads are pure too */
+    return op == IR_CONST || op == IR_FUNC_ADDR || op == IR_VTABLE || op == IR_METHOD
+           || (op >= IR_ADD && op <= IR_BIT_TEST);
+}
+
+static bool _is_commutative(ir_op_t op)
+{
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE;
+}
+
+static uint32_t _expression_hash(const ir_instr_t *instr)
+{
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ instr->op) * 16777619u;
+    hash = (hash ^ instr->type) * 16777619u;
+    hash = (hash ^ instr->a) * 16777619u;
+    hash = (hash ^ instr->b) * 16777619u;
+    return hash;
+}
+
+static void _cse(ir_function_t *function, arena_t *arena)
+{
+    (void) arena;
+    uint32_t count = function->block_count, b, i;
+    uint32_t size = 16;
+    while (size < function->instr_count * 2)
+        size *= 2;
+
+    uint32_t *order = malloc(count * sizeof(uint32_t));
+    uint32_t *idom = malloc(count * sizeof(uint32_t));
+    /* Dominator tree as first child / next sibling links */
+    uint32_t *child = malloc(count * sizeof(uint32_t));
+    uint32_t *sibling = malloc(count * sizeof(uint32_t));
+    uint32_t *stack = malloc(count * 2 * sizeof(uint32_t));
+    uint32_t *marks = malloc(count * sizeof(uint32_t));
+    opt_expression_t *table = calloc(size, sizeof(opt_expression_t));
+    opt_undo_t *undo = malloc(function->instr_count * sizeof(opt_undo_t));
+    uint32_t *replace = _identity_map(function->instr_count);
+    uint32_t reached, depth = 0, undo_count = 0;
+
+    if (order == NULL || idom == NULL || child == NULL || sibling == NULL || stack == NULL
+        || marks == NULL || table == NULL || undo == NULL || replace == NULL || count == 0)
+        goto done;
+
+    reached = ir_reverse_postorder(function, order);
+    ir_dominators(function, order, reached, idom);
+    for (b = 0; b < count; b++)
+        child[b] = sibling[b] = UINT32_MAX;
+    for (i = reached; i-- > 1;) {
+        sibling[order[i]] = child[idom[order[i]]];
+        child[idom[order[i]]] = order[i];
+    }
+
+    /* Preorder walk; leaving a block restores the table as it was on entry */
+    stack[depth++] = order[0] * 2;
+    while (depth > 0) {
+        uint32_t entry = stack[--depth];
+        uint32_t block = entry / 2;
+        if (entry & 1) {
+            while (undo_count > marks[block]) {
+                undo_count--;
+                table[undo[undo_count].slot].value = undo[undo_count].previous;
+            }
+            continue;
+        }
+
+        marks[block] = undo_count;
+        stack[depth++] = block * 2 + 1;
+        for (b = child[block]; b != UINT32_MAX; b = sibling[b])
+            stack[depth++] = b * 2;
+
+        const ir_block_t *current = &function->blocks[block];
+        for (i = 0; i < current->count; i++) {
+            ir_value_t value = current->instrs[i];
+            ir_instr_t *instr = &function->instrs[value];
+            ir_for_each_operand(function, value, _rewrite_operand, replace);
+            if (!_is_pure((ir_op_t) instr->op))
+                continue;
+            if (_is_commutative((ir_op_t) instr->op) && instr->a > instr->b) {
+                uint32_t swap = instr->a;
+                instr->a = instr->b;
+                instr->b = swap;
+            }
+
+            uint32_t slot = _expression_hash(instr) & (size - 1);
+            while (table[slot].value != IR_NONE) {
+                const opt_expression_t *expression = &table[slot];
+                if (expression->op == instr->op && expression->type == instr->type
+                    && expression->a == instr->a && expression->b == instr->b)
+                    break;
+                slot = (slot + 1) & (size - 1);
+            }
+            if (table[slot].value != IR_NONE) {
+                replace[value] = table[slot].value;
+                continue;
+            }
+            undo[undo_count].slot = slot;
+            undo[undo_count].previous = IR_NONE;
+            undo_count++;
+            table[slot].op = instr->op;
+            table[slot].type = instr->type;
+            table[slot].a = instr->a;
+            table[slot].b = instr->b;
+            table[slot].value = value;
+        }
+    }
+
+    /* Phis may use values from blocks visited later through back edges */
+    _rewrite_uses(function, replace);
+    for (i = 1; i < function->instr_count; i++)
+        if (replace[i] != i)
+            function->instrs[i].op = IR_NOP;
+    _compact_blocks(function);
+
+done:
+    free(order);
+    free(idom);
+    free(child);
+    free(sibling);
+    free(stack);
+    free(marks);
+    free(table);
+    free(undo);
+    free(replace);
+}
+
+/* Inlining */
+
+static uint32_t _body_size(const ir_function_t *function)
+{
+    uint32_t size = 0, b;
+    for (b = 0; b < function->block_count; b++)
+        size += function->blocks[b].count;
+    return size;
+}
+
+static bool _is_inlinable(const ir_module_t *module, uint32_t index)
+{
+    const ir_function_t *function = &module->functions[index];
+    uint32_t b, i;
+    if (function->error != NULL || function->block_count == 0
+        || _body_size(function) > OPT_INLINE_LIMIT)
+        return false;
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++) {
+            const ir_instr_t *instr = &function->instrs[block->instrs[i]];
+            if (instr->op == IR_CALL && instr->a == index)
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Moves the instructions after position `at` of `block` into a new block */
+static uint32_t _split_block(ir_function_t *function, arena_t *arena, uint32_t block, uint32_t at)
+{
+    uint32_t next = ir_add_block(function, arena), i;
+    if (next == UINT32_MAX)
+        return UINT32_MAX;
+
+    ir_block_t *source = &function->blocks[block];
+    for (i = at + 1; i < source->count; i++) {
+        if (!ir_block_push(function, arena, next, source->instrs[i]))
+            return UINT32_MAX;
+        source = &function->blocks[block];
+        function->instrs[source->instrs[i]].block = next;
+    }
+    source->count = at;
+
+    /* Successors now come from the new block, keeping the phi input order */
+    for (i = 0; i < ir_successor_count(function, next); i++) {
+        ir_block_t *successor = &function->blocks[ir_successor(function, next, i)];
+        uint32_t j;
+        for (j = 0; j < successor->pred_count; j++)
+            if (successor->preds[j] == block)
+                successor->preds[j] = next;
+    }
+    return next;
+}
+
+/*
+ * Turns `value`, the result of an inlined call, into a copy or phi of field
+ * `half` of the (block, value, vtable) returns and moves it to the front of
+ * `next`, where the returns jump to.
+ */
+static bool _merge_returns(
+    ir_function_t *function,
+    arena_t *arena,
+    ir_value_t value,
+    uint32_t next,
+    const uint32_t *returns,
+    uint32_t return_count,
+    uint32_t half)
+{
+    ir_instr_t *result = &function->instrs[value];
+    ir_block_t *target = &function->blocks[next];
+    uint32_t first, at = 0, i;
+
+    /* The call was split off already, its IR_CALL_SECOND still leads `next` */
+    while (at < target->count && target->instrs[at] != value)
+        at++;
+    if (at < target->count) {
+        memmove(
+            &target->instrs[at],
+            &target->instrs[at + 1],
+            (target->count - at - 1) * sizeof(ir_value_t));
+        target->count--;
+    }
+
+    if (result->type == IR_VOID) {
+        result->op = IR_NOP;
+        return true;
+    } else if (return_count == 1) {
+        _make_copy(result, returns[half]);
+    } else if (return_count == 0) {
+        ir_set_const(result, 0);
+    } else {
+        first = ir_add_operands(function, arena, NULL, return_count);
+        if (first == UINT32_MAX)
+            return false;
+        for (i = 0; i < return_count; i++)
+            function->operands[first + ir_pred_index(function, next, returns[i * 3])] =
+                returns[i * 3 + half];
+        result = &function->instrs[value];
+        result->op = IR_PHI;
+        result->a = first;
+        result->b = return_count;
+        result->c = 0;
+    }
+    result->block = next;
+    if (!ir_block_push(function, arena, next, value))
+        return false;
+    target = &function->blocks[next];
+    memmove(&target->instrs[1], &target->instrs[0], (target->count - 1) * sizeof(ir_value_t));
+    target->instrs[0] = value;
+    return true;
+}
+
+static bool _inline_call(ir_module_t *module, ir_function_t *function, ir_value_t call)
+{
+    arena_t *arena = module->arena;
+    const ir_function_t *callee = &module->functions[function->instrs[call].a];
+    uint32_t block = function->instrs[call].block, at = 0, first = 0, b, i;
+    uint32_t *blocks = malloc(callee->block_count * sizeof(uint32_t));
+    uint32_t *values = calloc(callee->instr_count, sizeof(uint32_t));
+    uint32_t *returns = malloc(callee->block_count * 3 * sizeof(uint32_t));
+    uint32_t return_count = 0;
+    bool ok = false;
+
+    if (blocks == NULL || values == NULL || returns == NULL)
+        goto done;
+    while (function->blocks[block].instrs[at] != call)
+        at++;
+    uint32_t next = _split_block(function, arena, block, at);
+    if (next == UINT32_MAX)
+        goto done;
+
+    for (b = 0; b < callee->block_count; b++)
+        if ((blocks[b] = ir_add_block(function, arena)) == UINT32_MAX)
+            goto done;
+
+    /* Number the copies first so operands can refer forward */
+    for (b = 0; b < callee->block_count; b++) {
+        const ir_block_t *source = &callee->blocks[b];
+        for (i = 0; i < source->count; i++) {
+            ir_value_t value = source->instrs[i];
+            const ir_instr_t *instr = &callee->instrs[value];
+            if (instr->op == IR_PARAM) {
+                const ir_instr_t *site = &function->instrs[call];
+                values[value] = function->operands[site->b + instr->a];
+                continue;
+            }
+            values[value] = ir_append(
+                function, arena, blocks[b], (ir_op_t) instr->op, (ir_type_t) instr->type, 0, 0, 0);
+            if (values[value] == IR_NONE)
+                goto done;
+        }
+        for (i = 0; i < source->pred_count; i++)
+            if (!ir_add_pred(function, arena, blocks[b], blocks[source->preds[i]]))
+                goto done;
+    }
+
+    for (b = 0; b < callee->block_count; b++) {
+        const ir_block_t *source = &callee->blocks[b];
+        for (i = 0; i < source->count; i++) {
+            const ir_instr_t *original = &callee->instrs[source->instrs[i]];
+            ir_value_t value = values[source->instrs[i]];
+            uint32_t j, count = 0;
+            if (original->op == IR_PARAM)
+                continue;
+
+            if (original->op == IR_PHI) {
+                count = original->b;
+            } else if (original->op == IR_CALL || original->op == IR_CALL_INDIRECT) {
+                count = original->c;
+            } else if (original->op == IR_SWITCH) {
+                count = 1 + original->c * 3;
+            } else if (original->op == IR_JUMP_TABLE) {
+                count = original->c;
+            }
+            if (count > 0) {
+                uint32_t source_first = original->op == IR_PHI ? original->a : original->b;
+                bool is_values = original->op != IR_SWITCH && original->op != IR_JUMP_TABLE;
+                first = ir_add_operands(function, arena, &callee->operands[source_first], count);
+                if (first == UINT32_MAX)
+                    goto done;
+                for (j = 0; j < count && is_values; j++)
+                    function->operands[first + j] = values[function->operands[first + j]];
+            }
+
+            ir_instr_t *copy = &function->instrs[value];
+            copy->a = original->a;
+            copy->b = original->b;
+            copy->c = original->c;
+            copy->flags = original->flags;
+            switch ((ir_op_t) original->op) {
+            case IR_PHI:
+                copy->a = first;
+                break;
+            case IR_CALL:
+                copy->b = first;
+                break;
+            case IR_CALL_INDIRECT:
+                copy->a = values[original->a];
+                copy->b = first;
+                break;
+            case IR_JUMP:
+            case IR_BRANCH:
+            case IR_SWITCH:
+            case IR_JUMP_TABLE:
+                if (original->op != IR_JUMP)
+                    copy->a = values[original->a];
+                if (count > 0)
+                    copy->b = first;
+                ir_for_each_target(function, value, _map_operand, blocks);
+                break;
+            case IR_RETURN:
+                returns[return_count * 3] = blocks[b];
+                returns[return_count * 3 + 1] = values[original->a];
+                returns[return_count * 3 + 2] = values[original->b];
+                return_count++;
+                copy->op = IR_JUMP;
+                copy->a = next;
+                if (!ir_add_pred(function, arena, next, blocks[b]))
+                    goto done;
+                break;
+            case IR_CONST:
+            case IR_FUNC_ADDR:
+            case IR_VTABLE:
+            case IR_NEW:
+                break;
+            default:
+                ir_for_each_operand(function, value, _map_operand, values);
+                break;
+            }
+        }
+    }
+
+    /* The call becomes a jump into the copy and a copy of the returned value */
+    if (ir_append(function, arena, block, IR_JUMP, IR_VOID, blocks[0], 0, 0) == IR_NONE
+        || !ir_add_pred(function, arena, blocks[0], block))
+        goto done;
+
+    /* The vtable half of a returned pair is merged the same way, right behind */
+    const ir_block_t *rest = &function->blocks[next];
+    if (callee->returns_pair && rest->count > 0
+        && function->instrs[rest->instrs[0]].op == IR_CALL_SECOND
+        && !_merge_returns(function, arena, rest->instrs[0], next, returns, return_count, 2))
+        goto done;
+    ok = _merge_returns(function, arena, call, next, returns, return_count, 1);
+
+done:
+    free(blocks);
+    free(values);
+    free(returns);
+    return ok;
+}
+
+static void _inline(ir_module_t *module)
+{
+    uint32_t f, b, i;
+    for (f = 0; f < module->function_count; f++) {
+        ir_function_t *function = &module->functions[f];
+        uint32_t *calls, call_count = 0;
+        if (function->error != NULL)
+            continue;
+
+        /* Only the call sites present now, so inlined bodies are not revisited */
+        if ((calls = malloc((function->instr_count + 1) * sizeof(uint32_t))) == NULL)
+            return;
+        for (b = 0; b < function->block_count; b++) {
+            const ir_block_t *block = &function->blocks[b];
+            for (i = 0; i < block->count; i++) {
+                const ir_instr_t *instr = &function->instrs[block->instrs[i]];
+                if (instr->op == IR_CALL && instr->a != f && _is_inlinable(module, instr->a))
+                    calls[call_count++] = block->instrs[i];
+            }
+        }
+        for (i = 0; i < call_count; i++)
+            if (!_inline_call(module, function, calls[i]))
+                break;
+        free(calls);
+    }
+}
+
+/* Devirtualization */
+
+/* Index of the vtable `value` always holds, looking through a few levels of phis */
+static uint32_t _known_vtable(const ir_function_t *function, ir_value_t value, uint32_t depth)
+{
+    value = _skip_copies(function, value);
+    const ir_instr_t *instr = &function->instrs[value];
+    uint32_t known = UINT32_MAX, i;
+
+    if (instr->op == IR_VTABLE)
+        return instr->a;
+    if (instr->op != IR_PHI || depth == 0)
+        return UINT32_MAX;
+    for (i = 0; i < instr->b; i++) {
+        ir_value_t input = _skip_copies(function, function->operands[instr->a + i]);
+        if (input == value)
+            continue;
+        uint32_t table = _known_vtable(function, input, depth - 1);
+        if (table == UINT32_MAX || (known != UINT32_MAX && table != known))
+            return UINT32_MAX;
+        known = table;
+    }
+    return known;
+}
+
+/* Unless the module is open it is the whole program, so one impl means one vtable */
+static uint32_t _only_vtable(const ir_module_t *module, ast_index_t interface)
+{
+    uint32_t found = UINT32_MAX, i;
+    if (module->open)
+        return UINT32_MAX;
+    for (i = 0; i < module->vtable_count; i++) {
+        if (module->vtables[i].interface != interface)
+            continue;
+        if (found != UINT32_MAX)
+            return UINT32_MAX;
+        found = i;
+    }
+    return found;
+}
+
+static void _devirtualize_function(const ir_module_t *module, ir_function_t *function)
+{
+    uint32_t b, i;
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++) {
+            ir_instr_t *instr = &function->instrs[block->instrs[i]];
+            if (instr->op != IR_METHOD)
+                continue;
+            uint32_t table = _known_vtable(function, instr->a, OPT_DEVIRT_PHI_DEPTH);
+            if (table == UINT32_MAX)
+                table = _only_vtable(module, instr->c);
+            if (table == UINT32_MAX || module->vtables[table].methods[instr->b] == UINT32_MAX)
+                continue;
+            instr->op = IR_FUNC_ADDR;
+            instr->a = module->vtables[table].methods[instr->b];
+            instr->b = 0;
+            instr->c = 0;
+        }
+    }
+
+    /* Calls through a known function are direct calls, which inline can take */
+    for (b = 0; b < function->block_count; b++) {
+        const ir_block_t *block = &function->blocks[b];
+        for (i = 0; i < block->count; i++) {
+            ir_instr_t *instr = &function->instrs[block->instrs[i]];
+            if (instr->op != IR_CALL_INDIRECT)
+                continue;
+            const ir_instr_t *callee = &function->instrs[_skip_copies(function, instr->a)];
+            if (callee->op != IR_FUNC_ADDR)
+                continue;
+            instr->op = IR_CALL;
+            instr->a = callee->a;
+        }
+    }
+}
+
+static void _devirtualize(ir_module_t *module)
+{
+    uint32_t f;
+    if (module->vtable_count == 0)
+        return;
+    for (f = 0; f < module->function_count; f++)
+        if (module->functions[f].error == NULL)
+            _devirtualize_function(module, &module->functions[f]);
+}
+
+/* Switch lowering */
+
+typedef struct
+{
+    uint64_t value;
+    uint32_t target;
+} opt_case_t;
+
+typedef enum {
+    OPT_CLUSTER_CASE,
+    OPT_CLUSTER_TABLE,
+    OPT_CLUSTER_BITS
+} opt_cluster_kind_t;
+
+typedef struct
+{
+    opt_cluster_kind_t kind;
+    uint32_t first;
+    uint32_t count;
+    uint64_t low;
+    uint64_t high;
+} opt_cluster_t;
+
+/* What the comparisons leading to a block proved about the value */
+typedef struct
+{
+    bool has_low;
+    bool has_high;
+    uint64_t low;
+    uint64_t high;
+} opt_bounds_t;
+
+typedef struct
+{
+    ir_function_t *function;
+    arena_t *arena;
+    ir_value_t value;
+    ir_type_t type;
+    const opt_case_t *cases;
+    /* Blocks numbered from here on were created by the lowering */
+    uint32_t first_new_block;
+    /* Edges into the switch's successors, connected once all are known */
+    uint32_t *edges;
+    uint32_t edge_count;
+    uint32_t edge_capacity;
+    bool failed;
+} opt_switch_t;
+
+static int _compare_signed(const void *a, const void *b)
+{
+    int64_t x = (int64_t) ((const opt_case_t *) a)->value;
+    int64_t y = (int64_t) ((const opt_case_t *) b)->value;
+    return (x > y) - (x < y);
+}
+
+static int _compare_unsigned(const void *a, const void *b)
+{
+    uint64_t x = ((const opt_case_t *) a)->value;
+    uint64_t y = ((const opt_case_t *) b)->value;
+    return (x > y) - (x < y);
+}
+
+static bool _less_equal(const opt_switch_t *lowering, uint64_t a, uint64_t b)
+{
+    return ir_type_signed(lowering->type) ? (int64_t) a <= (int64_t) b : a <= b;
+}
+
+static uint32_t _switch_block(opt_switch_t *lowering)
+{
+    uint32_t block = ir_add_block(lowering->function, lowering->arena);
+    lowering->failed = lowering->failed || block == UINT32_MAX;
+    return block == UINT32_MAX ? 0 : block;
+}
+
+static ir_value_t _switch_emit(
+    opt_switch_t *lowering, uint32_t block, ir_op_t op, ir_type_t type, uint32_t a, uint32_t b)
+{
+    ir_value_t value = ir_append(lowering->function, lowering->arena, block, op, type, a, b, 0);
+    lowering->failed = lowering->failed || value == IR_NONE;
+    return value;
+}
+
+static ir_value_t _switch_const(
+    opt_switch_t *lowering, uint32_t block, ir_type_t type, uint64_t value)
+{
+    ir_value_t result = ir_append_const(lowering->function, lowering->arena, block, type, value);
+    lowering->failed = lowering->failed || result == IR_NONE;
+    return result;
+}
+
+static void _switch_edge(opt_switch_t *lowering, uint32_t from, uint32_t to)
+{
+    if (to >= lowering->first_new_block) {
+        if (!ir_add_pred(lowering->function, lowering->arena, to, from))
+            lowering->failed = true;
+        return;
+    }
+    if (lowering->edge_count + 2 > lowering->edge_capacity) {
+        uint32_t capacity = lowering->edge_capacity ? lowering->edge_capacity * 2 : 32;
+        uint32_t *edges = realloc(lowering->edges, capacity * sizeof(uint32_t));
+        if (edges == NULL) {
+            lowering->failed = true;
+            return;
+        }
+        lowering->edges = edges;
+        lowering->edge_capacity = capacity;
+    }
+    lowering->edges[lowering->edge_count++] = from;
+    lowering->edges[lowering->edge_count++] = to;
+}
+
+static void _switch_jump(opt_switch_t *lowering, uint32_t from, uint32_t to)
+{
+    _switch_emit(lowering, from, IR_JUMP, IR_VOID, to, 0);
+    _switch_edge(lowering, from, to);
+}
+
+static void _switch_branch(
+    opt_switch_t *lowering, uint32_t from, ir_value_t condition, uint32_t then, uint32_t otherwise)
+{
+    ir_value_t branch = _switch_emit(lowering, from, IR_BRANCH, IR_VOID, condition, then);
+    if (branch != IR_NONE)
+        lowering->function->instrs[branch].c = otherwise;
+    _switch_edge(lowering, from, then);
+    _switch_edge(lowering, from, otherwise);
+}
+
+/*
+ * Splits the sorted cases into runs dispatched together: a bit test when a
+ * run fits in 64 values and reaches few blocks, a jump table when it is
+ * dense enough, otherwise a single comparison. The longer candidate wins.
+ */
+static uint32_t _cluster_cases(
+    const opt_case_t *cases, uint32_t count, opt_cluster_t *clusters)
+{
+    uint32_t cluster_count = 0, i = 0, j;
+    while (i < count) {
+        uint32_t targets[OPT_BIT_TEST_MAX_TARGETS], target_count = 0, bits = 1, table = 0, k;
+
+        for (j = i; j < count && cases[j].value - cases[i].value < 64; j++) {
+            for (k = 0; k < target_count && targets[k] != cases[j].target; k++)
+                ;
+            if (k == target_count && target_count == OPT_BIT_TEST_MAX_TARGETS)
+                break;
+            if (k == target_count)
+                targets[target_count++] = cases[j].target;
+            bits = j - i + 1;
+        }
+        for (j = i; j < count && cases[j].value - cases[i].value < OPT_TABLE_MAX_SIZE; j++)
+            if ((uint64_t) (j - i + 1) * 100
+                >= (cases[j].value - cases[i].value + 1) * OPT_TABLE_MIN_DENSITY)
+                table = j - i + 1;
+
+        opt_cluster_t *cluster = &clusters[cluster_count++];
+        if (bits >= OPT_BIT_TEST_MIN_CASES && bits >= table) {
+            cluster->kind = OPT_CLUSTER_BITS;
+            cluster->count = bits;
+        } else if (table >= OPT_TABLE_MIN_CASES) {
+            cluster->kind = OPT_CLUSTER_TABLE;
+            cluster->count = table;
+        } else {
+            cluster->kind = OPT_CLUSTER_CASE;
+            cluster->count = 1;
+        }
+        cluster->first = i;
+        cluster->low = cases[i].value;
+        cluster->high = cases[i + cluster->count - 1].value;
+        i += cluster->count;
+    }
+    return cluster_count;
+}
+
+/* Rebases the value to the cluster and checks it is in range unless known */
+static ir_value_t _switch_index(
+    opt_switch_t *lowering,
+    const opt_cluster_t *cluster,
+    const opt_bounds_t *bounds,
+    uint32_t *block,
+    uint32_t miss)
+{
+    ir_value_t low = _switch_const(lowering, *block, lowering->type, cluster->low);
+    ir_value_t index = _switch_emit(lowering, *block, IR_SUB, IR_U64, lowering->value, low);
+    if (bounds->has_low && bounds->has_high && _less_equal(lowering, cluster->low, bounds->low)
+        && _less_equal(lowering, bounds->high, cluster->high))
+        return index;
+
+    ir_value_t size = _switch_const(lowering, *block, IR_U64, cluster->high - cluster->low);
+    ir_value_t in_range = _switch_emit(lowering, *block, IR_LE, IR_BOOL, index, size);
+    uint32_t next = _switch_block(lowering);
+    _switch_branch(lowering, *block, in_range, next, miss);
+    *block = next;
+    return index;
+}
+
+static void _emit_cluster(
+    opt_switch_t *lowering,
+    const opt_cluster_t *cluster,
+    const opt_bounds_t *bounds,
+    uint32_t block,
+    uint32_t miss)
+{
+    const opt_case_t *cases = &lowering->cases[cluster->first];
+    ir_function_t *function = lowering->function;
+    uint32_t i, j;
+
+    if (cluster->kind == OPT_CLUSTER_CASE) {
+        if (bounds->has_low && bounds->has_high && bounds->low == cluster->low
+            && bounds->high == cluster->low) {
+            _switch_jump(lowering, block, cases[0].target);
+            return;
+        }
+        ir_value_t label = _switch_const(lowering, block, lowering->type, cluster->low);
+        ir_value_t equal = _switch_emit(lowering, block, IR_EQ, IR_BOOL, lowering->value, label);
+        _switch_branch(lowering, block, equal, cases[0].target, miss);
+        return;
+    }
+
+    ir_value_t index = _switch_index(lowering, cluster, bounds, &block, miss);
+    if (cluster->kind == OPT_CLUSTER_TABLE) {
+        uint32_t size = (uint32_t) (cluster->high - cluster->low) + 1;
+        uint32_t first = ir_add_operands(function, lowering->arena, NULL, size);
+        if (first == UINT32_MAX) {
+            lowering->failed = true;
+            return;
+        }
+        for (i = 0; i < size; i++)
+            function->operands[first + i] = miss;
+        for (i = 0; i < cluster->count; i++) {
+            uint32_t slot = (uint32_t) (cases[i].value - cluster->low);
+            function->operands[first + slot] = cases[i].target;
+        }
+        ir_value_t table = _switch_emit(lowering, block, IR_JUMP_TABLE, IR_VOID, index, first);
+        if (table != IR_NONE)
+            function->instrs[table].c = size;
+        for (i = 0; i < size; i++)
+            _switch_edge(lowering, block, function->operands[first + i]);
+        return;
+    }
+
+    /* One mask per destination, tested with a single bit test each */
+    for (i = 0; i < cluster->count; i++) {
+        uint64_t mask = 0;
+        for (j = 0; j < i && cases[j].target != cases[i].target; j++)
+            ;
+        if (j < i)
+            continue;
+        for (j = i; j < cluster->count; j++)
+            if (cases[j].target == cases[i].target)
+                mask |= (uint64_t) 1 << (cases[j].value - cluster->low);
+        ir_value_t bits = _switch_const(lowering, block, IR_U64, mask);
+        ir_value_t hit = _switch_emit(lowering, block, IR_BIT_TEST, IR_BOOL, index, bits);
+        uint32_t next = miss;
+        for (j = i + 1; j < cluster->count && next == miss; j++) {
+            uint32_t k;
+            for (k = 0; k < j && cases[k].target != cases[j].target; k++)
+                ;
+            if (k == j)
+                next = _switch_block(lowering);
+        }
+        _switch_branch(lowering, block, hit, cases[i].target, next);
+        block = next;
+    }
+}
+
+/* Binary search over the clusters, a short chain once few remain */
+static void _emit_tree(
+    opt_switch_t *lowering,
+    const opt_cluster_t *clusters,
+    uint32_t count,
+    opt_bounds_t bounds,
+    uint32_t block,
+    uint32_t fallback)
+{
+    uint32_t i;
+    if (lowering->failed)
+        return;
+    if (count == 0) {
+        _switch_jump(lowering, block, fallback);
+        return;
+    }
+    if (count <= OPT_SWITCH_CHAIN_CLUSTERS) {
+        for (i = 0; i < count; i++) {
+            uint32_t miss = i + 1 < count ? _switch_block(lowering) : fallback;
+            _emit_cluster(lowering, &clusters[i], &bounds, block, miss);
+            block = miss;
+        }
+        return;
+    }
+
+    uint32_t half = count / 2;
+    uint64_t pivot = clusters[half].low;
+    uint32_t left = _switch_block(lowering);
+    uint32_t right = _switch_block(lowering);
+    ir_value_t limit = _switch_const(lowering, block, lowering->type, pivot);
+    ir_value_t below = _switch_emit(lowering, block, IR_LT, IR_BOOL, lowering->value, limit);
+    _switch_branch(lowering, block, below, left, right);
+
+    opt_bounds_t left_bounds = bounds, right_bounds = bounds;
+    left_bounds.has_high = true;
+    left_bounds.high = pivot - 1;
+    right_bounds.has_low = true;
+    right_bounds.low = pivot;
+    _emit_tree(lowering, clusters, half, left_bounds, left, fallback);
+    _emit_tree(lowering, clusters + half, count - half, right_bounds, right, fallback);
+}
+
+static bool _lower_one_switch(ir_function_t *function, arena_t *arena, uint32_t block)
+{
+    ir_value_t value = ir_terminator(function, block);
+    const ir_instr_t *instr = &function->instrs[value];
+    uint32_t count = instr->c, successor_count = ir_successor_count(function, block), i, j;
+    opt_switch_t lowering;
+    memset(&lowering, 0, sizeof(opt_switch_t));
+
+    opt_case_t *cases = malloc((count ? count : 1) * sizeof(opt_case_t));
+    opt_cluster_t *clusters = malloc((count ? count : 1) * sizeof(opt_cluster_t));
+    uint32_t *targets = malloc(successor_count * sizeof(uint32_t));
+    uint32_t *froms = NULL;
+    bool ok = false;
+    if (cases == NULL || clusters == NULL || targets == NULL)
+        goto done;
+
+    for (i = 0; i < count; i++) {
+        cases[i].value = ir_switch_value(function, instr, i);
+        cases[i].target = ir_switch_target(function, instr, i);
+    }
+    for (i = 0; i < successor_count; i++)
+        targets[i] = ir_successor(function, block, i);
+    lowering.function = function;
+    lowering.arena = arena;
+    lowering.value = instr->a;
+    lowering.type = (ir_type_t) function->instrs[instr->a].type;
+    lowering.cases = cases;
+    lowering.first_new_block = function->block_count;
+    qsort(cases,
+          count,
+          sizeof(opt_case_t),
+          ir_type_signed(lowering.type) ? _compare_signed : _compare_unsigned);
+
+    /* The dispatch code replaces the switch at the end of its block */
+    uint32_t fallback = targets[0];
+    function->instrs[value].op = IR_NOP;
+    function->blocks[block].count--;
+    opt_bounds_t bounds = {0};
+    uint32_t cluster_count = _cluster_cases(cases, count, clusters);
+    _emit_tree(&lowering, clusters, cluster_count, bounds, block, fallback);
+    if (lowering.failed)
+        goto done;
+
+    /* Reconnect every distinct successor with its new predecessors */
+    if ((froms = malloc((lowering.edge_count / 2 + 1) * sizeof(uint32_t))) == NULL)
+        goto done;
+    for (i = 0; i < successor_count; i++) {
+        uint32_t from_count = 0;
+        for (j = 0; j < i && targets[j] != targets[i]; j++)
+            ;
+        if (j < i)
+            continue;
+        for (j = 0; j < lowering.edge_count; j += 2)
+            if (lowering.edges[j + 1] == targets[i])
+                froms[from_count++] = lowering.edges[j];
+        if (!ir_replace_pred(function, arena, targets[i], block, froms, from_count))
+            goto done;
+    }
+    ok = true;
+
+done:
+    free(cases);
+    free(clusters);
+    free(targets);
+    free(froms);
+    free(lowering.edges);
+    return ok;
+}
+
+static void _lower_switches(ir_function_t *function, arena_t *arena)
+{
+    uint32_t count = function->block_count, b;
+    for (b = 0; b < count; b++) {
+        ir_value_t terminator = ir_terminator(function, b);
+        if (terminator != IR_NONE && function->instrs[terminator].op == IR_SWITCH
+            && !_lower_one_switch(function, arena, b)) {
+            function->error = "out of memory";
+            function->error_node = function->declaration;
+            return;
+        }
+    }
+}
+
+/* Driver */
+
+static const opt_pass_t _passes[] = {
+    {"devirt", NULL, _devirtualize},
+    {"inline", NULL, _inline},
+    {"fold", _fold, NULL},
+    {"copyprop", _copyprop, NULL},
+    {"cse", _cse, NULL},
+    {"dce", _dce, NULL},
+    {"switch", _lower_switches, NULL}};
+
+static const opt_pass_t *_find_pass(const char *name, size_t length)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(_passes) / sizeof(_passes[0]); i++)
+        if (strlen(_passes[i].name) == length && !strncmp(_passes[i].name, name, length))
+            return &_passes[i];
+    return NULL;
+}
+
+bool opt_has_pass(const char *name, size_t length)
+{
+    return _find_pass(name, length) != NULL;
+}
+
+static void _pass_task(void *context, uint32_t worker, uint32_t index)
+{
+    opt_job_t *job = context;
+    ir_module_t *module = job->module;
+    ir_function_t *function = &module->functions[index];
+    if (function->error == NULL && function->block_count > 0)
+        job->pass->run_function(function, &module->worker_arenas[worker % module->worker_count]);
+}
+
+static void _run(ir_module_t *module, const opt_pass_t *pass, pool_t *pool)
+{
+    trace_span_t span = trace_begin(pass->name);
+    opt_job_t job = {.module = module, .pass = pass};
+    uint32_t i;
+
+    if (pass->run_module != NULL) {
+        pass->run_module(module);
+    } else if (pool != NULL) {
+        pool_run(pool, "opt_worker", module->function_count, _pass_task, &job);
+    } else {
+        for (i = 0; i < module->function_count; i++)
+            _pass_task(&job, 0, i);
+    }
+    trace_end(&span);
+}
+
+bool opt_run_pass(ir_module_t *module, const char *name, pool_t *pool)
+{
+    const opt_pass_t *pass = _find_pass(name, strlen(name));
+    if (pass == NULL)
+        return false;
+    _run(module, pass, pool);
+    return true;
+}
+
+bool opt_run_passes(ir_module_t *module, const char *passes, pool_t *pool)
+{
+    while (*passes != '\0') {
+        size_t length = strcspn(passes, ",");
+        const opt_pass_t *pass = _find_pass(passes, length);
+        if (length > 0 && pass == NULL)
+            return false;
+        if (pass != NULL)
+            _run(module, pass, pool);
+        passes += length + (passes[length] == ',');
+    }
+    return true;
+}
@@ -0,0 +1,882 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <parser.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARSER_MIN_TOKENS 256
+#define PREFIX_PRECEDENCE 7
+
+typedef struct
+{
+    ast_t *ast;
+    diagnostics_t *diagnostics;
+    uint32_t position;
+    unsigned flags;
+    bool panic;
+    bool failed;
+    /* Stack of child indices collected before being committed to `extra` */
+    uint32_t *scratch;
+    uint32_t scratch_count;
+    uint32_t scratch_capacity;
+} parser_t;
+
+static bool _grow_tokens(ast_t *ast, uint32_t capacity)
+{
+    token_t *tokens = arena_alloc_aligned(ast->arena, capacity * sizeof(token_t), sizeof(size_t));
+    intern_id_t *names = arena_alloc_aligned(
+        ast->arena, capacity * sizeof(intern_id_t), sizeof(intern_id_t));
+    if (tokens == NULL || names == NULL)
+        return false;
+    if (ast->token_count > 0) {
+        memcpy(tokens, ast->tokens, ast->token_count * sizeof(token_t));
+        memcpy(names, ast->names, ast->token_count * sizeof(intern_id_t));
+    }
+    ast->tokens = tokens;
+    ast->names = names;
+    return true;
+}
+
+bool parser_tokenize(ast_t *ast, lexer_t *lexer, diagnostics_t *diagnostics)
+{
+    return parser_tokenize_after(ast, NULL, 0, lexer, diagnostics);
+}
+
+bool parser_tokenize_after(
+    ast_t *ast, const token_t *prefix, uint32_t count, lexer_t *lexer, diagnostics_t *diagnostics)
+{
+    bool ok = true;
+    uint32_t capacity = count + PARSER_MIN_TOKENS, i;
+    token_t token;
+    ast->tokens = NULL;
+    ast->names = NULL;
+    ast->token_count = 0;
+
+    if (!_grow_tokens(ast, capacity))
+        return false;
+    if (count > 0)
+        memcpy(ast->tokens, prefix, count * sizeof(token_t));
+    for (i = 0; i < count; i++) {
+        ast->names[i] = INTERN_NONE;
+        if (prefix[i].type == TOKEN_IDENTIFIER && ast->interner != NULL)
+            ast->names[i] = intern(ast->interner, prefix[i].value, strlen(prefix[i].value));
+    }
+    ast->token_count = count;
+
+    do {
+        token = lexer_next(lexer);
+        if (ast->token_count == capacity) {
+            capacity *= 2;
+            if (!_grow_tokens(ast, capacity))
+                return false;
+        }
+        if (token.type == TOKEN_INVALID) {
+            diagnostics_add(
+                diagnostics, token.line, token.column, "invalid token '%s'", token.value);
+            ok = false;
+        }
+        ast->names[ast->token_count] = INTERN_NONE;
+        if (token.type == TOKEN_IDENTIFIER && ast->interner != NULL)
+            ast->names[ast->token_count] = intern(ast->interner, token.value, strlen(token.value));
+        ast->tokens[ast->token_count++] = token;
+    } while (token.type != TOKEN_EOF);
+
+    return ok;
+}
+
+static const token_t *_peek(parser_t *parser)
+{
+    return &parser->ast->tokens[parser->position];
+}
+
+static token_type_t _peek_type(parser_t *parser)
+{
+    return parser->ast->tokens[parser->position].type;
+}
+
+static uint32_t _advance(parser_t *parser)
+{
+    uint32_t token = parser->position;
+    if (parser->ast->tokens[token].type != TOKEN_EOF)
+        parser->position++;
+    return token;
+}
+
+static bool _match(parser_t *parser, token_type_t type)
+{
+    if (_peek_type(parser) != type)
+        return false;
+    _advance(parser);
+    return true;
+}
+
+static void _error(parser_t *parser, const char *format, ...)
+{
+    parser->failed = true;
+    if (parser->panic)
+        return;
+    parser->panic = true;
+
+    char buffer[128];
+    const token_t *token = _peek(parser);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (token->type == TOKEN_EOF)
+        diagnostics_add(
+            parser->diagnostics, token->line, token->column, "%s, found end of file", buffer);
+    else
+        diagnostics_add(
+            parser->diagnostics,
+            token->line,
+            token->column,
+            "%s, found '%s'",
+            buffer,
+            token->value);
+}
+
+static uint32_t _expect(parser_t *parser, token_type_t type, const char *what)
+{
+    if (_peek_type(parser) == type)
+        return _advance(parser);
+    _error(parser, "expected %s", what);
+    return parser->position;
+}
+
+static void _scratch_push(parser_t *parser, uint32_t value)
+{
+    if (parser->scratch_count == parser->scratch_capacity) {
+        uint32_t capacity = parser->scratch_capacity ? parser->scratch_capacity * 2 : 64;
+        uint32_t *scratch = realloc(parser->scratch, capacity * sizeof(uint32_t));
+        if (scratch == NULL) {
+            parser->failed = true;
+            return;
+        }
+        parser->scratch = scratch;
+        parser->scratch_capacity = capacity;
+    }
+    parser->scratch[parser->scratch_count++] = value;
+}
+
+/* Moves the scratch entries above `top` into `extra` and returns their range. */
+static void _scratch_commit(parser_t *parser, uint32_t top, uint32_t *start, uint32_t *end)
+{
+    *start = ast_add_extra(parser->ast, parser->scratch + top, parser->scratch_count - top);
+    *end = *start + (parser->scratch_count - top);
+    parser->scratch_count = top;
+}
+
+static uint32_t _add_range_record(parser_t *parser, uint32_t top)
+{
+    uint32_t range[2];
+    _scratch_commit(parser, top, &range[0], &range[1]);
+    return ast_add_extra(parser->ast, range, 2);
+}
+
+static ast_index_t _add_node(
+    parser_t *parser, ast_kind_t kind, uint32_t token, ast_index_t lhs, ast_index_t rhs)
+{
+    return ast_add_node(parser->ast, kind, token, lhs, rhs);
+}
+
+static bool _is_statement_start(token_type_t type)
+{
+    switch (type) {
+    case TOKEN_LET:
+    case TOKEN_RETURN:
+    case TOKEN_IF:
+    case TOKEN_FOR:
+    case TOKEN_SWITCH:
+    case TOKEN_BREAK:
+    case TOKEN_CONTINUE:
+    case TOKEN_FALL:
+    case TOKEN_SKIP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool _is_declaration_start(token_type_t type)
+{
+    switch (type) {
+    case TOKEN_FUNCTION:
+    case TOKEN_CLASS:
+    case TOKEN_INTERFACE:
+    case TOKEN_IMPL:
+    case TOKEN_ENUM:
+    case TOKEN_TYPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void _synchronize_statement(parser_t *parser)
+{
+    parser->panic = false;
+    while (1) {
+        token_type_t type = _peek_type(parser);
+        if (type == TOKEN_EOF || type == TOKEN_RIGHT_BRACE || _is_statement_start(type))
+            return;
+        _advance(parser);
+        if (type == TOKEN_SEMICOLON)
+            return;
+    }
+}
+
+static void _synchronize_declaration(parser_t *parser)
+{
+    parser->panic = false;
+    while (_peek_type(parser) != TOKEN_EOF && !_is_declaration_start(_peek_type(parser)))
+        _advance(parser);
+}
+
+/* Types */
+
+static ast_index_t _parse_type(parser_t *parser);
+
+static ast_index_t _parse_function_type(parser_t *parser)
+{
+    uint32_t token = _advance(parser);
+    uint32_t top = parser->scratch_count;
+    uint32_t record[3];
+
+    _expect(parser, TOKEN_LEFT_PAREN, "'('");
+    if (_peek_type(parser) != TOKEN_RIGHT_PAREN) {
+        do {
+            _scratch_push(parser, _parse_type(parser));
+        } while (_match(parser, TOKEN_COMMA));
+    }
+    _expect(parser, TOKEN_RIGHT_PAREN, "')'");
+    _scratch_commit(parser, top, &record[0], &record[1]);
+    record[2] = _match(parser, TOKEN_ARROW) ? _parse_type(parser) : AST_NONE;
+
+    return _add_node(
+        parser, AST_FUNCTION_TYPE, token, ast_add_extra(parser->ast, record, 3), AST_NONE);
+}
+
+static ast_index_t _parse_type(parser_t *parser)
+{
+    switch (_peek_type(parser)) {
+    case TOKEN_I8:
+    case TOKEN_I16:
+    case TOKEN_I32:
+    case TOKEN_I64:
+    case TOKEN_U8:
+    case TOKEN_U16:
+    case TOKEN_U32:
+    case TOKEN_U64:
+    case TOKEN_F32:
+    case TOKEN_F64:
+    case TOKEN_INT:
+    case TOKEN_UINT:
+    case TOKEN_BOOL:
+    case TOKEN_STRING:
+    case TOKEN_IDENTIFIER:
+        return _add_node(parser, AST_TYPE_NAME, _advance(parser), AST_NONE, AST_NONE);
+    case TOKEN_FUNCTION:
+        return _parse_function_type(parser);
+    default:
+        _error(parser, "expected a type");
+        return AST_NONE;
+    }
+}
+
+/* Expressions */
+
+static ast_index_t _parse_expression(parser_t *parser, int min_precedence);
+
+static int _binary_precedence(token_type_t type)
+{
+    switch (type) {
+    case TOKEN_OR:
+        return 1;
+    case TOKEN_AND:
+        return 2;
+    case TOKEN_EQUAL_EQUAL:
+    case TOKEN_NOT_EQUAL:
+        return 3;
+    case TOKEN_LESS_THAN:
+    case TOKEN_GREATER_THAN:
+    case TOKEN_LESS_EQUAL:
+    case TOKEN_GREATER_EQUAL:
+        return 4;
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+        return 5;
+    case TOKEN_STAR:
+    case TOKEN_SLASH:
+    case TOKEN_PERCENT:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static ast_index_t _parse_integer(parser_t *parser)
+{
+    uint32_t token = _advance(parser);
+    const char *digit = parser->ast->tokens[token].value;
+    unsigned long long value = 0;
+
+    for (; *digit; digit++) {
+        unsigned long long next = value * 10 + (unsigned long long) (*digit - '0');
+        if (next / 10 != value) {
+            parser->position = token;
+            _error(parser, "integer literal is too large");
+            parser->position = token + 1;
+            break;
+        }
+        value = next;
+    }
+
+    return _add_node(
+        parser,
+        AST_INTEGER,
+        token,
+        (uint32_t) (value & 0xffffffffu),
+        (uint32_t) (value >> 32));
+}
+
+static ast_index_t _parse_prefix(parser_t *parser)
+{
+    const token_t *token = _peek(parser);
+    uint32_t index;
+    ast_index_t node;
+
+    switch (token->type) {
+    case TOKEN_INTEGER:
+        return _parse_integer(parser);
+    case TOKEN_IDENTIFIER:
+        index = _advance(parser);
+        if (!strcmp(token->value, "true") || !strcmp(token->value, "false"))
+            return _add_node(parser, AST_BOOL, index, token->value[0] == 't', AST_NONE);
+        return _add_node(parser, AST_IDENTIFIER, index, AST_NONE, AST_NONE);
+    case TOKEN_NULL:
+        return _add_node(parser, AST_NULL, _advance(parser), AST_NONE, AST_NONE);
+    case TOKEN_LEFT_PAREN:
+        _advance(parser);
+        node = _parse_expression(parser, 0);
+        _expect(parser, TOKEN_RIGHT_PAREN, "')'");
+        return node;
+    case TOKEN_MINUS:
+    case TOKEN_NOT:
+        index = _advance(parser);
+        node = _add_node(
+            parser, AST_UNARY, index, _parse_expression(parser, PREFIX_PRECEDENCE), AST_NONE);
+        parser->ast->nodes[node].op = (uint8_t) token->type;
+        return node;
+    default:
+        _error(parser, "expected an expression");
+        return AST_NONE;
+    }
+}
+
+static ast_index_t _parse_call(parser_t *parser, ast_index_t callee)
+{
+    uint32_t token = _advance(parser);
+    uint32_t top = parser->scratch_count;
+
+    if (_peek_type(parser) != TOKEN_RIGHT_PAREN) {
+        do {
+            _scratch_push(parser, _parse_expression(parser, 0));
+        } while (_match(parser, TOKEN_COMMA));
+    }
+    _expect(parser, TOKEN_RIGHT_PAREN, "')'");
+
+    return _add_node(parser, AST_CALL, token, callee, _add_range_record(parser, top));
+}
+
+static ast_index_t _parse_expression(parser_t *parser, int min_precedence)
+{
+    ast_index_t lhs = _parse_prefix(parser);
+
+    while (!parser->panic) {
+        token_type_t type = _peek_type(parser);
+        if (type == TOKEN_LEFT_PAREN) {
+            lhs = _parse_call(parser, lhs);
+            continue;
+        }
+        if (type == TOKEN_DOT || type == TOKEN_DOUBLE_COLON) {
+            _advance(parser);
+            uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a member name");
+            lhs = _add_node(parser, type == TOKEN_DOT ? AST_MEMBER : AST_PATH, name, lhs, 0);
+            continue;
+        }
+
+        int precedence = _binary_precedence(type);
+        if (precedence == 0 || precedence <= min_precedence)
+            break;
+        uint32_t token = _advance(parser);
+        ast_index_t rhs = _parse_expression(parser, precedence);
+        lhs = _add_node(parser, AST_BINARY, token, lhs, rhs);
+        parser->ast->nodes[lhs].op = (uint8_t) type;
+    }
+
+    return lhs;
+}
+
+/* Statements */
+
+static ast_index_t _parse_statement(parser_t *parser);
+static ast_index_t _parse_block(parser_t *parser);
+
+static bool _is_assignment(token_type_t type)
+{
+    return type == TOKEN_EQUAL || type == TOKEN_PLUS_EQUAL || type == TOKEN_MINUS_EQUAL
+           || type == TOKEN_STAR_EQUAL || type == TOKEN_SLASH_EQUAL
+           || type == TOKEN_PERCENT_EQUAL;
+}
+
+static ast_index_t _finish_simple_statement(parser_t *parser, ast_index_t expression)
+{
+    token_type_t type = _peek_type(parser);
+    if (_is_assignment(type)) {
+        uint32_t token = _advance(parser);
+        ast_index_t value = _parse_expression(parser, 0);
+        _expect(parser, TOKEN_SEMICOLON, "';'");
+        ast_index_t node = _add_node(parser, AST_ASSIGN, token, expression, value);
+        parser->ast->nodes[node].op = (uint8_t) type;
+        return node;
+    }
+
+    uint32_t token = _expect(parser, TOKEN_SEMICOLON, "';'");
+    return _add_node(parser, AST_EXPR_STMT, token, expression, AST_NONE);
+}
+
+static ast_index_t _parse_let(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a variable name");
+    ast_index_t type = AST_NONE;
+    ast_index_t value = AST_NONE;
+
+    if (_match(parser, TOKEN_COLON))
+        type = _parse_type(parser);
+    if (_match(parser, TOKEN_EQUAL))
+        value = _parse_expression(parser, 0);
+    _expect(parser, TOKEN_SEMICOLON, "';'");
+
+    return _add_node(parser, AST_LET, name, type, value);
+}
+
+static ast_index_t _parse_if(parser_t *parser)
+{
+    uint32_t token = _advance(parser);
+    uint32_t branches[2];
+    ast_index_t condition = _parse_expression(parser, 0);
+
+    branches[0] = _parse_block(parser);
+    branches[1] = AST_NONE;
+    if (_match(parser, TOKEN_ELSE))
+        branches[1] = _peek_type(parser) == TOKEN_IF ? _parse_if(parser) : _parse_block(parser);
+
+    return _add_node(parser, AST_IF, token, condition, ast_add_extra(parser->ast, branches, 2));
+}
+
+static ast_index_t _parse_for(parser_t *parser)
+{
+    uint32_t token = _advance(parser);
+    ast_index_t condition = AST_NONE;
+
+    if (_peek_type(parser) != TOKEN_LEFT_BRACE)
+        condition = _parse_expression(parser, 0);
+
+    return _add_node(parser, AST_FOR, token, condition, _parse_block(parser));
+}
+
+/*
+ * Switch arms have no leading keyword, so an arm body ends at the first
+ * expression followed by ':' or ','. That expression is handed back through
+ * `pending` as the first label of the next arm.
+ */
+static ast_index_t _parse_case(parser_t *parser, ast_index_t *pending)
+{
+    uint32_t token = parser->position;
+    uint32_t top = parser->scratch_count;
+    uint16_t flags = 0;
+
+    if (*pending != AST_NONE) {
+        token = parser->ast->nodes[*pending].token;
+        _scratch_push(parser, *pending);
+        *pending = AST_NONE;
+        while (_match(parser, TOKEN_COMMA))
+            _scratch_push(parser, _parse_expression(parser, 0));
+    } else if (_match(parser, TOKEN_DEFAULT)) {
+        flags = AST_FLAG_DEFAULT;
+    } else {
+        do {
+            _scratch_push(parser, _parse_expression(parser, 0));
+        } while (_match(parser, TOKEN_COMMA));
+    }
+    uint32_t labels = _add_range_record(parser, top);
+    uint32_t colon = _expect(parser, TOKEN_COLON, "':' after switch label");
+
+    top = parser->scratch_count;
+    while (!parser->panic) {
+        token_type_t type = _peek_type(parser);
+        if (type == TOKEN_RIGHT_BRACE || type == TOKEN_EOF || type == TOKEN_DEFAULT)
+            break;
+        if (_is_statement_start(type) || type == TOKEN_LEFT_BRACE) {
+            _scratch_push(parser, _parse_statement(parser));
+            continue;
+        }
+
+        ast_index_t expression = _parse_expression(parser, 0);
+        type = _peek_type(parser);
+        if (type == TOKEN_COLON || type == TOKEN_COMMA) {
+            *pending = expression;
+            break;
+        }
+        _scratch_push(parser, _finish_simple_statement(parser, expression));
+    }
+
+    uint32_t start, end;
+    _scratch_commit(parser, top, &start, &end);
+    ast_index_t body = _add_node(parser, AST_BLOCK, colon, start, end);
+    ast_index_t node = _add_node(parser, AST_CASE, token, labels, body);
+    parser->ast->nodes[node].flags = flags;
+    return node;
+}
+
+static ast_index_t _parse_switch(parser_t *parser)
+{
+    uint32_t token = _advance(parser);
+    ast_index_t value = _parse_expression(parser, 0);
+    ast_index_t pending = AST_NONE;
+    uint32_t top = parser->scratch_count;
+
+    _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    while (!parser->panic && (pending != AST_NONE || _peek_type(parser) != TOKEN_RIGHT_BRACE)
+           && _peek_type(parser) != TOKEN_EOF)
+        _scratch_push(parser, _parse_case(parser, &pending));
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    return _add_node(parser, AST_SWITCH, token, value, _add_range_record(parser, top));
+}
+
+static ast_index_t _parse_statement(parser_t *parser)
+{
+    ast_index_t node;
+    uint32_t token;
+
+    switch (_peek_type(parser)) {
+    case TOKEN_LET:
+        return _parse_let(parser);
+    case TOKEN_RETURN:
+        token = _advance(parser);
+        node = _peek_type(parser) == TOKEN_SEMICOLON ? AST_NONE : _parse_expression(parser, 0);
+        _expect(parser, TOKEN_SEMICOLON, "';'");
+        return _add_node(parser, AST_RETURN, token, node, AST_NONE);
+    case TOKEN_IF:
+        return _parse_if(parser);
+    case TOKEN_FOR:
+        return _parse_for(parser);
+    case TOKEN_SWITCH:
+        return _parse_switch(parser);
+    case TOKEN_BREAK:
+    case TOKEN_CONTINUE:
+    case TOKEN_FALL:
+    case TOKEN_SKIP:
+        token = _advance(parser);
+        _expect(parser, TOKEN_SEMICOLON, "';'");
+        switch (parser->ast->tokens[token].type) {
+        case TOKEN_BREAK:
+            return _add_node(parser, AST_BREAK, token, AST_NONE, AST_NONE);
+        case TOKEN_CONTINUE:
+            return _add_node(parser, AST_CONTINUE, token, AST_NONE, AST_NONE);
+        case TOKEN_FALL:
+            return _add_node(parser, AST_FALL, token, AST_NONE, AST_NONE);
+        default:
+            return _add_node(parser, AST_SKIP, token, AST_NONE, AST_NONE);
+        }
+    case TOKEN_LEFT_BRACE:
+        return _parse_block(parser);
+    default:
+        return _finish_simple_statement(parser, _parse_expression(parser, 0));
+    }
+}
+
+static ast_index_t _parse_block(parser_t *parser)
+{
+    uint32_t token = _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    uint32_t top = parser->scratch_count;
+
+    while (_peek_type(parser) != TOKEN_RIGHT_BRACE && _peek_type(parser) != TOKEN_EOF) {
+        uint32_t before = parser->position;
+        ast_index_t statement = _parse_statement(parser);
+        if (parser->panic) {
+            _synchronize_statement(parser);
+            if (parser->position == before)
+                _advance(parser);
+            continue;
+        }
+        _scratch_push(parser, statement);
+    }
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    uint32_t start, end;
+    _scratch_commit(parser, top, &start, &end);
+    return _add_node(parser, AST_BLOCK, token, start, end);
+}
+
+/* Declarations */
+
+/* Records the body at the current '{' as a token range without parsing it. */
+static ast_index_t _skip_body(parser_t *parser)
+{
+    uint32_t start = _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    uint32_t depth = 1;
+    const token_t *tokens = parser->ast->tokens;
+
+    if (parser->panic)
+        return AST_NONE;
+    while (depth > 0) {
+        token_type_t type = tokens[parser->position].type;
+        if (type == TOKEN_EOF) {
+            parser->position = start;
+            _error(parser, "unterminated function body");
+            return AST_NONE;
+        }
+        depth += type == TOKEN_LEFT_BRACE;
+        depth -= type == TOKEN_RIGHT_BRACE;
+        parser->position++;
+    }
+
+    return _add_node(parser, AST_LAZY_BODY, start, parser->position - 1, AST_NONE);
+}
+
+static ast_index_t _parse_function(parser_t *parser, bool has_body)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a function name");
+    uint32_t top = parser->scratch_count;
+    uint32_t record[3];
+
+    _expect(parser, TOKEN_LEFT_PAREN, "'('");
+    if (_peek_type(parser) != TOKEN_RIGHT_PAREN) {
+        do {
+            uint32_t param = _expect(parser, TOKEN_IDENTIFIER, "a parameter name");
+            _expect(parser, TOKEN_COLON, "':'");
+            _scratch_push(parser, _add_node(parser, AST_PARAM, param, _parse_type(parser), 0));
+        } while (!parser->panic && _match(parser, TOKEN_COMMA));
+    }
+    _expect(parser, TOKEN_RIGHT_PAREN, "')'");
+    _scratch_commit(parser, top, &record[0], &record[1]);
+    record[2] = _match(parser, TOKEN_ARROW) ? _parse_type(parser) : AST_NONE;
+    uint32_t signature = ast_add_extra(parser->ast, record, 3);
+
+    ast_index_t body = AST_NONE;
+    if (has_body && (parser->flags & PARSER_LAZY_BODIES))
+        body = _skip_body(parser);
+    else if (has_body)
+        body = _parse_block(parser);
+    else
+        _expect(parser, TOKEN_SEMICOLON, "';'");
+
+    return _add_node(parser, AST_FUNCTION, name, signature, body);
+}
+
+static ast_index_t _parse_class(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a class name");
+    uint32_t top = parser->scratch_count;
+
+    _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    while (!parser->panic && _peek_type(parser) == TOKEN_IDENTIFIER) {
+        uint32_t field = _advance(parser);
+        _expect(parser, TOKEN_COLON, "':'");
+        ast_index_t type = _parse_type(parser);
+        _expect(parser, TOKEN_SEMICOLON, "';'");
+        _scratch_push(parser, _add_node(parser, AST_FIELD, field, type, AST_NONE));
+    }
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    uint32_t start, end;
+    _scratch_commit(parser, top, &start, &end);
+    return _add_node(parser, AST_CLASS, name, start, end);
+}
+
+static ast_index_t _parse_interface(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "an interface name");
+    uint32_t top = parser->scratch_count;
+
+    _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    while (!parser->panic && _peek_type(parser) == TOKEN_FUNCTION)
+        _scratch_push(parser, _parse_function(parser, false));
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    uint32_t start, end;
+    _scratch_commit(parser, top, &start, &end);
+    return _add_node(parser, AST_INTERFACE, name, start, end);
+}
+
+static ast_index_t _parse_impl(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a class name");
+    uint32_t top = parser->scratch_count;
+    uint32_t record[3] = {AST_NONE, 0, 0};
+
+    if (_match(parser, TOKEN_COLON)) {
+        uint32_t interface = _expect(parser, TOKEN_IDENTIFIER, "an interface name");
+        record[0] = _add_node(parser, AST_TYPE_NAME, interface, AST_NONE, AST_NONE);
+    }
+    _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    while (!parser->panic && _peek_type(parser) == TOKEN_FUNCTION)
+        _scratch_push(parser, _parse_function(parser, true));
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    _scratch_commit(parser, top, &record[1], &record[2]);
+    return _add_node(parser, AST_IMPL, name, ast_add_extra(parser->ast, record, 3), AST_NONE);
+}
+
+static ast_index_t _parse_enum(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "an enum name");
+    uint32_t top = parser->scratch_count;
+
+    _expect(parser, TOKEN_LEFT_BRACE, "'{'");
+    while (!parser->panic && _peek_type(parser) == TOKEN_IDENTIFIER) {
+        uint32_t variant = _advance(parser);
+        _scratch_push(parser, _add_node(parser, AST_ENUM_VARIANT, variant, AST_NONE, AST_NONE));
+        if (!_match(parser, TOKEN_COMMA))
+            break;
+    }
+    _expect(parser, TOKEN_RIGHT_BRACE, "'}'");
+
+    uint32_t start, end;
+    _scratch_commit(parser, top, &start, &end);
+    return _add_node(parser, AST_ENUM, name, start, end);
+}
+
+static ast_index_t _parse_type_alias(parser_t *parser)
+{
+    _advance(parser);
+    uint32_t name = _expect(parser, TOKEN_IDENTIFIER, "a type name");
+    _expect(parser, TOKEN_EQUAL, "'='");
+    ast_index_t type = _parse_type(parser);
+    _expect(parser, TOKEN_SEMICOLON, "';'");
+    return _add_node(parser, AST_TYPE_ALIAS, name, type, AST_NONE);
+}
+
+static ast_index_t _parse_declaration(parser_t *parser)
+{
+    switch (_peek_type(parser)) {
+    case TOKEN_FUNCTION:
+        return _parse_function(parser, true);
+    case TOKEN_CLASS:
+        return _parse_class(parser);
+    case TOKEN_INTERFACE:
+        return _parse_interface(parser);
+    case TOKEN_IMPL:
+        return _parse_impl(parser);
+    case TOKEN_ENUM:
+        return _parse_enum(parser);
+    case TOKEN_TYPE:
+        return _parse_type_alias(parser);
+    case TOKEN_LET:
+        return _parse_let(parser);
+    default:
+        _error(parser, "expected a declaration");
+        return AST_NONE;
+    }
+}
+
+static void _parser_init(parser_t *parser, ast_t *ast, diagnostics_t *diagnostics, unsigned flags)
+{
+    parser->ast = ast;
+    parser->diagnostics = diagnostics;
+    parser->position = 0;
+    parser->flags = flags;
+    parser->panic = false;
+    parser->failed = false;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+}
+
+bool parser_parse(ast_t *ast, diagnostics_t *diagnostics, unsigned flags)
+{
+    parser_t parser;
+    _parser_init(&parser, ast, diagnostics, flags);
+
+    /* Nearly every node owns a distinct token, so this is usually the only allocation */
+    if (!ast_reserve(ast, ast->token_count + 1, ast->token_count))
+        return false;
+
+    uint32_t start, end;
+    while (_peek_type(&parser) != TOKEN_EOF) {
+        uint32_t before = parser.position;
+        ast_index_t declaration = _parse_declaration(&parser);
+        if (parser.panic) {
+            if (parser.position == before)
+                _advance(&parser);
+            _synchronize_declaration(&parser);
+            continue;
+        }
+        _scratch_push(&parser, declaration);
+    }
+    _scratch_commit(&parser, 0, &start, &end);
+    ast->nodes[0].lhs = start;
+    ast->nodes[0].rhs = end;
+
+    free(parser.scratch);
+    return !parser.failed;
+}
+
+ast_index_t parser_parse_body(ast_t *ast, ast_index_t function, diagnostics_t *diagnostics)
+{
+    ast_index_t body = ast->nodes[function].rhs;
+    if (body == AST_NONE || ast->nodes[body].kind != AST_LAZY_BODY)
+        return body;
+
+    parser_t parser;
+    _parser_init(&parser, ast, diagnostics, 0);
+    parser.position = ast->nodes[body].token;
+    body = _parse_block(&parser);
+    free(parser.scratch);
+    if (parser.failed)
+        return AST_NONE;
+
+    ast->nodes[function].rhs = body;
+    return body;
+}
+
+static bool _parse_bodies_in(ast_t *ast, uint32_t start, uint32_t end, diagnostics_t *diagnostics)
+{
+    bool ok = true;
+    uint32_t i;
+    for (i = start; i < end; i++) {
+        ast_index_t function = ast->extra[i];
+        if (ast->nodes[function].kind == AST_FUNCTION
+            && parser_parse_body(ast, function, diagnostics) == AST_NONE
+            && ast->nodes[function].rhs != AST_NONE)
+            ok = false;
+    }
+    return ok;
+}
+
+bool parser_parse_bodies(ast_t *ast, diagnostics_t *diagnostics)
+{
+    bool ok = _parse_bodies_in(ast, ast->nodes[0].lhs, ast->nodes[0].rhs, diagnostics);
+    uint32_t i;
+    for (i = ast->nodes[0].lhs; i < ast->nodes[0].rhs; i++) {
+        const ast_node_t *node = &ast->nodes[ast->extra[i]];
+        if (node->kind == AST_IMPL) {
+            const uint32_t *record = &ast->extra[node->lhs];
+            ok = _parse_bodies_in(ast, record[1], record[2], diagnostics) && ok;
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <pool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+#include <unistd.h>
+
+typedef struct
+{
+    pool_t *pool;
+    uint32_t worker;
+} pool_thread_t;
+
+uint32_t pool_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t) count : 1;
+}
+
+/* Owner side: pops the bottom task. Only races with thieves on the last one. */
+static bool _take(pool_deque_t *deque, uint32_t *task)
+{
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    if (top == bottom) {
+        bool won = __atomic_compare_exchange_n(
+            &deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        if (!won)
+            return false;
+    }
+    *task = (uint32_t) bottom;
+    return true;
+}
+
+/* Thief side: claims the top task. Returns -1 when empty, 0 on a lost race. */
+static int _steal(pool_deque_t *deque, uint32_t *task)
+{
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+        return -1;
+    if (!__atomic_compare_exchange_n(
+            &deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return 0;
+    *task = (uint32_t) top;
+    return 1;
+}
+
+static void _work(pool_t *pool, uint32_t worker)
+{
+    trace_span_t span = trace_begin(pool->name);
+    pool_deque_t *own = &pool->deques[worker];
+    uint32_t task, i;
+
+    while (_take(own, &task))
+        pool->task(pool->context, worker, task);
+
+    /* No task is ever pushed back, so one pass finding every deque empty ends the phase */
+    bool found = true;
+    while (found) {
+        found = false;
+        for (i = 1; i < pool->worker_count; i++) {
+            pool_deque_t *victim = &pool->deques[(worker + i) % pool->worker_count];
+            int stolen;
+            while ((stolen = _steal(victim, &task)) >= 0) {
+                found = true;
+                if (stolen)
+                    pool->task(pool->context, worker, task);
+            }
+        }
+    }
+    trace_end(&span);
+}
+
+static void *_thread_main(void *argument)
+{
+    pool_thread_t *thread = argument;
+    pool_t *pool = thread->pool;
+    uint32_t worker = thread->worker;
+    uint32_t generation = 0;
+    free(thread);
+
+    trace_set_thread(worker);
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == generation && !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stopping)
+            break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        _work(pool, worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+bool pool_init(pool_t *pool, uint32_t worker_count)
+{
+    memset(pool, 0, sizeof(pool_t));
+    pool->worker_count = worker_count ? worker_count : pool_cpu_count();
+    pool->deques = calloc(pool->worker_count, sizeof(pool_deque_t));
+    pool->threads = calloc(pool->worker_count, sizeof(pthread_t));
+    if (pool->deques == NULL || pool->threads == NULL) {
+        free(pool->deques);
+        free(pool->threads);
+        return false;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    uint32_t i;
+    for (i = 1; i < pool->worker_count; i++) {
+        pool_thread_t *thread = malloc(sizeof(pool_thread_t));
+        if (thread != NULL) {
+            thread->pool = pool;
+            thread->worker = i;
+        }
+        if (thread == NULL || pthread_create(&pool->threads[i], NULL, _thread_main, thread)) {
+            free(thread);
+            /* Run with the threads that did start */
+            pool->worker_count = i;
+            break;
+        }
+    }
+    return true;
+}
+
+void pool_run(pool_t *pool, const char *name, uint32_t count, pool_task_t task, void *context)
+{
+    uint32_t workers = pool->worker_count, i;
+    if (count == 0)
+        return;
+    if (workers == 1 || count == 1) {
+        for (i = 0; i < count; i++)
+            task(context, 0, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < workers; i++) {
+        pool->deques[i].top = (int64_t) count * i / workers;
+        pool->deques[i].bottom = (int64_t) count * (i + 1) / workers;
+    }
+    pool->name = name;
+    pool->task = task;
+    pool->context = context;
+    pool->busy = workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    _work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(pool_t *pool)
+{
+    uint32_t i;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 1; i < pool->worker_count; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->deques);
+    free(pool->threads);
+}
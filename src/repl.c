@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <arena.h>
+#include <ast.h>
+#include <ctype.h>
+#include <diagnostic.h>
+#include <lower.h>
+#include <opt.h>
+#include <parser.h>
+#include <reader.h>
+#include <repl.h>
+#include <sema.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPL_PATH "<repl>"
+
+/* Everything one pass of the front end over the session allocates */
+typedef struct
+{
+    arena_t arena;
+    intern_t interner;
+    ast_t ast;
+    diagnostics_t diagnostics;
+    sema_t sema;
+    bool checked;
+} repl_unit_t;
+
+static const char *_keywords[] = {"function", "class", "interface", "impl", "enum", "type", "let"};
+
+/* Spelling of the result types an entry's value is printed for, by type kind */
+static const char *_result_types[] = {
+    [TYPE_BOOL] = "bool",
+    [TYPE_I8] = "i8",
+    [TYPE_I16] = "i16",
+    [TYPE_I32] = "i32",
+    [TYPE_I64] = "i64",
+    [TYPE_U8] = "u8",
+    [TYPE_U16] = "u16",
+    [TYPE_U32] = "u32",
+    [TYPE_U64] = "u64"};
+
+bool repl_init(repl_t *repl, const char *passes)
+{
+    memset(repl, 0, sizeof(repl_t));
+    repl->passes = passes;
+    return jit_init(&repl->jit);
+}
+
+void repl_destroy(repl_t *repl)
+{
+    jit_destroy(&repl->jit);
+    free(repl->tokens);
+    free(repl->text);
+    memset(repl, 0, sizeof(repl_t));
+}
+
+static bool _append(repl_t *repl, const char *text, size_t length)
+{
+    if (repl->length + length + 1 > repl->capacity) {
+        size_t capacity = repl->capacity ? repl->capacity : 4096;
+        while (repl->length + length + 1 > capacity)
+            capacity *= 2;
+        char *grown = realloc(repl->text, capacity);
+        if (grown == NULL)
+            return false;
+        repl->text = grown;
+        repl->capacity = capacity;
+    }
+    memcpy(repl->text + repl->length, text, length);
+    repl->length += length;
+    repl->text[repl->length] = '\0';
+    return true;
+}
+
+static bool _append_string(repl_t *repl, const char *text)
+{
+    return _append(repl, text, strlen(text));
+}
+
+static bool _is_declaration(const char *entry)
+{
+    size_t length = 0, i;
+    while (isalnum((unsigned char) entry[length]) || entry[length] == '_')
+        length++;
+    for (i = 0; i < sizeof(_keywords) / sizeof(_keywords[0]); i++)
+        if (strlen(_keywords[i]) == length && strncmp(_keywords[i], entry, length) == 0)
+            return true;
+    return false;
+}
+
+/* Diagnostics with lines counted from the entry, which starts at `first_line` */
+static void _report(const diagnostics_t *diagnostics, size_t first_line, FILE *err)
+{
+    uint32_t i;
+    for (i = 0; i < diagnostics->count; i++) {
+        const diagnostic_t *diagnostic = &diagnostics->items[i];
+        if (diagnostic->line < first_line)
+            fprintf(err, REPL_PATH ": error: %s\n", diagnostic->message);
+        else
+            fprintf(err, REPL_PATH ":%zu:%zu: error: %s\n", diagnostic->line - first_line + 1,
+                diagnostic->column, diagnostic->message);
+    }
+}
+
+/*
+ * Lexes the entry in `repl->text` after the saved definitions, then parses
+ * and checks them all, leaving the bodies of the saved ones unparsed.
+ */
+static bool _check(repl_t *repl, repl_unit_t *unit)
+{
+    memset(unit, 0, sizeof(repl_unit_t));
+    if (!arena_init(&unit->arena))
+        return false;
+    diagnostics_init(&unit->diagnostics, &unit->arena);
+    if (!intern_init(&unit->interner, &unit->arena)
+        || !ast_init(&unit->ast, &unit->arena, &unit->interner)) {
+        diagnostics_add(&unit->diagnostics, 0, 0, "out of memory");
+        return false;
+    }
+
+    reader_t reader = reader_from_string(repl->text);
+    lexer_t lexer = lexer_init(&reader);
+    lexer.line += repl->line_count;
+    if (!parser_tokenize_after(
+            &unit->ast, repl->tokens, repl->token_count, &lexer, &unit->diagnostics)
+        || !parser_parse(&unit->ast, &unit->diagnostics, PARSER_LAZY_BODIES))
+        return false;
+    if (!sema_init(&unit->sema, &unit->ast, &unit->arena, &unit->diagnostics)) {
+        diagnostics_add(&unit->diagnostics, 0, 0, "out of memory");
+        return false;
+    }
+    unit->checked = true;
+    unit->sema.settled_count = repl->declaration_count;
+    bool declared = sema_declare(&unit->sema);
+    return sema_resolve(&unit->sema) && declared && sema_check(&unit->sema);
+}
+
+/*
+ * Lowers the checked unit and hands its new functions to the JIT. Later
+ * entries may add impls, so devirt must not count on an interface keeping
+ * the only one it has now.
+ */
+static bool _compile(repl_t *repl, repl_unit_t *unit, FILE *err)
+{
+    ir_module_t module;
+    bool ok = ir_module_init(&module, &unit->arena, &unit->ast, 1);
+    module.open = true;
+    ok = ok && lower_module(&module, &unit->sema, NULL, &unit->diagnostics);
+    if (ok) {
+        opt_run_passes(&module, repl->passes, NULL);
+        ok = jit_add_module(&repl->jit, &module);
+        if (!ok)
+            fprintf(err, REPL_PATH ": error: %s\n", repl->jit.error);
+    }
+    ir_module_destroy(&module);
+    return ok;
+}
+
+static void _release(repl_unit_t *unit)
+{
+    if (unit->checked)
+        sema_destroy(&unit->sema);
+    arena_destroy(&unit->arena);
+    memset(unit, 0, sizeof(repl_unit_t));
+}
+
+/* Type of the value of a wrapper whose body is a single expression, TYPE_VOID otherwise */
+static type_id_t _entry_type(const repl_unit_t *unit)
+{
+    const ast_t *ast = &unit->ast;
+    const ast_node_t *root = &ast->nodes[0];
+    const ast_node_t *function = &ast->nodes[ast->extra[root->rhs - 1]];
+    const ast_node_t *body = &ast->nodes[function->rhs];
+    if (body->kind != AST_BLOCK || body->rhs - body->lhs != 1)
+        return TYPE_VOID;
+    const ast_node_t *statement = &ast->nodes[ast->extra[body->lhs]];
+    if (statement->kind != AST_EXPR_STMT)
+        return TYPE_VOID;
+    return unit->sema.node_types[statement->lhs];
+}
+
+static void _print(FILE *out, type_id_t type, uint64_t value)
+{
+    if (type == TYPE_BOOL)
+        fprintf(out, "%s\n", value ? "true" : "false");
+    else if (type >= TYPE_U8)
+        fprintf(out, "%llu\n", (unsigned long long) value);
+    else
+        fprintf(out, "%lld\n", (long long) value);
+}
+
+/* Keeps the tokens of the accepted entry in `unit`, all but its TOKEN_EOF */
+static bool _save(repl_t *repl, const repl_unit_t *unit)
+{
+    const ast_t *ast = &unit->ast;
+    uint32_t count = ast->token_count - 1;
+    if (count > repl->token_capacity) {
+        uint32_t capacity = repl->token_capacity ? repl->token_capacity : 1024;
+        while (count > capacity)
+            capacity *= 2;
+        token_t *tokens = realloc(repl->tokens, capacity * sizeof(token_t));
+        if (tokens == NULL)
+            return false;
+        repl->tokens = tokens;
+        repl->token_capacity = capacity;
+    }
+    memcpy(&repl->tokens[repl->token_count], &ast->tokens[repl->token_count],
+        (count - repl->token_count) * sizeof(token_t));
+    repl->token_count = count;
+    repl->declaration_count = ast->nodes[0].rhs - ast->nodes[0].lhs;
+    return true;
+}
+
+static bool _define(repl_t *repl, const char *entry, size_t length, FILE *err)
+{
+    size_t lines = 1, i;
+    repl_unit_t unit = {0};
+    /* `let` and `type` need a semicolon, which is optional on the last line */
+    bool terminated = entry[length - 1] == ';' || entry[length - 1] == '}';
+    repl->length = 0;
+    if (!_append(repl, entry, length) || !_append_string(repl, terminated ? "\n" : ";\n")) {
+        fprintf(err, REPL_PATH ": error: out of memory\n");
+        return false;
+    }
+
+    bool ok = _check(repl, &unit) && _compile(repl, &unit, err);
+    _report(&unit.diagnostics, repl->line_count + 1, err);
+    if (ok && !_save(repl, &unit)) {
+        fprintf(err, REPL_PATH ": error: out of memory\n");
+        ok = false;
+    }
+    _release(&unit);
+    if (!ok)
+        return false;
+    for (i = 0; i < length; i++)
+        lines += entry[i] == '\n';
+    repl->line_count += lines;
+    return true;
+}
+
+/*
+ * Puts a function `name` around the entry, returning `type` or running the
+ * entry as a statement when `type` is TYPE_VOID.
+ */
+static bool _wrap(repl_t *repl, const char *name, type_id_t type, const char *entry, size_t length)
+{
+    repl->length = 0;
+    bool ok = _append_string(repl, "function ") && _append_string(repl, name);
+    if (type == TYPE_VOID)
+        ok = ok && _append_string(repl, "() {\n") && _append(repl, entry, length)
+             && (entry[length - 1] == '}' || _append_string(repl, ";"));
+    else
+        ok = ok && _append_string(repl, "() -> ") && _append_string(repl, _result_types[type])
+             && _append_string(repl, " {\nreturn ") && _append(repl, entry, length)
+             && _append_string(repl, ";");
+    return ok && _append_string(repl, "\n}\n");
+}
+
+static bool _evaluate(repl_t *repl, const char *entry, size_t length, FILE *out, FILE *err)
+{
+    char name[32];
+    repl_unit_t unit = {0};
+    snprintf(name, sizeof(name), "__repl_%u", repl->entry_count++);
+
+    /* Check it as a statement first to learn the type of its value */
+    bool ok = _wrap(repl, name, TYPE_VOID, entry, length) && _check(repl, &unit);
+    type_id_t type = ok ? _entry_type(&unit) : TYPE_VOID;
+    if (ok && type >= TYPE_BOOL && type <= TYPE_U64) {
+        _release(&unit);
+        ok = _wrap(repl, name, type, entry, length) && _check(repl, &unit);
+    } else {
+        type = TYPE_VOID;
+    }
+    ok = ok && _compile(repl, &unit, err);
+    _report(&unit.diagnostics, repl->line_count + 2, err);
+    _release(&unit);
+
+    uint64_t value = 0;
+    if (ok && !jit_call(&repl->jit, name, &value)) {
+        fprintf(err, REPL_PATH ": error: %s\n", repl->jit.error);
+        return false;
+    }
+    if (ok && type != TYPE_VOID)
+        _print(out, type, value);
+    return ok;
+}
+
+bool repl_eval(repl_t *repl, const char *entry, FILE *out, FILE *err)
+{
+    size_t length;
+    while (isspace((unsigned char) *entry))
+        entry++;
+    length = strlen(entry);
+    while (length > 0 && isspace((unsigned char) entry[length - 1]))
+        length--;
+    if (length == 0)
+        return true;
+    if (_is_declaration(entry))
+        return _define(repl, entry, length, err);
+    /* A trailing semicolon is optional, the wrapper adds its own */
+    if (entry[length - 1] == ';' && --length == 0)
+        return true;
+    return _evaluate(repl, entry, length, out, err);
+}
+
+/* Open braces left after `line`, outside comments */
+static long _depth(const char *line, long depth)
+{
+    for (; *line != '\0' && !(line[0] == '/' && line[1] == '/'); line++)
+        depth += (*line == '{') - (*line == '}');
+    return depth;
+}
+
+void repl_run(repl_t *repl, FILE *in, FILE *out, FILE *err, bool prompt)
+{
+    char *line = NULL, *entry = NULL;
+    size_t capacity = 0, length = 0;
+    long depth = 0;
+    ssize_t read;
+
+    for (;;) {
+        if (prompt) {
+            fputs(length == 0 ? "dash> " : "....> ", out);
+            fflush(out);
+        }
+        if ((read = getline(&line, &capacity, in)) < 0)
+            break;
+        char *grown = realloc(entry, length + (size_t) read + 1);
+        if (grown == NULL) {
+            fprintf(err, REPL_PATH ": error: out of memory\n");
+            break;
+        }
+        entry = grown;
+        memcpy(entry + length, line, (size_t) read + 1);
+        length += (size_t) read;
+        depth = _depth(line, depth);
+        if (depth > 0)
+            continue;
+        repl_eval(repl, entry, out, err);
+        fflush(out);
+        length = 0;
+        depth = 0;
+    }
+    if (length > 0)
+        repl_eval(repl, entry, out, err);
+    if (prompt)
+        fputc('\n', out);
+    free(line);
+    free(entry);
+}
@@ -0,0 +1,1810 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <parser.h>
+#include <sema.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Declaration types that are computed on demand, to detect cycles */
+#define TYPE_UNCHECKED ((type_id_t) -2)
+#define TYPE_PENDING ((type_id_t) -1)
+
+typedef struct
+{
+    sema_t *sema;
+    diagnostics_t *diagnostics;
+    symbols_t *symbols;
+    bool ok;
+} resolver_t;
+
+static void _error_at(
+    diagnostics_t *diagnostics, const ast_t *ast, ast_index_t node, const char *format)
+{
+    const token_t *token = ast_token(ast, node);
+    diagnostics_add(diagnostics, token->line, token->column, format, token->value);
+}
+
+/* Grows a table indexed by node, the new entries being zero */
+static void *_grow_table(sema_t *sema, void *items, size_t element_size, uint32_t capacity)
+{
+    char *grown = arena_grow(sema->arena, items, sema->node_capacity, capacity, element_size);
+    if (grown != NULL)
+        memset(grown + sema->node_capacity * element_size, 0,
+            (capacity - sema->node_capacity) * element_size);
+    return grown;
+}
+
+static bool _ensure_node_tables(sema_t *sema)
+{
+    uint32_t count = sema->ast->node_count;
+    if (count <= sema->node_capacity)
+        return true;
+
+    uint32_t capacity = sema->node_capacity ? sema->node_capacity : 256;
+    while (capacity < count)
+        capacity *= 2;
+    ast_index_t *declarations = _grow_table(
+        sema, sema->declarations, sizeof(ast_index_t), capacity);
+    type_id_t *node_types = _grow_table(sema, sema->node_types, sizeof(type_id_t), capacity);
+    if (declarations == NULL || node_types == NULL)
+        return false;
+
+    sema->declarations = declarations;
+    sema->node_types = node_types;
+    sema->node_capacity = capacity;
+    return true;
+}
+
+bool sema_init(sema_t *sema, ast_t *ast, arena_t *arena, diagnostics_t *diagnostics)
+{
+    memset(sema, 0, sizeof(sema_t));
+    sema->ast = ast;
+    sema->arena = arena;
+    sema->diagnostics = diagnostics;
+    sema->self_name = intern(ast->interner, "self", 4);
+    pthread_mutex_init(&sema->types_lock, NULL);
+    return symbols_init(&sema->globals, arena, NULL) && types_init(&sema->types, arena)
+           && _ensure_node_tables(sema);
+}
+
+void sema_destroy(sema_t *sema)
+{
+    uint32_t i;
+    for (i = 0; i < sema->worker_count; i++)
+        arena_destroy(&sema->workers[i].arena);
+    sema->worker_count = 0;
+    pthread_mutex_destroy(&sema->types_lock);
+}
+
+static bool _declare(
+    sema_t *sema,
+    diagnostics_t *diagnostics,
+    symbols_t *symbols,
+    ast_index_t node,
+    symbol_kind_t kind)
+{
+    symbol_index_t previous = SYMBOL_NONE;
+    intern_id_t name = ast_name(sema->ast, node);
+    if (symbols_declare(symbols, name, kind, node, &previous) != SYMBOL_NONE)
+        return true;
+
+    if (previous == SYMBOL_NONE) {
+        _error_at(diagnostics, sema->ast, node, "out of memory declaring '%s'");
+    } else {
+        const symbol_t *symbol = symbols_get(symbols, previous);
+        const token_t *token = ast_token(sema->ast, node);
+        const char *path, *previous_path;
+        size_t line = ast_token(sema->ast, symbol->declaration)->line;
+        diagnostics_locate(diagnostics, token->line, &path);
+        line = diagnostics_locate(diagnostics, line, &previous_path);
+        if (previous_path != path)
+            diagnostics_add(diagnostics, token->line, token->column,
+                "redefinition of '%s' (previously declared at %s:%zu)", token->value,
+                previous_path, line);
+        else
+            diagnostics_add(diagnostics, token->line, token->column,
+                "redefinition of '%s' (previously declared at line %zu)", token->value, line);
+    }
+    return false;
+}
+
+bool sema_declare(sema_t *sema)
+{
+    const ast_t *ast = sema->ast;
+    bool ok = true;
+    uint32_t i;
+
+    for (i = ast->nodes[0].lhs; i < ast->nodes[0].rhs; i++) {
+        ast_index_t node = ast->extra[i];
+        switch ((ast_kind_t) ast->nodes[node].kind) {
+        case AST_FUNCTION:
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_FUNCTION) && ok;
+            break;
+        case AST_CLASS:
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_CLASS) && ok;
+            break;
+        case AST_INTERFACE:
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_INTERFACE) && ok;
+            break;
+        case AST_ENUM:
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_ENUM) && ok;
+            break;
+        case AST_TYPE_ALIAS:
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_TYPE_ALIAS) && ok;
+            break;
+        case AST_LET:
+            sema->ast->nodes[node].flags |= AST_FLAG_GLOBAL;
+            ok = _declare(sema, sema->diagnostics, &sema->globals, node, SYMBOL_LET) && ok;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return ok;
+}
+
+/* Tasks */
+
+/*
+ * Resolution and checking run one task per top-level declaration or method,
+ * in declaration order. With a pool the tasks run on its workers, each with
+ * its own arena, locals table and diagnostics; the diagnostics are merged
+ * back in task order, so the output does not depend on scheduling.
+ */
+
+typedef bool (*sema_step_t)(
+    sema_t *sema, const sema_task_t *task, diagnostics_t *diagnostics, symbols_t *locals);
+
+typedef struct
+{
+    sema_t *sema;
+    sema_step_t step;
+} sema_job_t;
+
+static bool _add_task(
+    sema_t *sema, ast_index_t node, ast_index_t owner, bool settled, uint32_t *capacity)
+{
+    if (sema->task_count == *capacity) {
+        uint32_t grown_capacity = *capacity ? *capacity * 2 : 64;
+        sema_task_t *tasks = arena_alloc_aligned(
+            sema->arena, grown_capacity * sizeof(sema_task_t), sizeof(uint32_t));
+        if (tasks == NULL)
+            return false;
+        if (sema->task_count > 0)
+            memcpy(tasks, sema->tasks, sema->task_count * sizeof(sema_task_t));
+        sema->tasks = tasks;
+        *capacity = grown_capacity;
+    }
+
+    sema_task_t *task = &sema->tasks[sema->task_count++];
+    memset(task, 0, sizeof(sema_task_t));
+    task->node = node;
+    task->owner = owner;
+    task->settled = settled;
+    return true;
+}
+
+static bool _collect_tasks(sema_t *sema)
+{
+    const ast_t *ast = sema->ast;
+    uint32_t capacity = 0, i, j;
+
+    sema->task_count = 0;
+    for (i = ast->nodes[0].lhs; i < ast->nodes[0].rhs; i++) {
+        ast_index_t node = ast->extra[i];
+        bool settled = i - ast->nodes[0].lhs < sema->settled_count;
+        if (!_add_task(sema, node, AST_NONE, settled, &capacity))
+            return false;
+        if (ast->nodes[node].kind != AST_IMPL)
+            continue;
+        const uint32_t *record = &ast->extra[ast->nodes[node].lhs];
+        for (j = record[1]; j < record[2]; j++)
+            if (!_add_task(sema, ast->extra[j], node, settled, &capacity))
+                return false;
+    }
+    return true;
+}
+
+static bool _ensure_workers(sema_t *sema)
+{
+    uint32_t count = sema->pool->worker_count, i;
+    if (sema->worker_count >= count)
+        return true;
+
+    sema_worker_t *workers = arena_alloc_aligned(
+        sema->arena, count * sizeof(sema_worker_t), sizeof(void *));
+    if (workers == NULL)
+        return false;
+    if (sema->worker_count > 0)
+        memcpy(workers, sema->workers, sema->worker_count * sizeof(sema_worker_t));
+    for (i = sema->worker_count; i < count; i++) {
+        sema_worker_t *worker = &workers[i];
+        if (!arena_init(&worker->arena))
+            return false;
+        diagnostics_init(&worker->diagnostics, &worker->arena);
+        /* Messages naming other lines locate them like the shared diagnostics */
+        worker->diagnostics.sources = sema->diagnostics->sources;
+        worker->diagnostics.source_count = sema->diagnostics->source_count;
+        if (!symbols_init(&worker->locals, &worker->arena, &sema->globals))
+            return false;
+        sema->workers = workers;
+        sema->worker_count = i + 1;
+    }
+    return true;
+}
+
+static void _run_task(void *context, uint32_t worker_index, uint32_t task_index)
+{
+    sema_job_t *job = context;
+    sema_worker_t *worker = &job->sema->workers[worker_index];
+    sema_task_t *task = &job->sema->tasks[task_index];
+
+    task->worker = worker_index;
+    task->first_diagnostic = worker->diagnostics.count;
+    task->ok = job->step(job->sema, task, &worker->diagnostics, &worker->locals);
+    task->diagnostic_count = worker->diagnostics.count - task->first_diagnostic;
+}
+
+static bool _run_tasks(sema_t *sema, const char *name, sema_step_t step)
+{
+    bool ok = true;
+    uint32_t i, j;
+
+    if (sema->pool == NULL || sema->pool->worker_count == 1) {
+        symbols_t locals;
+        if (!symbols_init(&locals, sema->arena, &sema->globals))
+            return false;
+        for (i = 0; i < sema->task_count; i++)
+            ok = step(sema, &sema->tasks[i], sema->diagnostics, &locals) && ok;
+        return ok;
+    }
+
+    if (!_ensure_workers(sema))
+        return false;
+    sema_job_t job = {.sema = sema, .step = step};
+    pool_run(sema->pool, name, sema->task_count, _run_task, &job);
+
+    for (i = 0; i < sema->task_count; i++) {
+        const sema_task_t *task = &sema->tasks[i];
+        const diagnostics_t *diagnostics = &sema->workers[task->worker].diagnostics;
+        for (j = task->first_diagnostic; j < task->first_diagnostic + task->diagnostic_count; j++) {
+            const diagnostic_t *diagnostic = &diagnostics->items[j];
+            diagnostics_add(
+                sema->diagnostics, diagnostic->line, diagnostic->column, "%s", diagnostic->message);
+        }
+        ok = task->ok && ok;
+    }
+    for (i = 0; i < sema->worker_count; i++)
+        sema->workers[i].diagnostics.count = 0;
+    return ok;
+}
+
+/* Resolution */
+
+static void _resolve_node(resolver_t *resolver, ast_index_t node);
+
+static void _resolve_range(resolver_t *resolver, uint32_t start, uint32_t end)
+{
+    uint32_t i;
+    for (i = start; i < end; i++)
+        _resolve_node(resolver, resolver->sema->ast->extra[i]);
+}
+
+static const symbol_t *_lookup(resolver_t *resolver, ast_index_t node)
+{
+    sema_t *sema = resolver->sema;
+    const symbol_t *symbol = symbols_lookup(resolver->symbols, ast_name(sema->ast, node));
+    if (symbol == NULL)
+        return NULL;
+    sema->declarations[node] = symbol->declaration;
+    return symbol;
+}
+
+static void _resolve_type(resolver_t *resolver, ast_index_t node)
+{
+    const ast_t *ast = resolver->sema->ast;
+    const ast_node_t *type = &ast->nodes[node];
+    const symbol_t *symbol;
+
+    if (node == AST_NONE)
+        return;
+    if (type->kind == AST_FUNCTION_TYPE) {
+        const uint32_t *record = &ast->extra[type->lhs];
+        uint32_t i;
+        for (i = record[0]; i < record[1]; i++)
+            _resolve_type(resolver, ast->extra[i]);
+        _resolve_type(resolver, record[2]);
+        return;
+    }
+    if (ast->tokens[type->token].type != TOKEN_IDENTIFIER)
+        return;
+
+    symbol = _lookup(resolver, node);
+    if (symbol == NULL) {
+        _error_at(resolver->diagnostics, ast, node, "unknown type '%s'");
+        resolver->ok = false;
+    } else if (
+        symbol->kind != SYMBOL_CLASS && symbol->kind != SYMBOL_INTERFACE
+        && symbol->kind != SYMBOL_ENUM && symbol->kind != SYMBOL_TYPE_ALIAS) {
+        _error_at(resolver->diagnostics, ast, node, "'%s' is not a type");
+        resolver->ok = false;
+    }
+}
+
+static void _resolve_block(resolver_t *resolver, ast_index_t block)
+{
+    const ast_node_t *node = &resolver->sema->ast->nodes[block];
+    if (!symbols_push_scope(resolver->symbols)) {
+        resolver->ok = false;
+        return;
+    }
+    _resolve_range(resolver, node->lhs, node->rhs);
+    symbols_pop_scope(resolver->symbols);
+}
+
+static void _resolve_node(resolver_t *resolver, ast_index_t index)
+{
+    const ast_t *ast = resolver->sema->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    const uint32_t *record;
+
+    if (index == AST_NONE)
+        return;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_BLOCK:
+        _resolve_block(resolver, index);
+        break;
+    case AST_LET:
+        _resolve_type(resolver, node->lhs);
+        /* The initializer cannot see the binding it initializes */
+        _resolve_node(resolver, node->rhs);
+        if (!_declare(resolver->sema, resolver->diagnostics, resolver->symbols, index, SYMBOL_LET))
+            resolver->ok = false;
+        break;
+    case AST_FIELD:
+        _resolve_type(resolver, node->lhs);
+        break;
+    case AST_RETURN:
+    case AST_EXPR_STMT:
+    case AST_UNARY:
+    case AST_MEMBER:
+    case AST_PATH:
+        _resolve_node(resolver, node->lhs);
+        break;
+    case AST_IF:
+        _resolve_node(resolver, node->lhs);
+        _resolve_node(resolver, ast->extra[node->rhs]);
+        _resolve_node(resolver, ast->extra[node->rhs + 1]);
+        break;
+    case AST_FOR:
+    case AST_ASSIGN:
+    case AST_BINARY:
+        _resolve_node(resolver, node->lhs);
+        _resolve_node(resolver, node->rhs);
+        break;
+    case AST_SWITCH:
+        _resolve_node(resolver, node->lhs);
+        _resolve_range(resolver, ast->extra[node->rhs], ast->extra[node->rhs + 1]);
+        break;
+    case AST_CASE:
+        record = &ast->extra[node->lhs];
+        _resolve_range(resolver, record[0], record[1]);
+        _resolve_node(resolver, node->rhs);
+        break;
+    case AST_CALL:
+        _resolve_node(resolver, node->lhs);
+        _resolve_range(resolver, ast->extra[node->rhs], ast->extra[node->rhs + 1]);
+        break;
+    case AST_IDENTIFIER:
+        if (_lookup(resolver, index) == NULL) {
+            _error_at(resolver->diagnostics, ast, index, "undefined name '%s'");
+            resolver->ok = false;
+        }
+        break;
+    case AST_TYPE_NAME:
+    case AST_FUNCTION_TYPE:
+        _resolve_type(resolver, index);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Resolves the signature of `function`, and its body unless `settled` */
+static void _resolve_function(
+    resolver_t *resolver, ast_index_t function, ast_index_t impl, bool settled)
+{
+    sema_t *sema = resolver->sema;
+    ast_t *ast = sema->ast;
+    const uint32_t *signature = &ast->extra[ast->nodes[function].lhs];
+    uint32_t i;
+
+    ast_index_t body = settled ? AST_NONE
+                               : parser_parse_body(ast, function, resolver->diagnostics);
+    if (!_ensure_node_tables(sema)
+        || (body == AST_NONE && !settled && ast->nodes[function].rhs != AST_NONE)) {
+        resolver->ok = false;
+        return;
+    }
+
+    if (!symbols_push_scope(resolver->symbols)) {
+        resolver->ok = false;
+        return;
+    }
+    if (impl != AST_NONE)
+        symbols_declare(resolver->symbols, sema->self_name, SYMBOL_SELF, impl, NULL);
+    for (i = signature[0]; i < signature[1]; i++) {
+        ast_index_t param = ast->extra[i];
+        _resolve_type(resolver, ast->nodes[param].lhs);
+        if (!_declare(sema, resolver->diagnostics, resolver->symbols, param, SYMBOL_PARAM))
+            resolver->ok = false;
+    }
+    _resolve_type(resolver, signature[2]);
+    if (body != AST_NONE)
+        _resolve_node(resolver, body);
+    symbols_pop_scope(resolver->symbols);
+}
+
+static void _resolve_impl(resolver_t *resolver, ast_index_t impl)
+{
+    const ast_t *ast = resolver->sema->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[impl].lhs];
+    const symbol_t *symbol = _lookup(resolver, impl);
+
+    if (symbol == NULL || symbol->kind != SYMBOL_CLASS) {
+        _error_at(resolver->diagnostics, ast, impl, "'%s' is not a class");
+        resolver->ok = false;
+    }
+    if (record[0] != AST_NONE) {
+        symbol = _lookup(resolver, record[0]);
+        if (symbol == NULL || symbol->kind != SYMBOL_INTERFACE) {
+            _error_at(resolver->diagnostics, ast, record[0], "'%s' is not an interface");
+            resolver->ok = false;
+        }
+    }
+}
+
+static bool _resolve_step(
+    sema_t *sema, const sema_task_t *task, diagnostics_t *diagnostics, symbols_t *locals)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *declaration = &ast->nodes[task->node];
+    uint32_t i;
+
+    resolver_t resolver = {
+        .sema = sema, .diagnostics = diagnostics, .symbols = locals, .ok = true};
+    switch ((ast_kind_t) declaration->kind) {
+    case AST_FUNCTION:
+        _resolve_function(&resolver, task->node, task->owner, task->settled);
+        break;
+    case AST_IMPL:
+        _resolve_impl(&resolver, task->node);
+        break;
+    case AST_CLASS:
+        _resolve_range(&resolver, declaration->lhs, declaration->rhs);
+        break;
+    case AST_INTERFACE:
+        for (i = declaration->lhs; i < declaration->rhs; i++)
+            _resolve_function(&resolver, ast->extra[i], AST_NONE, false);
+        break;
+    case AST_TYPE_ALIAS:
+        _resolve_type(&resolver, declaration->lhs);
+        break;
+    case AST_LET:
+        _resolve_type(&resolver, declaration->lhs);
+        _resolve_node(&resolver, declaration->rhs);
+        break;
+    default:
+        break;
+    }
+    return resolver.ok;
+}
+
+bool sema_resolve(sema_t *sema)
+{
+    bool ok = _collect_tasks(sema);
+
+    /* Bodies grow the AST, so they must all be parsed before running in parallel */
+    if (ok && sema->pool != NULL && sema->pool->worker_count > 1) {
+        ok = parser_parse_bodies(sema->ast, sema->diagnostics);
+        ok = _ensure_node_tables(sema) && ok;
+    }
+    return ok && _run_tasks(sema, "resolve_worker", _resolve_step);
+}
+
+/* Pair maps */
+
+static uint32_t _pair_hash(uint32_t first, uint32_t second)
+{
+    uint32_t hash = first * 0x9e3779b1u;
+    return (hash ^ (hash >> 15) ^ second) * 0x85ebca77u;
+}
+
+uint32_t sema_map_find(const sema_map_t *map, uint32_t first, uint32_t second)
+{
+    if (map->entries == NULL)
+        return 0;
+    uint32_t slot = _pair_hash(first, second) & map->mask;
+    while (map->entries[slot].first != 0) {
+        const sema_entry_t *entry = &map->entries[slot];
+        if (entry->first == first && entry->second == second)
+            return entry->value;
+        slot = (slot + 1) & map->mask;
+    }
+    return 0;
+}
+
+/* Inserts (first, second) -> value unless present; returns the value now in the map. */
+static uint32_t _map_insert(
+    arena_t *arena, sema_map_t *map, uint32_t first, uint32_t second, uint32_t value)
+{
+    if (map->entries == NULL || (map->count + 1) * 2 > map->mask + 1) {
+        uint32_t capacity = map->entries ? (map->mask + 1) * 2 : 64;
+        sema_entry_t *entries = arena_alloc_aligned(
+            arena, capacity * sizeof(sema_entry_t), sizeof(uint32_t));
+        if (entries == NULL)
+            return 0;
+        memset(entries, 0, capacity * sizeof(sema_entry_t));
+
+        uint32_t i;
+        for (i = 0; map->entries != NULL && i <= map->mask; i++) {
+            const sema_entry_t *entry = &map->entries[i];
+            if (entry->first == 0)
+                continue;
+            uint32_t slot = _pair_hash(entry->first, entry->second) & (capacity - 1);
+            while (entries[slot].first != 0)
+                slot = (slot + 1) & (capacity - 1);
+            entries[slot] = *entry;
+        }
+        map->entries = entries;
+        map->mask = capacity - 1;
+    }
+
+    uint32_t slot = _pair_hash(first, second) & map->mask;
+    while (map->entries[slot].first != 0) {
+        const sema_entry_t *entry = &map->entries[slot];
+        if (entry->first == first && entry->second == second)
+            return entry->value;
+        slot = (slot + 1) & map->mask;
+    }
+    map->entries[slot].first = first;
+    map->entries[slot].second = second;
+    map->entries[slot].value = value;
+    map->count++;
+    return value;
+}
+
+/* Type checking */
+
+typedef struct
+{
+    sema_t *sema;
+    diagnostics_t *diagnostics;
+    /* Declared result of the function being checked */
+    type_id_t result;
+    uint32_t loops;
+    bool ok;
+} checker_t;
+
+static void _report(checker_t *checker, ast_index_t node, const char *format, ...)
+{
+    const token_t *token = ast_token(checker->sema->ast, node);
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    diagnostics_add(checker->diagnostics, token->line, token->column, "%s", buffer);
+    checker->ok = false;
+}
+
+static const char *_format(checker_t *checker, type_id_t type, char *buffer, size_t size)
+{
+    types_format(&checker->sema->types, checker->sema->ast, type, buffer, size);
+    return buffer;
+}
+
+static void _report_mismatch(
+    checker_t *checker, ast_index_t node, type_id_t expected, type_id_t actual)
+{
+    char expected_name[96], actual_name[96];
+    _report(
+        checker,
+        node,
+        "expected '%s' but found '%s'",
+        _format(checker, expected, expected_name, sizeof(expected_name)),
+        _format(checker, actual, actual_name, sizeof(actual_name)));
+}
+
+static type_id_t _primitive_type(token_type_t token)
+{
+    switch (token) {
+    case TOKEN_BOOL:
+        return TYPE_BOOL;
+    case TOKEN_I8:
+        return TYPE_I8;
+    case TOKEN_I16:
+        return TYPE_I16;
+    case TOKEN_I32:
+        return TYPE_I32;
+    case TOKEN_I64:
+    case TOKEN_INT:
+        return TYPE_I64;
+    case TOKEN_U8:
+        return TYPE_U8;
+    case TOKEN_U16:
+        return TYPE_U16;
+    case TOKEN_U32:
+        return TYPE_U32;
+    case TOKEN_U64:
+    case TOKEN_UINT:
+        return TYPE_U64;
+    case TOKEN_F32:
+        return TYPE_F32;
+    case TOKEN_F64:
+        return TYPE_F64;
+    case TOKEN_STRING:
+        return TYPE_STRING;
+    default:
+        return TYPE_ERROR;
+    }
+}
+
+static type_id_t _type_of_type_node(checker_t *checker, ast_index_t node);
+
+static type_id_t _alias_type(checker_t *checker, ast_index_t alias)
+{
+    sema_t *sema = checker->sema;
+    type_id_t type = sema->node_types[alias];
+    if (type == TYPE_PENDING) {
+        _report(
+            checker,
+            alias,
+            "type alias '%s' refers to itself",
+            ast_token(sema->ast, alias)->value);
+        sema->node_types[alias] = TYPE_ERROR;
+        return TYPE_ERROR;
+    }
+    if (type != TYPE_UNCHECKED)
+        return type;
+
+    sema->node_types[alias] = TYPE_PENDING;
+    type = _type_of_type_node(checker, sema->ast->nodes[alias].lhs);
+    if (sema->node_types[alias] == TYPE_PENDING)
+        sema->node_types[alias] = type;
+    return sema->node_types[alias];
+}
+
+/* Canonical type spelled by a type node, AST_NONE meaning void. */
+static type_id_t _type_of_type_node(checker_t *checker, ast_index_t node)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const ast_node_t *type = &ast->nodes[node];
+    type_id_t result = TYPE_ERROR;
+
+    if (node == AST_NONE)
+        return TYPE_VOID;
+
+    if (type->kind == AST_FUNCTION_TYPE) {
+        const uint32_t *record = &ast->extra[type->lhs];
+        uint32_t count = record[1] - record[0], i;
+        type_id_t stack_params[16];
+        type_id_t *params = stack_params;
+        if (count > 16 && (params = malloc(count * sizeof(type_id_t))) == NULL)
+            return TYPE_ERROR;
+        for (i = 0; i < count; i++)
+            params[i] = _type_of_type_node(checker, ast->extra[record[0] + i]);
+        type_id_t returned = _type_of_type_node(checker, record[2]);
+        /* Bodies are checked concurrently and may spell new function types */
+        pthread_mutex_lock(&sema->types_lock);
+        result = types_function(&sema->types, params, count, returned);
+        pthread_mutex_unlock(&sema->types_lock);
+        if (params != stack_params)
+            free(params);
+    } else if (ast->tokens[type->token].type != TOKEN_IDENTIFIER) {
+        result = _primitive_type(ast->tokens[type->token].type);
+    } else {
+        ast_index_t declaration = sema->declarations[node];
+        switch ((ast_kind_t) ast->nodes[declaration].kind) {
+        case AST_CLASS:
+        case AST_INTERFACE:
+        case AST_ENUM:
+            result = sema->node_types[declaration];
+            break;
+        case AST_TYPE_ALIAS:
+            result = _alias_type(checker, declaration);
+            break;
+        default:
+            /* Already reported by name resolution */
+            break;
+        }
+    }
+
+    sema->node_types[node] = result;
+    return result;
+}
+
+static bool _implements(const sema_t *sema, type_id_t class_type, type_id_t interface)
+{
+    const type_t *class = types_get(&sema->types, class_type);
+    const type_t *target = types_get(&sema->types, interface);
+    return sema_map_find(&sema->implements, class->operand, target->operand) != 0;
+}
+
+static bool _assignable(const sema_t *sema, type_id_t target, type_id_t value)
+{
+    if (target == value || target == TYPE_ERROR || value == TYPE_ERROR)
+        return true;
+
+    type_kind_t target_kind = types_get(&sema->types, target)->kind;
+    type_kind_t value_kind = types_get(&sema->types, value)->kind;
+    if (value == TYPE_NULL)
+        return target_kind == TYPE_CLASS || target_kind == TYPE_INTERFACE;
+    return target_kind == TYPE_INTERFACE && value_kind == TYPE_CLASS
+           && _implements(sema, value, target);
+}
+
+static bool _expect(checker_t *checker, ast_index_t node, type_id_t expected, type_id_t actual)
+{
+    if (_assignable(checker->sema, expected, actual))
+        return true;
+    _report_mismatch(checker, node, expected, actual);
+    return false;
+}
+
+static type_id_t _check_expression(checker_t *checker, ast_index_t node, type_id_t expected);
+static type_id_t _global_let_type(checker_t *checker, ast_index_t let);
+
+static bool _is_constant(const sema_t *sema, ast_index_t index)
+{
+    const ast_node_t *node = &sema->ast->nodes[index];
+    switch ((ast_kind_t) node->kind) {
+    case AST_INTEGER:
+    case AST_BOOL:
+    case AST_PATH:
+        return true;
+    case AST_UNARY:
+        return _is_constant(sema, node->lhs);
+    case AST_BINARY:
+        return _is_constant(sema, node->lhs) && _is_constant(sema, node->rhs);
+    case AST_IDENTIFIER:
+        return sema->ast->nodes[sema->declarations[index]].kind == AST_LET
+               && (sema->ast->nodes[sema->declarations[index]].flags & AST_FLAG_GLOBAL);
+    default:
+        return false;
+    }
+}
+
+static uint64_t _variant_index(const sema_t *sema, ast_index_t variant)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *enumeration = &ast->nodes[types_get(
+        &sema->types, sema->node_types[variant])->operand];
+    uint32_t i;
+    for (i = enumeration->lhs; i < enumeration->rhs; i++)
+        if (ast->extra[i] == variant)
+            return i - enumeration->lhs;
+    return 0;
+}
+
+static bool _eval_binary(uint8_t op, type_id_t type, uint64_t lhs, uint64_t rhs, uint64_t *value)
+{
+    bool is_signed = type_is_signed(type);
+    switch ((token_type_t) op) {
+    case TOKEN_PLUS:
+        *value = lhs + rhs;
+        break;
+    case TOKEN_MINUS:
+        *value = lhs - rhs;
+        break;
+    case TOKEN_STAR:
+        *value = lhs * rhs;
+        break;
+    case TOKEN_SLASH:
+    case TOKEN_PERCENT:
+        if (rhs == 0)
+            return false;
+        if (is_signed && (int64_t) rhs == -1)
+            *value = op == TOKEN_SLASH ? 0 - lhs : 0;
+        else if (is_signed && op == TOKEN_SLASH)
+            *value = (uint64_t) ((int64_t) lhs / (int64_t) rhs);
+        else if (is_signed)
+            *value = (uint64_t) ((int64_t) lhs % (int64_t) rhs);
+        else
+            *value = op == TOKEN_SLASH ? lhs / rhs : lhs % rhs;
+        break;
+    case TOKEN_EQUAL_EQUAL:
+        *value = lhs == rhs;
+        return true;
+    case TOKEN_NOT_EQUAL:
+        *value = lhs != rhs;
+        return true;
+    case TOKEN_LESS_THAN:
+        *value = is_signed ? (int64_t) lhs < (int64_t) rhs : lhs < rhs;
+        return true;
+    case TOKEN_GREATER_THAN:
+        *value = is_signed ? (int64_t) lhs > (int64_t) rhs : lhs > rhs;
+        return true;
+    case TOKEN_LESS_EQUAL:
+        *value = is_signed ? (int64_t) lhs <= (int64_t) rhs : lhs <= rhs;
+        return true;
+    case TOKEN_GREATER_EQUAL:
+        *value = is_signed ? (int64_t) lhs >= (int64_t) rhs : lhs >= rhs;
+        return true;
+    case TOKEN_AND:
+        *value = lhs && rhs;
+        return true;
+    case TOKEN_OR:
+        *value = lhs || rhs;
+        return true;
+    default:
+        return false;
+    }
+    *value = type_wrap(type, *value);
+    return true;
+}
+
+bool sema_eval_constant(const sema_t *sema, ast_index_t index, uint64_t *value)
+{
+    const ast_node_t *node = &sema->ast->nodes[index];
+    type_id_t type = sema->node_types[index];
+    uint64_t lhs, rhs;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_INTEGER:
+        *value = type_wrap(type, ((uint64_t) node->rhs << 32) | node->lhs);
+        return true;
+    case AST_BOOL:
+        *value = node->lhs != 0;
+        return true;
+    case AST_PATH:
+        *value = _variant_index(sema, sema->declarations[index]);
+        return true;
+    case AST_IDENTIFIER:
+        node = &sema->ast->nodes[sema->declarations[index]];
+        return node->kind == AST_LET && (node->flags & AST_FLAG_GLOBAL)
+               && sema_eval_constant(sema, node->rhs, value);
+    case AST_UNARY:
+        if (!sema_eval_constant(sema, node->lhs, &lhs))
+            return false;
+        *value = node->op == TOKEN_NOT ? !lhs : type_wrap(type, 0 - lhs);
+        return true;
+    case AST_BINARY:
+        if (!sema_eval_constant(sema, node->lhs, &lhs)
+            || !sema_eval_constant(sema, node->rhs, &rhs))
+            return false;
+        return _eval_binary(node->op, sema->node_types[node->lhs], lhs, rhs, value);
+    default:
+        return false;
+    }
+}
+
+static bool _fits(type_id_t type, uint64_t value, bool negated)
+{
+    unsigned bits = type_bits(type);
+    if (type_is_float(type))
+        return true;
+    if (!type_is_signed(type))
+        return !negated && (bits == 64 || value <= (1ull << bits) - 1);
+    uint64_t limit = 1ull << (bits - 1);
+    return negated ? value <= limit : value < limit;
+}
+
+static type_id_t _check_integer(
+    checker_t *checker, ast_index_t index, type_id_t expected, bool negated)
+{
+    const ast_node_t *node = &checker->sema->ast->nodes[index];
+    uint64_t value = ((uint64_t) node->rhs << 32) | node->lhs;
+    type_id_t type = type_is_integer(expected) || type_is_float(expected) ? expected : TYPE_I64;
+    if (!_fits(type, value, negated)) {
+        char name[32];
+        _report(
+            checker,
+            index,
+            "integer literal %s%llu does not fit in '%s'",
+            negated ? "-" : "",
+            (unsigned long long) value,
+            _format(checker, type, name, sizeof(name)));
+    }
+    return type;
+}
+
+static type_id_t _declaration_value_type(checker_t *checker, ast_index_t use)
+{
+    sema_t *sema = checker->sema;
+    ast_index_t declaration = sema->declarations[use];
+    const ast_node_t *node = &sema->ast->nodes[declaration];
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_LET:
+        if (node->flags & AST_FLAG_GLOBAL)
+            return _global_let_type(checker, declaration);
+        return sema->node_types[declaration];
+    case AST_PARAM:
+    case AST_FUNCTION:
+    case AST_IMPL:
+        return sema->node_types[declaration];
+    case AST_ROOT:
+        /* Unresolved, already reported */
+        return TYPE_ERROR;
+    default:
+        _report(checker, use, "'%s' is not a value", ast_token(sema->ast, use)->value);
+        return TYPE_ERROR;
+    }
+}
+
+static ast_index_t _find_member(const ast_t *ast, ast_index_t owner, intern_id_t name)
+{
+    const ast_node_t *node = &ast->nodes[owner];
+    uint32_t i;
+    for (i = node->lhs; i < node->rhs; i++)
+        if (ast_name(ast, ast->extra[i]) == name)
+            return ast->extra[i];
+    return AST_NONE;
+}
+
+static type_id_t _check_member(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    type_id_t object = _check_expression(checker, ast->nodes[index].lhs, TYPE_ERROR);
+    const type_t *type = types_get(&sema->types, object);
+    char name[96];
+
+    if (object == TYPE_ERROR)
+        return TYPE_ERROR;
+    if (type->kind == TYPE_CLASS) {
+        ast_index_t field = _find_member(ast, type->operand, ast_name(ast, index));
+        if (field != AST_NONE) {
+            sema->declarations[index] = field;
+            return sema->node_types[field];
+        }
+    }
+    _report(
+        checker,
+        index,
+        "'%s' has no field '%s'",
+        _format(checker, object, name, sizeof(name)),
+        ast_token(ast, index)->value);
+    return TYPE_ERROR;
+}
+
+static type_id_t _check_path(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    ast_index_t namespace = ast->nodes[index].lhs;
+    ast_index_t declaration = sema->declarations[namespace];
+
+    if (ast->nodes[namespace].kind != AST_IDENTIFIER || declaration == AST_NONE) {
+        if (ast->nodes[namespace].kind != AST_IDENTIFIER)
+            _report(checker, index, "'::' needs an enum on its left");
+        return TYPE_ERROR;
+    }
+    if (ast->nodes[declaration].kind != AST_ENUM) {
+        _report(checker, namespace, "'%s' is not an enum", ast_token(ast, namespace)->value);
+        return TYPE_ERROR;
+    }
+
+    ast_index_t variant = _find_member(ast, declaration, ast_name(ast, index));
+    if (variant == AST_NONE) {
+        _report(
+            checker,
+            index,
+            "'%s' has no variant '%s'",
+            ast_token(ast, namespace)->value,
+            ast_token(ast, index)->value);
+        return TYPE_ERROR;
+    }
+    sema->declarations[index] = variant;
+    return sema->node_types[declaration];
+}
+
+static void _check_arguments(
+    checker_t *checker,
+    ast_index_t call,
+    const type_id_t *params,
+    uint32_t param_count,
+    const char *callee)
+{
+    const ast_t *ast = checker->sema->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[call].rhs];
+    uint32_t count = record[1] - record[0], i;
+
+    if (count != param_count) {
+        _report(
+            checker,
+            call,
+            "'%s' expects %u argument%s but got %u",
+            callee,
+            (unsigned) param_count,
+            param_count == 1 ? "" : "s",
+            (unsigned) count);
+    }
+    for (i = 0; i < count; i++) {
+        ast_index_t argument = ast->extra[record[0] + i];
+        type_id_t expected = i < param_count ? params[i] : TYPE_ERROR;
+        _expect(checker, argument, expected, _check_expression(checker, argument, expected));
+    }
+}
+
+static type_id_t _check_construction(checker_t *checker, ast_index_t call, ast_index_t class)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[class];
+    uint32_t count = node->rhs - node->lhs, i;
+    type_id_t stack_fields[16] = {0};
+    type_id_t *fields = stack_fields;
+
+    if (count > 16 && (fields = malloc(count * sizeof(type_id_t))) == NULL)
+        return TYPE_ERROR;
+    for (i = 0; i < count; i++)
+        fields[i] = sema->node_types[sema->ast->extra[node->lhs + i]];
+    _check_arguments(checker, call, fields, count, ast_token(sema->ast, class)->value);
+    if (fields != stack_fields)
+        free(fields);
+    return sema->node_types[class];
+}
+
+/*
+ * Calls through `object.name(...)` resolve to a method of the object's class
+ * or interface; the callee member node records the chosen function.
+ */
+static bool _method_callee(checker_t *checker, ast_index_t callee, type_id_t *type)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    type_id_t object = _check_expression(checker, ast->nodes[callee].lhs, TYPE_ERROR);
+    const type_t *object_type = types_get(&sema->types, object);
+    ast_index_t method = AST_NONE;
+
+    if (object == TYPE_ERROR) {
+        *type = TYPE_ERROR;
+        return true;
+    }
+    if (object_type->kind == TYPE_CLASS)
+        method = sema_map_find(&sema->methods, object_type->operand, ast_name(ast, callee));
+    else if (object_type->kind == TYPE_INTERFACE)
+        method = _find_member(ast, object_type->operand, ast_name(ast, callee));
+    if (method == AST_NONE)
+        return false;
+
+    sema->declarations[callee] = method;
+    sema->node_types[callee] = sema->node_types[method];
+    *type = sema->node_types[method];
+    return true;
+}
+
+static type_id_t _check_call(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    ast_index_t callee = ast->nodes[index].lhs;
+    const ast_node_t *callee_node = &ast->nodes[callee];
+    type_id_t type;
+
+    if (callee_node->kind == AST_IDENTIFIER
+        && ast->nodes[sema->declarations[callee]].kind == AST_CLASS) {
+        return _check_construction(checker, index, sema->declarations[callee]);
+    }
+    if (callee_node->kind != AST_MEMBER || !_method_callee(checker, callee, &type)) {
+        type = callee_node->kind == AST_MEMBER ? _check_member(checker, callee)
+                                               : _check_expression(checker, callee, TYPE_ERROR);
+        sema->node_types[callee] = type;
+    }
+    if (type == TYPE_ERROR)
+        return TYPE_ERROR;
+
+    const type_t *function = types_get(&sema->types, type);
+    if (function->kind != TYPE_FUNCTION) {
+        char name[96];
+        _report(
+            checker, index, "cannot call a value of type '%s'", _format(checker, type, name, 96));
+        return TYPE_ERROR;
+    }
+    const char *name = callee_node->kind == AST_IDENTIFIER || callee_node->kind == AST_MEMBER
+                           ? ast_token(ast, callee)->value
+                           : "function";
+    _check_arguments(
+        checker, index, types_params(&sema->types, type), function->param_count, name);
+    return function->operand;
+}
+
+static bool _is_arithmetic(type_id_t type)
+{
+    return type_is_integer(type) || type_is_float(type);
+}
+
+static type_id_t _check_unary(checker_t *checker, ast_index_t index, type_id_t expected)
+{
+    const ast_node_t *node = &checker->sema->ast->nodes[index];
+    char name[96];
+
+    if (node->op == TOKEN_NOT) {
+        type_id_t operand = _check_expression(checker, node->lhs, TYPE_BOOL);
+        _expect(checker, node->lhs, TYPE_BOOL, operand);
+        return TYPE_BOOL;
+    }
+
+    type_id_t operand;
+    if (checker->sema->ast->nodes[node->lhs].kind == AST_INTEGER) {
+        operand = _check_integer(checker, node->lhs, expected, true);
+        checker->sema->node_types[node->lhs] = operand;
+    } else {
+        operand = _check_expression(checker, node->lhs, expected);
+    }
+    if (operand != TYPE_ERROR && !(type_is_signed(operand) || type_is_float(operand))) {
+        _report(checker, index, "cannot negate '%s'", _format(checker, operand, name, 96));
+        return TYPE_ERROR;
+    }
+    return operand;
+}
+
+static bool _is_equality(uint8_t op)
+{
+    return op == TOKEN_EQUAL_EQUAL || op == TOKEN_NOT_EQUAL;
+}
+
+static bool _is_comparison(uint8_t op)
+{
+    return _is_equality(op) || op == TOKEN_LESS_THAN || op == TOKEN_GREATER_THAN
+           || op == TOKEN_LESS_EQUAL || op == TOKEN_GREATER_EQUAL;
+}
+
+static bool _is_untyped_literal(const ast_t *ast, ast_index_t index)
+{
+    const ast_node_t *node = &ast->nodes[index];
+    if (node->kind == AST_UNARY && node->op == TOKEN_MINUS)
+        node = &ast->nodes[node->lhs];
+    return node->kind == AST_INTEGER || node->kind == AST_NULL;
+}
+
+static type_id_t _check_binary(checker_t *checker, ast_index_t index, type_id_t expected)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[index];
+    uint8_t op = node->op;
+    type_id_t lhs, rhs;
+    char lhs_name[96], rhs_name[96];
+
+    if (op == TOKEN_AND || op == TOKEN_OR) {
+        _expect(checker, node->lhs, TYPE_BOOL, _check_expression(checker, node->lhs, TYPE_BOOL));
+        _expect(checker, node->rhs, TYPE_BOOL, _check_expression(checker, node->rhs, TYPE_BOOL));
+        return TYPE_BOOL;
+    }
+
+    /* Literals take their type from the other operand, so `1 + x` checks x first */
+    type_id_t hint = _is_comparison(op) ? TYPE_ERROR : expected;
+    if (_is_untyped_literal(sema->ast, node->lhs) && !_is_untyped_literal(sema->ast, node->rhs)) {
+        rhs = _check_expression(checker, node->rhs, hint);
+        lhs = _check_expression(checker, node->lhs, rhs);
+    } else {
+        lhs = _check_expression(checker, node->lhs, hint);
+        rhs = _check_expression(checker, node->rhs, lhs);
+    }
+    if (lhs == TYPE_ERROR || rhs == TYPE_ERROR)
+        return _is_comparison(op) ? TYPE_BOOL : TYPE_ERROR;
+
+    type_kind_t kind = types_get(&sema->types, lhs)->kind;
+    bool valid;
+    if (_is_equality(op))
+        valid = _assignable(sema, lhs, rhs) || _assignable(sema, rhs, lhs);
+    else if (_is_comparison(op))
+        valid = lhs == rhs && (_is_arithmetic(lhs) || kind == TYPE_ENUM);
+    else
+        valid = lhs == rhs && _is_arithmetic(lhs) && !(op == TOKEN_PERCENT && type_is_float(lhs));
+
+    if (!valid) {
+        _report(
+            checker,
+            index,
+            "invalid operands to '%s' ('%s' and '%s')",
+            ast_token(sema->ast, index)->value,
+            _format(checker, lhs, lhs_name, sizeof(lhs_name)),
+            _format(checker, rhs, rhs_name, sizeof(rhs_name)));
+    }
+    if (_is_comparison(op))
+        return TYPE_BOOL;
+    return valid ? lhs : TYPE_ERROR;
+}
+
+static bool _is_assignable_place(const sema_t *sema, ast_index_t index)
+{
+    const ast_node_t *node = &sema->ast->nodes[index];
+    if (node->kind == AST_MEMBER)
+        return sema->ast->nodes[sema->declarations[index]].kind == AST_FIELD;
+    if (node->kind != AST_IDENTIFIER)
+        return false;
+
+    const ast_node_t *declaration = &sema->ast->nodes[sema->declarations[index]];
+    return declaration->kind == AST_PARAM
+           || (declaration->kind == AST_LET && !(declaration->flags & AST_FLAG_GLOBAL));
+}
+
+static void _check_assign(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[index];
+    type_id_t target = _check_expression(checker, node->lhs, TYPE_ERROR);
+    type_id_t value = _check_expression(checker, node->rhs, target);
+    char name[96];
+
+    if (target == TYPE_ERROR)
+        return;
+    if (!_is_assignable_place(sema, node->lhs)) {
+        _report(checker, node->lhs, "cannot assign to this expression");
+    } else if (node->op != TOKEN_EQUAL) {
+        if (target != value || !_is_arithmetic(target)
+            || (node->op == TOKEN_PERCENT_EQUAL && type_is_float(target))) {
+            _report(
+                checker,
+                index,
+                "invalid compound assignment to '%s'",
+                _format(checker, target, name, sizeof(name)));
+        }
+    } else {
+        _expect(checker, node->rhs, target, value);
+    }
+}
+
+static type_id_t _check_expression(checker_t *checker, ast_index_t index, type_id_t expected)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[index];
+    type_id_t type = TYPE_ERROR;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_INTEGER:
+        type = _check_integer(checker, index, expected, false);
+        break;
+    case AST_BOOL:
+        type = TYPE_BOOL;
+        break;
+    case AST_NULL:
+        type = TYPE_NULL;
+        break;
+    case AST_IDENTIFIER:
+        type = _declaration_value_type(checker, index);
+        break;
+    case AST_MEMBER:
+        type = _check_member(checker, index);
+        break;
+    case AST_PATH:
+        type = _check_path(checker, index);
+        break;
+    case AST_CALL:
+        type = _check_call(checker, index);
+        break;
+    case AST_UNARY:
+        type = _check_unary(checker, index, expected);
+        break;
+    case AST_BINARY:
+        type = _check_binary(checker, index, expected);
+        break;
+    default:
+        break;
+    }
+
+    sema->node_types[index] = type;
+    return type;
+}
+
+static type_id_t _global_let_type(checker_t *checker, ast_index_t let)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[let];
+    type_id_t type = sema->node_types[let];
+
+    if (type == TYPE_PENDING) {
+        _report(
+            checker, let, "'%s' is defined in terms of itself", ast_token(sema->ast, let)->value);
+        sema->node_types[let] = TYPE_ERROR;
+        return TYPE_ERROR;
+    }
+    if (type != TYPE_UNCHECKED)
+        return type;
+
+    sema->node_types[let] = TYPE_PENDING;
+    type_id_t declared = node->lhs != AST_NONE ? _type_of_type_node(checker, node->lhs)
+                                                : TYPE_ERROR;
+    if (node->rhs == AST_NONE) {
+        _report(checker, let, "global '%s' needs an initializer", ast_token(sema->ast, let)->value);
+        type = declared;
+    } else {
+        type_id_t value = _check_expression(checker, node->rhs, declared);
+        if (node->lhs != AST_NONE)
+            _expect(checker, node->rhs, declared, value);
+        type = node->lhs != AST_NONE ? declared : value;
+        if (value != TYPE_ERROR && !_is_constant(sema, node->rhs))
+            _report(checker, node->rhs, "global initializer must be a constant expression");
+    }
+
+    if (sema->node_types[let] == TYPE_PENDING)
+        sema->node_types[let] = type == TYPE_NULL ? TYPE_ERROR : type;
+    return sema->node_types[let];
+}
+
+/* Statements */
+
+static void _check_statement(checker_t *checker, ast_index_t index);
+
+static void _check_range(checker_t *checker, uint32_t start, uint32_t end)
+{
+    uint32_t i;
+    for (i = start; i < end; i++)
+        _check_statement(checker, checker->sema->ast->extra[i]);
+}
+
+static void _check_condition(checker_t *checker, ast_index_t condition)
+{
+    _expect(checker, condition, TYPE_BOOL, _check_expression(checker, condition, TYPE_BOOL));
+}
+
+static void _check_local_let(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[index];
+    type_id_t type = node->lhs != AST_NONE ? _type_of_type_node(checker, node->lhs) : TYPE_ERROR;
+
+    if (node->rhs != AST_NONE) {
+        type_id_t value = _check_expression(checker, node->rhs, type);
+        if (node->lhs != AST_NONE) {
+            _expect(checker, node->rhs, type, value);
+        } else if (value == TYPE_NULL || value == TYPE_VOID) {
+            _report(
+                checker,
+                node->rhs,
+                "cannot infer the type of '%s'",
+                ast_token(sema->ast, index)->value);
+        } else {
+            type = value;
+        }
+    } else if (node->lhs == AST_NONE) {
+        _report(
+            checker,
+            index,
+            "'%s' needs a type or an initializer",
+            ast_token(sema->ast, index)->value);
+    }
+    sema->node_types[index] = type;
+}
+
+static int _compare_labels(const void *a, const void *b)
+{
+    uint64_t lhs = ((const uint64_t *) a)[0], rhs = ((const uint64_t *) b)[0];
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static void _check_switch(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    const uint32_t *cases = &ast->extra[node->rhs];
+    uint32_t label_count = 0, value_count = 0, i, j;
+    bool has_default = false;
+    char name[96];
+
+    type_id_t value = _check_expression(checker, node->lhs, TYPE_ERROR);
+    type_kind_t kind = types_get(&sema->types, value)->kind;
+    if (value != TYPE_ERROR && !type_is_integer(value) && kind != TYPE_ENUM && value != TYPE_BOOL) {
+        _report(checker, node->lhs, "cannot switch on '%s'", _format(checker, value, name, 96));
+        value = TYPE_ERROR;
+    }
+
+    for (i = cases[0]; i < cases[1]; i++) {
+        const ast_node_t *arm = &ast->nodes[ast->extra[i]];
+        label_count += ast->extra[arm->lhs + 1] - ast->extra[arm->lhs];
+    }
+
+    /* (value, label node) pairs, sorted to find duplicates */
+    uint64_t *labels = label_count > 0 ? malloc(label_count * 2 * sizeof(uint64_t)) : NULL;
+    for (i = cases[0]; i < cases[1]; i++) {
+        ast_index_t arm_index = ast->extra[i];
+        const ast_node_t *arm = &ast->nodes[arm_index];
+        const uint32_t *record = &ast->extra[arm->lhs];
+
+        if (arm->flags & AST_FLAG_DEFAULT) {
+            if (has_default)
+                _report(checker, arm_index, "multiple default cases in switch");
+            has_default = true;
+        }
+        for (j = record[0]; j < record[1]; j++) {
+            ast_index_t label = ast->extra[j];
+            type_id_t type = _check_expression(checker, label, value);
+            uint64_t constant;
+            if (!_expect(checker, label, value, type) || type == TYPE_ERROR)
+                continue;
+            if (!_is_constant(sema, label)) {
+                _report(checker, label, "case label must be a constant expression");
+            } else if (!sema_eval_constant(sema, label, &constant)) {
+                _report(checker, label, "case label is not a valid constant");
+            } else if (labels != NULL) {
+                labels[value_count * 2] = constant;
+                labels[value_count * 2 + 1] = label;
+                value_count++;
+            }
+        }
+
+        /* A trailing `fall` continues into the next case */
+        const ast_node_t *body = &ast->nodes[arm->rhs];
+        uint32_t end = body->rhs;
+        if (body->lhs < end && ast->nodes[ast->extra[end - 1]].kind == AST_FALL) {
+            if (i + 1 == cases[1])
+                _report(checker, ast->extra[end - 1], "'fall' in the last case of a switch");
+            end--;
+        }
+        _check_range(checker, body->lhs, end);
+    }
+
+    if (labels != NULL) {
+        qsort(labels, value_count, 2 * sizeof(uint64_t), _compare_labels);
+        for (i = 1; i < value_count; i++)
+            if (labels[i * 2] == labels[(i - 1) * 2])
+                _report(checker, (ast_index_t) labels[i * 2 + 1], "duplicate case label");
+        free(labels);
+    }
+}
+
+static void _check_statement(checker_t *checker, ast_index_t index)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const ast_node_t *node = &ast->nodes[index];
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_BLOCK:
+        _check_range(checker, node->lhs, node->rhs);
+        break;
+    case AST_LET:
+        _check_local_let(checker, index);
+        break;
+    case AST_RETURN:
+        if (node->lhs == AST_NONE) {
+            if (checker->result != TYPE_VOID && checker->result != TYPE_ERROR)
+                _report(checker, index, "missing return value");
+        } else if (checker->result == TYPE_VOID) {
+            _check_expression(checker, node->lhs, TYPE_ERROR);
+            _report(checker, node->lhs, "returning a value from a function without a result");
+        } else {
+            _expect(
+                checker,
+                node->lhs,
+                checker->result,
+                _check_expression(checker, node->lhs, checker->result));
+        }
+        break;
+    case AST_IF:
+        _check_condition(checker, node->lhs);
+        _check_statement(checker, ast->extra[node->rhs]);
+        if (ast->extra[node->rhs + 1] != AST_NONE)
+            _check_statement(checker, ast->extra[node->rhs + 1]);
+        break;
+    case AST_FOR:
+        if (node->lhs != AST_NONE)
+            _check_condition(checker, node->lhs);
+        checker->loops++;
+        _check_statement(checker, node->rhs);
+        checker->loops--;
+        break;
+    case AST_SWITCH:
+        _check_switch(checker, index);
+        break;
+    case AST_BREAK:
+    case AST_CONTINUE:
+        if (checker->loops == 0)
+            _report(checker, index, "'%s' outside of a loop", ast_kind_name(node->kind));
+        break;
+    case AST_FALL:
+        _report(checker, index, "'fall' must be the last statement of a switch case");
+        break;
+    case AST_EXPR_STMT:
+        _check_expression(checker, node->lhs, TYPE_ERROR);
+        break;
+    case AST_ASSIGN:
+        _check_assign(checker, index);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Whether a `break` inside `index` exits the loop whose body it is */
+static bool _contains_break(const sema_t *sema, ast_index_t index)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    uint32_t i;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_BREAK:
+        return true;
+    case AST_BLOCK:
+        for (i = node->lhs; i < node->rhs; i++)
+            if (_contains_break(sema, ast->extra[i]))
+                return true;
+        return false;
+    case AST_IF:
+        return _contains_break(sema, ast->extra[node->rhs])
+               || (ast->extra[node->rhs + 1] != AST_NONE
+                   && _contains_break(sema, ast->extra[node->rhs + 1]));
+    case AST_SWITCH:
+        for (i = ast->extra[node->rhs]; i < ast->extra[node->rhs + 1]; i++)
+            if (_contains_break(sema, ast->nodes[ast->extra[i]].rhs))
+                return true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+/* Whether control can never reach the end of `index` */
+static bool _terminates(const sema_t *sema, ast_index_t index)
+{
+    const ast_t *ast = sema->ast;
+    const ast_node_t *node = &ast->nodes[index];
+    uint32_t i;
+
+    switch ((ast_kind_t) node->kind) {
+    case AST_RETURN:
+        return true;
+    case AST_BLOCK:
+        for (i = node->lhs; i < node->rhs; i++)
+            if (_terminates(sema, ast->extra[i]))
+                return true;
+        return false;
+    case AST_IF:
+        return ast->extra[node->rhs + 1] != AST_NONE && _terminates(sema, ast->extra[node->rhs])
+               && _terminates(sema, ast->extra[node->rhs + 1]);
+    case AST_FOR:
+        /* Only an unconditional loop without a break never falls through */
+        return node->lhs == AST_NONE && !_contains_break(sema, node->rhs);
+    case AST_SWITCH: {
+        const uint32_t *cases = &ast->extra[node->rhs];
+        bool has_default = false;
+        for (i = cases[0]; i < cases[1]; i++) {
+            const ast_node_t *arm = &ast->nodes[ast->extra[i]];
+            const ast_node_t *body = &ast->nodes[arm->rhs];
+            bool falls = body->lhs < body->rhs
+                         && ast->nodes[ast->extra[body->rhs - 1]].kind == AST_FALL;
+            has_default = has_default || (arm->flags & AST_FLAG_DEFAULT);
+            if (!falls && !_terminates(sema, arm->rhs))
+                return false;
+        }
+        return has_default;
+    }
+    default:
+        return false;
+    }
+}
+
+static void _check_function(checker_t *checker, ast_index_t function)
+{
+    sema_t *sema = checker->sema;
+    const ast_node_t *node = &sema->ast->nodes[function];
+    if (node->rhs == AST_NONE || sema->node_types[function] == TYPE_ERROR)
+        return;
+
+    checker->result = types_get(&sema->types, sema->node_types[function])->operand;
+    checker->loops = 0;
+    _check_statement(checker, node->rhs);
+    if (checker->result != TYPE_VOID && checker->result != TYPE_ERROR
+        && !_terminates(sema, node->rhs)) {
+        _report(
+            checker,
+            function,
+            "function '%s' does not return a value on every path",
+            ast_token(sema->ast, function)->value);
+    }
+}
+
+/* Declarations */
+
+static void _declare_signature(checker_t *checker, ast_index_t function)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[function].lhs];
+    uint32_t count = record[1] - record[0], i;
+    type_id_t stack_params[16];
+    type_id_t *params = stack_params;
+
+    if (count > 16 && (params = malloc(count * sizeof(type_id_t))) == NULL) {
+        checker->ok = false;
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        ast_index_t param = ast->extra[record[0] + i];
+        params[i] = _type_of_type_node(checker, ast->nodes[param].lhs);
+        sema->node_types[param] = params[i];
+    }
+    type_id_t result = _type_of_type_node(checker, record[2]);
+    sema->node_types[function] = types_function(&sema->types, params, count, result);
+    if (params != stack_params)
+        free(params);
+}
+
+static void _check_impl(checker_t *checker, ast_index_t impl)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const uint32_t *record = &ast->extra[ast->nodes[impl].lhs];
+    ast_index_t class = sema->declarations[impl];
+    ast_index_t interface = record[0] != AST_NONE ? sema->declarations[record[0]] : AST_NONE;
+    uint32_t i;
+
+    if (ast->nodes[class].kind != AST_CLASS)
+        return;
+    sema->node_types[impl] = sema->node_types[class];
+
+    for (i = record[1]; i < record[2]; i++) {
+        ast_index_t method = ast->extra[i];
+        _declare_signature(checker, method);
+        ast_index_t existing = _map_insert(
+            sema->arena, &sema->methods, class, ast_name(ast, method), method);
+        if (existing == 0) {
+            checker->ok = false;
+        } else if (existing != method) {
+            _report(
+                checker,
+                method,
+                "'%s' already has a method '%s'",
+                ast_token(ast, class)->value,
+                ast_token(ast, method)->value);
+        }
+    }
+
+    if (interface == AST_NONE || ast->nodes[interface].kind != AST_INTERFACE)
+        return;
+    if (_map_insert(sema->arena, &sema->implements, class, interface, impl) != impl) {
+        _report(
+            checker,
+            impl,
+            "'%s' already implements '%s'",
+            ast_token(ast, impl)->value,
+            ast_token(ast, record[0])->value);
+        return;
+    }
+
+    /* Signatures are hash-consed, so conformance is one compare per method */
+    const ast_node_t *node = &ast->nodes[interface];
+    for (i = node->lhs; i < node->rhs; i++) {
+        ast_index_t required = ast->extra[i];
+        ast_index_t method = sema_map_find(&sema->methods, class, ast_name(ast, required));
+        char expected[96];
+        if (method == AST_NONE) {
+            _report(
+                checker,
+                impl,
+                "'%s' does not implement '%s' required by '%s'",
+                ast_token(ast, impl)->value,
+                ast_token(ast, required)->value,
+                ast_token(ast, record[0])->value);
+        } else if (sema->node_types[method] != sema->node_types[required]) {
+            _report(
+                checker,
+                method,
+                "'%s' should have type '%s' to implement '%s'",
+                ast_token(ast, method)->value,
+                _format(checker, sema->node_types[required], expected, sizeof(expected)),
+                ast_token(ast, record[0])->value);
+        }
+    }
+}
+
+static void _check_declarations(checker_t *checker)
+{
+    sema_t *sema = checker->sema;
+    const ast_t *ast = sema->ast;
+    const ast_node_t *root = &ast->nodes[0];
+    uint32_t i, j;
+
+    /* Nominal types first, so every later declaration can refer to any of them */
+    for (i = root->lhs; i < root->rhs; i++) {
+        ast_index_t index = ast->extra[i];
+        const ast_node_t *node = &ast->nodes[index];
+        switch ((ast_kind_t) node->kind) {
+        case AST_CLASS:
+            sema->node_types[index] = types_nominal(&sema->types, TYPE_CLASS, index);
+            break;
+        case AST_INTERFACE:
+            sema->node_types[index] = types_nominal(&sema->types, TYPE_INTERFACE, index);
+            break;
+        case AST_ENUM:
+            sema->node_types[index] = types_nominal(&sema->types, TYPE_ENUM, index);
+            for (j = node->lhs; j < node->rhs; j++)
+                sema->node_types[ast->extra[j]] = sema->node_types[index];
+            break;
+        case AST_TYPE_ALIAS:
+        case AST_LET:
+            sema->node_types[index] = TYPE_UNCHECKED;
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (i = root->lhs; i < root->rhs; i++) {
+        ast_index_t index = ast->extra[i];
+        const ast_node_t *node = &ast->nodes[index];
+        switch ((ast_kind_t) node->kind) {
+        case AST_TYPE_ALIAS:
+            _alias_type(checker, index);
+            break;
+        case AST_CLASS:
+            for (j = node->lhs; j < node->rhs; j++) {
+                ast_index_t field = ast->extra[j];
+                sema->node_types[field] = _type_of_type_node(checker, ast->nodes[field].lhs);
+            }
+            break;
+        case AST_INTERFACE:
+            for (j = node->lhs; j < node->rhs; j++)
+                _declare_signature(checker, ast->extra[j]);
+            break;
+        case AST_FUNCTION:
+            _declare_signature(checker, index);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* Impls need every interface signature, global lets may call nothing but see everything */
+    for (i = root->lhs; i < root->rhs; i++) {
+        ast_index_t index = ast->extra[i];
+        if (ast->nodes[index].kind == AST_IMPL)
+            _check_impl(checker, index);
+    }
+    for (i = root->lhs; i < root->rhs; i++) {
+        ast_index_t index = ast->extra[i];
+        if (ast->nodes[index].kind == AST_LET)
+            _global_let_type(checker, index);
+    }
+}
+
+static bool _check_step(
+    sema_t *sema, const sema_task_t *task, diagnostics_t *diagnostics, symbols_t *locals)
+{
+    checker_t checker = {.sema = sema, .diagnostics = diagnostics, .ok = true};
+    (void) locals;
+    if (sema->ast->nodes[task->node].kind == AST_FUNCTION && !task->settled)
+        _check_function(&checker, task->node);
+    return checker.ok;
+}
+
+/*
+ * Bodies spell function types while other workers read the type tables, so
+ * the tables get room up front for every function type the tree could add.
+ * Interning then never moves them, and only needs `types_lock`.
+ */
+static bool _reserve_body_types(sema_t *sema)
+{
+    const ast_t *ast = sema->ast;
+    uint32_t types = 0, params = 0, i;
+    for (i = 1; i < ast->node_count; i++) {
+        const ast_node_t *node = &ast->nodes[i];
+        if (node->kind != AST_FUNCTION_TYPE)
+            continue;
+        types++;
+        params += ast->extra[node->lhs + 1] - ast->extra[node->lhs];
+    }
+    return types_reserve(&sema->types, types, params);
+}
+
+bool sema_check(sema_t *sema)
+{
+    if (!_ensure_node_tables(sema) || (sema->tasks == NULL && !_collect_tasks(sema)))
+        return false;
+
+    checker_t checker = {.sema = sema, .diagnostics = sema->diagnostics, .ok = true};
+    _check_declarations(&checker);
+    return _reserve_body_types(sema) && _run_tasks(sema, "check_worker", _check_step)
+           && checker.ok;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <server.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_PROGRAM "dash"
+#define SERVER_BACKLOG 16
+
+bool server_init(server_t *server, pool_t *pool, server_compile_t compile)
+{
+    memset(server, 0, sizeof(server_t));
+    server->pool = pool;
+    server->compile = compile;
+    if (!arena_init(&server->arena))
+        return false;
+    if (!arena_init(&server->names)) {
+        arena_destroy(&server->arena);
+        return false;
+    }
+    if (!intern_init(&server->interner, &server->names)) {
+        arena_destroy(&server->names);
+        arena_destroy(&server->arena);
+        return false;
+    }
+    return true;
+}
+
+void server_destroy(server_t *server)
+{
+    driver_destroy(&server->driver);
+    arena_destroy(&server->names);
+    arena_destroy(&server->arena);
+}
+
+/* Splits `line` in place at whitespace, `argv` having room for every word */
+static int _split(char *line, char **argv)
+{
+    int argc = 0;
+    argv[argc++] = SERVER_PROGRAM;
+    while (*line != '\0') {
+        while (isspace((unsigned char) *line))
+            *line++ = '\0';
+        if (*line == '\0')
+            break;
+        argv[argc++] = line;
+        while (*line != '\0' && !isspace((unsigned char) *line))
+            line++;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+/* Runs one request, collecting what it prints to frame the reply */
+static int _request(
+    server_t *server, char *line, char **out_data, size_t *out_size, char **err_data,
+    size_t *err_size)
+{
+    size_t length = strlen(line);
+    char **argv = malloc((length / 2 + 3) * sizeof(char *));
+    FILE *out = open_memstream(out_data, out_size);
+    FILE *err = open_memstream(err_data, err_size);
+    int status = EXIT_FAILURE;
+    if (argv != NULL && out != NULL && err != NULL) {
+        int argc = _split(line, argv);
+        arena_reset(&server->arena);
+        status = server->compile(server, argc, argv, out, err);
+    } else if (err != NULL) {
+        fprintf(err, "Out of memory\n");
+    }
+    if (out != NULL)
+        fclose(out);
+    if (err != NULL)
+        fclose(err);
+    free(argv);
+    return status;
+}
+
+void server_serve(server_t *server, FILE *in, FILE *out)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    while (!server->stopping && getline(&line, &capacity, in) >= 0) {
+        char *out_data = NULL, *err_data = NULL;
+        size_t out_size = 0, err_size = 0;
+        int status = EXIT_SUCCESS;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!strcmp(line, SERVER_STOP))
+            server->stopping = true;
+        else
+            status = _request(server, line, &out_data, &out_size, &err_data, &err_size);
+        server->request_count++;
+
+        fprintf(out, "%d %zu %zu\n", status, out_size, err_size);
+        if (out_size > 0)
+            fwrite(out_data, 1, out_size, out);
+        if (err_size > 0)
+            fwrite(err_data, 1, err_size, out);
+        fflush(out);
+        free(out_data);
+        free(err_data);
+    }
+    free(line);
+}
+
+/* Listening socket bound to `path`, -1 on failure */
+static int _bind(const char *path)
+{
+    struct sockaddr_un address;
+    struct stat status;
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    /* Left behind by a server that did not shut down, anything else is kept */
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0
+        || listen(fd, SERVER_BACKLOG) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool server_listen(server_t *server, const char *path)
+{
+    int fd = _bind(path);
+    if (fd < 0)
+        return false;
+
+    /* A client going away mid-reply must not take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+    while (!server->stopping) {
+        int connection = accept(fd, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        int reply_fd = dup(connection);
+        FILE *in = fdopen(connection, "r");
+        FILE *out = reply_fd >= 0 ? fdopen(reply_fd, "w") : NULL;
+        if (in != NULL && out != NULL)
+            server_serve(server, in, out);
+        if (in != NULL)
+            fclose(in);
+        else
+            close(connection);
+        if (out != NULL)
+            fclose(out);
+        else if (reply_fd >= 0)
+            close(reply_fd);
+    }
+
+    close(fd);
+    unlink(path);
+    return server->stopping;
+}
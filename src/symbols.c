@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <string.h>
+#include <symbols.h>
+
+#define SYMBOLS_MIN_SLOTS 64
+#define SYMBOLS_MIN_BINDINGS 64
+#define SYMBOLS_MIN_SCOPES 16
+
+static uint32_t _slot_hash(intern_id_t name)
+{
+    /* Fibonacci hashing spreads the dense intern ids over the table */
+    return name * 2654435769u;
+}
+
+static uint32_t _find_slot(const symbols_t *symbols, intern_id_t name)
+{
+    uint32_t slot = _slot_hash(name) & symbols->slot_mask;
+    while (symbols->slots[slot].name != INTERN_NONE && symbols->slots[slot].name != name)
+        slot = (slot + 1) & symbols->slot_mask;
+    return slot;
+}
+
+static bool _grow_slots(symbols_t *symbols, uint32_t slot_count)
+{
+    symbol_slot_t *old_slots = symbols->slots;
+    uint32_t old_count = symbols->slots ? symbols->slot_mask + 1 : 0;
+    symbol_slot_t *slots = arena_alloc_aligned(
+        symbols->arena, slot_count * sizeof(symbol_slot_t), sizeof(uint32_t));
+    if (slots == NULL)
+        return false;
+
+    memset(slots, 0, slot_count * sizeof(symbol_slot_t));
+    symbols->slots = slots;
+    symbols->slot_mask = slot_count - 1;
+
+    uint32_t i;
+    for (i = 0; i < old_count; i++) {
+        if (old_slots[i].name != INTERN_NONE)
+            slots[_find_slot(symbols, old_slots[i].name)] = old_slots[i];
+    }
+    return true;
+}
+
+bool symbols_init(symbols_t *symbols, arena_t *arena, const symbols_t *parent)
+{
+    memset(symbols, 0, sizeof(symbols_t));
+    symbols->arena = arena;
+    symbols->parent = parent;
+    symbols->bindings = arena_alloc_aligned(
+        arena, SYMBOLS_MIN_BINDINGS * sizeof(symbol_t), sizeof(uint32_t));
+    symbols->scopes = arena_alloc_aligned(
+        arena, SYMBOLS_MIN_SCOPES * sizeof(uint32_t), sizeof(uint32_t));
+    if (symbols->bindings == NULL || symbols->scopes == NULL)
+        return false;
+    symbols->binding_capacity = SYMBOLS_MIN_BINDINGS;
+    symbols->scope_capacity = SYMBOLS_MIN_SCOPES;
+    /* Binding 0 backs SYMBOL_NONE */
+    memset(&symbols->bindings[0], 0, sizeof(symbol_t));
+    symbols->binding_count = 1;
+    return _grow_slots(symbols, SYMBOLS_MIN_SLOTS);
+}
+
+bool symbols_push_scope(symbols_t *symbols)
+{
+    if (symbols->depth == symbols->scope_capacity) {
+        uint32_t capacity = symbols->scope_capacity * 2;
+        uint32_t *scopes = arena_grow(
+            symbols->arena, symbols->scopes, symbols->depth, capacity, sizeof(uint32_t));
+        if (scopes == NULL)
+            return false;
+        symbols->scopes = scopes;
+        symbols->scope_capacity = capacity;
+    }
+    symbols->scopes[symbols->depth++] = symbols->binding_count;
+    return true;
+}
+
+void symbols_pop_scope(symbols_t *symbols)
+{
+    uint32_t start = symbols->scopes[--symbols->depth];
+    while (symbols->binding_count > start) {
+        const symbol_t *binding = &symbols->bindings[--symbols->binding_count];
+        symbols->slots[_find_slot(symbols, binding->name)].binding = binding->shadowed;
+    }
+}
+
+symbol_index_t symbols_declare(
+    symbols_t *symbols,
+    intern_id_t name,
+    symbol_kind_t kind,
+    ast_index_t declaration,
+    symbol_index_t *previous)
+{
+    uint32_t slot = _find_slot(symbols, name);
+    symbol_index_t shadowed = symbols->slots[slot].binding;
+
+    if (shadowed != SYMBOL_NONE && symbols->bindings[shadowed].depth == symbols->depth) {
+        if (previous != NULL)
+            *previous = shadowed;
+        return SYMBOL_NONE;
+    }
+
+    if (symbols->binding_count == symbols->binding_capacity) {
+        uint32_t capacity = symbols->binding_capacity * 2;
+        symbol_t *bindings = arena_grow(
+            symbols->arena,
+            symbols->bindings,
+            symbols->binding_count,
+            capacity,
+            sizeof(symbol_t));
+        if (bindings == NULL)
+            return SYMBOL_NONE;
+        symbols->bindings = bindings;
+        symbols->binding_capacity = capacity;
+    }
+
+    if (symbols->slots[slot].name == INTERN_NONE) {
+        /* Keep the load factor at or below 1/2 */
+        if ((symbols->slot_count + 1) * 2 > symbols->slot_mask + 1) {
+            if (!_grow_slots(symbols, (symbols->slot_mask + 1) * 2))
+                return SYMBOL_NONE;
+            slot = _find_slot(symbols, name);
+        }
+        symbols->slots[slot].name = name;
+        symbols->slot_count++;
+    }
+
+    symbol_index_t index = symbols->binding_count++;
+    symbol_t *binding = &symbols->bindings[index];
+    binding->name = name;
+    binding->kind = kind;
+    binding->declaration = declaration;
+    binding->shadowed = shadowed;
+    binding->depth = symbols->depth;
+    symbols->slots[slot].binding = index;
+    return index;
+}
+
+const symbol_t *symbols_lookup(const symbols_t *symbols, intern_id_t name)
+{
+    for (; symbols != NULL; symbols = symbols->parent) {
+        const symbol_slot_t *slot = &symbols->slots[_find_slot(symbols, name)];
+        if (slot->binding != SYMBOL_NONE)
+            return &symbols->bindings[slot->binding];
+    }
+    return NULL;
+}
+
+const symbol_t *symbols_get(const symbols_t *symbols, symbol_index_t index)
+{
+    return &symbols->bindings[index];
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <trace.h>
+
+typedef enum {
+    TRACE_EVENT_SPAN,
+    TRACE_EVENT_COUNTER,
+} trace_event_kind_t;
+
+typedef struct
+{
+    const char *name;
+    trace_event_kind_t kind;
+    uint64_t start;
+    uint64_t value; /* Duration for spans, sample for counters */
+    uint32_t thread;
+} trace_event_t;
+
+bool trace_enabled = false;
+
+static trace_event_t *trace_events = NULL;
+static size_t trace_event_count = 0;
+static size_t trace_event_capacity = 0;
+static uint64_t trace_epoch = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t trace_thread = 0;
+
+static uint64_t _trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void _trace_push(trace_event_t event)
+{
+    event.thread = trace_thread;
+    pthread_mutex_lock(&trace_lock);
+    if (trace_event_count == trace_event_capacity) {
+        size_t capacity = trace_event_capacity ? trace_event_capacity * 2 : 256;
+        trace_event_t *events = realloc(trace_events, capacity * sizeof(trace_event_t));
+        if (events == NULL) {
+            pthread_mutex_unlock(&trace_lock);
+            return;
+        }
+        trace_events = events;
+        trace_event_capacity = capacity;
+    }
+    trace_events[trace_event_count++] = event;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void trace_set_thread(uint32_t thread)
+{
+    trace_thread = thread;
+}
+
+void trace_enable(void)
+{
+    if (trace_epoch == 0)
+        trace_epoch = _trace_now();
+    trace_enabled = true;
+}
+
+void trace_disable(void)
+{
+    trace_enabled = false;
+}
+
+trace_span_t trace_begin(const char *name)
+{
+    trace_span_t span = {.name = name, .start = 0};
+    if (trace_enabled)
+        span.start = _trace_now();
+    return span;
+}
+
+void trace_end(trace_span_t *span)
+{
+    if (!trace_enabled || span->start == 0)
+        return;
+    trace_event_t event = {
+        .name = span->name,
+        .kind = TRACE_EVENT_SPAN,
+        .start = span->start,
+        .value = _trace_now() - span->start,
+    };
+    _trace_push(event);
+}
+
+void trace_counter(const char *name, uint64_t value)
+{
+    if (!trace_enabled)
+        return;
+    trace_event_t event = {
+        .name = name,
+        .kind = TRACE_EVENT_COUNTER,
+        .start = _trace_now(),
+        .value = value,
+    };
+    _trace_push(event);
+}
+
+static void _write_micros(FILE *out, uint64_t nanos)
+{
+    fprintf(out, "%llu.%03u", (unsigned long long) (nanos / 1000), (unsigned) (nanos % 1000));
+}
+
+bool trace_write_json(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+        return false;
+
+    fputs("{\"traceEvents\":[\n", out);
+    size_t i;
+    for (i = 0; i < trace_event_count; i++) {
+        const trace_event_t *event = &trace_events[i];
+        fprintf(
+            out,
+            "{\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":",
+            event->name,
+            (unsigned) event->thread + 1);
+        _write_micros(out, event->start - trace_epoch);
+        if (event->kind == TRACE_EVENT_SPAN) {
+            fputs(",\"ph\":\"X\",\"dur\":", out);
+            _write_micros(out, event->value);
+            fputs("}", out);
+        } else {
+            fprintf(
+                out,
+                ",\"ph\":\"C\",\"args\":{\"%s\":%llu}}",
+                event->name,
+                (unsigned long long) event->value);
+        }
+        fputs(i + 1 < trace_event_count ? ",\n" : "\n", out);
+    }
+    fputs("],\"displayTimeUnit\":\"ms\"}\n", out);
+
+    return fclose(out) == 0;
+}
+
+void trace_report(FILE *out)
+{
+    size_t i, j;
+    for (i = 0; i < trace_event_count; i++) {
+        const trace_event_t *event = &trace_events[i];
+        if (event->kind == TRACE_EVENT_COUNTER) {
+            fprintf(out, "%-24s %12llu\n", event->name, (unsigned long long) event->value);
+            continue;
+        }
+
+        /* Report each span name once, at its first occurrence */
+        bool seen = false;
+        for (j = 0; j < i && !seen; j++)
+            seen = trace_events[j].kind == TRACE_EVENT_SPAN
+                   && !strcmp(trace_events[j].name, event->name);
+        if (seen)
+            continue;
+
+        uint64_t total = 0;
+        size_t count = 0;
+        for (j = i; j < trace_event_count; j++) {
+            if (trace_events[j].kind == TRACE_EVENT_SPAN
+                && !strcmp(trace_events[j].name, event->name)) {
+                total += trace_events[j].value;
+                count++;
+            }
+        }
+        fprintf(out, "%-24s %9.3f ms", event->name, (double) total / 1e6);
+        if (count > 1)
+            fprintf(out, " (%zu spans)", count);
+        fputc('\n', out);
+    }
+}
+
+void trace_destroy(void)
+{
+    free(trace_events);
+    trace_events = NULL;
+    trace_event_count = 0;
+    trace_event_capacity = 0;
+}
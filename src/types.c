@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <types.h>
+
+#define TYPES_MIN_CAPACITY 64
+
+static uint32_t _mix(uint32_t hash, uint32_t value)
+{
+    hash ^= value + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint32_t _hash_type(
+    type_kind_t kind, uint32_t operand, const type_id_t *params, uint32_t param_count)
+{
+    uint32_t hash = _mix((uint32_t) kind, operand);
+    uint32_t i;
+    for (i = 0; i < param_count; i++)
+        hash = _mix(hash, params[i]);
+    return hash;
+}
+
+static bool _equal(
+    const types_t *types,
+    const type_t *type,
+    type_kind_t kind,
+    uint32_t operand,
+    const type_id_t *params,
+    uint32_t param_count)
+{
+    return type->kind == kind && type->operand == operand && type->param_count == param_count
+           && (param_count == 0
+               || !memcmp(
+                   &types->params[type->first_param], params, param_count * sizeof(type_id_t)));
+}
+
+static bool _rehash(types_t *types, uint32_t slot_count)
+{
+    type_id_t *slots = arena_alloc_aligned(
+        types->arena, slot_count * sizeof(type_id_t), sizeof(type_id_t));
+    if (slots == NULL)
+        return false;
+    memset(slots, 0, slot_count * sizeof(type_id_t));
+
+    uint32_t mask = slot_count - 1;
+    type_id_t id;
+    for (id = TYPE_PRIMITIVE_COUNT; id < types->count; id++) {
+        uint32_t slot = types->types[id].hash & mask;
+        while (slots[slot] != TYPE_ERROR)
+            slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+
+    types->slots = slots;
+    types->slot_mask = mask;
+    return true;
+}
+
+bool types_reserve(types_t *types, uint32_t type_count, uint32_t param_count)
+{
+    if (types->count + type_count > types->capacity) {
+        uint32_t capacity = types->capacity ? types->capacity * 2 : TYPES_MIN_CAPACITY;
+        while (capacity < types->count + type_count)
+            capacity *= 2;
+        type_t *grown = arena_grow(
+            types->arena, types->types, types->count, capacity, sizeof(type_t));
+        if (grown == NULL)
+            return false;
+        types->types = grown;
+        types->capacity = capacity;
+    }
+    if (types->param_count + param_count > types->param_capacity) {
+        uint32_t capacity = types->param_capacity ? types->param_capacity : TYPES_MIN_CAPACITY;
+        while (capacity < types->param_count + param_count)
+            capacity *= 2;
+        type_id_t *grown = arena_grow(
+            types->arena, types->params, types->param_count, capacity, sizeof(type_id_t));
+        if (grown == NULL)
+            return false;
+        types->params = grown;
+        types->param_capacity = capacity;
+    }
+    return true;
+}
+
+bool types_init(types_t *types, arena_t *arena)
+{
+    memset(types, 0, sizeof(types_t));
+    types->arena = arena;
+    if (!types_reserve(types, TYPE_PRIMITIVE_COUNT, 0) || !_rehash(types, TYPES_MIN_CAPACITY * 2))
+        return false;
+
+    type_id_t id;
+    for (id = 0; id < TYPE_PRIMITIVE_COUNT; id++) {
+        memset(&types->types[id], 0, sizeof(type_t));
+        types->types[id].kind = (type_kind_t) id;
+    }
+    types->count = TYPE_PRIMITIVE_COUNT;
+    return true;
+}
+
+static type_id_t _intern(
+    types_t *types,
+    type_kind_t kind,
+    uint32_t operand,
+    const type_id_t *params,
+    uint32_t param_count)
+{
+    uint32_t hash = _hash_type(kind, operand, params, param_count);
+    uint32_t slot = hash & types->slot_mask;
+    while (types->slots[slot] != TYPE_ERROR) {
+        const type_t *type = &types->types[types->slots[slot]];
+        if (type->hash == hash && _equal(types, type, kind, operand, params, param_count))
+            return types->slots[slot];
+        slot = (slot + 1) & types->slot_mask;
+    }
+
+    if (!types_reserve(types, 1, param_count))
+        return TYPE_ERROR;
+
+    type_id_t id = types->count++;
+    type_t *type = &types->types[id];
+    type->kind = kind;
+    type->operand = operand;
+    type->first_param = types->param_count;
+    type->param_count = param_count;
+    type->hash = hash;
+    if (param_count > 0)
+        memcpy(&types->params[types->param_count], params, param_count * sizeof(type_id_t));
+    types->param_count += param_count;
+
+    /* Keep the load factor at or below 1/2 */
+    if ((types->count - TYPE_PRIMITIVE_COUNT) * 2 > types->slot_mask + 1) {
+        if (!_rehash(types, (types->slot_mask + 1) * 2))
+            return TYPE_ERROR;
+    } else {
+        types->slots[slot] = id;
+    }
+    return id;
+}
+
+type_id_t types_nominal(types_t *types, type_kind_t kind, ast_index_t declaration)
+{
+    return _intern(types, kind, declaration, NULL, 0);
+}
+
+type_id_t types_function(
+    types_t *types, const type_id_t *params, uint32_t param_count, type_id_t result)
+{
+    return _intern(types, TYPE_FUNCTION, result, params, param_count);
+}
+
+const type_t *types_get(const types_t *types, type_id_t id)
+{
+    return &types->types[id];
+}
+
+const type_id_t *types_params(const types_t *types, type_id_t function)
+{
+    return &types->params[types->types[function].first_param];
+}
+
+static const char *_primitive_name(type_id_t id)
+{
+    switch ((type_kind_t) id) {
+    case TYPE_ERROR:
+        return "<error>";
+    case TYPE_VOID:
+        return "void";
+    case TYPE_BOOL:
+        return "bool";
+    case TYPE_I8:
+        return "i8";
+    case TYPE_I16:
+        return "i16";
+    case TYPE_I32:
+        return "i32";
+    case TYPE_I64:
+        return "i64";
+    case TYPE_U8:
+        return "u8";
+    case TYPE_U16:
+        return "u16";
+    case TYPE_U32:
+        return "u32";
+    case TYPE_U64:
+        return "u64";
+    case TYPE_F32:
+        return "f32";
+    case TYPE_F64:
+        return "f64";
+    case TYPE_STRING:
+        return "string";
+    case TYPE_NULL:
+        return "null";
+    default:
+        return NULL;
+    }
+}
+
+void types_format(
+    const types_t *types, const ast_t *ast, type_id_t id, char *buffer, size_t size)
+{
+    const type_t *type = &types->types[id];
+    const char *name = _primitive_name(id);
+    size_t length;
+    uint32_t i;
+
+    if (size == 0)
+        return;
+    if (name != NULL || type->kind != TYPE_FUNCTION) {
+        if (name == NULL)
+            name = ast_token(ast, type->operand)->value;
+        snprintf(buffer, size, "%s", name);
+        return;
+    }
+
+    snprintf(buffer, size, "function(");
+    for (i = 0; i < type->param_count; i++) {
+        length = strlen(buffer);
+        if (i > 0 && length + 2 < size)
+            strcat(buffer, ", ");
+        length = strlen(buffer);
+        types_format(
+            types, ast, types->params[type->first_param + i], buffer + length, size - length);
+    }
+    length = strlen(buffer);
+    if (type->operand != TYPE_VOID) {
+        snprintf(buffer + length, size - length, ") -> ");
+        length = strlen(buffer);
+        types_format(types, ast, type->operand, buffer + length, size - length);
+    } else {
+        snprintf(buffer + length, size - length, ")");
+    }
+}
+
+bool type_is_integer(type_id_t id)
+{
+    return id >= TYPE_I8 && id <= TYPE_U64;
+}
+
+bool type_is_signed(type_id_t id)
+{
+    return id >= TYPE_I8 && id <= TYPE_I64;
+}
+
+bool type_is_float(type_id_t id)
+{
+    return id == TYPE_F32 || id == TYPE_F64;
+}
+
+unsigned type_bits(type_id_t id)
+{
+    switch ((type_kind_t) id) {
+    case TYPE_I8:
+    case TYPE_U8:
+        return 8;
+    case TYPE_I16:
+    case TYPE_U16:
+        return 16;
+    case TYPE_I32:
+    case TYPE_U32:
+    case TYPE_F32:
+        return 32;
+    case TYPE_I64:
+    case TYPE_U64:
+    case TYPE_F64:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+uint64_t type_wrap(type_id_t id, uint64_t value)
+{
+    unsigned bits = type_bits(id);
+    if (bits == 0 || bits == 64 || !type_is_integer(id))
+        return value;
+
+    uint64_t mask = (1ull << bits) - 1;
+    value &= mask;
+    if (type_is_signed(id) && (value >> (bits - 1)))
+        value |= ~mask;
+    return value;
+}
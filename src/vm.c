@@ -0,0 +1,913 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <opt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vm.h>
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+/* A jump target word to fill in, with the edge's phi moves when `from` is set */
+typedef struct
+{
+    uint32_t at;
+    uint32_t block;
+    uint32_t from;
+} vm_fixup_t;
+
+typedef struct
+{
+    uint32_t to;
+    uint32_t from;
+} vm_move_t;
+
+typedef struct
+{
+    vm_t *vm;
+    ir_function_t *function;
+    uint32_t *code;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t *order;
+    uint32_t order_count;
+    uint32_t *registers;
+    uint32_t *uses;
+    /* Values emitted as part of the instruction using them */
+    uint8_t *fused;
+    uint32_t *block_offset;
+    vm_fixup_t *fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+    uint32_t scratch;
+    bool failed;
+} vm_compiler_t;
+
+/*
+ * Operands of each opcode for vm_dump: r register, i signed immediate, u
+ * number, k 64-bit constant in two words, f function, t jump target, a an
+ * argument count and that many registers, j a target count and targets.
+ */
+static const char *_formats[VM_OP_COUNT] = {
+    [VM_CONST] = "rk",   [VM_MOV] = "rr",     [VM_ADD] = "rrr",    [VM_SUB] = "rrr",
+    [VM_MUL] = "rrr",    [VM_ADDI] = "rri",   [VM_DIVS] = "rrr",   [VM_DIVU] = "rrr",
+    [VM_MODS] = "rrr",   [VM_MODU] = "rrr",   [VM_NEG] = "rr",     [VM_NOT] = "rr",
+    [VM_SEXT8] = "r",    [VM_SEXT16] = "r",   [VM_SEXT32] = "r",   [VM_ZEXT8] = "r",
+    [VM_ZEXT16] = "r",   [VM_ZEXT32] = "r",   [VM_EQ] = "rrr",     [VM_NE] = "rrr",
+    [VM_LT] = "rrr",     [VM_LE] = "rrr",     [VM_LTU] = "rrr",    [VM_LEU] = "rrr",
+    [VM_BT] = "rrr",     [VM_FUNC] = "rf",    [VM_VTABLE] = "ru",  [VM_METHOD] = "rru",
+    [VM_CALL] = "rfa",   [VM_CALLI] = "rra",  [VM_CALLM] = "rruua", [VM_SECOND] = "r",
+    [VM_NEW] = "ru",     [VM_LOAD] = "rru",   [VM_STORE] = "rru",  [VM_JMP] = "t",
+    [VM_BRT] = "rt",     [VM_BRF] = "rt",     [VM_BEQ] = "rrt",    [VM_BNE] = "rrt",
+    [VM_BLT] = "rrt",    [VM_BLE] = "rrt",    [VM_BLTU] = "rrt",   [VM_BLEU] = "rrt",
+    [VM_JTAB] = "rj",    [VM_RET] = "r",      [VM_RET2] = "rr",    [VM_RETV] = "",
+    [VM_TRAP] = ""};
+
+static const char *_names[VM_OP_COUNT] = {
+    "const", "mov",  "add",    "sub",   "mul",   "addi",  "divs", "divu", "mods", "modu",
+    "neg",   "not",  "sext8",  "sext16", "sext32", "zext8", "zext16", "zext32", "eq", "ne",
+    "lt",    "le",   "ltu",    "leu",   "bt",    "func",  "vtable", "method", "call", "calli",
+    "callm", "second", "new",  "load",  "store", "jmp",   "brt",  "brf",  "beq",  "bne",
+    "blt",   "ble",  "bltu",   "bleu",  "jtab",  "ret",   "ret2", "retv", "trap"};
+
+/* Compiling */
+
+static void _word(vm_compiler_t *c, uint32_t word)
+{
+    if (c->size == c->capacity) {
+        uint32_t capacity = c->capacity ? c->capacity * 2 : 256;
+        uint32_t *code = realloc(c->code, capacity * sizeof(uint32_t));
+        if (code == NULL) {
+            c->failed = true;
+            return;
+        }
+        c->code = code;
+        c->capacity = capacity;
+    }
+    c->code[c->size++] = word;
+}
+
+static bool _has_phis(const ir_function_t *function, uint32_t block)
+{
+    const ir_block_t *target = &function->blocks[block];
+    return target->count > 0 && function->instrs[target->instrs[0]].op == IR_PHI;
+}
+
+/* Emits `op` and as many of its first three operand words as it has */
+static void _emit(vm_compiler_t *c, vm_op_t op, uint32_t a, uint32_t b, uint32_t d)
+{
+    const char *format = _formats[op];
+    size_t words = strlen(format) + (strchr(format, 'k') != NULL);
+    _word(c, op);
+    if (words > 0)
+        _word(c, a);
+    if (words > 1)
+        _word(c, b);
+    if (words > 2)
+        _word(c, d);
+}
+
+/*
+ * Emits a jump target word for the edge from `from` into `block`, filled in
+ * once every block is placed. Edges into phis get their moves placed after
+ * the last block and jump there instead; pass UINT32_MAX to jump straight.
+ */
+static void _target(vm_compiler_t *c, uint32_t from, uint32_t block)
+{
+    if (c->fixup_count == c->fixup_capacity) {
+        uint32_t capacity = c->fixup_capacity ? c->fixup_capacity * 2 : 64;
+        vm_fixup_t *fixups = realloc(c->fixups, capacity * sizeof(vm_fixup_t));
+        if (fixups == NULL) {
+            c->failed = true;
+            return;
+        }
+        c->fixups = fixups;
+        c->fixup_capacity = capacity;
+    }
+    c->fixups[c->fixup_count].at = c->size;
+    c->fixups[c->fixup_count].block = block;
+    c->fixups[c->fixup_count++].from = _has_phis(c->function, block) ? from : UINT32_MAX;
+    _word(c, 0);
+}
+
+static uint32_t _reg(const vm_compiler_t *c, ir_value_t value)
+{
+    return c->registers[value];
+}
+
+static bool _fits_imm32(int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+/* The constant operand of an add or sub that VM_ADDI can take, negated for sub */
+static bool _immediate(
+    const vm_compiler_t *c, const ir_instr_t *instr, int64_t *value, ir_value_t *other)
+{
+    const ir_instr_t *a = &c->function->instrs[instr->a];
+    const ir_instr_t *b = &c->function->instrs[instr->b];
+    if (instr->op == IR_SUB && b->op == IR_CONST) {
+        *value = 0 - (int64_t) ir_const_value(b);
+        *other = instr->a;
+        return _fits_imm32(*value) && ir_const_value(b) != (uint64_t) INT64_MIN;
+    }
+    if (instr->op != IR_ADD)
+        return false;
+    if (b->op == IR_CONST && _fits_imm32((int64_t) ir_const_value(b))) {
+        *value = (int64_t) ir_const_value(b);
+        *other = instr->a;
+        return true;
+    }
+    if (a->op == IR_CONST && _fits_imm32((int64_t) ir_const_value(a))) {
+        *value = (int64_t) ir_const_value(a);
+        *other = instr->b;
+        return true;
+    }
+    return false;
+}
+
+static void _count_use(void *context, uint32_t *operand)
+{
+    uint32_t *uses = context;
+    uses[*operand]++;
+}
+
+/* Numbers registers, counts uses and picks the instructions to fuse. */
+static void _prepare(vm_compiler_t *c)
+{
+    ir_function_t *function = c->function;
+    uint32_t next = function->param_count, k, i;
+
+    for (k = 0; k < c->order_count; k++) {
+        const ir_block_t *block = &function->blocks[c->order[k]];
+        for (i = 0; i < block->count; i++) {
+            ir_value_t value = block->instrs[i];
+            const ir_instr_t *instr = &function->instrs[value];
+            if (instr->op == IR_PARAM)
+                c->registers[value] = instr->a;
+            else if (instr->type != IR_VOID)
+                c->registers[value] = next++;
+            ir_for_each_operand(function, value, _count_use, c->uses);
+        }
+    }
+    c->scratch = next;
+
+    for (k = 0; k < c->order_count; k++) {
+        const ir_block_t *block = &function->blocks[c->order[k]];
+        for (i = 0; i < block->count; i++) {
+            ir_value_t value = block->instrs[i];
+            const ir_instr_t *instr = &function->instrs[value];
+            int64_t immediate;
+            ir_value_t other;
+            if ((instr->op == IR_ADD || instr->op == IR_SUB)
+                && _immediate(c, instr, &immediate, &other))
+                c->uses[other == instr->a ? instr->b : instr->a]--;
+            /* Interface calls look the method up themselves, through their cache */
+            if (instr->op == IR_CALL_INDIRECT && c->uses[instr->a] == 1
+                && function->instrs[instr->a].op == IR_METHOD)
+                c->fused[instr->a] = 1;
+        }
+        /* A compare used only by the branch right after it branches itself */
+        if (block->count < 2)
+            continue;
+        const ir_instr_t *last = &function->instrs[block->instrs[block->count - 1]];
+        ir_value_t before = block->instrs[block->count - 2];
+        ir_op_t op = function->instrs[before].op;
+        if (last->op == IR_BRANCH && last->a == before && c->uses[before] == 1 && op >= IR_EQ
+            && op <= IR_GE)
+            c->fused[before] = 1;
+    }
+}
+
+/* Keeps `reg` wrapped to `type` after 64-bit arithmetic */
+static void _wrap(vm_compiler_t *c, uint32_t reg, ir_type_t type)
+{
+    static const vm_op_t extend[2][3] = {
+        {VM_ZEXT8, VM_ZEXT16, VM_ZEXT32}, {VM_SEXT8, VM_SEXT16, VM_SEXT32}};
+    unsigned bits = ir_type_bits(type);
+    if (bits == 8 || bits == 16 || bits == 32)
+        _emit(c, extend[ir_type_signed(type)][bits == 8 ? 0 : bits == 16 ? 1 : 2], reg, 0, 0);
+}
+
+/*
+ * Maps a compare to the VM's equal, less and less-or-equal forms, swapping
+ * the operands for the greater ones. `branch` picks the compare-and-branch
+ * opcodes, `invert` the negated condition.
+ */
+static vm_op_t _condition(
+    const vm_compiler_t *c, const ir_instr_t *instr, bool branch, bool invert, uint32_t *x,
+    uint32_t *y)
+{
+    bool is_signed = ir_type_signed(c->function->instrs[instr->a].type);
+    ir_op_t op = instr->op;
+    *x = _reg(c, instr->a);
+    *y = _reg(c, instr->b);
+    if (invert) {
+        static const ir_op_t negated[] = {IR_NE, IR_EQ, IR_GE, IR_GT, IR_LE, IR_LT};
+        op = negated[op - IR_EQ];
+    }
+    if (op == IR_GT || op == IR_GE) {
+        uint32_t swap = *x;
+        *x = *y;
+        *y = swap;
+        op = op == IR_GT ? IR_LT : IR_LE;
+    }
+    switch (op) {
+    case IR_EQ:
+        return branch ? VM_BEQ : VM_EQ;
+    case IR_NE:
+        return branch ? VM_BNE : VM_NE;
+    case IR_LT:
+        return branch ? (is_signed ? VM_BLT : VM_BLTU) : (is_signed ? VM_LT : VM_LTU);
+    default:
+        return branch ? (is_signed ? VM_BLE : VM_BLEU) : (is_signed ? VM_LE : VM_LEU);
+    }
+}
+
+/* Phi moves of the edge from `block` into `successor` as one parallel copy */
+static void _phi_moves(vm_compiler_t *c, uint32_t block, uint32_t successor)
+{
+    const ir_function_t *function = c->function;
+    const ir_block_t *target = &function->blocks[successor];
+    uint32_t index = ir_pred_index(function, successor, block), count = 0, i, j;
+    if (!_has_phis(function, successor))
+        return;
+
+    vm_move_t *moves = malloc(target->count * sizeof(vm_move_t));
+    if (moves == NULL) {
+        c->failed = true;
+        return;
+    }
+    for (i = 0; i < target->count; i++) {
+        ir_value_t phi = target->instrs[i];
+        if (function->instrs[phi].op != IR_PHI)
+            break;
+        uint32_t from = _reg(c, function->operands[function->instrs[phi].a + index]);
+        if (from != _reg(c, phi)) {
+            moves[count].to = _reg(c, phi);
+            moves[count++].from = from;
+        }
+    }
+
+    while (count > 0) {
+        bool progress = false;
+        i = 0;
+        while (i < count) {
+            for (j = 0; j < count && (j == i || moves[j].from != moves[i].to); j++)
+                ;
+            if (j < count) {
+                i++;
+                continue;
+            }
+            _emit(c, VM_MOV, moves[i].to, moves[i].from, 0);
+            moves[i] = moves[--count];
+            progress = true;
+        }
+        if (!progress) {
+            /* Only cycles are left: park one destination in scratch and read it from there */
+            uint32_t parked = moves[0].to;
+            _emit(c, VM_MOV, c->scratch, parked, 0);
+            for (i = 0; i < count; i++)
+                if (moves[i].from == parked)
+                    moves[i].from = c->scratch;
+        }
+    }
+    free(moves);
+}
+
+/* The edge from `block` into `successor`, falling through when it comes next */
+static void _edge(vm_compiler_t *c, uint32_t block, uint32_t successor, uint32_t next)
+{
+    _phi_moves(c, block, successor);
+    if (successor != next) {
+        _word(c, VM_JMP);
+        _target(c, UINT32_MAX, successor);
+    }
+}
+
+static void _branch(vm_compiler_t *c, uint32_t block, const ir_instr_t *instr, uint32_t next)
+{
+    const ir_instr_t *condition = &c->function->instrs[instr->a];
+    /* Fall through into the then block when it comes next and needs no moves */
+    bool invert = instr->b == next && !_has_phis(c->function, instr->b);
+    uint32_t taken = invert ? instr->c : instr->b, other = invert ? instr->b : instr->c;
+
+    if (c->fused[instr->a]) {
+        uint32_t x, y;
+        _word(c, _condition(c, condition, true, invert, &x, &y));
+        _word(c, x);
+        _word(c, y);
+    } else {
+        _word(c, invert ? VM_BRF : VM_BRT);
+        _word(c, _reg(c, instr->a));
+    }
+    _target(c, block, taken);
+    _edge(c, block, other, next);
+}
+
+static void _jump_table(vm_compiler_t *c, uint32_t block, const ir_instr_t *instr)
+{
+    const uint32_t *targets = &c->function->operands[instr->b];
+    uint32_t i;
+    _emit(c, VM_JTAB, _reg(c, instr->a), instr->c, 0);
+    for (i = 0; i < instr->c; i++)
+        _target(c, block, targets[i]);
+}
+
+static void _call(vm_compiler_t *c, ir_value_t value)
+{
+    const ir_instr_t *instr = &c->function->instrs[value];
+    const uint32_t *args = &c->function->operands[instr->b];
+    uint32_t dest = instr->type != IR_VOID ? _reg(c, value) : c->scratch, i;
+
+    if (instr->op == IR_CALL) {
+        _emit(c, VM_CALL, dest, instr->a, instr->c);
+    } else if (c->fused[instr->a]) {
+        const ir_instr_t *method = &c->function->instrs[instr->a];
+        vm_t *vm = c->vm;
+        vm_cache_t *caches = realloc(vm->caches, (vm->cache_count + 1) * sizeof(vm_cache_t));
+        if (caches == NULL) {
+            c->failed = true;
+            return;
+        }
+        vm->caches = caches;
+        vm->caches[vm->cache_count].vtable = NULL;
+        vm->caches[vm->cache_count].target = NULL;
+        _emit(c, VM_CALLM, dest, _reg(c, method->a), method->b);
+        _word(c, vm->cache_count++);
+        _word(c, instr->c);
+    } else {
+        _emit(c, VM_CALLI, dest, _reg(c, instr->a), instr->c);
+    }
+    for (i = 0; i < instr->c; i++)
+        _word(c, _reg(c, args[i]));
+}
+
+static void _instruction(vm_compiler_t *c, uint32_t block, ir_value_t value, uint32_t next)
+{
+    const ir_instr_t *instr = &c->function->instrs[value];
+    uint32_t d = _reg(c, value), x = 0, y = 0;
+    int64_t immediate;
+    ir_value_t other;
+
+    if (c->fused[value])
+        return;
+    switch ((ir_op_t) instr->op) {
+    case IR_NOP:
+    case IR_PARAM:
+    case IR_PHI:
+        break;
+    case IR_CONST:
+        if (c->uses[value] > 0)
+            _emit(c, VM_CONST, d, (uint32_t) ir_const_value(instr),
+                (uint32_t) (ir_const_value(instr) >> 32));
+        break;
+    case IR_COPY:
+        if (d != _reg(c, instr->a))
+            _emit(c, VM_MOV, d, _reg(c, instr->a), 0);
+        break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+        if (instr->op != IR_MUL && _immediate(c, instr, &immediate, &other))
+            _emit(c, VM_ADDI, d, _reg(c, other), (uint32_t) immediate);
+        else
+            _emit(c, instr->op == IR_ADD ? VM_ADD : instr->op == IR_SUB ? VM_SUB : VM_MUL, d,
+                _reg(c, instr->a), _reg(c, instr->b));
+        _wrap(c, d, instr->type);
+        break;
+    case IR_DIV:
+    case IR_MOD:
+        if (ir_type_signed(instr->type))
+            _emit(c, instr->op == IR_DIV ? VM_DIVS : VM_MODS, d, _reg(c, instr->a),
+                _reg(c, instr->b));
+        else
+            _emit(c, instr->op == IR_DIV ? VM_DIVU : VM_MODU, d, _reg(c, instr->a),
+                _reg(c, instr->b));
+        _wrap(c, d, instr->type);
+        break;
+    case IR_NEG:
+        _emit(c, VM_NEG, d, _reg(c, instr->a), 0);
+        _wrap(c, d, instr->type);
+        break;
+    case IR_NOT:
+        _emit(c, VM_NOT, d, _reg(c, instr->a), 0);
+        break;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+        _emit(c, _condition(c, instr, false, false, &x, &y), d, x, y);
+        break;
+    case IR_BIT_TEST:
+        _emit(c, VM_BT, d, _reg(c, instr->a), _reg(c, instr->b));
+        break;
+    case IR_FUNC_ADDR:
+        _emit(c, VM_FUNC, d, instr->a, 0);
+        break;
+    case IR_VTABLE:
+        _emit(c, VM_VTABLE, d, instr->a, 0);
+        break;
+    case IR_METHOD:
+        _emit(c, VM_METHOD, d, _reg(c, instr->a), instr->b);
+        break;
+    case IR_CALL:
+    case IR_CALL_INDIRECT:
+        _call(c, value);
+        break;
+    case IR_CALL_SECOND:
+        _emit(c, VM_SECOND, d, 0, 0);
+        break;
+    case IR_NEW:
+        _emit(c, VM_NEW, d, instr->a, 0);
+        break;
+    case IR_LOAD:
+        _emit(c, VM_LOAD, d, _reg(c, instr->a), instr->b);
+        break;
+    case IR_STORE:
+        _emit(c, VM_STORE, _reg(c, instr->a), _reg(c, instr->b), instr->c);
+        break;
+    case IR_JUMP:
+        _edge(c, block, instr->a, next);
+        break;
+    case IR_BRANCH:
+        _branch(c, block, instr, next);
+        break;
+    case IR_JUMP_TABLE:
+        _jump_table(c, block, instr);
+        break;
+    case IR_RETURN:
+        if (instr->b != IR_NONE)
+            _emit(c, VM_RET2, _reg(c, instr->a), _reg(c, instr->b), 0);
+        else if (instr->a != IR_NONE)
+            _emit(c, VM_RET, _reg(c, instr->a), 0, 0);
+        else
+            _emit(c, VM_RETV, 0, 0, 0);
+        break;
+    case IR_SWITCH:
+    case IR_UNREACHABLE:
+        _emit(c, VM_TRAP, 0, 0, 0);
+        break;
+    }
+}
+
+static bool _compile(vm_t *vm, uint32_t index)
+{
+    ir_function_t *function = &vm->module->functions[index];
+    uint32_t instrs = function->instr_count, blocks = function->block_count, k, i;
+    vm_compiler_t c = {.vm = vm, .function = function};
+
+    c.order = malloc(blocks * sizeof(uint32_t));
+    c.registers = calloc(instrs, sizeof(uint32_t));
+    c.uses = calloc(instrs, sizeof(uint32_t));
+    c.fused = calloc(instrs, 1);
+    c.block_offset = malloc(blocks * sizeof(uint32_t));
+    c.failed = c.order == NULL || c.registers == NULL || c.uses == NULL || c.fused == NULL
+               || c.block_offset == NULL;
+
+    if (!c.failed) {
+        c.order_count = ir_reverse_postorder(function, c.order);
+        _prepare(&c);
+    }
+    for (k = 0; k < c.order_count && !c.failed; k++) {
+        uint32_t b = c.order[k], next = k + 1 < c.order_count ? c.order[k + 1] : UINT32_MAX;
+        const ir_block_t *block = &function->blocks[b];
+        c.block_offset[b] = c.size;
+        for (i = 0; i < block->count; i++)
+            _instruction(&c, b, block->instrs[i], next);
+    }
+    /* Edges with moves go last; their jumps add fixups of their own, without moves */
+    for (i = 0; i < c.fixup_count && !c.failed; i++) {
+        vm_fixup_t fixup = c.fixups[i];
+        if (fixup.from == UINT32_MAX) {
+            c.code[fixup.at] = c.block_offset[fixup.block];
+            continue;
+        }
+        c.code[fixup.at] = c.size;
+        _edge(&c, fixup.from, fixup.block, UINT32_MAX);
+    }
+
+    vm_function_t *compiled = &vm->functions[index];
+    compiled->code = c.code;
+    compiled->size = c.size;
+    compiled->frame_size = c.scratch + 1;
+    compiled->param_count = function->param_count;
+    free(c.order);
+    free(c.registers);
+    free(c.uses);
+    free(c.fused);
+    free(c.block_offset);
+    free(c.fixups);
+    return !c.failed;
+}
+
+bool vm_init(vm_t *vm, ir_module_t *module)
+{
+    bool switches = false;
+    uint32_t i, b;
+
+    memset(vm, 0, sizeof(vm_t));
+    vm->module = module;
+    for (i = 0; i < module->function_count; i++) {
+        const ir_function_t *function = &module->functions[i];
+        if (function->error != NULL) {
+            vm->error = "function failed to lower";
+            return false;
+        }
+        for (b = 0; b < function->block_count && !switches; b++) {
+            ir_value_t terminator = ir_terminator(function, b);
+            switches = terminator != IR_NONE && function->instrs[terminator].op == IR_SWITCH;
+        }
+    }
+    if (switches)
+        opt_run_pass(module, "switch", NULL);
+
+    vm->error = "out of memory";
+    if (!arena_init(&vm->heap))
+        return false;
+    vm->functions = calloc(module->function_count + 1, sizeof(vm_function_t));
+    vm->stack = malloc(VM_STACK_SIZE * sizeof(uint64_t));
+    vm->frames = malloc(VM_MAX_FRAMES * sizeof(vm_frame_t));
+    if (vm->functions == NULL || vm->stack == NULL || vm->frames == NULL)
+        return false;
+    for (i = 0; i < module->function_count; i++)
+        if (!_compile(vm, i))
+            return false;
+    vm->error = NULL;
+    return true;
+}
+
+void vm_destroy(vm_t *vm)
+{
+    uint32_t i;
+    if (vm->functions != NULL)
+        for (i = 0; i < vm->module->function_count; i++)
+            free(vm->functions[i].code);
+    free(vm->functions);
+    free(vm->caches);
+    free(vm->stack);
+    free(vm->frames);
+    arena_destroy(&vm->heap);
+    memset(vm, 0, sizeof(vm_t));
+}
+
+uint32_t vm_find_function(const vm_t *vm, const char *name)
+{
+    uint32_t i;
+    for (i = 0; i < vm->module->function_count; i++)
+        if (strcmp(vm->module->functions[i].name, name) == 0)
+            return i;
+    return UINT32_MAX;
+}
+
+/* Running */
+
+#define R(i) base[pc[i]]
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(name) label_##name
+#define VM_NEXT(size) \
+    do { \
+        pc += (size); \
+        goto *labels[*pc]; \
+    } while (0)
+#else
+#define VM_CASE(name) case VM_##name
+#define VM_NEXT(size) \
+    do { \
+        pc += (size); \
+        goto dispatch; \
+    } while (0)
+#endif
+
+#define VM_COMPARE(name, test) \
+    VM_CASE(name) : R(1) = (test); \
+    VM_NEXT(4)
+#define VM_BRANCH(name, test) \
+    VM_CASE(name) : pc = (test) ? function->code + pc[3] : pc + 4; \
+    VM_NEXT(0)
+
+static bool _run(vm_t *vm, const vm_function_t *function, uint64_t *base, uint64_t *result)
+{
+#ifdef VM_COMPUTED_GOTO
+    static const void *const labels[VM_OP_COUNT] = {
+        [VM_CONST] = &&label_CONST,   [VM_MOV] = &&label_MOV,       [VM_ADD] = &&label_ADD,
+        [VM_SUB] = &&label_SUB,       [VM_MUL] = &&label_MUL,       [VM_ADDI] = &&label_ADDI,
+        [VM_DIVS] = &&label_DIVS,     [VM_DIVU] = &&label_DIVU,     [VM_MODS] = &&label_MODS,
+        [VM_MODU] = &&label_MODU,     [VM_NEG] = &&label_NEG,       [VM_NOT] = &&label_NOT,
+        [VM_SEXT8] = &&label_SEXT8,   [VM_SEXT16] = &&label_SEXT16, [VM_SEXT32] = &&label_SEXT32,
+        [VM_ZEXT8] = &&label_ZEXT8,   [VM_ZEXT16] = &&label_ZEXT16, [VM_ZEXT32] = &&label_ZEXT32,
+        [VM_EQ] = &&label_EQ,         [VM_NE] = &&label_NE,         [VM_LT] = &&label_LT,
+        [VM_LE] = &&label_LE,         [VM_LTU] = &&label_LTU,       [VM_LEU] = &&label_LEU,
+        [VM_BT] = &&label_BT,         [VM_FUNC] = &&label_FUNC,     [VM_VTABLE] = &&label_VTABLE,
+        [VM_METHOD] = &&label_METHOD, [VM_CALL] = &&label_CALL,     [VM_CALLI] = &&label_CALLI,
+        [VM_CALLM] = &&label_CALLM,   [VM_SECOND] = &&label_SECOND, [VM_NEW] = &&label_NEW,
+        [VM_LOAD] = &&label_LOAD,     [VM_STORE] = &&label_STORE,   [VM_JMP] = &&label_JMP,
+        [VM_BRT] = &&label_BRT,       [VM_BRF] = &&label_BRF,       [VM_BEQ] = &&label_BEQ,
+        [VM_BNE] = &&label_BNE,       [VM_BLT] = &&label_BLT,       [VM_BLE] = &&label_BLE,
+        [VM_BLTU] = &&label_BLTU,     [VM_BLEU] = &&label_BLEU,     [VM_JTAB] = &&label_JTAB,
+        [VM_RET] = &&label_RET,       [VM_RET2] = &&label_RET2,     [VM_RETV] = &&label_RETV,
+        [VM_TRAP] = &&label_TRAP};
+#endif
+    const uint64_t *stack_end = vm->stack + VM_STACK_SIZE;
+    const vm_frame_t *frames_end = vm->frames + VM_MAX_FRAMES;
+    vm_frame_t *frame = vm->frames;
+    const uint32_t *pc = function->code, *args;
+    const vm_function_t *callee;
+    uint64_t value, second = 0;
+    uint32_t count, dest, i;
+
+#ifdef VM_COMPUTED_GOTO
+    VM_NEXT(0);
+#else
+dispatch:
+    switch ((vm_op_t) *pc) {
+#endif
+    VM_CASE(CONST) : R(1) = (uint64_t) pc[2] | (uint64_t) pc[3] << 32;
+    VM_NEXT(4);
+    VM_CASE(MOV) : R(1) = R(2);
+    VM_NEXT(3);
+    VM_CASE(ADD) : R(1) = R(2) + R(3);
+    VM_NEXT(4);
+    VM_CASE(SUB) : R(1) = R(2) - R(3);
+    VM_NEXT(4);
+    VM_CASE(MUL) : R(1) = R(2) * R(3);
+    VM_NEXT(4);
+    VM_CASE(ADDI) : R(1) = R(2) + (uint64_t) (int64_t) (int32_t) pc[3];
+    VM_NEXT(4);
+    VM_CASE(DIVS) : if (R(3) == 0) goto divide_by_zero;
+    /* INT64_MIN / -1 overflows in C, wrap it like the optimizer does */
+    R(1) = (int64_t) R(3) == -1 ? 0 - R(2) : (uint64_t) ((int64_t) R(2) / (int64_t) R(3));
+    VM_NEXT(4);
+    VM_CASE(DIVU) : if (R(3) == 0) goto divide_by_zero;
+    R(1) = R(2) / R(3);
+    VM_NEXT(4);
+    VM_CASE(MODS) : if (R(3) == 0) goto divide_by_zero;
+    R(1) = (int64_t) R(3) == -1 ? 0 : (uint64_t) ((int64_t) R(2) % (int64_t) R(3));
+    VM_NEXT(4);
+    VM_CASE(MODU) : if (R(3) == 0) goto divide_by_zero;
+    R(1) = R(2) % R(3);
+    VM_NEXT(4);
+    VM_CASE(NEG) : R(1) = 0 - R(2);
+    VM_NEXT(3);
+    VM_CASE(NOT) : R(1) = R(2) ^ 1;
+    VM_NEXT(3);
+    VM_CASE(SEXT8) : R(1) = (uint64_t) (int64_t) (int8_t) R(1);
+    VM_NEXT(2);
+    VM_CASE(SEXT16) : R(1) = (uint64_t) (int64_t) (int16_t) R(1);
+    VM_NEXT(2);
+    VM_CASE(SEXT32) : R(1) = (uint64_t) (int64_t) (int32_t) R(1);
+    VM_NEXT(2);
+    VM_CASE(ZEXT8) : R(1) = (uint8_t) R(1);
+    VM_NEXT(2);
+    VM_CASE(ZEXT16) : R(1) = (uint16_t) R(1);
+    VM_NEXT(2);
+    VM_CASE(ZEXT32) : R(1) = (uint32_t) R(1);
+    VM_NEXT(2);
+    VM_COMPARE(EQ, R(2) == R(3));
+    VM_COMPARE(NE, R(2) != R(3));
+    VM_COMPARE(LT, (int64_t) R(2) < (int64_t) R(3));
+    VM_COMPARE(LE, (int64_t) R(2) <= (int64_t) R(3));
+    VM_COMPARE(LTU, R(2) < R(3));
+    VM_COMPARE(LEU, R(2) <= R(3));
+    VM_COMPARE(BT, (R(3) >> (R(2) & 63)) & 1);
+    VM_CASE(FUNC) : R(1) = (uint64_t) (size_t) &vm->functions[pc[2]];
+    VM_NEXT(3);
+    VM_CASE(VTABLE) : R(1) = (uint64_t) (size_t) &vm->module->vtables[pc[2]];
+    VM_NEXT(3);
+    VM_CASE(METHOD) : {
+        const ir_vtable_t *vtable = (const ir_vtable_t *) (size_t) R(2);
+        R(1) = (uint64_t) (size_t) &vm->functions[vtable->methods[pc[3]]];
+        VM_NEXT(4);
+    }
+    VM_CASE(CALL) : callee = &vm->functions[pc[2]];
+    count = pc[3];
+    args = pc + 4;
+    goto enter;
+    VM_CASE(CALLI) : callee = (const vm_function_t *) (size_t) R(2);
+    count = pc[3];
+    args = pc + 4;
+    goto enter;
+    VM_CASE(CALLM) : {
+        const ir_vtable_t *vtable = (const ir_vtable_t *) (size_t) R(2);
+        vm_cache_t *cache = &vm->caches[pc[4]];
+        if (cache->vtable == vtable) {
+            vm->cache_hits++;
+        } else {
+            vm->cache_misses++;
+            cache->vtable = vtable;
+            cache->target = &vm->functions[vtable->methods[pc[3]]];
+        }
+        callee = cache->target;
+        count = pc[5];
+        args = pc + 6;
+        goto enter;
+    }
+    VM_CASE(SECOND) : R(1) = second;
+    VM_NEXT(2);
+    VM_CASE(NEW) : {
+        void *object = arena_alloc_aligned(&vm->heap, pc[2] > 0 ? pc[2] : 8, 8);
+        if (object == NULL) {
+            vm->error = "out of memory";
+            return false;
+        }
+        memset(object, 0, pc[2]);
+        R(1) = (uint64_t) (size_t) object;
+        VM_NEXT(3);
+    }
+    VM_CASE(LOAD) : memcpy(&R(1), (const char *) (size_t) R(2) + pc[3], sizeof(uint64_t));
+    VM_NEXT(4);
+    VM_CASE(STORE) : memcpy((char *) (size_t) R(1) + pc[3], &R(2), sizeof(uint64_t));
+    VM_NEXT(4);
+    VM_CASE(JMP) : pc = function->code + pc[1];
+    VM_NEXT(0);
+    VM_CASE(BRT) : pc = R(1) ? function->code + pc[2] : pc + 3;
+    VM_NEXT(0);
+    VM_CASE(BRF) : pc = R(1) ? pc + 3 : function->code + pc[2];
+    VM_NEXT(0);
+    VM_BRANCH(BEQ, R(1) == R(2));
+    VM_BRANCH(BNE, R(1) != R(2));
+    VM_BRANCH(BLT, (int64_t) R(1) < (int64_t) R(2));
+    VM_BRANCH(BLE, (int64_t) R(1) <= (int64_t) R(2));
+    VM_BRANCH(BLTU, R(1) < R(2));
+    VM_BRANCH(BLEU, R(1) <= R(2));
+    VM_CASE(JTAB) : pc = function->code + pc[3 + R(1)];
+    VM_NEXT(0);
+    VM_CASE(RET) : value = R(1);
+    goto leave;
+    VM_CASE(RET2) : value = R(1);
+    second = R(2);
+    goto leave;
+    VM_CASE(RETV) : value = 0;
+    goto leave;
+    VM_CASE(TRAP) : vm->error = "reached unreachable code";
+    return false;
+#ifndef VM_COMPUTED_GOTO
+    default:
+        vm->error = "invalid opcode";
+        return false;
+    }
+#endif
+
+enter:
+    /* The callee's registers start after the caller's, parameters first */
+    dest = pc[1];
+    pc = args + count;
+    if (frame + 1 == frames_end || base + function->frame_size + callee->frame_size > stack_end) {
+        vm->error = "stack overflow";
+        return false;
+    }
+    frame++;
+    frame->pc = pc;
+    frame->base = base;
+    frame->function = function;
+    frame->dest = dest;
+    for (i = 0; i < count; i++)
+        base[function->frame_size + i] = base[args[i]];
+    base += function->frame_size;
+    function = callee;
+    pc = function->code;
+    VM_NEXT(0);
+
+leave:
+    if (frame == vm->frames) {
+        if (result != NULL)
+            *result = value;
+        return true;
+    }
+    pc = frame->pc;
+    base = frame->base;
+    function = frame->function;
+    base[frame->dest] = value;
+    frame--;
+    VM_NEXT(0);
+
+divide_by_zero:
+    vm->error = "division by zero";
+    return false;
+}
+
+bool vm_call(
+    vm_t *vm, uint32_t index, const uint64_t *args, uint32_t count, uint64_t *result)
+{
+    const vm_function_t *function = &vm->functions[index];
+    if (count != function->param_count || function->frame_size > VM_STACK_SIZE) {
+        vm->error = count != function->param_count ? "wrong argument count" : "stack overflow";
+        return false;
+    }
+    if (count > 0)
+        memcpy(vm->stack, args, count * sizeof(uint64_t));
+    vm->error = NULL;
+    return _run(vm, function, vm->stack, result);
+}
+
+/* Dumping */
+
+static uint32_t _dump_instr(const vm_t *vm, const uint32_t *pc, FILE *out)
+{
+    const char *format = _formats[*pc];
+    uint32_t size = 1, count, i;
+    fputs(_names[*pc], out);
+    for (; *format != '\0'; format++) {
+        fputs(size == 1 ? " " : ", ", out);
+        switch (*format) {
+        case 'r':
+            fprintf(out, "r%u", (unsigned) pc[size++]);
+            break;
+        case 'i':
+            fprintf(out, "%d", (int) (int32_t) pc[size++]);
+            break;
+        case 'k':
+            fprintf(out, "%llu", (unsigned long long) pc[size] | (unsigned long long) pc[size + 1]
+                                                                     << 32);
+            size += 2;
+            break;
+        case 'f':
+            fprintf(out, "%s", vm->module->functions[pc[size++]].name);
+            break;
+        case 't':
+            fprintf(out, "@%u", (unsigned) pc[size++]);
+            break;
+        case 'a':
+        case 'j':
+            count = pc[size++];
+            fputc(*format == 'a' ? '(' : '[', out);
+            for (i = 0; i < count; i++)
+                fprintf(out, *format == 'a' ? "%sr%u" : "%s@%u", i ? ", " : "",
+                    (unsigned) pc[size++]);
+            fputc(*format == 'a' ? ')' : ']', out);
+            break;
+        default:
+            fprintf(out, "%u", (unsigned) pc[size++]);
+            break;
+        }
+    }
+    fputc('\n', out);
+    return size;
+}
+
+void vm_dump_function(const vm_t *vm, uint32_t index, FILE *out)
+{
+    const vm_function_t *function = &vm->functions[index];
+    uint32_t at = 0;
+    fprintf(out, "function %s (%u registers) {\n", vm->module->functions[index].name,
+        (unsigned) function->frame_size);
+    while (at < function->size) {
+        fprintf(out, "%6u  ", (unsigned) at);
+        at += _dump_instr(vm, function->code + at, out);
+    }
+    fputs("}\n", out);
+}
+
+void vm_dump(const vm_t *vm, FILE *out)
+{
+    uint32_t i;
+    for (i = 0; i < vm->module->function_count; i++)
+        vm_dump_function(vm, i, out);
+}
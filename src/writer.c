@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <writer.h>
+
+#define WRITER_MEMORY_SIZE 4096
+
+static const char _digit_pairs[] = "00010203040506070809"
+                                   "10111213141516171819"
+                                   "20212223242526272829"
+                                   "30313233343536373839"
+                                   "40414243444546474849"
+                                   "50515253545556575859"
+                                   "60616263646566676869"
+                                   "70717273747576777879"
+                                   "80818283848586878889"
+                                   "90919293949596979899";
+
+static bool _init(writer_t *writer, int fd, size_t capacity)
+{
+    writer->data = malloc(capacity);
+    writer->size = 0;
+    writer->capacity = capacity;
+    writer->fd = fd;
+    writer->failed = writer->data == NULL;
+    return !writer->failed;
+}
+
+bool writer_init(writer_t *writer, int fd)
+{
+    return _init(writer, fd, WRITER_BUFFER_SIZE);
+}
+
+bool writer_init_memory(writer_t *writer)
+{
+    return _init(writer, -1, WRITER_MEMORY_SIZE);
+}
+
+/* Writes every vector fully, retrying after signals and short writes. */
+static bool _write_all(int fd, struct iovec *vectors, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(fd, vectors, count);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            return false;
+        while (count > 0 && (size_t) written >= vectors->iov_len) {
+            written -= (ssize_t) vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base = (char *) vectors->iov_base + written;
+            vectors->iov_len -= (size_t) written;
+        }
+    }
+    return true;
+}
+
+/* Sends the buffer and then `size` more bytes in one call. */
+static void _send(writer_t *writer, const void *data, size_t size)
+{
+    struct iovec vectors[2];
+    int count = 0;
+    if (writer->size > 0) {
+        vectors[count].iov_base = writer->data;
+        vectors[count++].iov_len = writer->size;
+    }
+    if (size > 0) {
+        vectors[count].iov_base = (void *) data;
+        vectors[count++].iov_len = size;
+    }
+    if (count > 0 && !_write_all(writer->fd, vectors, count))
+        writer->failed = true;
+    writer->size = 0;
+}
+
+/* Makes room for `size` more bytes, plus a terminator for memory writers. */
+static bool _reserve(writer_t *writer, size_t size)
+{
+    if (writer->failed)
+        return false;
+    if (writer->capacity - writer->size > size)
+        return true;
+
+    if (writer->fd >= 0) {
+        _send(writer, NULL, 0);
+        return !writer->failed && writer->capacity > size;
+    }
+
+    size_t capacity = writer->capacity * 2;
+    while (capacity - writer->size <= size)
+        capacity *= 2;
+    char *grown = realloc(writer->data, capacity);
+    if (grown == NULL) {
+        writer->failed = true;
+        return false;
+    }
+    writer->data = grown;
+    writer->capacity = capacity;
+    return true;
+}
+
+void writer_write(writer_t *writer, const void *data, size_t size)
+{
+    if (writer->failed)
+        return;
+    /* Big pieces skip the copy when they would not fit anyway */
+    if (writer->fd >= 0 && size >= writer->capacity - writer->size
+        && size >= writer->capacity / 2) {
+        _send(writer, data, size);
+        return;
+    }
+    if (_reserve(writer, size)) {
+        memcpy(writer->data + writer->size, data, size);
+        writer->size += size;
+    }
+}
+
+void writer_puts(writer_t *writer, const char *text)
+{
+    writer_write(writer, text, strlen(text));
+}
+
+void writer_putc(writer_t *writer, char c)
+{
+    if (writer->capacity - writer->size > 1 || _reserve(writer, 1))
+        writer->data[writer->size++] = c;
+}
+
+void writer_unsigned(writer_t *writer, uint64_t value)
+{
+    char digits[20];
+    char *end = digits + sizeof(digits), *start = end;
+
+    while (value >= 100) {
+        const char *pair = &_digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--start = pair[1];
+        *--start = pair[0];
+    }
+    if (value >= 10) {
+        *--start = _digit_pairs[value * 2 + 1];
+        *--start = _digit_pairs[value * 2];
+    } else {
+        *--start = (char) ('0' + value);
+    }
+    writer_write(writer, start, (size_t) (end - start));
+}
+
+void writer_signed(writer_t *writer, int64_t value)
+{
+    if (value >= 0) {
+        writer_unsigned(writer, (uint64_t) value);
+        return;
+    }
+    writer_putc(writer, '-');
+    /* Negate in unsigned arithmetic so INT64_MIN survives */
+    writer_unsigned(writer, 0 - (uint64_t) value);
+}
+
+bool writer_flush(writer_t *writer)
+{
+    if (writer->failed)
+        return false;
+    if (writer->fd >= 0)
+        _send(writer, NULL, 0);
+    else
+        writer->data[writer->size] = '\0';
+    return !writer->failed;
+}
+
+bool writer_destroy(writer_t *writer)
+{
+    bool ok = writer->data != NULL && writer_flush(writer);
+    free(writer->data);
+    writer->data = NULL;
+    writer->size = writer->capacity = 0;
+    return ok;
+}
@@ -0,0 +1,1469 @@
+/*
+ * Copyright (c) 2025, Ibrahim KAIKAA <ibrahimkaikaa@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include <emitter.h>
+#include <opt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86.h>
+
+typedef enum {
+    X86_RAX,
+    X86_RCX,
+    X86_RDX,
+    X86_RBX,
+    X86_RSP,
+    X86_RBP,
+    X86_RSI,
+    X86_RDI,
+    X86_R8,
+    X86_R9,
+    X86_R10,
+    X86_R11,
+    X86_R12,
+    X86_R13,
+    X86_R14,
+    X86_R15
+} x86_register_t;
+
+typedef enum {
+    X86_NOWHERE,
+    X86_REGISTER,
+    X86_STACK,
+    X86_IMMEDIATE
+} x86_kind_t;
+
+typedef struct
+{
+    uint8_t kind;
+    uint8_t reg;
+    /* Byte offset from rbp */
+    int32_t offset;
+    uint64_t value;
+} x86_location_t;
+
+typedef struct
+{
+    ir_value_t value;
+    uint32_t start;
+    uint32_t end;
+    bool crosses_call;
+} x86_interval_t;
+
+typedef struct
+{
+    x86_location_t from;
+    x86_location_t to;
+} x86_move_t;
+
+/* Symbol names of the module's functions and vtables */
+typedef struct
+{
+    const char **functions;
+    const char **vtables;
+} x86_symbols_t;
+
+typedef struct
+{
+    const ir_module_t *module;
+    const x86_symbols_t *symbols;
+    ir_function_t *function;
+    uint32_t index;
+    emitter_t *out;
+    /* Reachable blocks in layout order */
+    uint32_t *order;
+    uint32_t order_count;
+    /* Position of each instruction; block b spans block_start[b]..block_end[b] */
+    uint32_t *position;
+    uint32_t *block_start;
+    uint32_t *block_end;
+    uint32_t *uses;
+    /* Compares emitted as part of the branch right after them */
+    uint8_t *fused;
+    /* Live interval of each value */
+    uint32_t *start;
+    uint32_t *end;
+    /* Positions of calls, ascending */
+    uint32_t *calls;
+    uint32_t call_count;
+    x86_location_t *locations;
+    uint8_t saved[5];
+    uint32_t saved_count;
+    uint32_t spill_count;
+    uint32_t table_count;
+    /* Leaves without spills or stack parameters run without rbp frames */
+    bool framed;
+} x86_codegen_t;
+
+static const char *_reg64[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+static const char *_reg32[] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+static const char *_reg16[] = {
+    "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"};
+static const char *_reg8[] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+
+static const uint8_t _arguments[] = {X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9};
+static const uint8_t _caller_saved[] = {X86_RCX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10};
+static const uint8_t _callee_saved[] = {X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15};
+
+/* Condition codes in pairs, the negation of condition i is i ^ 1 */
+static const char *_conditions[] = {
+    "e", "ne", "l", "ge", "le", "g", "b", "ae", "be", "a", "c", "nc"};
+static const char *_jumps[] = {
+    "je", "jne", "jl", "jge", "jle", "jg", "jb", "jae", "jbe", "ja", "jc", "jnc"};
+
+#define X86_ARGUMENT_REGISTERS 6
+
+/* Operands and emission */
+
+static char *_format(arena_t *arena, const char *format, const char *name, uint32_t number)
+{
+    int length = snprintf(NULL, 0, format, name, number);
+    char *text = length >= 0 ? arena_alloc(arena, (size_t) length + 1) : NULL;
+    if (text != NULL)
+        snprintf(text, (size_t) length + 1, format, name, number);
+    return text;
+}
+
+static bool _name_symbols(const ir_module_t *module, x86_symbols_t *symbols)
+{
+    uint32_t i;
+    symbols->functions = arena_alloc_aligned(
+        module->arena, (module->function_count + 1) * sizeof(char *), sizeof(char *));
+    symbols->vtables = arena_alloc_aligned(
+        module->arena, (module->vtable_count + 1) * sizeof(char *), sizeof(char *));
+    if (symbols->functions == NULL || symbols->vtables == NULL)
+        return false;
+    for (i = 0; i < module->function_count; i++) {
+        const char *name = module->functions[i].name;
+        /* Two impls of different interfaces may give a class methods of the same name */
+        symbols->functions[i]
+            = _format(module->arena, strchr(name, '.') != NULL ? "dash.%s.%u" : "dash.%s", name, i);
+        if (symbols->functions[i] == NULL)
+            return false;
+    }
+    for (i = 0; i < module->vtable_count; i++)
+        if ((symbols->vtables[i] = _format(module->arena, "%s%u", ".Lvtable", i)) == NULL)
+            return false;
+    return true;
+}
+
+/* Emits `mnemonic` with up to two register operands, NULL for none */
+static void _emit(x86_codegen_t *x, const char *mnemonic, const char *first, const char *second)
+{
+    emitter_instr(x->out, mnemonic);
+    if (first != NULL)
+        emitter_register(x->out, first);
+    if (second != NULL)
+        emitter_register(x->out, second);
+    emitter_end(x->out);
+}
+
+/* Emits `mnemonic` with a register and an immediate */
+static void _emit_value(x86_codegen_t *x, const char *mnemonic, const char *reg, int64_t value)
+{
+    emitter_instr(x->out, mnemonic);
+    emitter_register(x->out, reg);
+    emitter_immediate(x->out, value);
+    emitter_end(x->out);
+}
+
+static void _jump(x86_codegen_t *x, const char *mnemonic, uint32_t block)
+{
+    emitter_instr(x->out, mnemonic);
+    emitter_local_operand(x->out, ".L", x->index, block);
+    emitter_end(x->out);
+}
+
+static x86_location_t _register(x86_register_t reg)
+{
+    x86_location_t location = {X86_REGISTER, (uint8_t) reg, 0, 0};
+    return location;
+}
+
+static x86_location_t _immediate(uint64_t value)
+{
+    x86_location_t location = {X86_IMMEDIATE, 0, 0, value};
+    return location;
+}
+
+static bool _same(const x86_location_t *a, const x86_location_t *b)
+{
+    if (a->kind != b->kind)
+        return false;
+    switch ((x86_kind_t) a->kind) {
+    case X86_REGISTER:
+        return a->reg == b->reg;
+    case X86_STACK:
+        return a->offset == b->offset;
+    case X86_IMMEDIATE:
+        return a->value == b->value;
+    default:
+        return true;
+    }
+}
+
+static bool _fits_imm32(uint64_t value)
+{
+    return (int64_t) value >= INT32_MIN && (int64_t) value <= INT32_MAX;
+}
+
+static bool _is_callee_saved(uint8_t reg)
+{
+    return reg == X86_RBX || reg >= X86_R12;
+}
+
+static void _operand(x86_codegen_t *x, const x86_location_t *location)
+{
+    switch ((x86_kind_t) location->kind) {
+    case X86_REGISTER:
+        emitter_register(x->out, _reg64[location->reg]);
+        break;
+    case X86_STACK:
+        emitter_memory(x->out, "qword", "rbp", NULL, 1, location->offset);
+        break;
+    default:
+        emitter_immediate(x->out, (int64_t) location->value);
+        break;
+    }
+}
+
+/* Emits `mnemonic` with operands in locations, NULL for none */
+static void _emit_locations(
+    x86_codegen_t *x,
+    const char *mnemonic,
+    const x86_location_t *first,
+    const x86_location_t *second)
+{
+    emitter_instr(x->out, mnemonic);
+    if (first != NULL)
+        _operand(x, first);
+    if (second != NULL)
+        _operand(x, second);
+    emitter_end(x->out);
+}
+
+static x86_location_t _location(const x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    if (instr->op == IR_CONST)
+        return _immediate(ir_const_value(instr));
+    return x->locations[value];
+}
+
+static void _move(x86_codegen_t *x, x86_location_t to, x86_location_t from)
+{
+    if (to.kind == X86_NOWHERE || from.kind == X86_NOWHERE || _same(&to, &from))
+        return;
+
+    if (to.kind == X86_REGISTER && from.kind == X86_IMMEDIATE) {
+        if (from.value == 0) {
+            _emit(x, "xor", _reg32[to.reg], _reg32[to.reg]);
+            return;
+        }
+        /* Writing the low half zeroes the rest and saves the REX prefix */
+        bool low = from.value <= UINT32_MAX;
+        emitter_instr(x->out, low || _fits_imm32(from.value) ? "mov" : "movabs");
+        emitter_register(x->out, low ? _reg32[to.reg] : _reg64[to.reg]);
+        emitter_immediate(x->out, (int64_t) from.value);
+        emitter_end(x->out);
+    } else if (to.kind == X86_STACK
+               && (from.kind == X86_STACK
+                   || (from.kind == X86_IMMEDIATE && !_fits_imm32(from.value)))) {
+        _move(x, _register(X86_RAX), from);
+        _move(x, to, _register(X86_RAX));
+    } else {
+        _emit_locations(x, "mov", &to, &from);
+    }
+}
+
+/* Makes `location` usable as the second operand of an ALU instruction. */
+static x86_location_t _source(x86_codegen_t *x, x86_location_t location, x86_register_t scratch)
+{
+    if (location.kind == X86_IMMEDIATE && !_fits_imm32(location.value)) {
+        _move(x, _register(scratch), location);
+        return _register(scratch);
+    }
+    return location;
+}
+
+/* Puts `location` in a register, `scratch` unless it already is one. */
+static x86_register_t _in_register(
+    x86_codegen_t *x, x86_location_t location, x86_register_t scratch)
+{
+    if (location.kind == X86_REGISTER)
+        return location.reg;
+    _move(x, _register(scratch), location);
+    return scratch;
+}
+
+/*
+ * Performs all `moves` as if every source were read before any destination
+ * is written. Clobbers rax for stack to stack moves and r11 to break cycles.
+ */
+static void _parallel_move(x86_codegen_t *x, x86_move_t *moves, uint32_t count)
+{
+    uint32_t kept = 0, i, j;
+    for (i = 0; i < count; i++)
+        if (moves[i].to.kind != X86_NOWHERE && !_same(&moves[i].from, &moves[i].to))
+            moves[kept++] = moves[i];
+    count = kept;
+
+    while (count > 0) {
+        bool progress = false;
+        i = 0;
+        while (i < count) {
+            for (j = 0; j < count && (j == i || !_same(&moves[j].from, &moves[i].to)); j++)
+                ;
+            if (j < count) {
+                i++;
+                continue;
+            }
+            _move(x, moves[i].to, moves[i].from);
+            moves[i] = moves[--count];
+            progress = true;
+        }
+        if (!progress) {
+            /* Only cycles are left: park one destination in r11 and read it from there */
+            x86_location_t parked = moves[0].to, scratch = _register(X86_R11);
+            _move(x, scratch, parked);
+            for (i = 0; i < count; i++)
+                if (_same(&moves[i].from, &parked))
+                    moves[i].from = scratch;
+        }
+    }
+}
+
+/* Critical edges */
+
+typedef struct
+{
+    uint32_t *targets;
+    uint32_t *splits;
+    uint32_t count;
+} x86_targets_t;
+
+static void _collect_target(void *context, uint32_t *target)
+{
+    x86_targets_t *targets = context;
+    targets->targets[targets->count++] = *target;
+}
+
+static void _retarget(void *context, uint32_t *target)
+{
+    x86_targets_t *targets = context;
+    uint32_t i;
+    for (i = 0; i < targets->count && targets->targets[i] != *target; i++)
+        ;
+    *target = targets->splits[i];
+}
+
+static bool _has_phis(const ir_function_t *function, uint32_t block)
+{
+    const ir_block_t *target = &function->blocks[block];
+    return target->count > 0 && function->instrs[target->instrs[0]].op == IR_PHI;
+}
+
+/*
+ * Gives every edge from a block with several successors into a block with
+ * phis a block of its own, so phi moves can always go before a jump.
+ * Duplicate edges of a switch share the new block.
+ */
+static bool _split_critical_edges(ir_function_t *function, arena_t *arena)
+{
+    uint32_t count = function->block_count, b, i, j;
+    uint32_t *targets = NULL, *splits = NULL, capacity = 0;
+    bool ok = true;
+
+    for (b = 0; b < count && ok; b++) {
+        uint32_t successors = ir_successor_count(function, b);
+        if (successors < 2)
+            continue;
+        if (successors > capacity) {
+            capacity = successors;
+            free(targets);
+            free(splits);
+            targets = malloc(capacity * sizeof(uint32_t));
+            splits = malloc(capacity * sizeof(uint32_t));
+            if (targets == NULL || splits == NULL) {
+                ok = false;
+                break;
+            }
+        }
+
+        x86_targets_t collected = {targets, splits, 0};
+        ir_value_t terminator = ir_terminator(function, b);
+        ir_for_each_target(function, terminator, _collect_target, &collected);
+        bool changed = false;
+        for (i = 0; i < collected.count && ok; i++) {
+            for (j = 0; j < i && targets[j] != targets[i]; j++)
+                ;
+            splits[i] = j < i ? splits[j] : targets[i];
+            if (j < i || !_has_phis(function, targets[i]))
+                continue;
+            uint32_t split = ir_add_block(function, arena);
+            ok = split != UINT32_MAX
+                 && ir_append(function, arena, split, IR_JUMP, IR_VOID, targets[i], 0, 0)
+                        != IR_NONE
+                 && ir_add_pred(function, arena, split, b)
+                 && ir_replace_pred(function, arena, targets[i], b, &split, 1);
+            splits[i] = split;
+            changed = true;
+        }
+        if (ok && changed)
+            ir_for_each_target(function, terminator, _retarget, &collected);
+    }
+
+    free(targets);
+    free(splits);
+    return ok;
+}
+
+/* Liveness and live intervals */
+
+typedef struct
+{
+    const ir_function_t *function;
+    uint64_t *set;
+} x86_live_t;
+
+typedef struct
+{
+    x86_codegen_t *x;
+    uint32_t position;
+} x86_use_t;
+
+static void _mark_live(void *context, uint32_t *operand)
+{
+    x86_live_t *live = context;
+    if (live->function->instrs[*operand].op != IR_CONST)
+        live->set[*operand >> 6] |= (uint64_t) 1 << (*operand & 63);
+}
+
+static void _count_use(void *context, uint32_t *operand)
+{
+    uint32_t *uses = context;
+    uses[*operand]++;
+}
+
+static void _cover(x86_codegen_t *x, ir_value_t value, uint32_t position)
+{
+    if (position < x->start[value])
+        x->start[value] = position;
+    if (position > x->end[value])
+        x->end[value] = position;
+}
+
+static void _extend_use(void *context, uint32_t *operand)
+{
+    x86_use_t *use = context;
+    if (use->x->function->instrs[*operand].op != IR_CONST)
+        _cover(use->x, *operand, use->position);
+}
+
+static void _number(x86_codegen_t *x)
+{
+    ir_function_t *function = x->function;
+    uint32_t next = 2, k, i;
+
+    for (k = 0; k < x->order_count; k++) {
+        uint32_t b = x->order[k];
+        const ir_block_t *block = &function->blocks[b];
+        x->block_start[b] = next;
+        for (i = 0; i < block->count; i++) {
+            ir_value_t value = block->instrs[i];
+            ir_op_t op = function->instrs[value].op;
+            /* Phis and parameters are all defined on entry to their block */
+            x->position[value] = op == IR_PHI || op == IR_PARAM ? x->block_start[b] : next;
+            if (op == IR_CALL || op == IR_CALL_INDIRECT || op == IR_NEW)
+                x->calls[x->call_count++] = next;
+            ir_for_each_operand(function, value, _count_use, x->uses);
+            next += 2;
+        }
+        x->block_end[b] = next - 1;
+    }
+
+    /* A compare used only by the branch right after it becomes its flags */
+    for (k = 0; k < x->order_count; k++) {
+        const ir_block_t *block = &function->blocks[x->order[k]];
+        if (block->count < 2)
+            continue;
+        const ir_instr_t *last = &function->instrs[block->instrs[block->count - 1]];
+        ir_value_t before = block->instrs[block->count - 2];
+        ir_op_t op = function->instrs[before].op;
+        if (last->op == IR_BRANCH && last->a == before && x->uses[before] == 1 && op >= IR_EQ
+            && op <= IR_BIT_TEST)
+            x->fused[before] = 1;
+    }
+}
+
+static void _live_out(
+    const x86_codegen_t *x, uint32_t block, const uint64_t *live_in, uint64_t *out, uint32_t words)
+{
+    const ir_function_t *function = x->function;
+    uint32_t count = ir_successor_count(function, block), s, w, i;
+    x86_live_t live = {function, out};
+
+    memset(out, 0, words * sizeof(uint64_t));
+    for (s = 0; s < count; s++) {
+        uint32_t successor = ir_successor(function, block, s);
+        const ir_block_t *target = &function->blocks[successor];
+        for (w = 0; w < words; w++)
+            out[w] |= live_in[(size_t) successor * words + w];
+        uint32_t index = ir_pred_index(function, successor, block);
+        for (i = 0; i < target->count; i++) {
+            const ir_instr_t *phi = &function->instrs[target->instrs[i]];
+            if (phi->op != IR_PHI)
+                break;
+            _mark_live(&live, &function->operands[phi->a + index]);
+        }
+    }
+}
+
+static bool _intervals(x86_codegen_t *x)
+{
+    ir_function_t *function = x->function;
+    uint32_t words = (function->instr_count + 63) / 64, k, i, w;
+    size_t size = (size_t) function->block_count * words;
+    uint64_t *live_in = calloc(size ? size : 1, sizeof(uint64_t));
+    uint64_t *live_out = calloc(size ? size : 1, sizeof(uint64_t));
+    uint64_t *live = malloc((words ? words : 1) * sizeof(uint64_t));
+    bool changed = true;
+    if (live_in == NULL || live_out == NULL || live == NULL) {
+        free(live_in);
+        free(live_out);
+        free(live);
+        return false;
+    }
+
+    /* Backwards dataflow, phi inputs are live at the end of their predecessor */
+    while (changed) {
+        changed = false;
+        for (k = x->order_count; k-- > 0;) {
+            uint32_t b = x->order[k];
+            const ir_block_t *block = &function->blocks[b];
+            uint64_t *out = &live_out[(size_t) b * words], *in = &live_in[(size_t) b * words];
+            x86_live_t context = {function, live};
+            _live_out(x, b, live_in, out, words);
+            memcpy(live, out, words * sizeof(uint64_t));
+            for (i = block->count; i-- > 0;) {
+                ir_value_t value = block->instrs[i];
+                live[value >> 6] &= ~((uint64_t) 1 << (value & 63));
+                if (function->instrs[value].op != IR_PHI)
+                    ir_for_each_operand(function, value, _mark_live, &context);
+            }
+            if (memcmp(live, in, words * sizeof(uint64_t)) != 0) {
+                memcpy(in, live, words * sizeof(uint64_t));
+                changed = true;
+            }
+        }
+    }
+
+    for (i = 0; i < function->instr_count; i++) {
+        x->start[i] = UINT32_MAX;
+        x->end[i] = 0;
+    }
+    for (k = 0; k < x->order_count; k++) {
+        uint32_t b = x->order[k];
+        const ir_block_t *block = &function->blocks[b];
+        for (w = 0; w < words; w++) {
+            uint64_t in = live_in[(size_t) b * words + w], out = live_out[(size_t) b * words + w];
+            while (in != 0) {
+                _cover(x, w * 64 + (uint32_t) __builtin_ctzll(in), x->block_start[b]);
+                in &= in - 1;
+            }
+            while (out != 0) {
+                _cover(x, w * 64 + (uint32_t) __builtin_ctzll(out), x->block_end[b]);
+                out &= out - 1;
+            }
+        }
+        for (i = 0; i < block->count; i++) {
+            ir_value_t value = block->instrs[i];
+            x86_use_t use = {x, x->position[value]};
+            if (function->instrs[value].type != IR_VOID)
+                _cover(x, value, x->position[value]);
+            if (function->instrs[value].op != IR_PHI)
+                ir_for_each_operand(function, value, _extend_use, &use);
+        }
+    }
+
+    free(live_in);
+    free(live_out);
+    free(live);
+    return true;
+}
+
+/* Linear scan */
+
+static int _compare_intervals(const void *a, const void *b)
+{
+    const x86_interval_t *left = a, *right = b;
+    if (left->start != right->start)
+        return left->start < right->start ? -1 : 1;
+    return left->value < right->value ? -1 : left->value > right->value;
+}
+
+static bool _crosses_call(const x86_codegen_t *x, uint32_t start, uint32_t end)
+{
+    uint32_t low = 0, high = x->call_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (x->calls[middle] <= start)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < x->call_count && x->calls[low] < end;
+}
+
+static void _spill(x86_codegen_t *x, ir_value_t value)
+{
+    x86_location_t location = {X86_STACK, 0, (int32_t) x->spill_count++, 0};
+    x->locations[value] = location;
+}
+
+static int _free_register(const bool *busy, bool crosses_call)
+{
+    uint32_t i;
+    if (!crosses_call)
+        for (i = 0; i < sizeof(_caller_saved); i++)
+            if (!busy[_caller_saved[i]])
+                return _caller_saved[i];
+    for (i = 0; i < sizeof(_callee_saved); i++)
+        if (!busy[_callee_saved[i]])
+            return _callee_saved[i];
+    return -1;
+}
+
+/* Register that would save a move for `value`, -1 when there is none */
+static int _hint(const x86_codegen_t *x, ir_value_t value)
+{
+    const ir_function_t *function = x->function;
+    const ir_instr_t *instr = &function->instrs[value];
+    const x86_location_t *operand;
+    uint32_t i;
+
+    switch ((ir_op_t) instr->op) {
+    case IR_PARAM:
+        /* rdx is not allocatable, div and mod clobber it: the third one gets copied */
+        if (instr->a >= X86_ARGUMENT_REGISTERS || _arguments[instr->a] == X86_RDX)
+            return -1;
+        return _arguments[instr->a];
+    case IR_PHI:
+        for (i = 0; i < instr->b; i++) {
+            operand = &x->locations[function->operands[instr->a + i]];
+            if (operand->kind == X86_REGISTER)
+                return operand->reg;
+        }
+        return -1;
+    case IR_COPY:
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_NEG:
+    case IR_NOT:
+    case IR_LOAD:
+    case IR_METHOD:
+        operand = &x->locations[instr->a];
+        if (operand->kind == X86_REGISTER && x->end[instr->a] == x->position[value])
+            return operand->reg;
+        return -1;
+    default:
+        return -1;
+    }
+}
+
+static void _scan(x86_codegen_t *x, x86_interval_t *intervals, uint32_t count)
+{
+    uint32_t active[16], active_count = 0, i, j;
+    bool busy[16] = {false}, used[16] = {false};
+
+    for (i = 0; i < count; i++) {
+        const x86_interval_t *current = &intervals[i];
+        /*
+         * Operands are read before the result is written, so a value whose
+         * last use is here can hand its register over; values defined at the
+         * same position (phis, parameters) never do.
+         */
+        for (j = 0; j < active_count;) {
+            const x86_interval_t *old = &intervals[active[j]];
+            if (old->end < current->start
+                || (old->end == current->start && old->start < current->start)) {
+                busy[x->locations[old->value].reg] = false;
+                active[j] = active[--active_count];
+            } else {
+                j++;
+            }
+        }
+
+        int reg = _hint(x, current->value);
+        if (reg < 0 || busy[reg] || (current->crosses_call && !_is_callee_saved((uint8_t) reg)))
+            reg = _free_register(busy, current->crosses_call);
+        if (reg >= 0) {
+            busy[reg] = used[reg] = true;
+            x->locations[current->value] = _register((x86_register_t) reg);
+            active[active_count++] = i;
+            continue;
+        }
+
+        /* Out of registers: whichever usable interval ends last goes to the stack */
+        uint32_t victim = UINT32_MAX;
+        for (j = 0; j < active_count; j++) {
+            const x86_interval_t *other = &intervals[active[j]];
+            uint8_t other_reg = x->locations[other->value].reg;
+            if ((!current->crosses_call || _is_callee_saved(other_reg))
+                && (victim == UINT32_MAX || other->end > intervals[active[victim]].end))
+                victim = j;
+        }
+        if (victim == UINT32_MAX || intervals[active[victim]].end <= current->end) {
+            _spill(x, current->value);
+            continue;
+        }
+        x->locations[current->value] = x->locations[intervals[active[victim]].value];
+        _spill(x, intervals[active[victim]].value);
+        active[victim] = i;
+    }
+
+    for (i = 0; i < sizeof(_callee_saved); i++)
+        if (used[_callee_saved[i]])
+            x->saved[x->saved_count++] = _callee_saved[i];
+}
+
+static bool _allocate(x86_codegen_t *x)
+{
+    const ir_function_t *function = x->function;
+    uint32_t count = 0, i;
+    x86_interval_t *intervals = malloc(function->instr_count * sizeof(x86_interval_t));
+    if (intervals == NULL)
+        return false;
+
+    for (i = 1; i < function->instr_count; i++) {
+        const ir_instr_t *instr = &function->instrs[i];
+        if (x->start[i] == UINT32_MAX || instr->type == IR_VOID || instr->op == IR_CONST
+            || x->fused[i])
+            continue;
+        x86_interval_t *interval = &intervals[count++];
+        interval->value = i;
+        interval->start = x->start[i];
+        interval->end = x->end[i];
+        interval->crosses_call = _crosses_call(x, x->start[i], x->end[i]);
+    }
+    qsort(intervals, count, sizeof(x86_interval_t), _compare_intervals);
+    _scan(x, intervals, count);
+    free(intervals);
+
+    /* Spill slots sit below the saved registers */
+    for (i = 1; i < function->instr_count; i++)
+        if (x->locations[i].kind == X86_STACK)
+            x->locations[i].offset = -8 * (int32_t) (x->saved_count + x->locations[i].offset + 1);
+    return true;
+}
+
+/* Instructions */
+
+static void _normalize(x86_codegen_t *x, x86_register_t reg, ir_type_t type)
+{
+    switch (type) {
+    case IR_I8:
+        _emit(x, "movsx", _reg64[reg], _reg8[reg]);
+        break;
+    case IR_I16:
+        _emit(x, "movsx", _reg64[reg], _reg16[reg]);
+        break;
+    case IR_I32:
+        _emit(x, "movsxd", _reg64[reg], _reg32[reg]);
+        break;
+    case IR_U8:
+        _emit(x, "movzx", _reg32[reg], _reg8[reg]);
+        break;
+    case IR_U16:
+        _emit(x, "movzx", _reg32[reg], _reg16[reg]);
+        break;
+    case IR_U32:
+        _emit(x, "mov", _reg32[reg], _reg32[reg]);
+        break;
+    default:
+        break;
+    }
+}
+
+static x86_register_t _result_register(const x86_location_t *to, x86_register_t scratch)
+{
+    return to->kind == X86_REGISTER ? (x86_register_t) to->reg : scratch;
+}
+
+static void _binary(x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    x86_location_t to = x->locations[value];
+    x86_location_t a = _location(x, instr->a), b = _location(x, instr->b);
+
+    /* Commutative operations read best with the destination or a register first */
+    if ((instr->op == IR_ADD || instr->op == IR_MUL)
+        && (_same(&to, &b) || (a.kind == X86_IMMEDIATE && b.kind != X86_IMMEDIATE))) {
+        x86_location_t swap = a;
+        a = b;
+        b = swap;
+    }
+
+    x86_register_t work;
+    if (instr->op == IR_ADD && to.kind == X86_REGISTER && a.kind == X86_REGISTER
+        && (b.kind == X86_REGISTER || (b.kind == X86_IMMEDIATE && _fits_imm32(b.value)))) {
+        work = (x86_register_t) to.reg;
+        emitter_instr(x->out, "lea");
+        emitter_register(x->out, _reg64[work]);
+        if (b.kind == X86_REGISTER)
+            emitter_memory(x->out, NULL, _reg64[a.reg], _reg64[b.reg], 1, 0);
+        else
+            emitter_memory(x->out, NULL, _reg64[a.reg], NULL, 1, (int64_t) b.value);
+        emitter_end(x->out);
+    } else {
+        work = to.kind == X86_REGISTER && !_same(&to, &b) ? (x86_register_t) to.reg : X86_R11;
+        _move(x, _register(work), a);
+        b = _source(x, b, X86_RAX);
+        x86_location_t result = _register(work);
+        if (instr->op == IR_MUL && b.kind == X86_IMMEDIATE) {
+            /* The three operand form takes the immediate */
+            emitter_instr(x->out, "imul");
+            emitter_register(x->out, _reg64[work]);
+            emitter_register(x->out, _reg64[work]);
+            emitter_immediate(x->out, (int64_t) b.value);
+            emitter_end(x->out);
+        } else {
+            const char *mnemonic = instr->op == IR_MUL ? "imul"
+                                   : instr->op == IR_ADD ? "add"
+                                                         : "sub";
+            _emit_locations(x, mnemonic, &result, &b);
+        }
+    }
+    _normalize(x, work, instr->type);
+    _move(x, to, _register(work));
+}
+
+static void _divide(x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    x86_location_t divisor = _location(x, instr->b);
+    bool is_signed = ir_type_signed(instr->type);
+
+    _move(x, _register(X86_RAX), _location(x, instr->a));
+    if (is_signed)
+        _emit(x, "cqo", NULL, NULL);
+    else
+        _emit(x, "xor", "edx", "edx");
+    if (divisor.kind == X86_IMMEDIATE) {
+        _move(x, _register(X86_R11), divisor);
+        divisor = _register(X86_R11);
+    }
+    _emit_locations(x, is_signed ? "idiv" : "div", &divisor, NULL);
+
+    x86_register_t result = instr->op == IR_DIV ? X86_RAX : X86_RDX;
+    _normalize(x, result, instr->type);
+    _move(x, x->locations[value], _register(result));
+}
+
+static void _unary(x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    x86_location_t to = x->locations[value];
+    x86_register_t work = _result_register(&to, X86_R11);
+
+    _move(x, _register(work), _location(x, instr->a));
+    if (instr->op == IR_NEG) {
+        _emit(x, "neg", _reg64[work], NULL);
+        _normalize(x, work, instr->type);
+    } else {
+        x86_location_t flag = _immediate(1);
+        emitter_instr(x->out, "xor");
+        emitter_register(x->out, _reg32[work]);
+        _operand(x, &flag);
+        emitter_end(x->out);
+    }
+    _move(x, to, _register(work));
+}
+
+/* Emits the flags for a compare and returns its index in _conditions. */
+static uint32_t _compare(x86_codegen_t *x, const ir_instr_t *instr)
+{
+    x86_location_t left = _location(x, instr->a), right = _location(x, instr->b);
+    ir_op_t op = instr->op;
+
+    if (op == IR_BIT_TEST) {
+        x86_location_t mask = _register(_in_register(x, right, X86_RAX));
+        if (left.kind == X86_IMMEDIATE)
+            left = _immediate(left.value & 63);
+        else
+            left = _register(_in_register(x, left, X86_R11));
+        _emit_locations(x, "bt", &mask, &left);
+        return 10;
+    }
+
+    bool is_signed = ir_type_signed(x->function->instrs[instr->a].type);
+    if (left.kind == X86_IMMEDIATE && right.kind != X86_IMMEDIATE) {
+        x86_location_t swap = left;
+        left = right;
+        right = swap;
+        if (op == IR_LT || op == IR_GT)
+            op = op == IR_LT ? IR_GT : IR_LT;
+        else if (op == IR_LE || op == IR_GE)
+            op = op == IR_LE ? IR_GE : IR_LE;
+    }
+    if (left.kind == X86_IMMEDIATE || (left.kind == X86_STACK && right.kind == X86_STACK))
+        left = _register(_in_register(x, left, X86_RAX));
+    right = _source(x, right, X86_R11);
+    _emit_locations(x, "cmp", &left, &right);
+
+    switch (op) {
+    case IR_EQ:
+        return 0;
+    case IR_NE:
+        return 1;
+    case IR_LT:
+        return is_signed ? 2 : 6;
+    case IR_GE:
+        return is_signed ? 3 : 7;
+    case IR_LE:
+        return is_signed ? 4 : 8;
+    default:
+        return is_signed ? 5 : 9;
+    }
+}
+
+static void _set_condition(x86_codegen_t *x, ir_value_t value)
+{
+    uint32_t condition = _compare(x, &x->function->instrs[value]);
+    char mnemonic[8] = "set";
+    strcat(mnemonic, _conditions[condition]);
+    _emit(x, mnemonic, "al", NULL);
+    _emit(x, "movzx", "eax", "al");
+    _move(x, x->locations[value], _register(X86_RAX));
+}
+
+/* Loads the 8 bytes at `offset` into the object in `base`. */
+static void _load(x86_codegen_t *x, ir_value_t value, ir_value_t base, uint32_t offset)
+{
+    x86_location_t to = x->locations[value];
+    x86_register_t object = _in_register(x, _location(x, base), X86_R11);
+    x86_register_t work = _result_register(&to, X86_RAX);
+    emitter_instr(x->out, "mov");
+    emitter_register(x->out, _reg64[work]);
+    emitter_memory(x->out, "qword", _reg64[object], NULL, 1, offset);
+    emitter_end(x->out);
+    _move(x, to, _register(work));
+}
+
+static void _store(x86_codegen_t *x, const ir_instr_t *instr)
+{
+    x86_register_t object = _in_register(x, _location(x, instr->a), X86_R11);
+    x86_location_t stored = _location(x, instr->b);
+    if (stored.kind != X86_IMMEDIATE || !_fits_imm32(stored.value))
+        stored = _register(_in_register(x, stored, X86_RAX));
+    emitter_instr(x->out, "mov");
+    emitter_memory(x->out, "qword", _reg64[object], NULL, 1, instr->c);
+    _operand(x, &stored);
+    emitter_end(x->out);
+}
+
+static void _address(x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    x86_location_t to = x->locations[value];
+    x86_register_t work = _result_register(&to, X86_RAX);
+
+    emitter_instr(x->out, "lea");
+    emitter_register(x->out, _reg64[work]);
+    emitter_rip_symbol(x->out, instr->op == IR_FUNC_ADDR ? x->symbols->functions[instr->a]
+                                                         : x->symbols->vtables[instr->a]);
+    emitter_end(x->out);
+    _move(x, to, _register(work));
+}
+
+static void _call(x86_codegen_t *x, ir_value_t value)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    const uint32_t *args = &x->function->operands[instr->b];
+    uint32_t stack = instr->c > X86_ARGUMENT_REGISTERS ? instr->c - X86_ARGUMENT_REGISTERS : 0;
+    uint32_t padding = stack & 1, count = 0, i;
+    x86_move_t moves[X86_ARGUMENT_REGISTERS + 1];
+
+    /* Stack arguments go first, before the register moves overwrite anything */
+    if (padding)
+        _emit_value(x, "sub", "rsp", 8);
+    for (i = instr->c; i-- > X86_ARGUMENT_REGISTERS;) {
+        x86_location_t arg = _location(x, args[i]);
+        if (arg.kind == X86_IMMEDIATE && !_fits_imm32(arg.value))
+            arg = _register(_in_register(x, arg, X86_RAX));
+        _emit_locations(x, "push", &arg, NULL);
+    }
+
+    for (i = 0; i < instr->c && i < X86_ARGUMENT_REGISTERS; i++) {
+        moves[count].from = _location(x, args[i]);
+        moves[count++].to = _register(_arguments[i]);
+    }
+    /* r10 is not an argument register and dies at the call anyway */
+    if (instr->op == IR_CALL_INDIRECT) {
+        moves[count].from = _location(x, instr->a);
+        moves[count++].to = _register(X86_R10);
+    }
+    _parallel_move(x, moves, count);
+
+    if (instr->op == IR_CALL_INDIRECT) {
+        _emit(x, "call", "r10", NULL);
+    } else {
+        emitter_instr(x->out, "call");
+        emitter_symbol_operand(x->out, x->symbols->functions[instr->a]);
+        emitter_end(x->out);
+    }
+    if (stack + padding > 0)
+        _emit_value(x, "add", "rsp", 8 * (stack + padding));
+    _move(x, x->locations[value], _register(X86_RAX));
+}
+
+static void _epilogue(x86_codegen_t *x)
+{
+    uint32_t i;
+    if (x->framed && x->saved_count == 0) {
+        _emit(x, "leave", NULL, NULL);
+    } else if (x->framed) {
+        emitter_instr(x->out, "lea");
+        emitter_register(x->out, "rsp");
+        emitter_memory(x->out, NULL, "rbp", NULL, 1, -8 * (int64_t) x->saved_count);
+        emitter_end(x->out);
+        for (i = x->saved_count; i-- > 0;)
+            _emit(x, "pop", _reg64[x->saved[i]], NULL);
+        _emit(x, "pop", "rbp", NULL);
+    }
+    _emit(x, "ret", NULL, NULL);
+}
+
+static bool _phi_moves(x86_codegen_t *x, uint32_t block, uint32_t successor)
+{
+    const ir_function_t *function = x->function;
+    const ir_block_t *target = &function->blocks[successor];
+    uint32_t index = ir_pred_index(function, successor, block), count = 0, i;
+    if (!_has_phis(function, successor))
+        return true;
+
+    x86_move_t *moves = malloc(target->count * sizeof(x86_move_t));
+    if (moves == NULL)
+        return false;
+    for (i = 0; i < target->count; i++) {
+        ir_value_t phi = target->instrs[i];
+        if (function->instrs[phi].op != IR_PHI)
+            break;
+        moves[count].from = _location(x, function->operands[function->instrs[phi].a + index]);
+        moves[count++].to = x->locations[phi];
+    }
+    _parallel_move(x, moves, count);
+    free(moves);
+    return true;
+}
+
+static void _branch(x86_codegen_t *x, const ir_instr_t *instr, uint32_t next)
+{
+    x86_location_t condition = _location(x, instr->a);
+    uint32_t code;
+
+    if (x->fused[instr->a]) {
+        code = _compare(x, &x->function->instrs[instr->a]);
+    } else if (condition.kind == X86_IMMEDIATE) {
+        uint32_t target = condition.value ? instr->b : instr->c;
+        if (target != next)
+            _jump(x, "jmp", target);
+        return;
+    } else {
+        if (condition.kind == X86_REGISTER)
+            _emit(x, "test", _reg64[condition.reg], _reg64[condition.reg]);
+        else
+            _emit_locations(x, "cmp", &condition, &(x86_location_t){X86_IMMEDIATE, 0, 0, 0});
+        code = 1;
+    }
+
+    if (instr->b == next) {
+        _jump(x, _jumps[code ^ 1], instr->c);
+        return;
+    }
+    _jump(x, _jumps[code], instr->b);
+    if (instr->c != next)
+        _jump(x, "jmp", instr->c);
+}
+
+static void _jump_table(x86_codegen_t *x, const ir_instr_t *instr)
+{
+    x86_register_t index = _in_register(x, _location(x, instr->a), X86_R11);
+    uint32_t table = x->table_count++, i;
+
+    emitter_instr(x->out, "lea");
+    emitter_register(x->out, "rax");
+    emitter_rip_local(x->out, ".Ltable", x->index, table);
+    emitter_end(x->out);
+    emitter_instr(x->out, "movsxd");
+    emitter_register(x->out, "rdx");
+    emitter_memory(x->out, "dword", "rax", _reg64[index], 4, 0);
+    emitter_end(x->out);
+    _emit(x, "add", "rax", "rdx");
+    _emit(x, "jmp", "rax", NULL);
+    emitter_align(x->out, 2);
+    emitter_define_local(x->out, ".Ltable", x->index, table);
+    for (i = 0; i < instr->c; i++)
+        emitter_long_difference(x->out, ".L", x->index, x->function->operands[instr->b + i],
+            ".Ltable", x->index, table);
+}
+
+static bool _instruction(x86_codegen_t *x, uint32_t block, ir_value_t value, uint32_t next)
+{
+    const ir_instr_t *instr = &x->function->instrs[value];
+    x86_location_t to = x->locations[value];
+
+    switch ((ir_op_t) instr->op) {
+    case IR_NOP:
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_PHI:
+        break;
+    case IR_COPY:
+        _move(x, to, _location(x, instr->a));
+        break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+        _binary(x, value);
+        break;
+    case IR_DIV:
+    case IR_MOD:
+        _divide(x, value);
+        break;
+    case IR_NEG:
+    case IR_NOT:
+        _unary(x, value);
+        break;
+    case IR_EQ:
+    case IR_NE:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_BIT_TEST:
+        if (!x->fused[value])
+            _set_condition(x, value);
+        break;
+    case IR_FUNC_ADDR:
+    case IR_VTABLE:
+        _address(x, value);
+        break;
+    case IR_METHOD:
+        _load(x, value, instr->a, 8 * instr->b);
+        break;
+    case IR_CALL:
+    case IR_CALL_INDIRECT:
+        _call(x, value);
+        break;
+    case IR_CALL_SECOND:
+        /* Nothing runs between the call and this, rdx still holds the second half */
+        _move(x, to, _register(X86_RDX));
+        break;
+    case IR_NEW:
+        _emit_value(x, "mov", "edi", instr->a);
+        emitter_instr(x->out, "call");
+        emitter_symbol_operand(x->out, "__dash_alloc");
+        emitter_end(x->out);
+        _move(x, to, _register(X86_RAX));
+        break;
+    case IR_LOAD:
+        _load(x, value, instr->a, instr->b);
+        break;
+    case IR_STORE:
+        _store(x, instr);
+        break;
+    case IR_JUMP:
+        if (!_phi_moves(x, block, instr->a))
+            return false;
+        if (instr->a != next)
+            _jump(x, "jmp", instr->a);
+        break;
+    case IR_BRANCH:
+        _branch(x, instr, next);
+        break;
+    case IR_JUMP_TABLE:
+        _jump_table(x, instr);
+        break;
+    case IR_RETURN:
+        if (instr->a != IR_NONE)
+            _move(x, _register(X86_RAX), _location(x, instr->a));
+        if (instr->b != IR_NONE)
+            _move(x, _register(X86_RDX), _location(x, instr->b));
+        _epilogue(x);
+        break;
+    case IR_SWITCH:
+    case IR_UNREACHABLE:
+        _emit(x, "ud2", NULL, NULL);
+        break;
+    }
+    return true;
+}
+
+/* Functions */
+
+static bool _prologue(x86_codegen_t *x)
+{
+    const ir_function_t *function = x->function;
+    const ir_block_t *entry = &function->blocks[0];
+    uint32_t frame = 8 * x->spill_count, count = 0, i;
+    x86_move_t *moves = malloc((entry->count + 1) * sizeof(x86_move_t));
+    if (moves == NULL)
+        return false;
+
+    x->framed = x->call_count > 0 || x->spill_count > 0 || x->saved_count > 0
+                || function->param_count > X86_ARGUMENT_REGISTERS;
+    if (x->framed) {
+        _emit(x, "push", "rbp", NULL);
+        _emit(x, "mov", "rbp", "rsp");
+    }
+    for (i = 0; i < x->saved_count; i++)
+        _emit(x, "push", _reg64[x->saved[i]], NULL);
+    /* Keep rsp 16 byte aligned for calls */
+    if ((8 * x->saved_count + frame) % 16 != 0)
+        frame += 8;
+    if (frame > 0)
+        _emit_value(x, "sub", "rsp", frame);
+
+    /* Parameters move from their ABI places all at once */
+    for (i = 0; i < entry->count; i++) {
+        ir_value_t value = entry->instrs[i];
+        const ir_instr_t *instr = &function->instrs[value];
+        if (instr->op != IR_PARAM || x->uses[value] == 0)
+            continue;
+        if (instr->a < X86_ARGUMENT_REGISTERS) {
+            moves[count].from = _register(_arguments[instr->a]);
+        } else {
+            x86_location_t slot = {X86_STACK, 0, (int32_t) (16 + 8 * (instr->a - 6)), 0};
+            moves[count].from = slot;
+        }
+        moves[count++].to = x->locations[value];
+    }
+    _parallel_move(x, moves, count);
+    free(moves);
+    return true;
+}
+
+static void _release(x86_codegen_t *x)
+{
+    free(x->order);
+    free(x->position);
+    free(x->block_start);
+    free(x->block_end);
+    free(x->uses);
+    free(x->fused);
+    free(x->start);
+    free(x->end);
+    free(x->calls);
+    free(x->locations);
+}
+
+static bool _emit_function(x86_codegen_t *x)
+{
+    ir_function_t *function = x->function;
+    uint32_t instrs = function->instr_count, blocks = function->block_count, k, i;
+
+    x->order = malloc(blocks * sizeof(uint32_t));
+    x->position = calloc(instrs, sizeof(uint32_t));
+    x->block_start = calloc(blocks, sizeof(uint32_t));
+    x->block_end = calloc(blocks, sizeof(uint32_t));
+    x->uses = calloc(instrs, sizeof(uint32_t));
+    x->fused = calloc(instrs, 1);
+    x->start = malloc(instrs * sizeof(uint32_t));
+    x->end = malloc(instrs * sizeof(uint32_t));
+    x->calls = malloc(instrs * sizeof(uint32_t));
+    x->locations = calloc(instrs, sizeof(x86_location_t));
+    if (x->order == NULL || x->position == NULL || x->block_start == NULL || x->block_end == NULL
+        || x->uses == NULL || x->fused == NULL || x->start == NULL || x->end == NULL
+        || x->calls == NULL || x->locations == NULL)
+        return false;
+
+    x->order_count = ir_reverse_postorder(function, x->order);
+    _number(x);
+    if (!_intervals(x) || !_allocate(x))
+        return false;
+
+    const char *symbol = x->symbols->functions[x->index];
+    emitter_begin_function(x->out, symbol, strchr(function->name, '.') == NULL);
+    if (!_prologue(x))
+        return false;
+
+    for (k = 0; k < x->order_count; k++) {
+        uint32_t b = x->order[k], next = k + 1 < x->order_count ? x->order[k + 1] : UINT32_MAX;
+        const ir_block_t *block = &function->blocks[b];
+        emitter_define_local(x->out, ".L", x->index, b);
+        for (i = 0; i < block->count; i++)
+            if (!_instruction(x, b, block->instrs[i], next))
+                return false;
+    }
+
+    emitter_end_function(x->out, symbol);
+    return true;
+}
+
+/* Module */
+
+static void _emit_vtables(
+    const ir_module_t *module,
+    const x86_symbols_t *symbols,
+    x86_defined_t defined,
+    void *context,
+    emitter_t *out)
+{
+    bool started = false;
+    uint32_t i, j;
+    for (i = 0; i < module->vtable_count; i++) {
+        const ir_vtable_t *vtable = &module->vtables[i];
+        if (defined != NULL && defined(context, symbols->vtables[i]))
+            continue;
+        if (!started) {
+            emitter_line(out, ".section .data.rel.ro,\"aw\"");
+            emitter_align(out, 3);
+            started = true;
+        }
+        emitter_define_symbol(out, symbols->vtables[i]);
+        for (j = 0; j < vtable->method_count; j++)
+            emitter_quad_symbol(out, symbols->functions[vtable->methods[j]]);
+    }
+    if (started)
+        emitter_line(out, ".text");
+}
+
+/* Bump allocator: rdi holds a size in bytes, the object comes back in rax */
+static void _emit_runtime(emitter_t *out)
+{
+    emitter_text(out,
+        "\t.p2align 4\n"
+        "__dash_alloc:\n"
+        "\tmov rax, qword ptr [rip + .Ldash_heap]\n"
+        "\tlea rdx, [rax + rdi]\n"
+        "\tcmp rdx, qword ptr [rip + .Ldash_heap_end]\n"
+        "\tjae .Ldash_refill\n"
+        "\tmov qword ptr [rip + .Ldash_heap], rdx\n"
+        "\tret\n"
+        ".Ldash_refill:\n"
+        "\tpush rdi\n");
+    emitter_instr(out, "mov");
+    emitter_register(out, "edi");
+    emitter_immediate(out, X86_HEAP_CHUNK);
+    emitter_end(out);
+    emitter_text(out,
+        "\tcall malloc@PLT\n"
+        "\tpop rdi\n"
+        "\ttest rax, rax\n"
+        "\tjz .Ldash_out_of_memory\n");
+    emitter_instr(out, "lea");
+    emitter_register(out, "rdx");
+    emitter_memory(out, NULL, "rax", NULL, 1, X86_HEAP_CHUNK);
+    emitter_end(out);
+    emitter_text(out,
+        "\tmov qword ptr [rip + .Ldash_heap_end], rdx\n"
+        "\tlea rdx, [rax + rdi]\n"
+        "\tmov qword ptr [rip + .Ldash_heap], rdx\n"
+        "\tret\n"
+        ".Ldash_out_of_memory:\n"
+        "\tand rsp, -16\n"
+        "\tcall abort@PLT\n"
+        "\t.bss\n"
+        "\t.p2align 3\n"
+        ".Ldash_heap:\n"
+        "\t.zero 8\n"
+        ".Ldash_heap_end:\n"
+        "\t.zero 8\n"
+        "\t.text\n");
+}
+
+static void _emit_entry(const ir_module_t *module, const x86_symbols_t *symbols, emitter_t *out)
+{
+    uint32_t i;
+    for (i = 0; i < module->function_count; i++) {
+        const ir_function_t *function = &module->functions[i];
+        if (strcmp(function->name, "main") != 0 || function->param_count != 0)
+            continue;
+        emitter_text(out, "\t.globl main\n\t.type main, @function\nmain:\n\tsub rsp, 8\n\tcall ");
+        emitter_text(out, symbols->functions[i]);
+        emitter_end(out);
+        if (function->result == IR_VOID)
+            emitter_line(out, "xor eax, eax");
+        emitter_text(out, "\tadd rsp, 8\n\tret\n");
+        return;
+    }
+}
+
+/* Lowers the switches left and names the symbols */
+static bool _prepare(ir_module_t *module, x86_symbols_t *symbols)
+{
+    bool switches = false;
+    uint32_t i, b;
+
+    for (i = 0; i < module->function_count; i++) {
+        const ir_function_t *function = &module->functions[i];
+        if (function->error != NULL)
+            return false;
+        for (b = 0; b < function->block_count && !switches; b++) {
+            ir_value_t terminator = ir_terminator(function, b);
+            switches = terminator != IR_NONE && function->instrs[terminator].op == IR_SWITCH;
+        }
+    }
+    if (switches)
+        opt_run_pass(module, "switch", NULL);
+    return _name_symbols(module, symbols);
+}
+
+static bool _emit_code(
+    ir_module_t *module,
+    const x86_symbols_t *symbols,
+    x86_defined_t defined,
+    void *context,
+    emitter_t *out)
+{
+    uint32_t i;
+    for (i = 0; i < module->function_count; i++) {
+        x86_codegen_t x = {.module = module, .function = &module->functions[i], .index = i};
+        if (defined != NULL && defined(context, symbols->functions[i]))
+            continue;
+        x.symbols = symbols;
+        x.out = out;
+        bool ok = x.function->error == NULL && _split_critical_edges(x.function, module->arena)
+                  && _emit_function(&x);
+        _release(&x);
+        if (!ok)
+            return false;
+    }
+    _emit_vtables(module, symbols, defined, context, out);
+    return true;
+}
+
+bool x86_emit_module(ir_module_t *module, emitter_t *out)
+{
+    x86_symbols_t symbols;
+    if (!_prepare(module, &symbols))
+        return false;
+
+    emitter_line(out, ".intel_syntax noprefix");
+    emitter_line(out, ".text");
+    if (!_emit_code(module, &symbols, NULL, NULL, out))
+        return false;
+    _emit_runtime(out);
+    _emit_entry(module, &symbols, out);
+    emitter_line(out, ".section .note.GNU-stack,\"\",@progbits");
+    return !emitter_failed(out);
+}
+
+bool x86_emit_code(ir_module_t *module, x86_defined_t defined, void *context, emitter_t *out)
+{
+    x86_symbols_t symbols;
+    return _prepare(module, &symbols) && _emit_code(module, &symbols, defined, context, out)
+           && !emitter_failed(out);
+}
@@ -1,4 +1,5 @@
 #include <arena.h>
+#include <stdint.h>
 #include <string.h>
 #include <unity.h>
 #include <utils.h>
@@ -127,6 +128,67 @@ void test_allocations_are_contiguous(void)
     TEST_ASSERT_EQUAL_PTR(ptr1 + 10, ptr2);
 }
 
+void test_arena_alloc_aligned(void)
+{
+    char *ptr1 = arena_alloc(&arena, 3);
+    char *ptr2 = arena_alloc_aligned(&arena, 16, 8);
+    TEST_ASSERT_NOT_NULL(ptr1);
+    TEST_ASSERT_NOT_NULL(ptr2);
+    TEST_ASSERT_EQUAL(0, (size_t) ptr2 % 8);
+    TEST_ASSERT_EQUAL_PTR(ptr1 + 8, ptr2);
+    TEST_ASSERT_EQUAL(24, arena_used(&arena));
+
+    /* Only the unpadded size would still fit in the current chunk */
+    size_t capacity = arena.current->capacity;
+    TEST_ASSERT_NOT_NULL(arena_alloc(&arena, capacity - arena.current->size - 23));
+    char *ptr3 = arena_alloc_aligned(&arena, 16, 8);
+    TEST_ASSERT_NOT_NULL(ptr3);
+    TEST_ASSERT_EQUAL(0, (size_t) ptr3 % 8);
+    TEST_ASSERT_EQUAL_PTR(arena.current->data, ptr3);
+    TEST_ASSERT_EQUAL(capacity - 23 + 16, arena_used(&arena));
+}
+
+void test_arena_grow(void)
+{
+    uint32_t *items = arena_alloc_aligned(&arena, 4 * sizeof(uint32_t), sizeof(uint32_t));
+    uint32_t i;
+    TEST_ASSERT_NOT_NULL(items);
+    for (i = 0; i < 4; i++)
+        items[i] = i + 1;
+    uint32_t *grown = arena_grow(&arena, items, 3, 16, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(grown);
+    TEST_ASSERT_TRUE(grown != items);
+    TEST_ASSERT_EQUAL(0, (size_t) grown % sizeof(void *));
+    for (i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL(i + 1, grown[i]);
+    TEST_ASSERT_NOT_NULL(arena_grow(&arena, NULL, 0, 8, sizeof(uint64_t)));
+}
+
+void test_arena_reset(void)
+{
+    size_t chunk_size = arena.first->capacity;
+    char *ptr1 = arena_alloc(&arena, chunk_size - 100);
+    char *ptr2 = arena_alloc(&arena, chunk_size * 3);
+    char *ptr3 = arena_alloc(&arena, 200);
+    size_t size = arena.size;
+    TEST_ASSERT_NOT_NULL(ptr3);
+
+    arena_reset(&arena);
+    TEST_ASSERT_EQUAL(0, arena_used(&arena));
+    /* The same chunks come back in the same order */
+    TEST_ASSERT_EQUAL_PTR(ptr1, arena_alloc(&arena, chunk_size - 100));
+    TEST_ASSERT_EQUAL_PTR(ptr2, arena_alloc(&arena, chunk_size * 3));
+    TEST_ASSERT_EQUAL_PTR(ptr3, arena_alloc(&arena, 200));
+    TEST_ASSERT_EQUAL(size, arena.size);
+
+    /* A chunk too small for the next allocation is skipped, not dropped */
+    arena_reset(&arena);
+    arena_alloc(&arena, chunk_size - 100);
+    arena_alloc(&arena, chunk_size * 5);
+    TEST_ASSERT_EQUAL_PTR(ptr2, arena_alloc(&arena, 100));
+    TEST_ASSERT_EQUAL(size + chunk_size * 5, arena.size);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -138,5 +200,8 @@ int main(void)
     RUN_TEST(test_arena_alloc_zero);
     RUN_TEST(test_arena_destroy);
     RUN_TEST(test_allocations_are_contiguous);
+    RUN_TEST(test_arena_alloc_aligned);
+    RUN_TEST(test_arena_grow);
+    RUN_TEST(test_arena_reset);
     return UNITY_END();
 }
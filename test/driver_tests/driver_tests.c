@@ -0,0 +1,451 @@
+#include <arena.h>
+#include <ast.h>
+#include <cache.h>
+#include <dirent.h>
+#include <diagnostic.h>
+#include <driver.h>
+#include <parser.h>
+#include <pool.h>
+#include <reader.h>
+#include <sema.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+
+#define MAX_FILES 8
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+static pool_t pool;
+static char paths[MAX_FILES][32];
+static const char *inputs[MAX_FILES];
+static uint32_t file_count;
+static char cache_directory[32];
+
+static const char *pieces[] = {
+    "interface Shape { function area() -> i64; }\n"
+    "class Square { side: i64; }\n"
+    "enum Color { Red, Green }\n",
+    "impl Square : Shape {\n"
+    "    function area() -> i64 { return self.side * self.side; }\n"
+    "}\n"
+    "type Op = function(i64) -> i64;\n",
+    "function pick(c: Color, x: i64) -> i64 {\n"
+    "    switch x { 1, 2: return 10; default: if c == Color::Red { return 1; } else { } }\n"
+    "    let s: Shape = Square(x);\n"
+    "    for x > 0 { x -= 1; }\n"
+    "    return s.area() + pick(c, 0);\n"
+    "}\n"};
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+    TEST_ASSERT_TRUE(pool_init(&pool, 4));
+    file_count = 0;
+    cache_directory[0] = '\0';
+}
+
+void tearDown(void)
+{
+    uint32_t i;
+    for (i = 0; i < file_count; i++)
+        if (inputs[i] == paths[i])
+            unlink(paths[i]);
+    if (cache_directory[0] != '\0') {
+        DIR *directory = opendir(cache_directory);
+        struct dirent *entry;
+        char path[64];
+        while (directory != NULL && (entry = readdir(directory)) != NULL) {
+            snprintf(path, sizeof(path), "%s/%s", cache_directory, entry->d_name);
+            if (entry->d_name[0] != '.')
+                unlink(path);
+        }
+        if (directory != NULL)
+            closedir(directory);
+        rmdir(cache_directory);
+    }
+    pool_destroy(&pool);
+    arena_destroy(&arena);
+}
+
+static void add_file(const char *source)
+{
+    strcpy(paths[file_count], "/tmp/dash-driver-XXXXXX");
+    int fd = mkstemp(paths[file_count]);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_TRUE(write(fd, source, strlen(source)) == (ssize_t) strlen(source));
+    close(fd);
+    inputs[file_count] = paths[file_count];
+    file_count++;
+}
+
+static char *dump(const ast_t *tree)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    ast_dump(tree, AST_NONE, out);
+    fclose(out);
+    return text;
+}
+
+/* Dump of `source` parsed as a single file */
+static char *dump_single(const char *source)
+{
+    intern_t single_interner;
+    ast_t single;
+    TEST_ASSERT_TRUE(intern_init(&single_interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&single, &arena, &single_interner));
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&single, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&single, &diagnostics, 0));
+    return dump(&single);
+}
+
+void merges_in_command_line_order(void)
+{
+    char source[1024] = "";
+    driver_t driver;
+    uint32_t i;
+    for (i = 0; i < 3; i++) {
+        add_file(pieces[i]);
+        strcat(source, pieces[i]);
+    }
+
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT((int) strlen(source), (int) driver.bytes);
+    TEST_ASSERT_TRUE(driver_merge(&driver, &ast, &diagnostics));
+    driver_destroy(&driver);
+
+    char *merged = dump(&ast), *expected = dump_single(source);
+    TEST_ASSERT_EQUAL_STRING(expected, merged);
+    free(merged);
+    free(expected);
+
+    /* The merged tree goes through the rest of the front end like any other */
+    sema_t sema;
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_TRUE(sema_check(&sema));
+    sema_destroy(&sema);
+    TEST_ASSERT_EQUAL_INT(0, (int) diagnostics.count);
+}
+
+void merges_lazy_bodies(void)
+{
+    arena_t part_arena;
+    intern_t part_interners[3];
+    ast_t parts[3];
+    const ast_t *part_pointers[3];
+    size_t line_offsets[3] = {0, 10, 20};
+    char source[1024] = "";
+    uint32_t i;
+    TEST_ASSERT_TRUE(arena_init(&part_arena));
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(intern_init(&part_interners[i], &part_arena));
+        TEST_ASSERT_TRUE(ast_init(&parts[i], &part_arena, &part_interners[i]));
+        reader_t reader = reader_from_string(pieces[i]);
+        lexer_t lexer = lexer_init(&reader);
+        TEST_ASSERT_TRUE(parser_tokenize(&parts[i], &lexer, &diagnostics));
+        TEST_ASSERT_TRUE(parser_parse(&parts[i], &diagnostics, PARSER_LAZY_BODIES));
+        part_pointers[i] = &parts[i];
+        strcat(source, pieces[i]);
+    }
+    TEST_ASSERT_TRUE(ast_merge(&ast, part_pointers, 3, line_offsets));
+    size_t last_line = parts[2].tokens[parts[2].token_count - 1].line;
+    arena_destroy(&part_arena);
+
+    /* Lazy bodies point at the merged tokens */
+    TEST_ASSERT_TRUE(parser_parse_bodies(&ast, &diagnostics));
+    char *merged = dump(&ast), *expected = dump_single(source);
+    TEST_ASSERT_EQUAL_STRING(expected, merged);
+    free(merged);
+    free(expected);
+    TEST_ASSERT_EQUAL_INT((int) last_line + 20, (int) ast.tokens[ast.token_count - 1].line);
+}
+
+void locates_diagnostics(void)
+{
+    driver_t driver;
+    add_file("function twice() {}\n\nlet unused = 1;\n");
+    add_file("class Point { x: i64; }\n"
+             "function twice() {}\n");
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_TRUE(driver_merge(&driver, &ast, &diagnostics));
+    driver_destroy(&driver);
+
+    sema_t sema;
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(!sema_declare(&sema));
+    sema_destroy(&sema);
+
+    char *text = NULL;
+    size_t length = 0;
+    char expected[256];
+    FILE *out = open_memstream(&text, &length);
+    diagnostics_print(&diagnostics, out, "unused");
+    fclose(out);
+    snprintf(expected, sizeof(expected),
+        "%s:2:10: error: redefinition of 'twice' (previously declared at %s:1)\n", paths[1],
+        paths[0]);
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+    free(text);
+
+    const char *path;
+    TEST_ASSERT_EQUAL_INT(0, (int) diagnostics_locate(&diagnostics, 0, &path));
+    TEST_ASSERT_EQUAL_STRING(paths[0], path);
+    TEST_ASSERT_EQUAL_INT(3, (int) diagnostics_locate(&diagnostics, 3, &path));
+    TEST_ASSERT_EQUAL_STRING(paths[0], path);
+    TEST_ASSERT_EQUAL_INT(1, (int) diagnostics_locate(&diagnostics, 4, &path));
+    TEST_ASSERT_EQUAL_STRING(paths[1], path);
+}
+
+void reports_failures_in_order(void)
+{
+    driver_t driver;
+    add_file("function f() -> i64 { return 1; }\n");
+    add_file("function g( {\n");
+    inputs[file_count++] = "/nonexistent/dash.dash";
+    add_file("function h() -> { }\n");
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    TEST_ASSERT_TRUE(!driver_parse(&driver, &pool));
+
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    driver_report(&driver, out);
+    fclose(out);
+    driver_destroy(&driver);
+
+    const char *syntax = strstr(text, paths[1]);
+    const char *missing = strstr(text, "Could not read '/nonexistent/dash.dash'");
+    const char *last = strstr(text, paths[3]);
+    TEST_ASSERT_NOT_NULL(syntax);
+    TEST_ASSERT_NOT_NULL(missing);
+    TEST_ASSERT_NOT_NULL(last);
+    TEST_ASSERT_TRUE(syntax < missing && missing < last);
+    TEST_ASSERT_NULL(strstr(text, paths[0]));
+    free(text);
+}
+
+static void make_cache(cache_t *cache, unsigned flags)
+{
+    strcpy(cache_directory, "/tmp/dash-cache-XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(cache_directory));
+    TEST_ASSERT_TRUE(cache_init(cache, cache_directory, flags));
+}
+
+void hashes_contents(void)
+{
+    const char *text = "function main() -> i64 { return 0; }";
+    uint64_t hash = cache_hash(text, strlen(text), 0);
+    TEST_ASSERT_TRUE(hash == cache_hash(text, strlen(text), 0));
+    TEST_ASSERT_TRUE(hash != cache_hash(text, strlen(text), 1));
+    TEST_ASSERT_TRUE(hash != cache_hash(text, strlen(text) - 1, 0));
+    TEST_ASSERT_TRUE(cache_hash("abcdefgh1", 9, 0) != cache_hash("abcdefgh2", 9, 0));
+    TEST_ASSERT_TRUE(cache_hash("", 0, 0) != cache_hash("", 0, 1));
+}
+
+void stores_and_maps_trees(void)
+{
+    cache_t cache, other;
+    cache_entry_t entry;
+    const char *source = pieces[2];
+    make_cache(&cache, 0);
+    uint64_t key = cache_key(&cache, cache_hash(source, strlen(source), 0));
+    TEST_ASSERT_TRUE(!cache_load(&cache, key, &ast, &entry));
+
+    intern_t stored_interner;
+    ast_t stored;
+    TEST_ASSERT_TRUE(intern_init(&stored_interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&stored, &arena, &stored_interner));
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&stored, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&stored, &diagnostics, 0));
+    TEST_ASSERT_TRUE(cache_store(&cache, key, &stored));
+
+    TEST_ASSERT_TRUE(cache_load(&cache, key, &ast, &entry));
+    TEST_ASSERT_EQUAL_INT((int) stored.node_count, (int) ast.node_count);
+    TEST_ASSERT_EQUAL_INT((int) stored.token_count, (int) ast.token_count);
+    TEST_ASSERT_EQUAL_INT((int) stored_interner.count, (int) interner.count);
+    ast_index_t function = ast.extra[ast.nodes[0].lhs];
+    TEST_ASSERT_EQUAL_STRING("pick", intern_string(&interner, ast_name(&ast, function)));
+    char *loaded = dump(&ast), *expected = dump(&stored);
+    TEST_ASSERT_EQUAL_STRING(expected, loaded);
+    free(loaded);
+    free(expected);
+    cache_release(&entry);
+
+    /* Other parser flags make other keys, and entries are checked against theirs */
+    TEST_ASSERT_TRUE(cache_init(&other, cache_directory, 1));
+    TEST_ASSERT_TRUE(cache_key(&other, cache_hash(source, strlen(source), 0)) != key);
+    other.salt = cache.salt + 1;
+    TEST_ASSERT_TRUE(!cache_load(&other, key, &stored, &entry));
+    TEST_ASSERT_NULL(entry.data);
+}
+
+void reuses_unchanged_files(void)
+{
+    cache_t cache;
+    driver_t driver;
+    uint32_t i;
+    make_cache(&cache, DRIVER_PARSE_FLAGS);
+    for (i = 0; i < 3; i++)
+        add_file(pieces[i]);
+
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    driver.cache = &cache;
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(0, (int) driver.cache_hits);
+    TEST_ASSERT_TRUE(driver_merge(&driver, &ast, &diagnostics));
+    driver_destroy(&driver);
+    char *first = dump(&ast);
+
+    /* Only the edited file is parsed again */
+    FILE *file = fopen(paths[1], "a");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs("function added() {}\n", file);
+    fclose(file);
+    intern_t second_interner;
+    ast_t second;
+    TEST_ASSERT_TRUE(intern_init(&second_interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&second, &arena, &second_interner));
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    driver.cache = &cache;
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(2, (int) driver.cache_hits);
+    TEST_ASSERT_TRUE(driver.files[0]->cached && !driver.files[1]->cached);
+    TEST_ASSERT_TRUE(driver_merge(&driver, &second, &diagnostics));
+    driver_destroy(&driver);
+
+    char *again = dump(&second);
+    TEST_ASSERT_NOT_NULL(strstr(again, "(function added ( ) _ (block))"));
+    TEST_ASSERT_TRUE(strlen(again) > strlen(first));
+    free(first);
+    free(again);
+}
+
+void keeps_trees_across_inputs(void)
+{
+    driver_t driver;
+    uint32_t i;
+    for (i = 0; i < 3; i++)
+        add_file(pieces[i]);
+    memset(&driver, 0, sizeof(driver_t));
+
+    /* A repeated path is parsed once */
+    const char *repeated[] = {inputs[0], inputs[1], inputs[0], inputs[2]};
+    TEST_ASSERT_TRUE(driver_set_inputs(&driver, repeated, 4));
+    TEST_ASSERT_EQUAL_INT(3, (int) driver.file_count);
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(0, (int) driver.reused);
+    TEST_ASSERT_TRUE(driver_merge(&driver, &ast, &diagnostics));
+    char *first = dump(&ast);
+    driver_file_t *kept = driver.files[0];
+
+    TEST_ASSERT_TRUE(driver_set_inputs(&driver, inputs, file_count));
+    TEST_ASSERT_TRUE(driver.files[0] == kept && driver.files[0]->loaded);
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(3, (int) driver.reused);
+    intern_t second_interner;
+    ast_t second;
+    TEST_ASSERT_TRUE(intern_init(&second_interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&second, &arena, &second_interner));
+    TEST_ASSERT_TRUE(driver_merge(&driver, &second, &diagnostics));
+    char *again = dump(&second);
+    TEST_ASSERT_EQUAL_STRING(first, again);
+
+    /* An edit is picked up, a dropped file is let go */
+    FILE *file = fopen(paths[1], "a");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs("function added() {}\n", file);
+    fclose(file);
+    TEST_ASSERT_TRUE(driver_set_inputs(&driver, inputs + 1, 2));
+    TEST_ASSERT_EQUAL_INT(2, (int) driver.file_count);
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(1, (int) driver.reused);
+    TEST_ASSERT_TRUE(!driver.files[0]->reused && driver.files[1]->reused);
+    driver_destroy(&driver);
+    free(first);
+    free(again);
+}
+
+void recovers_from_damaged_entries(void)
+{
+    cache_t cache;
+    driver_t driver;
+    make_cache(&cache, DRIVER_PARSE_FLAGS);
+    add_file(pieces[2]);
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    driver.cache = &cache;
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_TRUE(driver_merge(&driver, &ast, &diagnostics));
+    driver_destroy(&driver);
+    char *expected = dump(&ast);
+
+    /* A flipped bit in the middle of the entry makes it a miss */
+    char path[64];
+    uint64_t key = cache_key(&cache, cache_hash(pieces[2], strlen(pieces[2]), 0));
+    snprintf(path, sizeof(path), "%s/%016llx.ast", cache_directory, (unsigned long long) key);
+    FILE *file = fopen(path, "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fseek(file, 0, SEEK_END) == 0);
+    long middle = ftell(file) / 2;
+    TEST_ASSERT_TRUE(fseek(file, middle, SEEK_SET) == 0);
+    int byte = fgetc(file);
+    TEST_ASSERT_TRUE(byte != EOF && fseek(file, middle, SEEK_SET) == 0);
+    fputc(byte ^ 0x10, file);
+    fclose(file);
+
+    intern_t second_interner;
+    ast_t second;
+    TEST_ASSERT_TRUE(intern_init(&second_interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&second, &arena, &second_interner));
+    TEST_ASSERT_TRUE(driver_init(&driver, inputs, file_count));
+    driver.cache = &cache;
+    TEST_ASSERT_TRUE(driver_parse(&driver, &pool));
+    TEST_ASSERT_EQUAL_INT(0, (int) driver.cache_hits);
+    TEST_ASSERT_TRUE(driver_merge(&driver, &second, &diagnostics));
+    driver_destroy(&driver);
+    char *again = dump(&second);
+    TEST_ASSERT_EQUAL_STRING(expected, again);
+    free(expected);
+    free(again);
+
+    /* Indices out of bounds are caught even when the bytes hash right */
+    TEST_ASSERT_TRUE(ast_validate(&second));
+    second.nodes[1].token = second.token_count;
+    TEST_ASSERT_TRUE(!ast_validate(&second));
+    second.nodes[1].token = 0;
+    second.nodes[1].kind = AST_FUNCTION_TYPE + 1;
+    TEST_ASSERT_TRUE(!ast_validate(&second));
+    second.nodes[1].kind = AST_ROOT;
+    TEST_ASSERT_TRUE(!ast_validate(&second));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(merges_in_command_line_order);
+    RUN_TEST(merges_lazy_bodies);
+    RUN_TEST(locates_diagnostics);
+    RUN_TEST(reports_failures_in_order);
+    RUN_TEST(hashes_contents);
+    RUN_TEST(stores_and_maps_trees);
+    RUN_TEST(reuses_unchanged_files);
+    RUN_TEST(recovers_from_damaged_entries);
+    RUN_TEST(keeps_trees_across_inputs);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+#include <emitter.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <unity.h>
+#include <writer.h>
+
+static writer_t writer;
+static emitter_t emitter;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(writer_init_memory(&writer));
+    emitter_init(&emitter, &writer);
+}
+
+void tearDown(void)
+{
+    writer_destroy(&writer);
+}
+
+static const char *text(void)
+{
+    TEST_ASSERT_TRUE(writer_flush(&writer));
+    return writer.data;
+}
+
+void formats_integers(void)
+{
+    writer_unsigned(&writer, 0);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, 9);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, 10);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, 99);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, 100);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, 1234567);
+    writer_putc(&writer, ' ');
+    writer_unsigned(&writer, UINT64_MAX);
+    TEST_ASSERT_EQUAL_STRING("0 9 10 99 100 1234567 18446744073709551615", text());
+}
+
+void formats_signed_integers(void)
+{
+    writer_signed(&writer, -1);
+    writer_putc(&writer, ' ');
+    writer_signed(&writer, 42);
+    writer_putc(&writer, ' ');
+    writer_signed(&writer, INT64_MIN);
+    TEST_ASSERT_EQUAL_STRING("-1 42 -9223372036854775808", text());
+}
+
+void grows_memory_writers(void)
+{
+    uint32_t i;
+    for (i = 0; i < 100000; i++)
+        writer_puts(&writer, "0123456789");
+    const char *data = text();
+    TEST_ASSERT_EQUAL_INT(1000000, (int) strlen(data));
+    TEST_ASSERT_TRUE(memcmp(data + 999990, "0123456789", 10) == 0);
+}
+
+void flushes_to_file_descriptors(void)
+{
+    char path[] = "/tmp/dash-writer-XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+
+    size_t big = WRITER_BUFFER_SIZE + 12345, i;
+    char *piece = malloc(big);
+    TEST_ASSERT_NOT_NULL(piece);
+    for (i = 0; i < big; i++)
+        piece[i] = (char) ('a' + i % 26);
+
+    writer_t out;
+    TEST_ASSERT_TRUE(writer_init(&out, fd));
+    writer_puts(&out, "head ");
+    /* Larger than the buffer, goes out next to it without a copy */
+    writer_write(&out, piece, big);
+    for (i = 0; i < 200000; i++)
+        writer_unsigned(&out, i % 10);
+    TEST_ASSERT_TRUE(writer_destroy(&out));
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    TEST_ASSERT_EQUAL_INT((int) (5 + big + 200000), (int) size);
+    char *back = malloc((size_t) size);
+    TEST_ASSERT_NOT_NULL(back);
+    TEST_ASSERT_TRUE(pread(fd, back, (size_t) size, 0) == size);
+    TEST_ASSERT_TRUE(memcmp(back, "head ", 5) == 0);
+    TEST_ASSERT_TRUE(memcmp(back + 5, piece, big) == 0);
+    TEST_ASSERT_TRUE(memcmp(back + size - 3, "789", 3) == 0);
+    free(back);
+    free(piece);
+    close(fd);
+}
+
+void reports_write_errors(void)
+{
+    writer_t out;
+    TEST_ASSERT_TRUE(writer_init(&out, 1000));
+    writer_puts(&out, "lost");
+    TEST_ASSERT_TRUE(!writer_destroy(&out));
+}
+
+void emits_instructions(void)
+{
+    emitter_instr(&emitter, "mov");
+    emitter_register(&emitter, "rax");
+    emitter_memory(&emitter, "qword", "rbp", NULL, 1, -8);
+    emitter_end(&emitter);
+    emitter_instr(&emitter, "movsxd");
+    emitter_register(&emitter, "rdx");
+    emitter_memory(&emitter, "dword", "rax", "rcx", 4, 16);
+    emitter_end(&emitter);
+    emitter_instr(&emitter, "imul");
+    emitter_register(&emitter, "rcx");
+    emitter_register(&emitter, "rcx");
+    emitter_immediate(&emitter, -3);
+    emitter_end(&emitter);
+    emitter_instr(&emitter, "lea");
+    emitter_register(&emitter, "rsp");
+    emitter_memory(&emitter, NULL, "rbp", NULL, 1, -16);
+    emitter_end(&emitter);
+    emitter_line(&emitter, "ret");
+    TEST_ASSERT_EQUAL_STRING("\tmov rax, qword ptr [rbp - 8]\n"
+                             "\tmovsxd rdx, dword ptr [rax + rcx*4 + 16]\n"
+                             "\timul rcx, rcx, -3\n"
+                             "\tlea rsp, [rbp - 16]\n"
+                             "\tret\n",
+        text());
+}
+
+void emits_local_labels(void)
+{
+    emitter_define_local(&emitter, ".L", 3, 7);
+    emitter_instr(&emitter, "jne");
+    emitter_local_operand(&emitter, ".L", 3, 12);
+    emitter_end(&emitter);
+    emitter_define_local(&emitter, ".Lvtable", 2, EMITTER_NO_NUMBER);
+    TEST_ASSERT_EQUAL_STRING(".L3_7:\n\tjne .L3_12\n.Lvtable2:\n", text());
+}
+
+void emits_symbols_and_data(void)
+{
+    emitter_begin_function(&emitter, "dash.f", true);
+    emitter_instr(&emitter, "lea");
+    emitter_register(&emitter, "rax");
+    emitter_rip_local(&emitter, ".Ltable", 0, 1);
+    emitter_end(&emitter);
+    emitter_instr(&emitter, "call");
+    emitter_symbol_operand(&emitter, "dash.g");
+    emitter_end(&emitter);
+    emitter_long_difference(&emitter, ".L", 0, 2, ".Ltable", 0, 1);
+    emitter_end_function(&emitter, "dash.f");
+    emitter_quad_symbol(&emitter, "dash.g");
+    TEST_ASSERT_EQUAL_STRING("\t.globl dash.f\n\t.p2align 4\n\t.type dash.f, @function\ndash.f:\n"
+                             "\tlea rax, [rip + .Ltable0_1]\n\tcall dash.g\n"
+                             "\t.long .L0_2 - .Ltable0_1\n\t.size dash.f, .-dash.f\n"
+                             "\t.quad dash.g\n",
+        text());
+}
+
+void encodes_into_an_assembler(void)
+{
+    assembler_t assembler;
+    assembler_init(&assembler);
+    emitter_init_assembler(&emitter, &assembler);
+    emitter_line(&emitter, ".text");
+    emitter_instr(&emitter, "lea");
+    emitter_register(&emitter, "rsp");
+    emitter_memory(&emitter, NULL, "rbp", NULL, 1, -16);
+    emitter_end(&emitter);
+    TEST_ASSERT_TRUE(!emitter_failed(&emitter));
+    TEST_ASSERT_EQUAL_INT(4, (int) assembler.size);
+    TEST_ASSERT_EQUAL_INT(0x8d, assembler.code[1]);
+
+    /* Text has no encoding */
+    emitter_text(&emitter, "nop");
+    TEST_ASSERT_TRUE(emitter_failed(&emitter));
+    assembler_destroy(&assembler);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(formats_integers);
+    RUN_TEST(formats_signed_integers);
+    RUN_TEST(grows_memory_writers);
+    RUN_TEST(flushes_to_file_descriptors);
+    RUN_TEST(reports_write_errors);
+    RUN_TEST(emits_instructions);
+    RUN_TEST(emits_local_labels);
+    RUN_TEST(emits_symbols_and_data);
+    RUN_TEST(encodes_into_an_assembler);
+    return UNITY_END();
+}
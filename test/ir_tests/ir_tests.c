@@ -0,0 +1,679 @@
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <intern.h>
+#include <ir.h>
+#include <lower.h>
+#include <opt.h>
+#include <parser.h>
+#include <reader.h>
+#include <sema.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+static sema_t sema;
+static ir_module_t module;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+    memset(&module, 0, sizeof(ir_module_t));
+}
+
+void tearDown(void)
+{
+    ir_module_destroy(&module);
+    arena_destroy(&arena);
+}
+
+static bool lower(const char *source)
+{
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, 0));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_TRUE(sema_check(&sema));
+    TEST_ASSERT_TRUE(ir_module_init(&module, &arena, &ast, 1));
+    bool ok = lower_module(&module, &sema, NULL, &diagnostics);
+    sema_destroy(&sema);
+    return ok;
+}
+
+static void assert_valid(void)
+{
+    char error[128];
+    uint32_t i;
+    for (i = 0; i < module.function_count; i++)
+        if (!ir_verify(&module.functions[i], error, sizeof(error)))
+            TEST_FAIL_MESSAGE(error);
+}
+
+#define ASSERT_IR(index, expected) \
+    do { \
+        char *actual = NULL; \
+        size_t length = 0; \
+        FILE *out = open_memstream(&actual, &length); \
+        ir_dump_function(&module, &module.functions[index], out); \
+        fclose(out); \
+        TEST_ASSERT_EQUAL_STRING(expected, actual); \
+        free(actual); \
+    } while (0)
+
+static uint32_t count_ops(uint32_t index, ir_op_t op)
+{
+    const ir_function_t *function = &module.functions[index];
+    uint32_t count = 0, b, i;
+    for (b = 0; b < function->block_count; b++)
+        for (i = 0; i < function->blocks[b].count; i++)
+            count += function->instrs[function->blocks[b].instrs[i]].op == op;
+    return count;
+}
+
+/* Enough of an interpreter to check control flow, no calls or memory */
+static uint64_t run(uint32_t index, const uint64_t *args)
+{
+    const ir_function_t *function = &module.functions[index];
+    uint64_t *values = calloc(function->instr_count, sizeof(uint64_t));
+    uint64_t inputs[64];
+    uint32_t block = 0, pred = UINT32_MAX, steps = 0, i;
+
+    TEST_ASSERT_NOT_NULL(values);
+    for (;;) {
+        const ir_block_t *current = &function->blocks[block];
+        uint32_t phis = 0;
+        TEST_ASSERT_TRUE(++steps < 100000);
+        /* Phis read their inputs together, on the edge */
+        while (phis < current->count && function->instrs[current->instrs[phis]].op == IR_PHI) {
+            const ir_instr_t *phi = &function->instrs[current->instrs[phis]];
+            inputs[phis++] =
+                values[function->operands[phi->a + ir_pred_index(function, block, pred)]];
+        }
+        for (i = 0; i < phis; i++)
+            values[current->instrs[i]] = inputs[i];
+
+        for (i = phis; i < current->count; i++) {
+            ir_value_t value = current->instrs[i];
+            const ir_instr_t *instr = &function->instrs[value];
+            ir_type_t type = (ir_type_t) instr->type;
+            /* Constants keep their bits in a and b, don't read those as values */
+            bool has_operands = instr->op != IR_CONST && instr->op != IR_PARAM;
+            uint32_t first = has_operands && instr->a < function->instr_count ? instr->a : 0;
+            uint64_t a = values[first];
+            uint64_t b = has_operands && instr->b < function->instr_count ? values[instr->b] : 0;
+            bool is_signed = ir_type_signed((ir_type_t) function->instrs[first].type);
+            switch ((ir_op_t) instr->op) {
+            case IR_CONST:
+                values[value] = ir_const_value(instr);
+                break;
+            case IR_PARAM:
+                values[value] = ir_wrap(type, args[instr->a]);
+                break;
+            case IR_COPY:
+                values[value] = a;
+                break;
+            case IR_ADD:
+                values[value] = ir_wrap(type, a + b);
+                break;
+            case IR_SUB:
+                values[value] = ir_wrap(type, a - b);
+                break;
+            case IR_MUL:
+                values[value] = ir_wrap(type, a * b);
+                break;
+            case IR_NEG:
+                values[value] = ir_wrap(type, 0 - a);
+                break;
+            case IR_EQ:
+                values[value] = a == b;
+                break;
+            case IR_NE:
+                values[value] = a != b;
+                break;
+            case IR_LT:
+                values[value] = is_signed ? (int64_t) a < (int64_t) b : a < b;
+                break;
+            case IR_LE:
+                values[value] = is_signed ? (int64_t) a <= (int64_t) b : a <= b;
+                break;
+            case IR_GT:
+                values[value] = is_signed ? (int64_t) a > (int64_t) b : a > b;
+                break;
+            case IR_GE:
+                values[value] = is_signed ? (int64_t) a >= (int64_t) b : a >= b;
+                break;
+            case IR_BIT_TEST:
+                TEST_ASSERT_TRUE(a < 64);
+                values[value] = (b >> a) & 1;
+                break;
+            case IR_JUMP_TABLE:
+                TEST_ASSERT_TRUE(a < instr->c);
+                /* fall through */
+            case IR_JUMP:
+            case IR_BRANCH:
+            case IR_SWITCH:
+                break;
+            case IR_RETURN:
+                a = values[instr->a];
+                free(values);
+                return a;
+            default:
+                TEST_FAIL_MESSAGE(ir_op_name((ir_op_t) instr->op));
+            }
+        }
+
+        const ir_instr_t *terminator = &function->instrs[ir_terminator(function, block)];
+        uint32_t next = ir_successor(function, block, 0);
+        if (terminator->op == IR_BRANCH) {
+            next = values[terminator->a] ? terminator->b : terminator->c;
+        } else if (terminator->op == IR_JUMP_TABLE) {
+            next = ir_successor(function, block, (uint32_t) values[terminator->a]);
+        } else if (terminator->op == IR_SWITCH) {
+            for (i = 0; i < terminator->c; i++)
+                if (ir_switch_value(function, terminator, i) == values[terminator->a])
+                    next = ir_switch_target(function, terminator, i);
+        }
+        pred = block;
+        block = next;
+    }
+}
+
+void lower_builds_ssa(void)
+{
+    TEST_ASSERT_TRUE(lower("function sum(n: i32) -> i32 {\n"
+                           "    let total: i32 = 0;\n"
+                           "    for n > 0 { total += n; n -= 1; }\n"
+                           "    return total;\n"
+                           "}"));
+    assert_valid();
+    TEST_ASSERT_EQUAL(1, module.function_count);
+    ASSERT_IR(
+        0,
+        "function sum(i32) -> i32 {\n"
+        "b0:\n"
+        "  %1 = param i32 0\n"
+        "  %2 = const i32 0\n"
+        "  jump b1\n"
+        "b1: ; preds b0 b2\n"
+        "  %8 = phi i32 [b0: %2], [b2: %9]\n"
+        "  %4 = phi i32 [b0: %1], [b2: %11]\n"
+        "  %5 = const i32 0\n"
+        "  %6 = gt bool %4, %5\n"
+        "  br %6, b2, b3\n"
+        "b2: ; preds b1\n"
+        "  %9 = add i32 %8, %4\n"
+        "  %10 = const i32 1\n"
+        "  %11 = sub i32 %4, %10\n"
+        "  jump b1\n"
+        "b3: ; preds b1\n"
+        "  ret %8\n"
+        "}\n");
+}
+
+void lower_methods_and_objects(void)
+{
+    TEST_ASSERT_TRUE(lower("class Point { x: i32; y: i32; }\n"
+                           "impl Point { function move(d: i32) { self.y += d; } }\n"
+                           "function make() -> Point {\n"
+                           "    let p = Point(1, 2);\n"
+                           "    p.move(3);\n"
+                           "    return p;\n"
+                           "}"));
+    assert_valid();
+    TEST_ASSERT_EQUAL(2, module.function_count);
+    TEST_ASSERT_EQUAL_STRING("Point.move", module.functions[0].name);
+    TEST_ASSERT_EQUAL_STRING("make", module.functions[1].name);
+    ASSERT_IR(
+        0,
+        "function Point.move(ptr, i32) -> void {\n"
+        "b0:\n"
+        "  %1 = param ptr 0\n"
+        "  %2 = param i32 1\n"
+        "  %3 = load i32 %1+8\n"
+        "  %4 = add i32 %3, %2\n"
+        "  store %1+8, %4\n"
+        "  ret\n"
+        "}\n");
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_NEW));
+    TEST_ASSERT_EQUAL(2, count_ops(1, IR_STORE));
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_CALL));
+}
+
+void lower_switch_falls_through(void)
+{
+    TEST_ASSERT_TRUE(lower("function pick(c: i32) -> i32 {\n"
+                           "    let r: i32 = 0;\n"
+                           "    switch c { 1: r = 10; fall; 2, 3: r += 1; default: r = 7; }\n"
+                           "    return r;\n"
+                           "}"));
+    assert_valid();
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_SWITCH));
+    uint64_t expected[] = {7, 11, 1, 1, 7}, c;
+    for (c = 0; c < 5; c++)
+        TEST_ASSERT_EQUAL(expected[c], run(0, &c));
+
+    /* The first case jumps straight into the second */
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_SWITCH));
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_ADD));
+    for (c = 0; c < 5; c++)
+        TEST_ASSERT_EQUAL(expected[c], run(0, &c));
+}
+
+static char source[65536];
+
+/* function f(v: <type>) -> i64 { switch v { <label>: return <i % 5>; ... default: return 99; } } */
+static void switch_source(const char *type, const int64_t *labels, uint32_t count)
+{
+    uint32_t i;
+    int length = snprintf(
+        source, sizeof(source), "function f(v: %s) -> i64 {\n    switch v {\n", type);
+    for (i = 0; i < count; i++)
+        length += snprintf(
+            source + length,
+            sizeof(source) - length,
+            "    %lld: return %u;\n",
+            (long long) labels[i],
+            (unsigned) i % 5);
+    snprintf(source + length, sizeof(source) - length, "    default: return 99;\n    }\n}");
+}
+
+static uint64_t switch_expected(const int64_t *labels, uint32_t count, int64_t value)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+        if (labels[i] == value)
+            return i % 5;
+    return 99;
+}
+
+void switch_uses_jump_tables(void)
+{
+    int64_t labels[40], v;
+    uint32_t i;
+    for (i = 0; i < 40; i++)
+        labels[i] = (int64_t) i - 20 + (i > 30) * 2;
+    switch_source("i32", labels, 40);
+    TEST_ASSERT_TRUE(lower(source));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "switch", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_SWITCH));
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_JUMP_TABLE));
+    for (v = -30; v < 40; v++)
+        TEST_ASSERT_EQUAL(switch_expected(labels, 40, v), run(0, (uint64_t *) &v));
+}
+
+void switch_uses_bit_tests(void)
+{
+    TEST_ASSERT_TRUE(lower("function f(v: u8) -> i64 {\n"
+                           "    switch v { 1, 5, 9, 13, 60: return 1; 3, 7, 11: return 2; "
+                           "default: return 0; }\n"
+                           "}"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "switch", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(2, count_ops(0, IR_BIT_TEST));
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_JUMP_TABLE));
+    uint64_t v;
+    for (v = 0; v < 256; v++) {
+        uint64_t expected = v == 1 || v == 5 || v == 9 || v == 13 || v == 60 ? 1 : 0;
+        TEST_ASSERT_EQUAL(v == 3 || v == 7 || v == 11 ? 2 : expected, run(0, &v));
+    }
+}
+
+void switch_searches_sparse_cases(void)
+{
+    int64_t labels[300], v;
+    uint32_t i;
+    for (i = 0; i < 300; i++)
+        labels[i] = ((int64_t) i - 150) * 1000003;
+    switch_source("i64", labels, 300);
+    TEST_ASSERT_TRUE(lower(source));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "switch", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_SWITCH));
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_JUMP_TABLE));
+    TEST_ASSERT_EQUAL(300, count_ops(0, IR_EQ));
+    TEST_ASSERT_TRUE(count_ops(0, IR_LT) > 0);
+    for (i = 0; i < 300; i++) {
+        v = labels[i];
+        TEST_ASSERT_EQUAL(i % 5, run(0, (uint64_t *) &v));
+        v = labels[i] + 1;
+        TEST_ASSERT_EQUAL(99, run(0, (uint64_t *) &v));
+    }
+}
+
+void switch_mixes_clusters(void)
+{
+    int64_t labels[64], v;
+    uint32_t i, count = 0;
+    /* A dense run, scattered values and a run reaching only two blocks */
+    for (i = 0; i < 20; i++)
+        labels[count++] = 100 + i;
+    for (i = 0; i < 10; i++)
+        labels[count++] = 5000 + (int64_t) i * 977;
+    for (i = 0; i < 12; i++)
+        labels[count++] = -200 + (int64_t) i * 5;
+    switch_source("i64", labels, count);
+    TEST_ASSERT_TRUE(lower(source));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_JUMP_TABLE));
+    for (v = -250; v < 15000; v++)
+        TEST_ASSERT_EQUAL(switch_expected(labels, count, v), run(0, (uint64_t *) &v));
+}
+
+void lower_reports_unsupported(void)
+{
+    TEST_ASSERT_FALSE(lower("function half(x: f64) -> f64 { return x; }"));
+    TEST_ASSERT_EQUAL(1, diagnostics.count);
+    TEST_ASSERT_NOT_NULL(module.functions[0].error);
+}
+
+static const char *shapes_source =
+    "interface Shape { function area() -> i64; function scale(k: i64) -> i64; }\n"
+    "class Square { side: i64; }\n"
+    "class Rect { w: i64; h: i64; }\n"
+    "impl Square : Shape {\n"
+    "    function area() -> i64 { return self.side * self.side; }\n"
+    "    function scale(k: i64) -> i64 { return self.side * k; }\n"
+    "}\n"
+    "impl Rect : Shape {\n"
+    "    function area() -> i64 { return self.w * self.h; }\n"
+    "    function scale(k: i64) -> i64 { return self.h * k; }\n"
+    "}\n";
+
+static char *with_shapes(const char *code)
+{
+    static char source[2048];
+    snprintf(source, sizeof(source), "%s%s", shapes_source, code);
+    return source;
+}
+
+void lower_interfaces_as_fat_pointers(void)
+{
+    TEST_ASSERT_TRUE(lower(with_shapes("class Holder { count: i64; shape: Shape; }\n"
+                                       "function pick(s: Shape, big: bool) -> Shape {\n"
+                                       "    if big { return Rect(1, 2); }\n"
+                                       "    return s;\n"
+                                       "}\n"
+                                       "function use(h: Holder) -> i64 {\n"
+                                       "    return pick(h.shape, false).scale(h.count);\n"
+                                       "}")));
+    assert_valid();
+    TEST_ASSERT_EQUAL(2, module.vtable_count);
+    TEST_ASSERT_EQUAL_STRING("Square", ast_token(&ast, module.vtables[0].class)->value);
+    TEST_ASSERT_EQUAL(2, module.vtables[0].method_count);
+    TEST_ASSERT_EQUAL_STRING("Square.scale", module.functions[module.vtables[0].methods[1]].name);
+    TEST_ASSERT_EQUAL_STRING("Rect.area", module.functions[module.vtables[1].methods[0]].name);
+    ASSERT_IR(
+        4,
+        "function pick(ptr, ptr, bool) -> (ptr, ptr) {\n"
+        "b0:\n"
+        "  %1 = param ptr 0\n"
+        "  %2 = param ptr 1\n"
+        "  %3 = param bool 2\n"
+        "  br %3, b1, b2\n"
+        "b1: ; preds b0\n"
+        "  %5 = new ptr 16\n"
+        "  %6 = const i64 1\n"
+        "  store %5+0, %6\n"
+        "  %8 = const i64 2\n"
+        "  store %5+8, %8\n"
+        "  %10 = vtable ptr @Rect:Shape\n"
+        "  ret %5, %10\n"
+        "b2: ; preds b0\n"
+        "  ret %1, %2\n"
+        "}\n");
+    ASSERT_IR(
+        5,
+        "function use(ptr) -> i64 {\n"
+        "b0:\n"
+        "  %1 = param ptr 0\n"
+        "  %2 = load ptr %1+8\n"
+        "  %3 = load ptr %1+16\n"
+        "  %4 = const bool 0\n"
+        "  %5 = call ptr @pick(%2, %3, %4)\n"
+        "  %6 = second ptr %5\n"
+        "  %7 = method ptr %6[1]\n"
+        "  %8 = load i64 %1+0\n"
+        "  %9 = call_indirect i64 %7(%5, %8)\n"
+        "  ret %9\n"
+        "}\n");
+}
+
+void devirt_uses_known_vtables(void)
+{
+    TEST_ASSERT_TRUE(lower(with_shapes("function f(c: bool) -> i64 {\n"
+                                       "    let s: Shape = Square(2);\n"
+                                       "    if c { s = Square(3); }\n"
+                                       "    return s.area() + s.scale(2);\n"
+                                       "}")));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "devirt", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(4, IR_CALL_INDIRECT));
+    TEST_ASSERT_EQUAL(2, count_ops(4, IR_CALL));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    /* Direct calls to small methods get inlined */
+    TEST_ASSERT_EQUAL(0, count_ops(4, IR_CALL));
+    TEST_ASSERT_EQUAL(0, count_ops(4, IR_METHOD));
+}
+
+void devirt_uses_single_impls(void)
+{
+    TEST_ASSERT_TRUE(lower("interface Counter { function next() -> i64; }\n"
+                           "class Ticks { n: i64; }\n"
+                           "impl Ticks : Counter { function next() -> i64 { return self.n; } }\n"
+                           "function f(c: Counter) -> i64 { return c.next(); }"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "devirt", NULL));
+    assert_valid();
+    ASSERT_IR(
+        1,
+        "function f(ptr, ptr) -> i64 {\n"
+        "b0:\n"
+        "  %1 = param ptr 0\n"
+        "  %2 = param ptr 1\n"
+        "  %3 = func ptr @Ticks.next\n"
+        "  %4 = call i64 @Ticks.next(%1)\n"
+        "  ret %4\n"
+        "}\n");
+}
+
+void devirt_keeps_dynamic_calls(void)
+{
+    TEST_ASSERT_TRUE(lower(with_shapes("function f(s: Shape, c: bool) -> i64 {\n"
+                                       "    if c { s = Rect(1, 2); }\n"
+                                       "    return s.area();\n"
+                                       "}\n"
+                                       "function g(c: bool) -> i64 {\n"
+                                       "    let s: Shape = Square(1);\n"
+                                       "    if c { s = Rect(1, 2); }\n"
+                                       "    return s.area();\n"
+                                       "}")));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(1, count_ops(4, IR_CALL_INDIRECT));
+    TEST_ASSERT_EQUAL(1, count_ops(5, IR_CALL_INDIRECT));
+    TEST_ASSERT_EQUAL(1, count_ops(5, IR_METHOD));
+}
+
+void inline_merges_returned_pairs(void)
+{
+    TEST_ASSERT_TRUE(lower(with_shapes("function make(big: bool) -> Shape {\n"
+                                       "    if big { return Rect(3, 4); }\n"
+                                       "    return Square(2);\n"
+                                       "}\n"
+                                       "function f() -> i64 { return make(true).area(); }")));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "inline", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(5, IR_CALL_SECOND));
+    TEST_ASSERT_EQUAL(2, count_ops(5, IR_PHI));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(5, IR_CALL_INDIRECT));
+}
+
+void fold_evaluates_constants(void)
+{
+    TEST_ASSERT_TRUE(lower("function f(a: u8) -> u8 { let x: u8 = 200 + 100; return a * 1 + x; }"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "fold", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_MUL));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, "copyprop,fold,dce", NULL));
+    ASSERT_IR(
+        0,
+        "function f(u8) -> u8 {\n"
+        "b0:\n"
+        "  %1 = param u8 0\n"
+        "  %4 = const u8 44\n"
+        "  %7 = add u8 %1, %4\n"
+        "  ret %7\n"
+        "}\n");
+}
+
+void fold_removes_constant_branches(void)
+{
+    TEST_ASSERT_TRUE(lower("function f(a: i32, b: i32) -> i32 {\n"
+                           "    if 2 < 1 { return a; } else { return b; }\n"
+                           "}"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "fold", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_BRANCH));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "dce", NULL));
+    assert_valid();
+    ASSERT_IR(
+        0,
+        "function f(i32, i32) -> i32 {\n"
+        "b0:\n"
+        "  %2 = param i32 1\n"
+        "  ret %2\n"
+        "}\n");
+}
+
+void copyprop_removes_trivial_phis(void)
+{
+    TEST_ASSERT_TRUE(lower("function f(a: i32, n: i32) -> i32 {\n"
+                           "    let b = a;\n"
+                           "    for n > 0 { n -= 1; }\n"
+                           "    return b;\n"
+                           "}"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "copyprop", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(0, IR_COPY));
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_PHI));
+}
+
+void cse_shares_expressions(void)
+{
+    TEST_ASSERT_TRUE(lower("function f(a: i32, b: i32) -> i32 {\n"
+                           "    let x = a + b;\n"
+                           "    if a > 0 { return (b + a) * x; }\n"
+                           "    return a + b;\n"
+                           "}"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "cse", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_ADD));
+    TEST_ASSERT_EQUAL(1, count_ops(0, IR_CONST));
+}
+
+void dce_removes_unused_values(void)
+{
+    TEST_ASSERT_TRUE(lower("function g() -> i32 { return 1; }\n"
+                           "function f(a: i32, b: i32) -> i32 {\n"
+                           "    let x = a * b;\n"
+                           "    let y = a / b;\n"
+                           "    g();\n"
+                           "    return a;\n"
+                           "    return x;\n"
+                           "}"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "dce", NULL));
+    assert_valid();
+    /* Division may trap and calls have effects, the product is dead */
+    TEST_ASSERT_EQUAL(0, count_ops(1, IR_MUL));
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_DIV));
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_CALL));
+    TEST_ASSERT_EQUAL(1, module.functions[1].block_count);
+}
+
+void inline_copies_small_callees(void)
+{
+    TEST_ASSERT_TRUE(lower("function sq(n: i32) -> i32 { return n * n; }\n"
+                           "function fact(n: i32) -> i32 { if n < 2 { return 1; } "
+                           "return n * fact(n - 1); }\n"
+                           "function f(a: i32) -> i32 { return sq(a) + fact(a); }"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "inline", NULL));
+    assert_valid();
+    /* Recursive callees stay calls */
+    TEST_ASSERT_EQUAL(1, count_ops(2, IR_CALL));
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_CALL));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    assert_valid();
+    ASSERT_IR(
+        0,
+        "function sq(i32) -> i32 {\n"
+        "b0:\n"
+        "  %1 = param i32 0\n"
+        "  %2 = mul i32 %1, %1\n"
+        "  ret %2\n"
+        "}\n");
+    TEST_ASSERT_EQUAL(1, count_ops(2, IR_MUL));
+    TEST_ASSERT_EQUAL(1, count_ops(2, IR_CALL));
+}
+
+void inline_merges_several_returns(void)
+{
+    TEST_ASSERT_TRUE(lower("function abs(n: i32) -> i32 { if n < 0 { return -n; } return n; }\n"
+                           "function f(a: i32) -> i32 { return abs(a) + 1; }"));
+    TEST_ASSERT_TRUE(opt_run_pass(&module, "inline", NULL));
+    assert_valid();
+    TEST_ASSERT_EQUAL(0, count_ops(1, IR_CALL));
+    TEST_ASSERT_EQUAL(1, count_ops(1, IR_PHI));
+}
+
+void passes_reject_unknown_names(void)
+{
+    TEST_ASSERT_TRUE(lower("function f() {}"));
+    TEST_ASSERT_FALSE(opt_run_pass(&module, "unroll", NULL));
+    TEST_ASSERT_FALSE(opt_run_passes(&module, "fold,unroll", NULL));
+    TEST_ASSERT_TRUE(opt_run_passes(&module, "", NULL));
+    TEST_ASSERT_TRUE(opt_has_pass("cse,dce", 3));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(lower_builds_ssa);
+    RUN_TEST(lower_methods_and_objects);
+    RUN_TEST(lower_switch_falls_through);
+    RUN_TEST(lower_reports_unsupported);
+    RUN_TEST(switch_uses_jump_tables);
+    RUN_TEST(switch_uses_bit_tests);
+    RUN_TEST(switch_searches_sparse_cases);
+    RUN_TEST(switch_mixes_clusters);
+    RUN_TEST(lower_interfaces_as_fat_pointers);
+    RUN_TEST(devirt_uses_known_vtables);
+    RUN_TEST(devirt_uses_single_impls);
+    RUN_TEST(devirt_keeps_dynamic_calls);
+    RUN_TEST(inline_merges_returned_pairs);
+    RUN_TEST(fold_evaluates_constants);
+    RUN_TEST(fold_removes_constant_branches);
+    RUN_TEST(copyprop_removes_trivial_phis);
+    RUN_TEST(cse_shares_expressions);
+    RUN_TEST(dce_removes_unused_values);
+    RUN_TEST(inline_copies_small_callees);
+    RUN_TEST(inline_merges_several_returns);
+    RUN_TEST(passes_reject_unknown_names);
+    return UNITY_END();
+}
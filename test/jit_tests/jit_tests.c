@@ -0,0 +1,271 @@
+#include <arena.h>
+#include <assembler.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <emitter.h>
+#include <intern.h>
+#include <ir.h>
+#include <jit.h>
+#include <lower.h>
+#include <opt.h>
+#include <parser.h>
+#include <reader.h>
+#include <repl.h>
+#include <sema.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+static arena_t arena;
+static jit_t jit;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(jit_init(&jit));
+}
+
+void tearDown(void)
+{
+    jit_destroy(&jit);
+    arena_destroy(&arena);
+}
+
+/* Compiles `source` on its own and adds it to the JIT */
+static bool add(const char *source)
+{
+    intern_t interner;
+    ast_t ast;
+    diagnostics_t diagnostics;
+    sema_t sema;
+    ir_module_t module;
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, 0));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_TRUE(sema_check(&sema));
+    TEST_ASSERT_TRUE(ir_module_init(&module, &arena, &ast, 1));
+    TEST_ASSERT_TRUE(lower_module(&module, &sema, NULL, &diagnostics));
+    sema_destroy(&sema);
+    TEST_ASSERT_TRUE(opt_run_passes(&module, OPT_DEFAULT_PASSES, NULL));
+    bool ok = jit_add_module(&jit, &module);
+    ir_module_destroy(&module);
+    return ok;
+}
+
+static uint64_t call(const char *name)
+{
+    uint64_t result = 0;
+    if (!jit_call(&jit, name, &result))
+        TEST_FAIL_MESSAGE(jit.error);
+    return result;
+}
+
+static void check_bytes(const assembler_t *assembler, const char *expected)
+{
+    char text[256] = "";
+    size_t i;
+    for (i = 0; i < assembler->size && i < 80; i++)
+        sprintf(text + strlen(text), i ? " %02x" : "%02x", assembler->code[i]);
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+}
+
+void encodes_instructions(void)
+{
+    assembler_t assembler;
+    emitter_t e;
+    assembler_init(&assembler);
+    emitter_init_assembler(&e, &assembler);
+
+    emitter_instr(&e, "mov");
+    emitter_register(&e, "rax");
+    emitter_memory(&e, "qword", "rbp", NULL, 1, -8);
+    emitter_end(&e);
+    emitter_instr(&e, "add");
+    emitter_register(&e, "r12");
+    emitter_immediate(&e, 1000);
+    emitter_end(&e);
+    emitter_instr(&e, "movzx");
+    emitter_register(&e, "eax");
+    emitter_register(&e, "sil");
+    emitter_end(&e);
+    emitter_instr(&e, "movsxd");
+    emitter_register(&e, "rdx");
+    emitter_memory(&e, "dword", "rax", "r11", 4, 0);
+    emitter_end(&e);
+    emitter_instr(&e, "mov");
+    emitter_memory(&e, "qword", "r12", NULL, 1, 0);
+    emitter_register(&e, "rax");
+    emitter_end(&e);
+    emitter_instr(&e, "ret");
+    emitter_end(&e);
+
+    TEST_ASSERT_NULL(assembler.error);
+    check_bytes(&assembler,
+        "48 8b 45 f8 49 81 c4 e8 03 00 00 40 0f b6 c6 4a 63 14 98 49 89 04 24 c3");
+    assembler_destroy(&assembler);
+}
+
+void resolves_labels(void)
+{
+    assembler_t assembler;
+    emitter_t e;
+    assembler_init(&assembler);
+    emitter_init_assembler(&e, &assembler);
+
+    emitter_define_local(&e, ".L", 0, 0);
+    emitter_instr(&e, "jne");
+    emitter_local_operand(&e, ".L", 0, 1);
+    emitter_end(&e);
+    emitter_instr(&e, "jmp");
+    emitter_local_operand(&e, ".L", 0, 0);
+    emitter_end(&e);
+    emitter_define_local(&e, ".L", 0, 1);
+    emitter_instr(&e, "call");
+    emitter_symbol_operand(&e, "dash.f");
+    emitter_end(&e);
+    emitter_long_difference(&e, ".L", 0, 0, ".L", 0, 1);
+
+    TEST_ASSERT_TRUE(assembler_finish(&assembler));
+    check_bytes(&assembler, "0f 85 05 00 00 00 e9 f5 ff ff ff e8 00 00 00 00 f5 ff ff ff");
+    /* Only the symbol is left for whoever places the code */
+    TEST_ASSERT_EQUAL_INT(1, (int) assembler.fixup_count);
+    TEST_ASSERT_EQUAL_STRING("dash.f", assembler.fixups[0].target.symbol);
+    TEST_ASSERT_EQUAL_INT(12, (int) assembler.fixups[0].at);
+    TEST_ASSERT_EQUAL_INT(16, (int) assembler.fixups[0].end);
+
+    emitter_instr(&e, "mov");
+    emitter_register(&e, "rax");
+    emitter_register(&e, "nonsense");
+    emitter_end(&e);
+    TEST_ASSERT_EQUAL_STRING("unknown register", assembler.error);
+    assembler_destroy(&assembler);
+}
+
+void runs_compiled_code(void)
+{
+    TEST_ASSERT_TRUE(add("function fib(n: i64) -> i64 {\n"
+                         "    if n < 2 { return n; }\n"
+                         "    return fib(n - 1) + fib(n - 2);\n"
+                         "}\n"
+                         "function pick(x: i64) -> i64 {\n"
+                         "    switch x {\n"
+                         "        1: return 10; 2: return 20; 3: return 30;\n"
+                         "        4: return 40; 5: return 50; 6: return 60;\n"
+                         "        default: return 7;\n"
+                         "    }\n"
+                         "    return 0;\n"
+                         "}\n"
+                         "function wrap(x: i8) -> i8 { return x + 100; }\n"
+                         "function main() -> i64 {\n"
+                         "    let s: i64 = 0;\n"
+                         "    let i: i64 = 0;\n"
+                         "    for i < 8 { s += pick(i); i += 1; }\n"
+                         "    if wrap(100) == -56 { s += 1000; }\n"
+                         "    return fib(20) + s;\n"
+                         "}\n"));
+    TEST_ASSERT_EQUAL_INT(6765 + 224 + 1000, (int) call("main"));
+    TEST_ASSERT_NOT_NULL(jit_find_function(&jit, "fib"));
+    TEST_ASSERT_NULL(jit_find_function(&jit, "missing"));
+}
+
+void links_across_modules(void)
+{
+    const char *shapes = "interface Shape { function area() -> i64; }\n"
+                         "class Square { side: i64; }\n"
+                         "impl Square : Shape {\n"
+                         "    function area() -> i64 { return self.side * self.side; }\n"
+                         "}\n"
+                         "function area(s: Shape) -> i64 { return s.area(); }\n";
+    char source[1024];
+    TEST_ASSERT_TRUE(add(shapes));
+    void *area = jit_find_function(&jit, "area");
+    size_t size = jit.size;
+
+    /* The second module repeats the first, only `main` is new */
+    snprintf(source, sizeof(source), "%s%s", shapes,
+        "function main() -> i64 { return area(Square(6)) + area(Square(2)); }\n");
+    TEST_ASSERT_TRUE(add(source));
+    TEST_ASSERT_TRUE(area == jit_find_function(&jit, "area"));
+    TEST_ASSERT_TRUE(jit.size > size);
+    TEST_ASSERT_EQUAL_INT(40, (int) call("main"));
+}
+
+void traps(void)
+{
+    TEST_ASSERT_TRUE(add("function div(a: i64, b: i64) -> i64 { return a / b; }\n"
+                         "function zero() -> i64 { return div(7, 0); }\n"
+                         "function deep(n: i64) -> i64 { return deep(n + 1) + 1; }\n"
+                         "function overflow() -> i64 { return deep(0); }\n"
+                         "function three() -> i64 { return div(7, 2); }\n"));
+    uint64_t result;
+    TEST_ASSERT_TRUE(!jit_call(&jit, "zero", &result));
+    TEST_ASSERT_EQUAL_STRING("division by zero", jit.error);
+    TEST_ASSERT_TRUE(!jit_call(&jit, "overflow", &result));
+    TEST_ASSERT_NOT_NULL(strstr(jit.error, "stack overflow"));
+    TEST_ASSERT_EQUAL_INT(3, (int) call("three"));
+}
+
+void repl_session(void)
+{
+    const char *input = "function sq(x: i64) -> i64 { return x * x; }\n"
+                        "sq(12)\n"
+                        "let k = 7\n"
+                        "class P { x: i64; y: i64; }\n"
+                        "function sum(p: P) -> i64 {\n"
+                        "    return p.x + p.y;\n"
+                        "}\n"
+                        "sum(P(k, 2)) == 9\n"
+                        "missing(1)\n"
+                        "function sq(x: i64) -> i64 { return x; }\n"
+                        "let u: u8 = 200;\n"
+                        "u + 100\n"
+                        "10 / (k - 7)\n"
+                        "sq(-3)\n"
+                        "interface Shape { function area() -> i64; }\n"
+                        "class Square { side: i64; }\n"
+                        "impl Square : Shape { function area() -> i64 { return self.side; } }\n"
+                        "function total(s: Shape, n: i64) -> i64 { return s.area() * n; }\n"
+                        "total(Square(3), 2)\n"
+                        "class Rect { w: i64; h: i64; }\n"
+                        "impl Rect : Shape { function area() -> i64 { return self.w * self.h; } }\n"
+                        "total(Rect(2, 5), 2)\n";
+    char *output = NULL, *errors = NULL;
+    size_t output_length = 0, errors_length = 0;
+    FILE *in = fmemopen((void *) input, strlen(input), "r");
+    FILE *out = open_memstream(&output, &output_length);
+    FILE *err = open_memstream(&errors, &errors_length);
+    repl_t repl;
+    TEST_ASSERT_TRUE(repl_init(&repl, OPT_DEFAULT_PASSES));
+    repl_run(&repl, in, out, err, false);
+    repl_destroy(&repl);
+    fclose(in);
+    fclose(out);
+    fclose(err);
+
+    TEST_ASSERT_EQUAL_STRING("144\ntrue\n44\n9\n6\n20\n", output);
+    TEST_ASSERT_NOT_NULL(strstr(errors, "<repl>:1:1: error: undefined name 'missing'"));
+    TEST_ASSERT_NOT_NULL(strstr(errors, "<repl>: error: division by zero"));
+    free(output);
+    free(errors);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(encodes_instructions);
+    RUN_TEST(resolves_labels);
+    RUN_TEST(runs_compiled_code);
+    RUN_TEST(links_across_modules);
+    RUN_TEST(traps);
+    RUN_TEST(repl_session);
+    return UNITY_END();
+}
@@ -94,6 +94,25 @@ void lex_unsigned_integers(void)
     COMPARE_TOKEN_LISTS(expected_list, actual_list);
 }
 
+void lex_64_bit_integers(void)
+{
+    reader_t reader = reader_from_string(
+        "9223372036854775807 18446744073709551615 18446744073709551616 "
+        "000000000000000000000000042 123456789012345678901234567890");
+    lexer_t lexer = lexer_init(&reader);
+    init_token_list(
+        &expected_list,
+        (token_t) {.value = "9223372036854775807", .type = TOKEN_INTEGER, .line = 1, .column = 1},
+        (token_t) {.value = "18446744073709551615", .type = TOKEN_INTEGER, .line = 1, .column = 21},
+        (token_t) {.value = "18446744073709551616", .type = TOKEN_INTEGER, .line = 1, .column = 42},
+        (token_t) {.value = "42", .type = TOKEN_INTEGER, .line = 1, .column = 63},
+        (token_t) {
+            .value = "12345678901234567890123", .type = TOKEN_INTEGER, .line = 1, .column = 91},
+        (token_t) {.value = "", .type = TOKEN_EOF, .line = 1, .column = 121});
+    lex_all(&lexer, &actual_list);
+    COMPARE_TOKEN_LISTS(expected_list, actual_list);
+}
+
 void lex_operators(void)
 {
     reader_t reader = reader_from_string(
@@ -170,6 +189,7 @@ int main(void)
     RUN_TEST(lex_empty_string);
     RUN_TEST(lex_keywords);
     RUN_TEST(lex_unsigned_integers);
+    RUN_TEST(lex_64_bit_integers);
     RUN_TEST(lex_operators);
     RUN_TEST(lex_separate_with_operators);
     RUN_TEST(lex_ignore_comments);
@@ -0,0 +1,266 @@
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <parser.h>
+#include <reader.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+}
+
+void tearDown(void)
+{
+    arena_destroy(&arena);
+}
+
+static bool parse_with(const char *source, unsigned flags)
+{
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    return parser_tokenize(&ast, &lexer, &diagnostics) && parser_parse(&ast, &diagnostics, flags);
+}
+
+static bool parse(const char *source)
+{
+    return parse_with(source, 0);
+}
+
+#define ASSERT_AST(expected) \
+    do { \
+        char *actual = NULL; \
+        size_t length = 0; \
+        FILE *out = open_memstream(&actual, &length); \
+        ast_dump(&ast, AST_NONE, out); \
+        fclose(out); \
+        TEST_ASSERT_EQUAL_STRING(expected, actual); \
+        free(actual); \
+    } while (0)
+
+void parse_empty(void)
+{
+    TEST_ASSERT_TRUE(parse(""));
+    ASSERT_AST("(root)");
+    TEST_ASSERT_EQUAL(1, ast.node_count);
+}
+
+void parse_function(void)
+{
+    TEST_ASSERT_TRUE(parse("function add(a: i32, b: i32) -> i32 { return a + b; }"));
+    ASSERT_AST("(root (function add ( (param a i32) (param b i32) ) i32 (block (return (binary + a "
+               "b)))))");
+}
+
+void parse_precedence(void)
+{
+    TEST_ASSERT_TRUE(parse("let x = 1 + 2 * 3 - -4 < 5 || !a && b == c;"));
+    ASSERT_AST("(root (let x _ (binary || (binary < (binary - (binary + 1 (binary * 2 3)) (unary - "
+               "4)) 5) (binary && (unary ! a) (binary == b c)))))");
+}
+
+void parse_postfix(void)
+{
+    TEST_ASSERT_TRUE(parse("let x = -Point::make(1, f()).x;"));
+    ASSERT_AST("(root (let x _ (unary - (member (call (path Point make) 1 (call f)) x))))");
+}
+
+void parse_declarations(void)
+{
+    TEST_ASSERT_TRUE(parse(
+        "class P { x: i32; }\n"
+        "interface S { function area() -> int; }\n"
+        "impl P : S { function area() -> int { return 0; } }\n"
+        "enum Color { Red, Green, }\n"
+        "type F = function(i8, bool) -> u64;"));
+    ASSERT_AST("(root (class P (field x i32)) (interface S (function area ( ) int _)) (impl P S "
+               "(function area ( ) int (block (return 0)))) (enum Color Red Green) (type F "
+               "(function_type ( i8 bool ) u64)))");
+}
+
+void parse_statements(void)
+{
+    TEST_ASSERT_TRUE(parse(
+        "function f() { if a { skip; } else if b { x += 1; } else { g(); }"
+        " for { break; } for i < 3 { continue; } }"));
+    ASSERT_AST("(root (function f ( ) _ (block (if a (block skip) (if b (block (assign += x 1)) "
+               "(block (expr (call g))))) (for _ (block break)) (for (binary < i 3) (block "
+               "continue)))))");
+}
+
+void parse_switch(void)
+{
+    TEST_ASSERT_TRUE(parse(
+        "function f() { switch x { 1, 2: y = 1; fall; Color::Red: g(); default: { return; } } }"));
+    ASSERT_AST("(root (function f ( ) _ (block (switch x (case 1 2 (block (assign = y 1) fall)) "
+               "(case (path Color Red) (block (expr (call g)))) (case default (block (block "
+               "(return _))))))))");
+}
+
+/* extra[start..end) lies within the array and lists nodes in the order they were parsed */
+static void assert_child_range(uint32_t start, uint32_t end)
+{
+    uint32_t i;
+    TEST_ASSERT_TRUE(start <= end && end <= ast.extra_count);
+    for (i = start; i < end; i++) {
+        TEST_ASSERT_TRUE(ast.extra[i] != AST_NONE && ast.extra[i] < ast.node_count);
+        TEST_ASSERT_TRUE(i == start || ast.extra[i - 1] < ast.extra[i]);
+    }
+}
+
+void parse_nodes_are_compact(void)
+{
+    uint32_t i, ranges = 0;
+    TEST_ASSERT_EQUAL(16, sizeof(ast_node_t));
+    TEST_ASSERT_TRUE(parse("function f(a: i32, b: i32) -> i32 { g(a, b); return a + b; }"));
+    TEST_ASSERT_TRUE(ast.node_count <= ast.token_count + 1);
+    /* Variable-length children are ranges of the single extra array */
+    for (i = 0; i < ast.node_count; i++) {
+        const ast_node_t *node = ast_node(&ast, i);
+        switch ((ast_kind_t) node->kind) {
+        case AST_ROOT:
+        case AST_BLOCK:
+            assert_child_range(node->lhs, node->rhs);
+            ranges++;
+            break;
+        case AST_FUNCTION:
+            TEST_ASSERT_TRUE(node->lhs + 3 <= ast.extra_count);
+            assert_child_range(ast.extra[node->lhs], ast.extra[node->lhs + 1]);
+            TEST_ASSERT_EQUAL_INT(2, (int) (ast.extra[node->lhs + 1] - ast.extra[node->lhs]));
+            ranges++;
+            break;
+        case AST_CALL:
+            TEST_ASSERT_TRUE(node->rhs + 2 <= ast.extra_count);
+            assert_child_range(ast.extra[node->rhs], ast.extra[node->rhs + 1]);
+            TEST_ASSERT_EQUAL_INT(2, (int) (ast.extra[node->rhs + 1] - ast.extra[node->rhs]));
+            ranges++;
+            break;
+        default:
+            break;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(4, (int) ranges);
+}
+
+void parse_64_bit_integers(void)
+{
+    TEST_ASSERT_TRUE(parse("let a = 9223372036854775807; let b = 18446744073709551615;"));
+    ASSERT_AST("(root (let a _ 9223372036854775807) (let b _ 18446744073709551615))");
+}
+
+void parse_rejects_large_integers(void)
+{
+    TEST_ASSERT_FALSE(parse("let c = 18446744073709551616;"));
+    TEST_ASSERT_EQUAL(1, diagnostics.count);
+    TEST_ASSERT_EQUAL(9, diagnostics.items[0].column);
+    TEST_ASSERT_EQUAL_STRING("integer literal is too large, found '18446744073709551616'",
+        diagnostics.items[0].message);
+}
+
+void parse_rejects_integers_longer_than_tokens(void)
+{
+    TEST_ASSERT_FALSE(parse("let d = 123456789012345678901234567;"));
+    TEST_ASSERT_EQUAL(1, diagnostics.count);
+    TEST_ASSERT_EQUAL_STRING("integer literal is too large, found '12345678901234567890123'",
+        diagnostics.items[0].message);
+}
+
+void parse_reports_errors(void)
+{
+    TEST_ASSERT_FALSE(parse("function f( { }\nfunction g() { let = 1; return 2 }"));
+    TEST_ASSERT_EQUAL(3, diagnostics.count);
+    TEST_ASSERT_EQUAL(1, diagnostics.items[0].line);
+    TEST_ASSERT_EQUAL(13, diagnostics.items[0].column);
+    TEST_ASSERT_EQUAL_STRING("expected a parameter name, found '{'", diagnostics.items[0].message);
+    TEST_ASSERT_EQUAL_STRING("expected a variable name, found '='", diagnostics.items[1].message);
+    TEST_ASSERT_EQUAL_STRING("expected ';', found '}'", diagnostics.items[2].message);
+}
+
+void parse_lazy_bodies(void)
+{
+    TEST_ASSERT_TRUE(parse_with(
+        "function f(a: i32) -> i32 { if a { { b(); } return 1; } return 2; }\n"
+        "impl P { function g() { h(); } }",
+        PARSER_LAZY_BODIES));
+    ASSERT_AST("(root (function f ( (param a i32) ) i32 (lazy_body 9..26)) (impl P _ (function g ( "
+               ") _ (lazy_body 34..39))))");
+    uint32_t nodes = ast.node_count;
+
+    ast_index_t f = ast.extra[ast.nodes[0].lhs];
+    ast_index_t body = parser_parse_body(&ast, f, &diagnostics);
+    TEST_ASSERT_EQUAL(AST_BLOCK, ast.nodes[body].kind);
+    TEST_ASSERT_EQUAL(body, ast.nodes[f].rhs);
+    TEST_ASSERT_TRUE(ast.node_count > nodes);
+    /* Parsing again is a no-op */
+    TEST_ASSERT_EQUAL(body, parser_parse_body(&ast, f, &diagnostics));
+
+    TEST_ASSERT_TRUE(parser_parse_bodies(&ast, &diagnostics));
+    ASSERT_AST("(root (function f ( (param a i32) ) i32 (block (if a (block (block (expr (call "
+               "b))) (return 1)) _) (return 2))) (impl P _ (function g ( ) _ (block (expr (call "
+               "h))))))");
+}
+
+void parse_lazy_body_errors(void)
+{
+    TEST_ASSERT_TRUE(parse_with("function f() { let = 1; }", PARSER_LAZY_BODIES));
+    TEST_ASSERT_EQUAL(0, diagnostics.count);
+    TEST_ASSERT_FALSE(parser_parse_bodies(&ast, &diagnostics));
+    TEST_ASSERT_EQUAL(1, diagnostics.count);
+
+    TEST_ASSERT_FALSE(parse_with("function f() { {", PARSER_LAZY_BODIES));
+    TEST_ASSERT_EQUAL_STRING(
+        "unterminated function body, found '{'", diagnostics.items[1].message);
+}
+
+void parse_after_saved_tokens(void)
+{
+    reader_t first = reader_from_string("let a = 1;\n");
+    lexer_t lexer = lexer_init(&first);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    uint32_t count = ast.token_count - 1;
+    token_t *saved = malloc(count * sizeof(token_t));
+    memcpy(saved, ast.tokens, count * sizeof(token_t));
+
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    reader_t second = reader_from_string("let b = a;");
+    lexer = lexer_init(&second);
+    lexer.line += 1;
+    TEST_ASSERT_TRUE(parser_tokenize_after(&ast, saved, count, &lexer, &diagnostics));
+    free(saved);
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, 0));
+    ASSERT_AST("(root (let a _ 1) (let b _ a))");
+    TEST_ASSERT_EQUAL(ast.names[1], ast.names[count + 3]);
+    TEST_ASSERT_EQUAL(2, ast.tokens[count].line);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(parse_empty);
+    RUN_TEST(parse_function);
+    RUN_TEST(parse_precedence);
+    RUN_TEST(parse_postfix);
+    RUN_TEST(parse_declarations);
+    RUN_TEST(parse_statements);
+    RUN_TEST(parse_switch);
+    RUN_TEST(parse_nodes_are_compact);
+    RUN_TEST(parse_64_bit_integers);
+    RUN_TEST(parse_rejects_large_integers);
+    RUN_TEST(parse_rejects_integers_longer_than_tokens);
+    RUN_TEST(parse_reports_errors);
+    RUN_TEST(parse_lazy_bodies);
+    RUN_TEST(parse_lazy_body_errors);
+    RUN_TEST(parse_after_saved_tokens);
+    return UNITY_END();
+}
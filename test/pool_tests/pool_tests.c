@@ -0,0 +1,99 @@
+#include <pool.h>
+#include <string.h>
+#include <unity.h>
+
+static pool_t pool;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(pool_init(&pool, 4));
+}
+
+void tearDown(void)
+{
+    pool_destroy(&pool);
+}
+
+typedef struct
+{
+    uint32_t runs[10000];
+    uint32_t workers[10000];
+} counts_t;
+
+static void count_task(void *context, uint32_t worker, uint32_t task)
+{
+    counts_t *counts = context;
+    __atomic_fetch_add(&counts->runs[task], 1, __ATOMIC_RELAXED);
+    counts->workers[task] = worker;
+}
+
+static counts_t counts;
+
+void pool_runs_every_task_once(void)
+{
+    uint32_t i;
+    TEST_ASSERT_EQUAL(4, pool.worker_count);
+    memset(&counts, 0, sizeof(counts));
+    pool_run(&pool, "test", 10000, count_task, &counts);
+    for (i = 0; i < 10000; i++) {
+        TEST_ASSERT_EQUAL(1, counts.runs[i]);
+        TEST_ASSERT_TRUE(counts.workers[i] < 4);
+    }
+}
+
+void pool_runs_repeatedly(void)
+{
+    uint32_t expected[7] = {0};
+    uint32_t round, i;
+    memset(&counts, 0, sizeof(counts));
+    for (round = 0; round < 200; round++) {
+        pool_run(&pool, "test", round % 7, count_task, &counts);
+        for (i = 0; i < round % 7; i++)
+            expected[i]++;
+    }
+    for (i = 0; i < 7; i++)
+        TEST_ASSERT_EQUAL(expected[i], counts.runs[i]);
+}
+
+static void slow_first_task(void *context, uint32_t worker, uint32_t task)
+{
+    volatile uint32_t spin;
+    if (task < 100)
+        for (spin = 0; spin < 200000; spin++)
+            ;
+    count_task(context, worker, task);
+}
+
+void pool_steals_from_busy_workers(void)
+{
+    uint32_t i;
+    memset(&counts, 0, sizeof(counts));
+    /* Worker 0 owns all the slow tasks, the others finish early and steal */
+    pool_run(&pool, "test", 400, slow_first_task, &counts);
+    for (i = 0; i < 400; i++)
+        TEST_ASSERT_EQUAL(1, counts.runs[i]);
+}
+
+void pool_single_worker_runs_inline(void)
+{
+    pool_t single;
+    uint32_t i;
+    TEST_ASSERT_TRUE(pool_init(&single, 1));
+    memset(&counts, 0, sizeof(counts));
+    pool_run(&single, "test", 100, count_task, &counts);
+    for (i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(1, counts.runs[i]);
+        TEST_ASSERT_EQUAL(0, counts.workers[i]);
+    }
+    pool_destroy(&single);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(pool_runs_every_task_once);
+    RUN_TEST(pool_runs_repeatedly);
+    RUN_TEST(pool_steals_from_busy_workers);
+    RUN_TEST(pool_single_worker_runs_inline);
+    return UNITY_END();
+}
@@ -0,0 +1,385 @@
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <intern.h>
+#include <parser.h>
+#include <pool.h>
+#include <reader.h>
+#include <sema.h>
+#include <stdio.h>
+#include <string.h>
+#include <symbols.h>
+#include <unity.h>
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+static sema_t sema;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+}
+
+void tearDown(void)
+{
+    arena_destroy(&arena);
+}
+
+static bool resolve(const char *source)
+{
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, PARSER_LAZY_BODIES));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    bool declared = sema_declare(&sema);
+    return sema_resolve(&sema) && declared;
+}
+
+static intern_id_t name(const char *string)
+{
+    return intern(&interner, string, strlen(string));
+}
+
+void intern_deduplicates(void)
+{
+    intern_id_t a = name("alpha");
+    intern_id_t b = name("beta");
+    TEST_ASSERT_NOT_EQUAL(INTERN_NONE, a);
+    TEST_ASSERT_NOT_EQUAL(a, b);
+    TEST_ASSERT_EQUAL(a, name("alpha"));
+    TEST_ASSERT_EQUAL(a, intern_find(&interner, "alpha", 5));
+    TEST_ASSERT_EQUAL(INTERN_NONE, intern_find(&interner, "gamma", 5));
+    TEST_ASSERT_EQUAL_STRING("beta", intern_string(&interner, b));
+}
+
+void intern_grows(void)
+{
+    char buffer[16];
+    intern_id_t ids[2000];
+    int i;
+    for (i = 0; i < 2000; i++) {
+        snprintf(buffer, sizeof(buffer), "name%d", i);
+        ids[i] = name(buffer);
+    }
+    for (i = 0; i < 2000; i++) {
+        snprintf(buffer, sizeof(buffer), "name%d", i);
+        TEST_ASSERT_EQUAL(ids[i], name(buffer));
+        TEST_ASSERT_EQUAL_STRING(buffer, intern_string(&interner, ids[i]));
+    }
+    TEST_ASSERT_EQUAL(2001, interner.count);
+}
+
+void symbols_shadow_and_restore(void)
+{
+    symbols_t symbols;
+    symbol_index_t previous = SYMBOL_NONE;
+    intern_id_t x = name("x");
+    TEST_ASSERT_TRUE(symbols_init(&symbols, &arena, NULL));
+
+    TEST_ASSERT_NOT_EQUAL(SYMBOL_NONE, symbols_declare(&symbols, x, SYMBOL_LET, 1, NULL));
+    TEST_ASSERT_EQUAL(SYMBOL_NONE, symbols_declare(&symbols, x, SYMBOL_LET, 2, &previous));
+    TEST_ASSERT_EQUAL(1, symbols_get(&symbols, previous)->declaration);
+
+    TEST_ASSERT_TRUE(symbols_push_scope(&symbols));
+    TEST_ASSERT_NOT_EQUAL(SYMBOL_NONE, symbols_declare(&symbols, x, SYMBOL_LET, 3, NULL));
+    TEST_ASSERT_EQUAL(3, symbols_lookup(&symbols, x)->declaration);
+    symbols_pop_scope(&symbols);
+
+    TEST_ASSERT_EQUAL(1, symbols_lookup(&symbols, x)->declaration);
+    TEST_ASSERT_NULL(symbols_lookup(&symbols, name("y")));
+}
+
+void symbols_deep_nesting(void)
+{
+    symbols_t globals, locals;
+    char buffer[16];
+    uint32_t i;
+    TEST_ASSERT_TRUE(symbols_init(&globals, &arena, NULL));
+    TEST_ASSERT_TRUE(symbols_init(&locals, &arena, &globals));
+    symbols_declare(&globals, name("g"), SYMBOL_FUNCTION, 7, NULL);
+
+    for (i = 1; i <= 1000; i++) {
+        TEST_ASSERT_TRUE(symbols_push_scope(&locals));
+        snprintf(buffer, sizeof(buffer), "v%u", i % 10);
+        TEST_ASSERT_NOT_EQUAL(
+            SYMBOL_NONE, symbols_declare(&locals, name(buffer), SYMBOL_LET, i, NULL));
+    }
+    TEST_ASSERT_EQUAL(1000, symbols_lookup(&locals, name("v0"))->declaration);
+    TEST_ASSERT_EQUAL(7, symbols_lookup(&locals, name("g"))->declaration);
+
+    for (i = 1000; i > 5; i--)
+        symbols_pop_scope(&locals);
+    TEST_ASSERT_EQUAL(5, symbols_lookup(&locals, name("v5"))->declaration);
+    TEST_ASSERT_NULL(symbols_lookup(&locals, name("v6")));
+}
+
+void resolve_names(void)
+{
+    TEST_ASSERT_TRUE(resolve(
+        "class P { x: i32; }\n"
+        "function f(p: P) -> i32 { let a = 1; { let a = a; return a; } }\n"
+        "function g() -> i32 { return f(P(1)); }"));
+    TEST_ASSERT_EQUAL(0, diagnostics.count);
+
+    /* `a` in the inner initializer refers to the outer let */
+    uint32_t i;
+    ast_index_t outer = AST_NONE;
+    for (i = 1; i < ast.node_count; i++) {
+        if (ast.nodes[i].kind == AST_LET && outer == AST_NONE)
+            outer = i;
+        if (ast.nodes[i].kind == AST_LET && i != outer)
+            TEST_ASSERT_EQUAL(outer, sema.declarations[ast.nodes[i].rhs]);
+    }
+}
+
+void resolve_reports_errors(void)
+{
+    TEST_ASSERT_FALSE(resolve(
+        "function f(a: i32, a: i32) -> T { return b; }\n"
+        "function f() {}\n"
+        "impl f { }"));
+    TEST_ASSERT_EQUAL(5, diagnostics.count);
+    TEST_ASSERT_EQUAL_STRING(
+        "redefinition of 'f' (previously declared at line 1)", diagnostics.items[0].message);
+    TEST_ASSERT_EQUAL_STRING(
+        "redefinition of 'a' (previously declared at line 1)", diagnostics.items[1].message);
+    TEST_ASSERT_EQUAL_STRING("unknown type 'T'", diagnostics.items[2].message);
+    TEST_ASSERT_EQUAL_STRING("undefined name 'b'", diagnostics.items[3].message);
+    TEST_ASSERT_EQUAL_STRING("'f' is not a class", diagnostics.items[4].message);
+}
+
+static bool check(const char *source)
+{
+    return resolve(source) && sema_check(&sema);
+}
+
+void types_hash_cons(void)
+{
+    types_t types;
+    TEST_ASSERT_TRUE(types_init(&types, &arena));
+    type_id_t params[2] = {TYPE_I32, TYPE_BOOL};
+    type_id_t f = types_function(&types, params, 2, TYPE_I64);
+    TEST_ASSERT_EQUAL(f, types_function(&types, params, 2, TYPE_I64));
+    TEST_ASSERT_NOT_EQUAL(f, types_function(&types, params, 1, TYPE_I64));
+    TEST_ASSERT_NOT_EQUAL(f, types_function(&types, params, 2, TYPE_VOID));
+    TEST_ASSERT_NOT_EQUAL(
+        types_nominal(&types, TYPE_CLASS, 3), types_nominal(&types, TYPE_CLASS, 4));
+    TEST_ASSERT_EQUAL(types_nominal(&types, TYPE_ENUM, 3), types_nominal(&types, TYPE_ENUM, 3));
+
+    /* Nested function types, enough of them to rehash */
+    type_id_t previous = TYPE_VOID;
+    uint32_t i;
+    for (i = 0; i < 1000; i++)
+        previous = types_function(&types, &previous, 1, TYPE_VOID);
+    TEST_ASSERT_EQUAL(TYPE_PRIMITIVE_COUNT + 6 + 1000, types.count);
+    previous = TYPE_VOID;
+    for (i = 0; i < 1000; i++)
+        previous = types_function(&types, &previous, 1, TYPE_VOID);
+    TEST_ASSERT_EQUAL(TYPE_PRIMITIVE_COUNT + 6 + 1000, types.count);
+
+    /* Reserved room is used in place, the arrays do not move */
+    TEST_ASSERT_TRUE(types_reserve(&types, 1000, 2000));
+    const type_t *reserved = types_get(&types, TYPE_VOID);
+    const type_id_t *reserved_params = types_params(&types, f);
+    for (i = 0; i < 1000; i++)
+        previous = types_function(&types, params, 2, previous);
+    TEST_ASSERT_EQUAL_PTR(reserved, types_get(&types, TYPE_VOID));
+    TEST_ASSERT_EQUAL_PTR(reserved_params, types_params(&types, f));
+
+    char buffer[64];
+    types_format(&types, &ast, f, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("function(i32, bool) -> i64", buffer);
+    TEST_ASSERT_EQUAL(0xFFFFFFFFFFFFFF80ull, type_wrap(TYPE_I8, 128));
+    TEST_ASSERT_EQUAL(0x80, type_wrap(TYPE_U8, 0x180));
+}
+
+void check_accepts_program(void)
+{
+    TEST_ASSERT_TRUE(check(
+        "enum Color { Red, Green, Blue, }\n"
+        "type Callback = function(i32) -> i32;\n"
+        "let LIMIT: i32 = 4 * 8;\n"
+        "interface Shape { function area() -> i64; }\n"
+        "class Square { side: i64; next: Square; }\n"
+        "impl Square : Shape { function area() -> i64 { return self.side * self.side; } }\n"
+        "function twice(f: Callback, x: i32) -> i32 { return f(f(x)); }\n"
+        "function inc(x: i32) -> i32 { return x + 1; }\n"
+        "function use(s: Shape) -> i64 { return s.area(); }\n"
+        "function pick(c: Color) -> i32 {\n"
+        "    switch c { Color::Red: fall; Color::Green: return LIMIT; default: return 1; }\n"
+        "}\n"
+        "function main() -> i64 {\n"
+        "    let s = Square(3, null);\n"
+        "    let n: u8 = 255;\n"
+        "    let total = use(s) + 1;\n"
+        "    let p = pick(Color::Blue) + twice(inc, -2147483648);\n"
+        "    for { if total > 10 { return total; } total += 1; }\n"
+        "}"));
+    TEST_ASSERT_EQUAL(0, diagnostics.count);
+
+    /* Literals take the expected type and the structural function type is shared */
+    uint32_t i;
+    type_id_t callback = TYPE_ERROR;
+    for (i = 1; i < ast.node_count; i++) {
+        if (ast.nodes[i].kind == AST_TYPE_ALIAS)
+            callback = sema.node_types[i];
+        if (ast.nodes[i].kind == AST_LET && !strcmp(ast_token(&ast, i)->value, "n"))
+            TEST_ASSERT_EQUAL(TYPE_U8, sema.node_types[ast.nodes[i].rhs]);
+        if (ast.nodes[i].kind == AST_FUNCTION && !strcmp(ast_token(&ast, i)->value, "inc"))
+            TEST_ASSERT_EQUAL(callback, sema.node_types[i]);
+    }
+    TEST_ASSERT_NOT_EQUAL(TYPE_ERROR, callback);
+}
+
+void check_reports_errors(void)
+{
+    TEST_ASSERT_FALSE(check(
+        "enum E { A, B, }\n"
+        "interface I { function f() -> i32; }\n"
+        "class C { x: i32; }\n"
+        "class D { }\n"
+        "impl C : I { function f() -> bool { return true; } }\n"
+        "type Loop = Loop;\n"
+        "let G = G + 1;\n"
+        "function g(c: C) -> i32 {\n"
+        "    let b: bool = 1;\n"
+        "    let u: u8 = 256;\n"
+        "    c.y = 2;\n"
+        "    switch c.x { 1: skip; 1: fall; }\n"
+        "    break;\n"
+        "    let i: I = D();\n"
+        "    if c.x { }\n"
+        "}"));
+    const char *expected[] = {
+        "type alias 'Loop' refers to itself",
+        "'f' should have type 'function() -> i32' to implement 'I'",
+        "'G' is defined in terms of itself",
+        "expected 'bool' but found 'i64'",
+        "integer literal 256 does not fit in 'u8'",
+        "'C' has no field 'y'",
+        "'fall' in the last case of a switch",
+        "duplicate case label",
+        "'break' outside of a loop",
+        "expected 'I' but found 'D'",
+        "expected 'bool' but found 'i32'",
+        "function 'g' does not return a value on every path",
+    };
+    uint32_t i, count = sizeof(expected) / sizeof(expected[0]);
+    for (i = 0; i < diagnostics.count && i < count; i++)
+        TEST_ASSERT_EQUAL_STRING(expected[i], diagnostics.items[i].message);
+    TEST_ASSERT_EQUAL(count, diagnostics.count);
+}
+
+void check_in_parallel(void)
+{
+    char source[16384] = "class C { x: i32; }\n";
+    char function[160];
+    int i;
+    for (i = 0; i < 60; i++) {
+        snprintf(
+            function,
+            sizeof(function),
+            "function fn%d(c: C) -> i32 { let b: bool = %d; return c.x + fn%d(c); }\n",
+            i,
+            i,
+            (i + 1) % 60);
+        strcat(source, function);
+    }
+
+    pool_t pool;
+    TEST_ASSERT_TRUE(pool_init(&pool, 4));
+    TEST_ASSERT_TRUE(resolve(source));
+    sema.pool = &pool;
+    TEST_ASSERT_FALSE(sema_check(&sema));
+    sema_destroy(&sema);
+    pool_destroy(&pool);
+
+    /* One error per function, merged back in declaration order */
+    TEST_ASSERT_EQUAL(60, diagnostics.count);
+    for (i = 0; i < 60; i++) {
+        TEST_ASSERT_EQUAL(i + 2, diagnostics.items[i].line);
+        TEST_ASSERT_EQUAL_STRING("expected 'bool' but found 'i64'", diagnostics.items[i].message);
+    }
+}
+
+void check_function_types_in_parallel(void)
+{
+    static const char *types[] = {"i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64"};
+    char source[32768] = "";
+    char function[200], expected[64];
+    int i;
+    /* Every body spells function types no other body does */
+    for (i = 0; i < 64; i++) {
+        snprintf(function, sizeof(function),
+            "function fn%d(x: bool) -> bool { let f: function(%s) -> %s = fn%d; return x; }\n", i,
+            types[i % 8], types[i / 8], i);
+        strcat(source, function);
+    }
+
+    pool_t pool;
+    TEST_ASSERT_TRUE(pool_init(&pool, 4));
+    TEST_ASSERT_TRUE(resolve(source));
+    sema.pool = &pool;
+    TEST_ASSERT_FALSE(sema_check(&sema));
+    sema_destroy(&sema);
+    pool_destroy(&pool);
+
+    TEST_ASSERT_EQUAL(64, diagnostics.count);
+    for (i = 0; i < 64; i++) {
+        snprintf(expected, sizeof(expected), "expected 'function(%s) -> %s' but found",
+            types[i % 8], types[i / 8]);
+        TEST_ASSERT_TRUE(!strncmp(expected, diagnostics.items[i].message, strlen(expected)));
+    }
+}
+
+void check_skips_settled_bodies(void)
+{
+    reader_t reader = reader_from_string(
+        "class C { x: i32; }\n"
+        "impl C { function m() -> i32 { return missing; } }\n"
+        "function old(c: C) -> i32 { let b: bool = 1; return c.m(); }\n"
+        "function fresh(c: C) -> i32 { let b: bool = 2; return old(c); }\n");
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, PARSER_LAZY_BODIES));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    sema.settled_count = 3;
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_FALSE(sema_check(&sema));
+    sema_destroy(&sema);
+
+    /* Only the new body is parsed and checked, calls into settled ones still type */
+    TEST_ASSERT_EQUAL(1, diagnostics.count);
+    TEST_ASSERT_EQUAL(4, diagnostics.items[0].line);
+    TEST_ASSERT_EQUAL_STRING("expected 'bool' but found 'i64'", diagnostics.items[0].message);
+    uint32_t i, lazy = 0;
+    for (i = 1; i < ast.node_count; i++)
+        lazy += ast.nodes[i].kind == AST_FUNCTION
+                && ast.nodes[ast.nodes[i].rhs].kind == AST_LAZY_BODY;
+    TEST_ASSERT_EQUAL(2, lazy);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(intern_deduplicates);
+    RUN_TEST(intern_grows);
+    RUN_TEST(symbols_shadow_and_restore);
+    RUN_TEST(symbols_deep_nesting);
+    RUN_TEST(resolve_names);
+    RUN_TEST(resolve_reports_errors);
+    RUN_TEST(types_hash_cons);
+    RUN_TEST(check_accepts_program);
+    RUN_TEST(check_reports_errors);
+    RUN_TEST(check_in_parallel);
+    RUN_TEST(check_function_types_in_parallel);
+    RUN_TEST(check_skips_settled_bodies);
+    return UNITY_END();
+}
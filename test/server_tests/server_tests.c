@@ -0,0 +1,99 @@
+#include <arena.h>
+#include <pool.h>
+#include <server.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+static pool_t pool;
+static server_t server;
+static size_t arena_used_before;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(pool_init(&pool, 2));
+    TEST_ASSERT_TRUE(server_init(&server, &pool, NULL));
+    arena_used_before = 0;
+}
+
+void tearDown(void)
+{
+    server_destroy(&server);
+    pool_destroy(&pool);
+}
+
+/* Prints its arguments to `out`, one per line, and their count to `err` */
+static int echo(server_t *context, int argc, char **argv, FILE *out, FILE *err)
+{
+    int i;
+    arena_used_before = arena_used(&context->arena);
+    TEST_ASSERT_NOT_NULL(arena_alloc(&context->arena, 1024));
+    for (i = 0; i < argc; i++)
+        fprintf(out, "%s\n", argv[i]);
+    fprintf(err, "%d", argc);
+    return argc;
+}
+
+/* Reply to `requests` */
+static char *serve(const char *requests)
+{
+    char *reply = NULL;
+    size_t length = 0;
+    FILE *in = fmemopen((void *) requests, strlen(requests), "r");
+    FILE *out = open_memstream(&reply, &length);
+    TEST_ASSERT_NOT_NULL(in);
+    TEST_ASSERT_NOT_NULL(out);
+    server_serve(&server, in, out);
+    fclose(in);
+    fclose(out);
+    return reply;
+}
+
+void frames_replies(void)
+{
+    server.compile = echo;
+    char *reply = serve("-S  a.dash\tb.dash\n\n");
+    TEST_ASSERT_EQUAL_STRING("4 22 1\ndash\n-S\na.dash\nb.dash\n4"
+                             "1 5 1\ndash\n1",
+        reply);
+    TEST_ASSERT_EQUAL_INT(2, (int) server.request_count);
+    free(reply);
+}
+
+void resets_arena_between_requests(void)
+{
+    server.compile = echo;
+    char *reply = serve("a\nb\n");
+    TEST_ASSERT_EQUAL_INT(0, (int) arena_used_before);
+    TEST_ASSERT_EQUAL_INT(1024, (int) arena_used(&server.arena));
+    free(reply);
+}
+
+void stops_on_request(void)
+{
+    server.compile = echo;
+    char *reply = serve("a\nstop\nb\n");
+    TEST_ASSERT_EQUAL_STRING("2 7 1\ndash\na\n20 0 0\n", reply);
+    TEST_ASSERT_TRUE(server.stopping);
+    TEST_ASSERT_EQUAL_INT(2, (int) server.request_count);
+    free(reply);
+}
+
+void refuses_long_socket_paths(void)
+{
+    char path[256];
+    memset(path, 'x', sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    TEST_ASSERT_TRUE(!server_listen(&server, path));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(frames_replies);
+    RUN_TEST(resets_arena_between_requests);
+    RUN_TEST(stops_on_request);
+    RUN_TEST(refuses_long_socket_paths);
+    return UNITY_END();
+}
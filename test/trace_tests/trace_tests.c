@@ -0,0 +1,192 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+#include <unistd.h>
+#include <unity.h>
+
+static char path[32];
+
+void setUp(void)
+{
+    strcpy(path, "/tmp/dash-trace-XXXXXX");
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+    trace_enable();
+}
+
+void tearDown(void)
+{
+    trace_disable();
+    trace_destroy();
+    unlink(path);
+}
+
+static char *report(void)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    trace_report(out);
+    fclose(out);
+    return text;
+}
+
+static char *write_json(void)
+{
+    TEST_ASSERT_TRUE(trace_write_json(path));
+    FILE *in = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(in);
+    char *text = calloc(1, 4096);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_TRUE(fread(text, 1, 4095, in) < 4095);
+    fclose(in);
+    return text;
+}
+
+/* Brackets outside strings balance, and nothing follows the outer object */
+static bool well_formed(const char *json)
+{
+    int depth = 0;
+    bool quoted = false;
+    for (; *json != '\0'; json++) {
+        if (*json == '"')
+            quoted = !quoted;
+        else if (!quoted && (*json == '{' || *json == '['))
+            depth++;
+        else if (!quoted && (*json == '}' || *json == ']') && --depth == 0)
+            return !strcmp(json + 1, "\n");
+        if (depth < 0)
+            return false;
+    }
+    return false;
+}
+
+static size_t occurrences(const char *text, const char *needle)
+{
+    size_t count = 0;
+    for (; (text = strstr(text, needle)) != NULL; text++)
+        count++;
+    return count;
+}
+
+void pairs_spans_and_counters(void)
+{
+    trace_span_t outer = trace_begin("parse");
+    trace_span_t inner = trace_begin("lex");
+    trace_end(&inner);
+    inner = trace_begin("lex");
+    trace_end(&inner);
+    trace_end(&outer);
+    trace_counter("tokens", 42);
+
+    char *text = report();
+    TEST_ASSERT_EQUAL_INT(1, (int) occurrences(text, "lex "));
+    TEST_ASSERT_NOT_NULL(strstr(text, " ms (2 spans)\n"));
+    TEST_ASSERT_EQUAL_INT(1, (int) occurrences(text, "parse "));
+    TEST_ASSERT_EQUAL_INT(1, (int) occurrences(text, "spans"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "tokens                             42\n"));
+    /* Spans are recorded as they end */
+    TEST_ASSERT_TRUE(strstr(text, "lex ") < strstr(text, "parse "));
+    free(text);
+}
+
+void writes_chrome_json(void)
+{
+    trace_span_t span = trace_begin("parse");
+    trace_end(&span);
+    trace_counter("tokens", 42);
+
+    char *json = write_json();
+    TEST_ASSERT_TRUE(well_formed(json));
+    TEST_ASSERT_TRUE(!strncmp(json, "{\"traceEvents\":[\n", 17));
+    TEST_ASSERT_EQUAL_INT(2, (int) occurrences(json, "{\"name\":"));
+    TEST_ASSERT_EQUAL_INT(1, (int) occurrences(json, "\"ph\":\"X\",\"dur\":"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"parse\",\"pid\":1,\"tid\":1,\"ts\":"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"ph\":\"C\",\"args\":{\"tokens\":42}}\n"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "],\"displayTimeUnit\":\"ms\"}\n"));
+    free(json);
+}
+
+void writes_empty_traces(void)
+{
+    char *json = write_json();
+    TEST_ASSERT_TRUE(well_formed(json));
+    TEST_ASSERT_EQUAL_STRING("{\"traceEvents\":[\n],\"displayTimeUnit\":\"ms\"}\n", json);
+    free(json);
+}
+
+static void *record_on_worker(void *context)
+{
+    (void) context;
+    trace_set_thread(3);
+    trace_span_t span = trace_begin("worker");
+    trace_end(&span);
+    return NULL;
+}
+
+void tags_events_with_their_thread(void)
+{
+    pthread_t thread;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, record_on_worker, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+    trace_span_t span = trace_begin("main");
+    trace_end(&span);
+
+    char *json = write_json();
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"worker\",\"pid\":1,\"tid\":4,"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"main\",\"pid\":1,\"tid\":1,"));
+    free(json);
+}
+
+void records_nothing_while_disabled(void)
+{
+    trace_span_t straddling = trace_begin("straddling");
+    trace_disable();
+    TEST_ASSERT_TRUE(!trace_enabled);
+    trace_span_t span = trace_begin("disabled");
+    trace_end(&span);
+    trace_counter("disabled", 1);
+    trace_end(&straddling);
+
+    /* A span begun while disabled is dropped even if tracing comes back */
+    span = trace_begin("late");
+    trace_enable();
+    trace_end(&span);
+
+    char *text = report();
+    TEST_ASSERT_EQUAL_STRING("", text);
+    free(text);
+}
+
+void destroy_drops_events(void)
+{
+    trace_span_t span = trace_begin("parse");
+    trace_end(&span);
+    trace_counter("tokens", 1);
+    trace_destroy();
+
+    char *text = report();
+    TEST_ASSERT_EQUAL_STRING("", text);
+    free(text);
+
+    /* Recording starts over afterwards */
+    trace_counter("tokens", 2);
+    text = report();
+    TEST_ASSERT_EQUAL_INT(1, (int) occurrences(text, "tokens"));
+    free(text);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(pairs_spans_and_counters);
+    RUN_TEST(writes_chrome_json);
+    RUN_TEST(writes_empty_traces);
+    RUN_TEST(tags_events_with_their_thread);
+    RUN_TEST(records_nothing_while_disabled);
+    RUN_TEST(destroy_drops_events);
+    return UNITY_END();
+}
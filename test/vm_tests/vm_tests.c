@@ -0,0 +1,250 @@
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <intern.h>
+#include <ir.h>
+#include <lower.h>
+#include <opt.h>
+#include <parser.h>
+#include <reader.h>
+#include <sema.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include <vm.h>
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+static sema_t sema;
+static ir_module_t module;
+static vm_t vm;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+    memset(&module, 0, sizeof(ir_module_t));
+    memset(&vm, 0, sizeof(vm_t));
+}
+
+void tearDown(void)
+{
+    vm_destroy(&vm);
+    ir_module_destroy(&module);
+    arena_destroy(&arena);
+}
+
+static void compile(const char *source, const char *passes)
+{
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, 0));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_TRUE(sema_check(&sema));
+    TEST_ASSERT_TRUE(ir_module_init(&module, &arena, &ast, 1));
+    TEST_ASSERT_TRUE(lower_module(&module, &sema, NULL, &diagnostics));
+    sema_destroy(&sema);
+    TEST_ASSERT_TRUE(opt_run_passes(&module, passes, NULL));
+    TEST_ASSERT_TRUE(vm_init(&vm, &module));
+}
+
+static uint64_t call(const char *name, const uint64_t *args, uint32_t count)
+{
+    uint64_t result = 0;
+    uint32_t index = vm_find_function(&vm, name);
+    TEST_ASSERT_TRUE(index != UINT32_MAX);
+    if (!vm_call(&vm, index, args, count, &result))
+        TEST_FAIL_MESSAGE(vm.error);
+    return result;
+}
+
+/* Bytecode of function `name` as vm_dump_function prints it */
+static char *dump(const char *name)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    TEST_ASSERT_NOT_NULL(out);
+    vm_dump_function(&vm, vm_find_function(&vm, name), out);
+    fclose(out);
+    return text;
+}
+
+static const char *shapes_source =
+    "interface Shape { function area() -> i64; function scale(k: i64) -> i64; }\n"
+    "class Square { side: i64; }\n"
+    "class Rect { w: i64; h: i64; }\n"
+    "impl Square : Shape {\n"
+    "    function area() -> i64 { return self.side * self.side; }\n"
+    "    function scale(k: i64) -> i64 { return self.side * k; }\n"
+    "}\n"
+    "impl Rect : Shape {\n"
+    "    function area() -> i64 { return self.w * self.h; }\n"
+    "    function scale(k: i64) -> i64 { return self.h * k; }\n"
+    "}\n"
+    "function make(big: bool) -> Shape {\n"
+    "    if big { return Rect(3, 4); }\n"
+    "    return Square(2);\n"
+    "}\n"
+    "function total(s: Shape, n: i64) -> i64 {\n"
+    "    let sum: i64 = 0;\n"
+    "    for n > 0 { sum += s.area(); n -= 1; }\n"
+    "    return sum;\n"
+    "}\n"
+    "function main() -> i64 {\n"
+    "    let s = make(false);\n"
+    "    return total(make(true), 2) + s.scale(5) + make(true).scale(2);\n"
+    "}\n";
+
+void runs_recursion(void)
+{
+    uint64_t n = 20;
+    compile("function fib(n: i64) -> i64 {\n"
+            "    if n < 2 { return n; }\n"
+            "    return fib(n - 1) + fib(n - 2);\n"
+            "}\n",
+        OPT_DEFAULT_PASSES);
+    TEST_ASSERT_EQUAL_INT(6765, (int) call("fib", &n, 1));
+}
+
+void runs_phi_cycles(void)
+{
+    uint64_t n = 4;
+    compile("function rotate(n: i64) -> i64 {\n"
+            "    let a: i64 = 1;\n"
+            "    let b: i64 = 2;\n"
+            "    let c: i64 = 3;\n"
+            "    for n > 0 { let t = a; a = b; b = c; c = t; n -= 1; }\n"
+            "    return a * 100 + b * 10 + c;\n"
+            "}\n",
+        OPT_DEFAULT_PASSES);
+    TEST_ASSERT_EQUAL_INT(231, (int) call("rotate", &n, 1));
+    n = 3;
+    TEST_ASSERT_EQUAL_INT(123, (int) call("rotate", &n, 1));
+}
+
+void runs_narrow_arithmetic(void)
+{
+    compile("function wrap(x: i8) -> i8 { return x + 100; }\n"
+            "function uwrap(x: u8) -> u8 { return x * 3; }\n"
+            "function udiv(x: u64, y: u64) -> u64 { return x / y; }\n"
+            "function sdiv(x: i64, y: i64) -> i64 { return x / y; }\n"
+            "function smod(x: i32, y: i32) -> i32 { return x % y; }\n"
+            "function main() -> i64 {\n"
+            "    let ok: i64 = 0;\n"
+            "    if wrap(100) == -56 { ok += 1; }\n"
+            "    if uwrap(100) == 44 { ok += 2; }\n"
+            "    if udiv(0 - 1, 2) > 1000 { ok += 4; }\n"
+            "    if sdiv(0 - 7, 2) == -3 { ok += 8; }\n"
+            "    if smod(0 - 7, 3) == -1 { ok += 16; }\n"
+            "    return ok;\n"
+            "}\n",
+        "");
+    TEST_ASSERT_EQUAL_INT(31, (int) call("main", NULL, 0));
+}
+
+void runs_switches(void)
+{
+    compile("function pick(x: i64) -> i64 {\n"
+            "    switch x {\n"
+            "        1: return 10; 2: return 20; 3: return 30;\n"
+            "        4: return 40; 5: return 50; 6: return 60;\n"
+            "        default: return 7;\n"
+            "    }\n"
+            "    return 0;\n"
+            "}\n"
+            "function bits(x: i64) -> i64 {\n"
+            "    switch x { 1, 3, 5, 7, 9, 11: return 1; default: return 2; }\n"
+            "    return 0;\n"
+            "}\n"
+            "function main() -> i64 {\n"
+            "    let s: i64 = 0;\n"
+            "    let i: i64 = 0;\n"
+            "    for i < 12 { s += pick(i) + bits(i) * 100; i += 1; }\n"
+            "    return s;\n"
+            "}\n",
+        OPT_DEFAULT_PASSES);
+    TEST_ASSERT_EQUAL_INT(2052, (int) call("main", NULL, 0));
+    char *text = dump("pick");
+    TEST_ASSERT_NOT_NULL(strstr(text, "jtab "));
+    free(text);
+}
+
+void runs_interface_dispatch(void)
+{
+    compile(shapes_source, "");
+    TEST_ASSERT_EQUAL_INT(42, (int) call("main", NULL, 0));
+}
+
+void caches_interface_calls(void)
+{
+    compile(shapes_source, "");
+    char *text = dump("total");
+    TEST_ASSERT_NOT_NULL(strstr(text, "callm "));
+    TEST_ASSERT_NULL(strstr(text, "method "));
+    free(text);
+
+    /* Three call sites, the one in total's loop sees the same vtable twice */
+    TEST_ASSERT_EQUAL_INT(42, (int) call("main", NULL, 0));
+    TEST_ASSERT_EQUAL_INT(1, (int) vm.cache_hits);
+    TEST_ASSERT_EQUAL_INT(3, (int) vm.cache_misses);
+    /* and the caches stay warm across calls */
+    TEST_ASSERT_EQUAL_INT(42, (int) call("main", NULL, 0));
+    TEST_ASSERT_EQUAL_INT(5, (int) vm.cache_hits);
+    TEST_ASSERT_EQUAL_INT(3, (int) vm.cache_misses);
+}
+
+void fuses_superinstructions(void)
+{
+    compile("function count(n: i64) -> i64 {\n"
+            "    let i: i64 = 0;\n"
+            "    for i < n { i += 1; }\n"
+            "    return i;\n"
+            "}\n",
+        OPT_DEFAULT_PASSES);
+    char *text = dump("count");
+    TEST_ASSERT_NOT_NULL(strstr(text, "addi r"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "blt r"));
+    TEST_ASSERT_NULL(strstr(text, " lt r"));
+    TEST_ASSERT_NULL(strstr(text, "brt "));
+    free(text);
+
+    uint64_t n = 1000;
+    TEST_ASSERT_EQUAL_INT(1000, (int) call("count", &n, 1));
+}
+
+void traps(void)
+{
+    uint64_t args[2] = {7, 0}, result;
+    compile("function div(a: i64, b: i64) -> i64 { return a / b; }\n"
+            "function deep(n: i64) -> i64 { return deep(n + 1) + 1; }\n",
+        "");
+    TEST_ASSERT_TRUE(!vm_call(&vm, vm_find_function(&vm, "div"), args, 2, &result));
+    TEST_ASSERT_EQUAL_STRING("division by zero", vm.error);
+    TEST_ASSERT_TRUE(!vm_call(&vm, vm_find_function(&vm, "deep"), args, 1, &result));
+    TEST_ASSERT_EQUAL_STRING("stack overflow", vm.error);
+    args[1] = 2;
+    TEST_ASSERT_EQUAL_INT(3, (int) call("div", args, 2));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(runs_recursion);
+    RUN_TEST(runs_phi_cycles);
+    RUN_TEST(runs_narrow_arithmetic);
+    RUN_TEST(runs_switches);
+    RUN_TEST(runs_interface_dispatch);
+    RUN_TEST(caches_interface_calls);
+    RUN_TEST(fuses_superinstructions);
+    RUN_TEST(traps);
+    return UNITY_END();
+}
@@ -0,0 +1,294 @@
+#include <arena.h>
+#include <ast.h>
+#include <diagnostic.h>
+#include <intern.h>
+#include <ir.h>
+#include <lower.h>
+#include <opt.h>
+#include <parser.h>
+#include <reader.h>
+#include <sema.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+#include <writer.h>
+#include <x86.h>
+
+static arena_t arena;
+static intern_t interner;
+static ast_t ast;
+static diagnostics_t diagnostics;
+static sema_t sema;
+static ir_module_t module;
+static char *assembly;
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(arena_init(&arena));
+    TEST_ASSERT_TRUE(intern_init(&interner, &arena));
+    TEST_ASSERT_TRUE(ast_init(&ast, &arena, &interner));
+    diagnostics_init(&diagnostics, &arena);
+    memset(&module, 0, sizeof(ir_module_t));
+    assembly = NULL;
+}
+
+void tearDown(void)
+{
+    free(assembly);
+    ir_module_destroy(&module);
+    arena_destroy(&arena);
+}
+
+static void compile(const char *source, const char *passes)
+{
+    reader_t reader = reader_from_string(source);
+    lexer_t lexer = lexer_init(&reader);
+    TEST_ASSERT_TRUE(parser_tokenize(&ast, &lexer, &diagnostics));
+    TEST_ASSERT_TRUE(parser_parse(&ast, &diagnostics, 0));
+    TEST_ASSERT_TRUE(sema_init(&sema, &ast, &arena, &diagnostics));
+    TEST_ASSERT_TRUE(sema_declare(&sema));
+    TEST_ASSERT_TRUE(sema_resolve(&sema));
+    TEST_ASSERT_TRUE(sema_check(&sema));
+    TEST_ASSERT_TRUE(ir_module_init(&module, &arena, &ast, 1));
+    TEST_ASSERT_TRUE(lower_module(&module, &sema, NULL, &diagnostics));
+    sema_destroy(&sema);
+    TEST_ASSERT_TRUE(opt_run_passes(&module, passes, NULL));
+
+    writer_t writer;
+    emitter_t emitter;
+    TEST_ASSERT_TRUE(writer_init_memory(&writer));
+    emitter_init(&emitter, &writer);
+    TEST_ASSERT_TRUE(x86_emit_module(&module, &emitter));
+    TEST_ASSERT_TRUE(writer_flush(&writer));
+    /* The test owns the buffer from here */
+    assembly = writer.data;
+}
+
+/* Assembles, links and runs the program, returning its exit status */
+static int run(const char *source, const char *passes)
+{
+    char path[] = "/tmp/dash-x86-XXXXXX.s", program[sizeof(path)], command[128];
+    compile(source, passes);
+
+    int fd = mkstemps(path, 2);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_TRUE(write(fd, assembly, strlen(assembly)) == (ssize_t) strlen(assembly));
+    close(fd);
+    strcpy(program, path);
+    program[strlen(program) - 2] = '\0';
+
+    snprintf(command, sizeof(command), "cc -o %s %s", program, path);
+    int status = system(command);
+    unlink(path);
+    TEST_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    status = system(program);
+    unlink(program);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static const char *shapes_source =
+    "interface Shape { function area() -> i64; function scale(k: i64) -> i64; }\n"
+    "class Square { side: i64; }\n"
+    "class Rect { w: i64; h: i64; }\n"
+    "impl Square : Shape {\n"
+    "    function area() -> i64 { return self.side * self.side; }\n"
+    "    function scale(k: i64) -> i64 { return self.side * k; }\n"
+    "}\n"
+    "impl Rect : Shape {\n"
+    "    function area() -> i64 { return self.w * self.h; }\n"
+    "    function scale(k: i64) -> i64 { return self.h * k; }\n"
+    "}\n"
+    "function make(big: bool) -> Shape {\n"
+    "    if big { return Rect(3, 4); }\n"
+    "    return Square(2);\n"
+    "}\n"
+    "function total(s: Shape, n: i64) -> i64 {\n"
+    "    let sum: i64 = 0;\n"
+    "    for n > 0 { sum += s.area(); n -= 1; }\n"
+    "    return sum;\n"
+    "}\n"
+    "function main() -> i64 {\n"
+    "    let s = make(false);\n"
+    "    return total(make(true), 2) + s.scale(5) + make(true).scale(2);\n"
+    "}\n";
+
+void emits_an_entry_point_for_main(void)
+{
+    compile("function main() -> i64 { return 3; }\n", OPT_DEFAULT_PASSES);
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\t.globl dash.main\n"));
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "main:\n\tsub rsp, 8\n\tcall dash.main\n"));
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "dash.main:\n.L0_0:\n\tmov eax, 3\n\tret\n"));
+}
+
+void fuses_compares_into_branches(void)
+{
+    compile("function count(n: i64) -> i64 {\n"
+            "    let i: i64 = 0;\n"
+            "    for i < n { i += 1; }\n"
+            "    return i;\n"
+            "}\n",
+        OPT_DEFAULT_PASSES);
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\tcmp "));
+    TEST_ASSERT_NULL(strstr(assembly, "\tset"));
+    TEST_ASSERT_NULL(strstr(assembly, "push rbp"));
+}
+
+void keeps_values_across_calls_in_callee_saved_registers(void)
+{
+    compile("function id(x: i64) -> i64 { return x; }\n"
+            "function twice(x: i64) -> i64 { return id(x) + id(x); }\n",
+        "");
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\tpush rbx\n"));
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\tmov rbx, rdi\n"));
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\tpop rbx\n"));
+}
+
+void emits_vtables_as_data(void)
+{
+    compile(shapes_source, "");
+    TEST_ASSERT_NOT_NULL(strstr(assembly, ".Lvtable0:\n\t.quad dash.Square.area.0\n"
+                                          "\t.quad dash.Square.scale.1\n"));
+    TEST_ASSERT_NOT_NULL(strstr(assembly, "\tcall r10\n"));
+}
+
+void runs_recursion(void)
+{
+    TEST_ASSERT_EQUAL_INT(109,
+        run("function fib(n: i64) -> i64 {\n"
+            "    if n < 2 { return n; }\n"
+            "    return fib(n - 1) + fib(n - 2);\n"
+            "}\n"
+            "function main() -> i64 { return fib(20) % 256; }\n",
+            OPT_DEFAULT_PASSES));
+}
+
+void runs_phi_cycles(void)
+{
+    const char *source = "function rotate(n: i64) -> i64 {\n"
+                         "    let a: i64 = 1;\n"
+                         "    let b: i64 = 2;\n"
+                         "    let c: i64 = 3;\n"
+                         "    for n > 0 { let t = a; a = b; b = c; c = t; n -= 1; }\n"
+                         "    return a * 100 + b * 10 + c;\n"
+                         "}\n"
+                         "function main() -> i64 { return rotate(4) - rotate(3) + 100; }\n";
+    TEST_ASSERT_EQUAL_INT(208, run(source, OPT_DEFAULT_PASSES));
+}
+
+void runs_stack_arguments_and_spills(void)
+{
+    TEST_ASSERT_EQUAL_INT(82,
+        run("function many(a: i64, b: i64, c: i64, d: i64, e: i64, f: i64, g: i64, h: i64,\n"
+            "    i: i64) -> i64 {\n"
+            "    return a - b + c * 2 - d + e * 3 - f + g * 5 - h + i * 7;\n"
+            "}\n"
+            "function id(x: i64) -> i64 { return x; }\n"
+            "function pressure(n: i64) -> i64 {\n"
+            "    let a = id(n + 1); let b = id(n + 2); let c = id(n + 3);\n"
+            "    let d = id(n + 4); let e = id(n + 5); let f = id(n + 6);\n"
+            "    let g = id(n + 7); let h = id(n + 8); let i = id(n + 9);\n"
+            "    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9;\n"
+            "}\n"
+            "function main() -> i64 {\n"
+            "    return many(1, 2, 3, 4, 5, 6, 7, 8, 9) + many(9, 8, 7, 6, 5, 4, 3, 2, 1)\n"
+            "        + pressure(1) - 388;\n"
+            "}\n",
+            ""));
+}
+
+void runs_narrow_arithmetic(void)
+{
+    TEST_ASSERT_EQUAL_INT(31,
+        run("function wrap(x: i8) -> i8 { return x + 100; }\n"
+            "function uwrap(x: u8) -> u8 { return x * 3; }\n"
+            "function udiv(x: u64, y: u64) -> u64 { return x / y; }\n"
+            "function sdiv(x: i64, y: i64) -> i64 { return x / y; }\n"
+            "function smod(x: i32, y: i32) -> i32 { return x % y; }\n"
+            "function main() -> i64 {\n"
+            "    let ok: i64 = 0;\n"
+            "    if wrap(100) == -56 { ok += 1; }\n"
+            "    if uwrap(100) == 44 { ok += 2; }\n"
+            "    if udiv(0 - 1, 2) > 1000 { ok += 4; }\n"
+            "    if sdiv(0 - 7, 2) == -3 { ok += 8; }\n"
+            "    if smod(0 - 7, 3) == -1 { ok += 16; }\n"
+            "    return ok;\n"
+            "}\n",
+            ""));
+}
+
+void runs_division_with_a_third_parameter(void)
+{
+    /* The third parameter arrives in rdx, which cqo and idiv overwrite */
+    const char *source = "function by_third(a: i64, b: i64, c: i64) -> i64 { return a / c + b; }\n"
+                         "function after(a: i64, b: i64, c: i64) -> i64 {\n"
+                         "    let q: i64 = a / b;\n"
+                         "    let r: i64 = a % b;\n"
+                         "    return q + r + c;\n"
+                         "}\n"
+                         "function unsigned_third(a: u64, b: u64, c: u64) -> u64 {\n"
+                         "    return a % c * c;\n"
+                         "}\n"
+                         "function main() -> i64 {\n"
+                         "    let ok: i64 = 0;\n"
+                         "    if by_third(20, 3, 4) == 8 { ok += 1; }\n"
+                         "    if after(100, 7, 5) == 21 { ok += 2; }\n"
+                         "    if unsigned_third(23, 1, 5) == 15 { ok += 4; }\n"
+                         "    return ok;\n"
+                         "}\n";
+    TEST_ASSERT_EQUAL_INT(7, run(source, ""));
+}
+
+void runs_switches(void)
+{
+    const char *source = "function pick(x: i64) -> i64 {\n"
+                         "    switch x {\n"
+                         "        1: return 10; 2: return 20; 3: return 30;\n"
+                         "        4: return 40; 5: return 50; 6: return 60;\n"
+                         "        default: return 7;\n"
+                         "    }\n"
+                         "    return 0;\n"
+                         "}\n"
+                         "function bits(x: i64) -> i64 {\n"
+                         "    switch x { 1, 3, 5, 7, 9, 11: return 1; default: return 2; }\n"
+                         "    return 0;\n"
+                         "}\n"
+                         "function main() -> i64 {\n"
+                         "    let s: i64 = 0;\n"
+                         "    let i: i64 = 0;\n"
+                         "    for i < 12 { s += pick(i) + bits(i) * 100; i += 1; }\n"
+                         "    return s % 256;\n"
+                         "}\n";
+    TEST_ASSERT_EQUAL_INT(4, run(source, OPT_DEFAULT_PASSES));
+}
+
+void runs_interface_dispatch(void)
+{
+    TEST_ASSERT_EQUAL_INT(42, run(shapes_source, ""));
+}
+
+void runs_interface_dispatch_optimized(void)
+{
+    TEST_ASSERT_EQUAL_INT(42, run(shapes_source, OPT_DEFAULT_PASSES));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(emits_an_entry_point_for_main);
+    RUN_TEST(fuses_compares_into_branches);
+    RUN_TEST(keeps_values_across_calls_in_callee_saved_registers);
+    RUN_TEST(emits_vtables_as_data);
+    RUN_TEST(runs_recursion);
+    RUN_TEST(runs_phi_cycles);
+    RUN_TEST(runs_stack_arguments_and_spills);
+    RUN_TEST(runs_narrow_arithmetic);
+    RUN_TEST(runs_division_with_a_third_parameter);
+    RUN_TEST(runs_switches);
+    RUN_TEST(runs_interface_dispatch);
+    RUN_TEST(runs_interface_dispatch_optimized);
+    return UNITY_END();
+}